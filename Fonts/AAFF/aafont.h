@@ -0,0 +1,38 @@
+// Anti-aliased font structures, fonts are made by Tools/aaff_pack.py
+//
+// Each glyph is a coverage bitmap of 2 or 4 bits per pixel, scanned row by row
+// and run length encoded as one stream per glyph. Runs continue across rows:
+//   0x00-0x3F  n+1 pixels with no coverage (background)
+//   0x40-0x7F  (n&0x3F)+1 pixels with full coverage (text colour)
+//   0x80-0xFF  (n&0x7F)+1 pixels of partial coverage follow, packed MSB first
+//              at bpp bits each and padded to a whole byte
+// Most of a glyph is background or solid so the stream is little bigger than
+// a 1bpp RLE font, while the edges are blended.
+#pragma once
+
+#ifdef LOAD_AAFF
+
+typedef struct { // Data stored PER GLYPH
+    uint32_t dataOffset; // Offset of the RLE stream in AAfont->data
+    uint8_t width, height; // Bitmap dimensions in pixels
+    uint8_t xAdvance; // Distance to advance cursor (x axis)
+    int8_t xOffset, yOffset; // Dist from cursor pos on the baseline to UL corner
+} AAglyph;
+
+typedef struct { // Optional sparse code point map, as GFXrange
+    uint16_t first, last; // Inclusive Unicode extents of this run
+    uint16_t glyphIndex; // Index in AAfont->glyph of the glyph for 'first'
+} AArange;
+
+typedef struct { // Data stored for FONT AS A WHOLE
+    uint8_t *data; // Glyph RLE streams, concatenated
+    AAglyph *glyph; // Glyph array
+    uint16_t first, last; // Unicode extents
+    uint8_t yAdvance; // Newline distance (y axis)
+    uint8_t ascent; // Baseline distance from the top of a line
+    uint8_t bpp; // Coverage bits per pixel, 2 or 4
+    AArange *range; // Runs sorted by code point, NULL = contiguous first..last
+    uint16_t rangeCount; // Number of entries in range
+} AAfont;
+
+#endif // LOAD_AAFF
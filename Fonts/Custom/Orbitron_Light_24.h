@@ -196,4 +196,4 @@ const GFXglyph Orbitron_Light_24Glyphs[] PROGMEM = {
 	  {  2521,   5,  17,   8,    1,  -17 } // '}'
 };
 const GFXfont Orbitron_Light_24 PROGMEM = {
-(uint8_t  *)Orbitron_Light_24Bitmaps,(GFXglyph *)Orbitron_Light_24Glyphs,0x20, 0x7D, 24};
+(uint8_t  *)Orbitron_Light_24Bitmaps,(GFXglyph *)Orbitron_Light_24Glyphs,0x20, 0x7D, 24, NULL, 0};
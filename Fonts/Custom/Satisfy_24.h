@@ -196,4 +196,4 @@ const GFXglyph Satisfy_24Glyphs[] PROGMEM = {
 	  {  2595,  10,  24,   7,   -3,  -21 } // '}'
 };
 const GFXfont Satisfy_24 PROGMEM = {
-(uint8_t  *)Satisfy_24Bitmaps,(GFXglyph *)Satisfy_24Glyphs,0x20, 0x7D, 36};
+(uint8_t  *)Satisfy_24Bitmaps,(GFXglyph *)Satisfy_24Glyphs,0x20, 0x7D, 36, NULL, 0};
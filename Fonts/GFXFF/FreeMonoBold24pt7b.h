@@ -667,6 +667,6 @@ const GFXglyph FreeMonoBold24pt7bGlyphs[] PROGMEM = {
 const GFXfont FreeMonoBold24pt7b PROGMEM = {
   (uint8_t  *)FreeMonoBold24pt7bBitmaps,
   (GFXglyph *)FreeMonoBold24pt7bGlyphs,
-  0x20, 0x7E, 47 };
+  0x20, 0x7E, 47, NULL, 0 };
 
 // Approx. 7469 bytes
@@ -638,6 +638,6 @@ const GFXglyph FreeMonoOblique24pt7bGlyphs[] PROGMEM = {
 const GFXfont FreeMonoOblique24pt7b PROGMEM = {
   (uint8_t  *)FreeMonoOblique24pt7bBitmaps,
   (GFXglyph *)FreeMonoOblique24pt7bGlyphs,
-  0x20, 0x7E, 47 };
+  0x20, 0x7E, 47, NULL, 0 };
 
 // Approx. 7124 bytes
@@ -222,6 +222,6 @@ const GFXglyph FreeSansBoldOblique9pt7bGlyphs[] PROGMEM = {
 const GFXfont FreeSansBoldOblique9pt7b PROGMEM = {
   (uint8_t  *)FreeSansBoldOblique9pt7bBitmaps,
   (GFXglyph *)FreeSansBoldOblique9pt7bGlyphs,
-  0x20, 0x7E, 22 };
+  0x20, 0x7E, 22, NULL, 0 };
 
 // Approx. 2136 bytes
@@ -424,6 +424,6 @@ const GFXglyph FreeSerif18pt7bGlyphs[] PROGMEM = {
 const GFXfont FreeSerif18pt7b PROGMEM = {
   (uint8_t  *)FreeSerif18pt7bBitmaps,
   (GFXglyph *)FreeSerif18pt7bGlyphs,
-  0x20, 0x7E, 42 };
+  0x20, 0x7E, 42, NULL, 0 };
 
 // Approx. 4558 bytes
@@ -457,6 +457,6 @@ const GFXglyph FreeSerifBold18pt7bGlyphs[] PROGMEM = {
 const GFXfont FreeSerifBold18pt7b PROGMEM = {
   (uint8_t  *)FreeSerifBold18pt7bBitmaps,
   (GFXglyph *)FreeSerifBold18pt7bGlyphs,
-  0x20, 0x7E, 42 };
+  0x20, 0x7E, 42, NULL, 0 };
 
 // Approx. 4945 bytes
@@ -754,6 +754,6 @@ const GFXglyph FreeSerifBold24pt7bGlyphs[] PROGMEM = {
 const GFXfont FreeSerifBold24pt7b PROGMEM = {
   (uint8_t  *)FreeSerifBold24pt7bBitmaps,
   (GFXglyph *)FreeSerifBold24pt7bGlyphs,
-  0x20, 0x7E, 56 };
+  0x20, 0x7E, 56, NULL, 0 };
 
 // Approx. 8519 bytes
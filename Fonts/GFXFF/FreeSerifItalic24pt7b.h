@@ -732,6 +732,6 @@ const GFXglyph FreeSerifItalic24pt7bGlyphs[] PROGMEM = {
 const GFXfont FreeSerifItalic24pt7b PROGMEM = {
   (uint8_t  *)FreeSerifItalic24pt7bBitmaps,
   (GFXglyph *)FreeSerifItalic24pt7bGlyphs,
-  0x20, 0x7E, 56 };
+  0x20, 0x7E, 56, NULL, 0 };
 
 // Approx. 8251 bytes
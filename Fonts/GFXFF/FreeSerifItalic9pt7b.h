@@ -197,6 +197,6 @@ const GFXglyph FreeSerifItalic9pt7bGlyphs[] PROGMEM = {
 const GFXfont FreeSerifItalic9pt7b PROGMEM = {
   (uint8_t  *)FreeSerifItalic9pt7bBitmaps,
   (GFXglyph *)FreeSerifItalic9pt7bGlyphs,
-  0x20, 0x7E, 22 };
+  0x20, 0x7E, 22, NULL, 0 };
 
 // Approx. 1835 bytes
@@ -16,11 +16,19 @@ typedef struct { // Data stored PER GLYPH
     int8_t xOffset, yOffset; // Dist from cursor pos to UL corner
 } GFXglyph;
 
+typedef struct { // Optional sparse code point map, one entry PER RUN of glyphs
+    uint16_t first, last; // Inclusive Unicode extents of this run
+    uint16_t glyphIndex; // Index in GFXfont->glyph of the glyph for 'first'
+} GFXrange;
+
 typedef struct { // Data stored for FONT AS A WHOLE:
     uint8_t *bitmap; // Glyph bitmaps, concatenated
     GFXglyph *glyph; // Glyph array
-    uint16_t first, last; // ASCII extents
+    uint16_t first, last; // ASCII extents (overall extents if range is used)
     uint8_t yAdvance; // Newline distance (y axis)
+    // Sparse fonts only (see Tools/gfxff_pack.py), NULL and 0 in the original fonts
+    GFXrange *range; // Runs sorted by code point, binary searched, NULL = contiguous first..last
+    uint16_t rangeCount; // Number of entries in range
 } GFXfont;
 
 extern const GFXfont TomThumb;
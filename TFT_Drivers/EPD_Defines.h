@@ -1,20 +1,32 @@
-// Null set for ePaper
-#define TFT_WIDTH  1000
-#define TFT_HEIGHT 1000
+// ePaper, drawn into a framebuffer by display_hal_epd.c which decodes the MIPI DCS
+// window and memory commands below, so these are not sent to any panel
 
-#define TFT_INIT_DELAY 0
+// Panel size in its native orientation, set in the setup file
+#ifndef TFT_WIDTH
+#define TFT_WIDTH  128
+#endif
+#ifndef TFT_HEIGHT
+#define TFT_HEIGHT 296
+#endif
+
+#ifndef EPD_BPP
+#define EPD_BPP 1 // 1 (black and white) or 2 (4 grey levels) bits per pixel
+#endif
+
+#define TFT_INIT_DELAY 0x80
 
 #define TFT_NOP     0x00
-#define TFT_SWRST   0x00
+#define TFT_SWRST   0x01 // Clears the framebuffer to white, the next flush is a full refresh
 
-#define TFT_CASET   0x00
-#define TFT_PASET   0x00
-#define TFT_RAMWR   0x00
+#define TFT_CASET   0x2A
+#define TFT_PASET   0x2B
+#define TFT_RAMWR   0x2C
 
-#define TFT_RAMRD   0x00
+#define TFT_RAMRD   0x2E
 #define TFT_IDXRD   0x00
 
-#define TFT_MADCTL  0x00
+// Takes the rotation 0-3 rather than MADCTL bits
+#define TFT_MADCTL  0x36
 #define TFT_MAD_MY  0x00
 #define TFT_MAD_MX  0x00
 #define TFT_MAD_MV  0x00
@@ -23,5 +35,5 @@
 #define TFT_MAD_MH  0x00
 #define TFT_MAD_RGB 0x00
 
-#define TFT_INVOFF  0x00
-#define TFT_INVON   0x00
+#define TFT_INVOFF  0x20
+#define TFT_INVON   0x21
@@ -0,0 +1,16 @@
+
+// This is the command sequence that rotates the ePaper framebuffer coordinate frame
+
+  rotation = m % 4; // Limit the range of values to 0-3
+
+  writecommand(TFT_MADCTL);
+  writedata(rotation);
+
+  if (rotation & 1) {
+    _width  = _init_height;
+    _height = _init_width;
+  }
+  else {
+    _width  = _init_width;
+    _height = _init_height;
+  }
@@ -0,0 +1,96 @@
+
+// Built-in driver table used when TFT_RUNTIME_DRIVER is defined, see displayDriverTable()
+//
+// The init sequences are in the format accepted by the commandList() function and
+// are the ILI9341_Init.h and ST7789_Init.h sequences with the command names expanded
+// so that both controllers can be built into one image. Both use the MIPI DCS
+// CASET/PASET/RAMWR window so no window function is needed
+
+static const uint8_t PROGMEM ili9341Init[] = {
+    21,                       // 21 commands in list:
+    0xEF, 3, 0x03, 0x80, 0x02,
+    0xCF, 3, 0x00, 0xC1, 0x30,
+    0xED, 4, 0x64, 0x03, 0x12, 0x81,
+    0xE8, 3, 0x85, 0x00, 0x78,
+    0xCB, 5, 0x39, 0x2C, 0x00, 0x34, 0x02,
+    0xF7, 1, 0x20,
+    0xEA, 2, 0x00, 0x00,
+    0xC0, 1, 0x23,            // PWCTR1, VRH[5:0]
+    0xC1, 1, 0x10,            // PWCTR2, SAP[2:0];BT[3:0]
+    0xC5, 2, 0x3E, 0x28,      // VMCTR1
+    0xC7, 1, 0x86,            // VMCTR2
+    0x36, 1, 0x48,            // MADCTL, set again by setRotation()
+    0x3A, 1, 0x55,            // PIXFMT, 16 bits per pixel
+    0xB1, 2, 0x00, 0x13,      // FRMCTR1
+    0xB6, 3, 0x08, 0x82, 0x27, // DFUNCTR
+    0xF2, 1, 0x00,            // 3Gamma function disable
+    0x26, 1, 0x01,            // GAMMASET, gamma curve selected
+    0xE0, 15,                 // GMCTRP1, set gamma
+      0x0F, 0x31, 0x2B, 0x0C, 0x0E, 0x08, 0x4E, 0xF1,
+      0x37, 0x07, 0x10, 0x03, 0x0E, 0x09, 0x00,
+    0xE1, 15,                 // GMCTRN1, set gamma
+      0x00, 0x0E, 0x14, 0x03, 0x11, 0x07, 0x31, 0xC1,
+      0x48, 0x08, 0x0F, 0x0C, 0x31, 0x36, 0x0F,
+    0x11, TFT_INIT_DELAY,     // SLPOUT, exit sleep
+      120,
+    0x29, 0                   // DISPON, display on
+};
+
+static const uint8_t PROGMEM st7789Init[] = {
+    21,                       // 21 commands in list:
+    0x11, TFT_INIT_DELAY,     // SLPOUT, sleep out
+      120,
+    0x13, 0,                  // NORON, normal display mode on
+    0x36, 1, 0x00,            // MADCTL, set again by setRotation()
+    0xB6, 2, 0x0A, 0x82,      // JLX240 display datasheet
+    0xB0, 2, 0x00, 0xE0,      // RAMCTRL, 5 to 6-bit conversion: r0 = r5, b0 = b5
+    0x3A, 1 + TFT_INIT_DELAY, 0x55, // COLMOD, 16 bits per pixel
+      10,
+    0xB2, 5, 0x0C, 0x0C, 0x00, 0x33, 0x33, // PORCTRL
+    0xB7, 1, 0x35,            // GCTRL, voltages VGH / VGL
+    0xBB, 1, 0x28,            // VCOMS
+    0xC0, 1, 0x0C,            // LCMCTRL
+    0xC2, 2, 0x01, 0xFF,      // VDVVRHEN
+    0xC3, 1, 0x10,            // VRHS
+    0xC4, 1, 0x20,            // VDVSET
+    0xC6, 1, 0x0F,            // FRCTR2
+    0xD0, 2, 0xA4, 0xA1,      // PWCTRL1
+    0xE0, 14,                 // PVGAMCTRL
+      0xD0, 0x00, 0x02, 0x07, 0x0A, 0x28, 0x32, 0x44,
+      0x42, 0x06, 0x0E, 0x12, 0x14, 0x17,
+    0xE1, 14,                 // NVGAMCTRL
+      0xD0, 0x00, 0x02, 0x07, 0x0A, 0x28, 0x31, 0x54,
+      0x47, 0x0E, 0x1C, 0x17, 0x1B, 0x1E,
+    0x21, 0,                  // INVON
+    0x2A, 4, 0x00, 0x00, 0x00, 0xEF, // CASET, 0 to 239
+    0x2B, 4 + TFT_INIT_DELAY, 0x00, 0x00, 0x01, 0x3F, // RASET, 0 to 319
+      120,
+    0x29, TFT_INIT_DELAY,     // DISPON, display on
+      120
+};
+
+// ST7789 first, its RDDID is 0x858552. The ILI9341 returns no fixed RDDID so it
+// is the fallback for any other panel
+static const tftDriver builtinDrivers[] = {
+    {
+        .id = 0x7789,
+        .rddid = 0x858552, .rddidMask = 0xFFFFFF,
+        .init = st7789Init,
+        .madctl = { 0x00, 0x60, 0xC0, 0xA0 }, // None, MX MV, MX MY, MV MY
+        .rotations = 4,
+        .colourOrder = 0x00, // RGB
+        .read = TFT_READ_RGB666,
+        .depth = 16,
+        // 240 x 320 panels, offsets for e.g. 240 x 240 panels go in an application table
+    },
+    {
+        .id = 0x9341,
+        .rddid = 0, .rddidMask = 0,
+        .init = ili9341Init,
+        .madctl = { 0x40, 0x20, 0x80, 0xE0, 0xC0, 0x60, 0x00, 0xA0 },
+        .rotations = 8,
+        .colourOrder = 0x08, // BGR
+        .read = TFT_READ_RGB666,
+        .depth = 16,
+    },
+};
@@ -62,7 +62,11 @@
   writedata(0x21 | TFT_MAD_COLOR_ORDER);
 
   writecommand(0xF0);   //pixel data interface
+#ifdef TFT_PARALLEL_16_BIT
+  writedata(0x03);      //16-bit bus, RGB565
+#else
   writedata(0x00);      //8-bit bus
+#endif
 
   delay(1);
 
@@ -166,7 +170,11 @@
   writedata(0x21 | TFT_MAD_COLOR_ORDER);
 
   writecommand(0xF0);   //pixel data interface
+#ifdef TFT_PARALLEL_16_BIT
+  writedata(0x03);      //16-bit bus, RGB565
+#else
   writedata(0x00);      //8-bit bus
+#endif
 
   delay(1);
 
@@ -270,7 +278,11 @@
   writedata(0x21 | TFT_MAD_COLOR_ORDER);    // -- Set rotation
 
   writecommand(0xF0);   //pixel data interface
+#ifdef TFT_PARALLEL_16_BIT
+  writedata(0x03);      //16-bit bus, RGB565
+#else
   writedata(0x00);      //8-bit bus
+#endif
 
   delay(10);
 
@@ -371,7 +383,11 @@
 	//writedata(0x0050);    //16-bit/pixel
 
   writecommand(0xF0);   //pixel data interface
+#ifdef TFT_PARALLEL_16_BIT
+  writedata(0x03);      //16-bit bus, RGB565
+#else
   writedata(0x00);      //000 = 8-bit bus, 011 = 16-bit, 110 = 9-bit
+#endif
 
   writecommand(0xBC);
   writedata(0x40);     //contrast value
@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+"""
+Pack a subset of a font into a compact anti-aliased header for the
+LOAD_AAFF renderer, 2 or 4 bits of coverage per pixel.
+
+Coverage comes from freetype-py grey scale rendering for TTF/OTF input, or
+from a BDF drawn at --oversample times the target size which is box
+filtered down. Each glyph is run length coded (see Fonts/AAFF/aafont.h):
+runs of empty and fully covered pixels cost one byte, so only the edge
+pixels are stored as literals and most glyphs are far smaller than a
+bitmap at the same bit depth.
+
+Usage:
+  aaff_pack.py font.ttf Name --size 20 --bpp 4 --chars 0x20-0x7E > Name.h
+  aaff_pack.py big.bdf Name --oversample 4 --bpp 2 --text strings.txt > Name.h
+
+--chars and --text work as for gfxff_pack.py. The generated font replaces
+font 1 until another font is selected:
+  #include "Name.h"
+  setAAFont(&Name);
+"""
+
+import argparse
+import sys
+
+from gfxff_pack import load_bdf, make_runs, comment, parse_chars
+
+
+class AAGlyph:
+    def __init__(self, code, width, height, x_advance, x_offset, y_offset, cover):
+        self.code = code
+        self.width = width
+        self.height = height
+        self.x_advance = x_advance
+        self.x_offset = x_offset
+        self.y_offset = y_offset
+        self.cover = cover  # list of rows of 0-255 coverage values
+
+
+def load_freetype_gray(path, size, wanted):
+    try:
+        import freetype
+    except ImportError:
+        raise SystemExit("TTF/OTF input needs freetype-py (pip install freetype-py)")
+    face = freetype.Face(path)
+    face.set_pixel_sizes(0, size)
+    glyphs = {}
+    for code in sorted(wanted):
+        if face.get_char_index(code) == 0:
+            continue
+        face.load_char(code, freetype.FT_LOAD_RENDER)
+        bmp = face.glyph.bitmap
+        cover = [list(bmp.buffer[y * bmp.pitch:y * bmp.pitch + bmp.width]) for y in range(bmp.rows)]
+        glyphs[code] = AAGlyph(code, bmp.width, bmp.rows, face.glyph.advance.x >> 6,
+                               face.glyph.bitmap_left, -face.glyph.bitmap_top, cover)
+    return glyphs, face.size.height >> 6, face.size.ascender >> 6
+
+
+def downsample(glyph, n):
+    # Align the box to the n x n grid in baseline relative coordinates
+    x0 = glyph.x_offset // n
+    y0 = glyph.y_offset // n
+    x1 = -((-(glyph.x_offset + glyph.width)) // n)
+    y1 = -((-(glyph.y_offset + glyph.height)) // n)
+    w, h = x1 - x0, y1 - y0
+    cover = [[0] * w for _ in range(h)]
+    for y, row in enumerate(glyph.rows):
+        for x, bit in enumerate(row):
+            if bit:
+                cover[(glyph.y_offset + y) // n - y0][(glyph.x_offset + x) // n - x0] += 1
+    area = n * n
+    cover = [[(c * 255 + area // 2) // area for c in row] for row in cover]
+    return AAGlyph(glyph.code, w, h, (glyph.x_advance + n // 2) // n, x0, y0, cover)
+
+
+def trim(glyph):
+    # Drop empty border rows and columns so the box is as small as possible
+    rows = [y for y in range(glyph.height) if any(glyph.cover[y])]
+    cols = [x for x in range(glyph.width) if any(row[x] for row in glyph.cover)]
+    if not rows:
+        return AAGlyph(glyph.code, 0, 0, glyph.x_advance, 0, 0, [])
+    cover = [row[cols[0]:cols[-1] + 1] for row in glyph.cover[rows[0]:rows[-1] + 1]]
+    return AAGlyph(glyph.code, len(cols), len(rows), glyph.x_advance,
+                   glyph.x_offset + cols[0], glyph.y_offset + rows[0], cover)
+
+
+def encode(glyph, bpp):
+    top = (1 << bpp) - 1
+    values = [(c * top + 127) // 255 for row in glyph.cover for c in row]
+    out = []
+    i = 0
+    while i < len(values):
+        v = values[i]
+        if v == 0 or v == top:
+            n = 1
+            while i + n < len(values) and values[i + n] == v and n < 64:
+                n += 1
+            out.append((0x00 if v == 0 else 0x40) | (n - 1))
+            i += n
+            continue
+        # Literal run, ends where a run of two or more empty or full pixels starts
+        n = 1
+        while i + n < len(values) and n < 128:
+            if values[i + n] in (0, top) and i + n + 1 < len(values) and values[i + n + 1] == values[i + n]:
+                break
+            n += 1
+        out.append(0x80 | (n - 1))
+        acc = bits = 0
+        for value in values[i:i + n]:
+            acc = (acc << bpp) | value
+            bits += bpp
+            if bits == 8:
+                out.append(acc)
+                acc = bits = 0
+        if bits:
+            out.append(acc << (8 - bits))
+        i += n
+    return out
+
+
+def emit(name, glyphs, y_advance, ascent, bpp, out):
+    codes = sorted(glyphs)
+    if not codes:
+        raise SystemExit("no requested glyphs found in font")
+    runs = make_runs(codes)
+
+    data = []
+    offsets = {}
+    for code in codes:
+        offsets[code] = len(data)
+        data.extend(encode(glyphs[code], bpp))
+
+    out.write("// Generated by Tools/aaff_pack.py, %d glyphs in %d ranges, %d bpp\n\n" % (len(codes), len(runs), bpp))
+    out.write("const uint8_t %sData[] PROGMEM = {\n" % name)
+    for i in range(0, len(data), 12):
+        out.write("  " + ", ".join("0x%02X" % b for b in data[i:i + 12]) + ",\n")
+    out.write("  0x00 };\n\n")
+
+    out.write("const AAglyph %sGlyphs[] PROGMEM = {\n" % name)
+    for i, code in enumerate(codes):
+        g = glyphs[code]
+        sep = " }," if i + 1 < len(codes) else " } };"
+        out.write("  { %6d, %3d, %3d, %3d, %4d, %4d%s   // %s\n" % (
+            offsets[code], g.width, g.height, g.x_advance, g.x_offset, g.y_offset, sep, comment(code)))
+    out.write("\n")
+
+    out.write("const AArange %sRanges[] PROGMEM = {\n" % name)
+    index = 0
+    for i, (first, last) in enumerate(runs):
+        sep = " }," if i + 1 < len(runs) else " } };"
+        out.write("  { 0x%04X, 0x%04X, %5d%s\n" % (first, last, index, sep))
+        index += last - first + 1
+    out.write("\n")
+
+    out.write("const AAfont %s PROGMEM = {\n" % name)
+    out.write("  (uint8_t  *)%sData,\n" % name)
+    out.write("  (AAglyph *)%sGlyphs,\n" % name)
+    out.write("  0x%04X, 0x%04X, %d, %d, %d,\n" % (codes[0], codes[-1], y_advance, ascent, bpp))
+    out.write("  (AArange *)%sRanges, %d };\n\n" % (name, len(runs)))
+    out.write("// Approx. %d bytes\n" % (len(data) + len(codes) * 12 + len(runs) * 6 + 20))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("font", help="BDF, TTF or OTF font file")
+    ap.add_argument("name", help="C identifier of the generated AAfont")
+    ap.add_argument("--chars", action="append", default=[], help="code point or range, e.g. 0x20-0x7E")
+    ap.add_argument("--text", action="append", default=[], help="UTF-8 file, every character is included")
+    ap.add_argument("--size", type=int, default=16, help="pixel size for TTF/OTF input")
+    ap.add_argument("--bpp", type=int, choices=(2, 4), default=4, help="coverage bits per pixel")
+    ap.add_argument("--oversample", type=int, default=4, help="BDF scale factor relative to the output")
+    args = ap.parse_args()
+
+    wanted = set()
+    for spec in args.chars:
+        wanted |= parse_chars(spec)
+    for path in args.text:
+        with open(path, "r", encoding="utf-8") as f:
+            wanted |= {ord(c) for c in f.read() if c not in "\r\n"}
+    if not wanted:
+        wanted = set(range(0x20, 0x7F))
+    wanted = {c for c in wanted if c <= 0xFFFF}
+
+    if args.font.lower().endswith(".bdf"):
+        n = max(1, args.oversample)
+        mono, y_advance = load_bdf(args.font, wanted)
+        glyphs = {code: downsample(g, n) for code, g in mono.items()}
+        y_advance = (y_advance + n - 1) // n
+        ascent = max([0] + [-g.y_offset for g in glyphs.values()])
+    else:
+        glyphs, y_advance, ascent = load_freetype_gray(args.font, args.size, wanted)
+
+    glyphs = {code: trim(g) for code, g in glyphs.items()}
+    ascent = max([ascent] + [-g.y_offset for g in glyphs.values() if g.height])
+
+    missing = wanted - set(glyphs)
+    if missing:
+        sys.stderr.write("warning: %d code points not in font\n" % len(missing))
+
+    emit(args.name, glyphs, y_advance, ascent, args.bpp, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""
+Convert a sequence of PNG frames into a delta coded RGB565 clip played by
+clipFrame() or clipUpdate() when LOAD_CLIP is defined.
+
+Usage:
+  clip565_pack.py Name frame*.png > Name.h
+  clip565_pack.py Name frame*.png --fps 25 --gap 16 --bin wipe.clip > Name.h
+
+Frames must all be the same size and are given in play order. Pixels are
+converted to RGB565 as color565() does, any alpha is blended with --bg
+(RGB888, default black) first. The first frame is stored whole, the rest
+only as the rectangles that differ from the frame before. Unchanged gaps
+of up to --gap pixels (default 8) inside a row are sent again rather
+than starting a new rectangle, and rows changed over the same columns are
+merged into one rectangle.
+
+The generated array is played with:
+  #include "Name.h"
+  clipPlayer clip;
+  if (clipOpen(&clip, Name, sizeof(Name), NULL, NULL))
+    while (clipUpdate(&clip, x, y, ms)) ... // ms from a free running clock
+
+Format, all values little endian u16:
+  header  "C565", width, height, frame count, ms per frame
+  then for each frame the number of rectangles followed by, for each,
+  x, y, w, h and ops giving its w * h pixels row by row:
+    0nnnnnnn nnnnnnnn   n literal RGB565 pixels follow
+    1nnnnnnn nnnnnnnn   one RGB565 pixel follows, repeated n times
+  Ops may span rows but not rectangles.
+"""
+
+import argparse
+import struct
+import sys
+
+from q565_pack import read_png, to565
+
+
+def row_spans(prev, cur, width, y, gap):
+    spans = []
+    x = 0
+    while x < width:
+        if prev[y * width + x] == cur[y * width + x]:
+            x += 1
+            continue
+        start = x
+        end = x + 1
+        x += 1
+        # Extend over short unchanged gaps
+        while x < width:
+            if prev[y * width + x] != cur[y * width + x]:
+                end = x + 1
+            elif x - end >= gap:
+                break
+            x += 1
+        spans.append((start, end))
+        x = end
+    return spans
+
+
+def frame_rects(prev, cur, width, height, gap):
+    if prev is None:
+        return [(0, 0, width, height)]
+
+    rects = []
+    open_rects = {}  # (x0, x1) -> index of the rectangle ending on the row above
+    for y in range(height):
+        next_open = {}
+        for x0, x1 in row_spans(prev, cur, width, y, gap):
+            i = open_rects.get((x0, x1))
+            if i is not None:
+                rx, ry, rw, rh = rects[i]
+                rects[i] = (rx, ry, rw, rh + 1)
+            else:
+                i = len(rects)
+                rects.append((x0, y, x1 - x0, 1))
+            next_open[(x0, x1)] = i
+        open_rects = next_open
+    return rects
+
+
+def encode_pixels(pixels):
+    words = []
+    lit = []
+
+    def flush():
+        if lit:
+            words.append(len(lit))
+            words.extend(lit)
+            del lit[:]
+
+    i = 0
+    while i < len(pixels):
+        n = 1
+        while i + n < len(pixels) and pixels[i + n] == pixels[i] and n < 0x7FFF:
+            n += 1
+        if n >= 3:
+            flush()
+            words.append(0x8000 | n)
+            words.append(pixels[i])
+            i += n
+        else:
+            lit.append(pixels[i])
+            if len(lit) == 0x7FFF:
+                flush()
+            i += 1
+    flush()
+    return words
+
+
+def encode(width, height, frames, period, gap):
+    words = [width, height, len(frames), period]
+    rect_count = 0
+    key_words = 0
+    prev = None
+    for cur in frames:
+        rects = frame_rects(prev, cur, width, height, gap)
+        words.append(len(rects))
+        for rx, ry, rw, rh in rects:
+            words.extend((rx, ry, rw, rh))
+            words.extend(encode_pixels([cur[(ry + j) * width + rx + i] for j in range(rh) for i in range(rw)]))
+        rect_count += len(rects)
+        if prev is None:
+            key_words = len(words) - 4
+        prev = cur
+    return b"C565" + struct.pack("<%dH" % len(words), *words), rect_count, key_words * 2
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("name", help="C identifier of the generated array")
+    ap.add_argument("frames", nargs="+", help="PNG files in play order")
+    ap.add_argument("--fps", type=float, default=30, help="frame rate, default 30")
+    ap.add_argument("--gap", type=int, default=8, help="longest unchanged run sent again inside a row")
+    ap.add_argument("--bg", default="0x000000", help="RGB888 colour that alpha is blended with")
+    ap.add_argument("--bin", help="also write the encoded clip to this file")
+    args = ap.parse_args()
+
+    bg = int(args.bg, 0)
+    bg = (bg >> 16 & 255, bg >> 8 & 255, bg & 255)
+    frames = []
+    for path in args.frames:
+        w, h, pixels = read_png(path)
+        if frames and (w, h) != (width, height):
+            raise SystemExit("%s: %dx%d, the first frame is %dx%d" % (path, w, h, width, height))
+        width, height = w, h
+        frames.append([to565(p, bg) for p in pixels])
+    if width > 0xFFFF or height > 0xFFFF or len(frames) > 0xFFFF:
+        raise SystemExit("clip too large")
+    period = min(0xFFFF, int(round(1000.0 / args.fps))) if args.fps > 0 else 0
+    data, rects, key = encode(width, height, frames, period, max(0, args.gap))
+
+    out = sys.stdout
+    out.write("// Generated by Tools/clip565_pack.py, %dx%d, %d frames at %d ms, %d rectangles\n\n" % (
+        width, height, len(frames), period, rects))
+    out.write("const uint8_t %s[] PROGMEM = {\n" % args.name)
+    for i in range(0, len(data), 12):
+        out.write("  " + ", ".join("0x%02X" % b for b in data[i:i + 12]) + ",\n")
+    out.write("};\n\n")
+    out.write("// %d bytes, %d as raw RGB565 frames\n" % (len(data), width * height * 2 * len(frames)))
+
+    if args.bin:
+        with open(args.bin, "wb") as f:
+            f.write(data)
+    sys.stderr.write("%s: %d bytes, keyframe %d, %d per frame after it\n" % (
+        args.name, len(data), key, (len(data) - 12 - key) // max(1, len(frames) - 1)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,308 @@
+#!/usr/bin/env python3
+"""
+Pack a subset of a BDF (or TTF/OTF, needs freetype-py) font into an
+Adafruit_GFX style header for the LOAD_GFXFF renderer.
+
+Only the glyphs actually needed are emitted. Code points are grouped into
+runs of consecutive values and a sorted GFXrange table is written so that
+the library can binary search any code point, e.g. a Cyrillic block plus
+a few hundred scattered CJK characters cost no more than those glyphs.
+
+Usage:
+  gfxff_pack.py font.bdf Name --chars 0x20-0x7E --chars 0x400-0x44F \
+                --text strings.txt > Name.h
+  gfxff_pack.py font.ttf Name --size 16 --text ui_strings.txt > Name.h
+
+--chars takes a single code point or an inclusive range (hex or decimal),
+--text takes a UTF-8 file whose characters are all included. Both can be
+repeated. Code points above 0xFFFF are skipped (decodeUTF8 is 16-bit).
+
+The generated font is used exactly like the bundled fonts:
+  #include "Name.h"
+  setFreeFont(&Name);
+
+With --bin FILE a flash image is written as well, for fonts kept in an
+external SPI flash and selected with setFlashFont(address, NULL) when
+LOAD_FLASH_FONT is defined. Image layout, all values little endian:
+  header  32 bytes: "GFXF", u16 version (1), u16 range count,
+          u16 glyph count, u16 first, u16 last, u8 yAdvance,
+          u8 max ascent, u8 max descent, u8 reserved, u16 max glyph bytes,
+          u32 range table offset, u32 glyph table offset,
+          u32 bitmap offset
+  ranges   6 bytes each: u16 first, u16 last, u16 glyph index
+  glyphs  10 bytes each: u32 bitmap offset, u8 width, u8 height,
+          u8 xAdvance, i8 xOffset, i8 yOffset, u8 reserved
+  bitmaps packed exactly as in the header output
+"""
+
+import argparse
+import struct
+import sys
+
+
+class Glyph:
+    def __init__(self, code, width, height, x_advance, x_offset, y_offset, rows):
+        self.code = code
+        self.width = width
+        self.height = height
+        self.x_advance = x_advance
+        self.x_offset = x_offset
+        self.y_offset = y_offset
+        self.rows = rows  # list of lists of 0/1, height x width
+
+
+def parse_int(text):
+    text = text.strip()
+    if text.lower().startswith("u+"):
+        return int(text[2:], 16)
+    return int(text, 0)
+
+
+def parse_chars(spec):
+    if "-" in spec[1:]:
+        split = spec.index("-", 1)
+        first, last = parse_int(spec[:split]), parse_int(spec[split + 1:])
+    else:
+        first = last = parse_int(spec)
+    if first > last:
+        raise SystemExit("bad range %s" % spec)
+    return set(range(first, last + 1))
+
+
+def load_bdf(path, wanted):
+    glyphs = {}
+    ascent = descent = None
+    bbox_h = 0
+    with open(path, "r", encoding="latin-1") as f:
+        lines = iter(f.read().splitlines())
+    for line in lines:
+        words = line.split()
+        if not words:
+            continue
+        if words[0] == "FONT_ASCENT":
+            ascent = int(words[1])
+        elif words[0] == "FONT_DESCENT":
+            descent = int(words[1])
+        elif words[0] == "FONTBOUNDINGBOX":
+            bbox_h = int(words[2])
+        elif words[0] == "STARTCHAR":
+            code = -1
+            dwidth = 0
+            bbx = (0, 0, 0, 0)
+            rows = []
+            for line in lines:
+                words = line.split()
+                if not words:
+                    continue
+                if words[0] == "ENCODING":
+                    code = int(words[1])
+                elif words[0] == "DWIDTH":
+                    dwidth = int(words[1])
+                elif words[0] == "BBX":
+                    bbx = tuple(int(v) for v in words[1:5])
+                elif words[0] == "BITMAP":
+                    for line in lines:
+                        if line.startswith("ENDCHAR"):
+                            break
+                        value = int(line.strip(), 16)
+                        bits = len(line.strip()) * 4
+                        rows.append([(value >> (bits - 1 - x)) & 1 for x in range(bbx[0])])
+                    break
+            if code in wanted:
+                w, h, xo, yo = bbx
+                glyphs[code] = Glyph(code, w, h, dwidth, xo, -(h + yo), rows)
+    y_advance = (ascent + descent) if ascent is not None and descent is not None else bbox_h
+    return glyphs, y_advance
+
+
+def load_freetype(path, size, wanted):
+    try:
+        import freetype
+    except ImportError:
+        raise SystemExit("TTF/OTF input needs freetype-py (pip install freetype-py)")
+    face = freetype.Face(path)
+    face.set_pixel_sizes(0, size)
+    glyphs = {}
+    for code in sorted(wanted):
+        if face.get_char_index(code) == 0:
+            continue
+        face.load_char(code, freetype.FT_LOAD_RENDER | freetype.FT_LOAD_TARGET_MONO)
+        bmp = face.glyph.bitmap
+        rows = []
+        for y in range(bmp.rows):
+            row = bmp.buffer[y * bmp.pitch:(y + 1) * bmp.pitch]
+            rows.append([(row[x >> 3] >> (7 - (x & 7))) & 1 for x in range(bmp.width)])
+        glyphs[code] = Glyph(code, bmp.width, bmp.rows, face.glyph.advance.x >> 6,
+                             face.glyph.bitmap_left, -face.glyph.bitmap_top, rows)
+    return glyphs, face.size.height >> 6
+
+
+def pack_bits(glyph):
+    out = []
+    acc = 0
+    n = 0
+    for row in glyph.rows:
+        for bit in row:
+            acc = (acc << 1) | bit
+            n += 1
+            if n == 8:
+                out.append(acc)
+                acc = n = 0
+    if n:
+        out.append(acc << (8 - n))
+    return out
+
+
+def make_runs(codes):
+    runs = []
+    for code in codes:
+        if runs and runs[-1][1] + 1 == code:
+            runs[-1][1] = code
+        else:
+            runs.append([code, code])
+    return runs
+
+
+def comment(code):
+    ch = chr(code)
+    return "0x%04X '%s'" % (code, ch) if ch.isprintable() and ch not in "\\'" else "0x%04X" % code
+
+
+def check_limits(glyphs, y_advance):
+    """Refuse fonts that GFXglyph / GFXfont fields cannot hold, C would truncate them silently"""
+    bad = []
+    total = 0
+    for code in sorted(glyphs):
+        g = glyphs[code]
+        total += (g.width * g.height + 7) // 8
+        if not (0 <= g.width <= 255 and 0 <= g.height <= 255 and 0 <= g.x_advance <= 255):
+            bad.append("%s: size %dx%d, advance %d over 255" % (comment(code), g.width, g.height, g.x_advance))
+        if not (-128 <= g.x_offset <= 127 and -128 <= g.y_offset <= 127):
+            bad.append("%s: offset %d,%d outside -128..127" % (comment(code), g.x_offset, g.y_offset))
+    if not 0 <= y_advance <= 255:
+        bad.append("line height %d over 255" % y_advance)
+    if total > 0xFFFFFFFF:
+        bad.append("%d bytes of bitmap, bitmapOffset is 32-bit" % total)
+    if bad:
+        raise SystemExit("font cannot be addressed by GFXfont:\n  " + "\n  ".join(bad[:10]))
+
+
+def emit(name, glyphs, y_advance, out):
+    codes = sorted(glyphs)
+    if not codes:
+        raise SystemExit("no requested glyphs found in font")
+    runs = make_runs(codes)
+
+    bitmaps = []
+    offsets = {}
+    for code in codes:
+        offsets[code] = len(bitmaps)
+        bitmaps.extend(pack_bits(glyphs[code]))
+
+    out.write("// Generated by Tools/gfxff_pack.py, %d glyphs in %d ranges\n\n" % (len(codes), len(runs)))
+    out.write("const uint8_t %sBitmaps[] PROGMEM = {\n" % name)
+    for i in range(0, len(bitmaps), 12):
+        out.write("  " + ", ".join("0x%02X" % b for b in bitmaps[i:i + 12]) + ",\n")
+    out.write("  0x00 };\n\n")
+
+    out.write("const GFXglyph %sGlyphs[] PROGMEM = {\n" % name)
+    for i, code in enumerate(codes):
+        g = glyphs[code]
+        sep = " }," if i + 1 < len(codes) else " } };"
+        out.write("  { %6d, %3d, %3d, %3d, %4d, %4d%s   // %s\n" % (
+            offsets[code], g.width, g.height, g.x_advance, g.x_offset, g.y_offset, sep, comment(code)))
+    out.write("\n")
+
+    out.write("const GFXrange %sRanges[] PROGMEM = {\n" % name)
+    index = 0
+    for i, (first, last) in enumerate(runs):
+        sep = " }," if i + 1 < len(runs) else " } };"
+        out.write("  { 0x%04X, 0x%04X, %5d%s\n" % (first, last, index, sep))
+        index += last - first + 1
+    out.write("\n")
+
+    out.write("const GFXfont %s PROGMEM = {\n" % name)
+    out.write("  (uint8_t  *)%sBitmaps,\n" % name)
+    out.write("  (GFXglyph *)%sGlyphs,\n" % name)
+    out.write("  0x%04X, 0x%04X, %d,\n" % (codes[0], codes[-1], y_advance))
+    out.write("  (GFXrange *)%sRanges, %d };\n\n" % (name, len(runs)))
+    out.write("// Approx. %d bytes\n" % (len(bitmaps) + len(codes) * 12 + len(runs) * 6 + 16))
+
+
+def emit_bin(glyphs, y_advance, path):
+    codes = sorted(glyphs)
+    runs = make_runs(codes)
+
+    bitmaps = []
+    offsets = {}
+    max_bytes = 0
+    for code in codes:
+        packed = pack_bits(glyphs[code])
+        offsets[code] = len(bitmaps)
+        bitmaps.extend(packed)
+        max_bytes = max(max_bytes, len(packed))
+
+    # Largest extents above and below the baseline, as setFreeFont() computes them
+    ascent = max([0] + [-glyphs[c].y_offset for c in codes])
+    descent = max([0] + [glyphs[c].height + glyphs[c].y_offset for c in codes])
+
+    ranges = b""
+    index = 0
+    for first, last in runs:
+        ranges += struct.pack("<HHH", first, last, index)
+        index += last - first + 1
+
+    table = b""
+    for code in codes:
+        g = glyphs[code]
+        table += struct.pack("<IBBBbbB", offsets[code], g.width, g.height, g.x_advance, g.x_offset, g.y_offset, 0)
+
+    range_offset = 32
+    glyph_offset = range_offset + len(ranges)
+    bitmap_offset = glyph_offset + len(table)
+    header = struct.pack("<4sHHHHHBBBBHIII", b"GFXF", 1, len(runs), len(codes), codes[0], codes[-1],
+                         y_advance, min(ascent, 255), min(descent, 255), 0, max_bytes,
+                         range_offset, glyph_offset, bitmap_offset)
+    with open(path, "wb") as f:
+        f.write(header + ranges + table + bytes(bitmaps))
+    sys.stderr.write("%s: %d bytes, largest glyph %d bytes (FLASH_FONT_CACHE_SLOT)\n" % (
+        path, bitmap_offset + len(bitmaps), max_bytes))
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("font", help="BDF, TTF or OTF font file")
+    ap.add_argument("name", help="C identifier of the generated GFXfont")
+    ap.add_argument("--chars", action="append", default=[], help="code point or range, e.g. 0x20-0x7E")
+    ap.add_argument("--text", action="append", default=[], help="UTF-8 file, every character is included")
+    ap.add_argument("--size", type=int, default=16, help="pixel size for TTF/OTF input")
+    ap.add_argument("--bin", help="also write an image for external flash (setFlashFont)")
+    args = ap.parse_args()
+
+    wanted = set()
+    for spec in args.chars:
+        wanted |= parse_chars(spec)
+    for path in args.text:
+        with open(path, "r", encoding="utf-8") as f:
+            wanted |= {ord(c) for c in f.read() if c not in "\r\n"}
+    if not wanted:
+        wanted = set(range(0x20, 0x7F))
+    wanted = {c for c in wanted if c <= 0xFFFF}
+
+    if args.font.lower().endswith(".bdf"):
+        glyphs, y_advance = load_bdf(args.font, wanted)
+    else:
+        glyphs, y_advance = load_freetype(args.font, args.size, wanted)
+
+    missing = wanted - set(glyphs)
+    if missing:
+        sys.stderr.write("warning: %d code points not in font\n" % len(missing))
+
+    check_limits(glyphs, y_advance)
+    emit(args.name, glyphs, y_advance, sys.stdout)
+    if args.bin:
+        emit_bin(glyphs, y_advance, args.bin)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,128 @@
+/***************************************************
+  Board support for the host builds: the register
+  blocks and SPL calls of stm32f4xx.h, and a clock
+  that only moves when the library waits.
+
+  A DMA stream completes the moment it is enabled.
+  hostDmaStarted, when set, sees each start.
+ ****************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "stm32f4xx.h"
+
+GPIO_TypeDef hostGPIOA, hostGPIOB, hostGPIOC, hostGPIOD, hostGPIOE;
+SPI_TypeDef hostSPI2 = { .SR = SPI_I2S_FLAG_TXE | SPI_I2S_FLAG_RXNE }; // Never busy
+DMA_Stream_TypeDef hostDMA1_Stream3, hostDMA1_Stream4, hostDMA2_Stream0;
+FSMC_Bank1E_TypeDef hostFSMC_Bank1E;
+DWT_Type hostDWT;
+CoreDebug_Type hostCoreDebug;
+
+uint32_t hostMs;
+void (*hostDmaStarted)(DMA_Stream_TypeDef *stream);
+
+static bool dmaComplete[3]; // Transfer complete flag of each stream, as dmaIndex()
+
+void delayWaitms(uint32_t ms)
+{
+    hostMs += ms;
+}
+
+void delay(uint32_t ms)
+{
+    hostMs += ms;
+}
+
+uint32_t getTicks(void)
+{
+    return hostMs;
+}
+
+void RCC_GetClocksFreq(RCC_ClocksTypeDef *clocks)
+{
+    clocks->SYSCLK_Frequency = 168000000;
+    clocks->HCLK_Frequency = 168000000;
+    clocks->PCLK1_Frequency = 42000000;
+    clocks->PCLK2_Frequency = 84000000;
+}
+
+void RCC_AHB1PeriphClockCmd(uint32_t periph, int state) { (void)periph; (void)state; }
+void RCC_AHB3PeriphClockCmd(uint32_t periph, int state) { (void)periph; (void)state; }
+void RCC_APB1PeriphClockCmd(uint32_t periph, int state) { (void)periph; (void)state; }
+
+void GPIO_StructInit(GPIO_InitTypeDef *init) { memset(init, 0, sizeof(*init)); }
+void GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init) { (void)port; (void)init; }
+void GPIO_PinAFConfig(GPIO_TypeDef *port, uint16_t source, uint8_t af) { (void)port; (void)source; (void)af; }
+
+void SPI_StructInit(SPI_InitTypeDef *init) { memset(init, 0, sizeof(*init)); }
+void SPI_I2S_DeInit(SPI_TypeDef *spi) { spi->CR1 = 0; }
+void SPI_I2S_DMACmd(SPI_TypeDef *spi, uint16_t req, int state) { (void)spi; (void)req; (void)state; }
+uint16_t SPI_I2S_ReceiveData(SPI_TypeDef *spi) { return spi->DR; }
+
+void SPI_Init(SPI_TypeDef *spi, SPI_InitTypeDef *init)
+{
+    spi->CR1 = init->SPI_Direction | init->SPI_Mode | init->SPI_DataSize | init->SPI_CPOL | init->SPI_CPHA |
+               init->SPI_NSS | init->SPI_BaudRatePrescaler | init->SPI_FirstBit;
+}
+
+void SPI_Cmd(SPI_TypeDef *spi, int state)
+{
+    if (state)
+        spi->CR1 |= SPI_CR1_SPE;
+    else
+        spi->CR1 &= ~SPI_CR1_SPE;
+}
+
+void DMA_DeInit(DMA_Stream_TypeDef *stream) { memset((void *)stream, 0, sizeof(*stream)); }
+void DMA_StructInit(DMA_InitTypeDef *init) { memset(init, 0, sizeof(*init)); }
+
+void DMA_Init(DMA_Stream_TypeDef *stream, DMA_InitTypeDef *init)
+{
+    stream->CR = init->DMA_Channel | init->DMA_DIR | init->DMA_PeripheralInc | init->DMA_MemoryInc |
+                 init->DMA_PeripheralDataSize | init->DMA_MemoryDataSize | init->DMA_Mode | init->DMA_Priority;
+    stream->NDTR = init->DMA_BufferSize;
+}
+
+static int dmaIndex(DMA_Stream_TypeDef *stream)
+{
+    return (stream == DMA1_Stream3) ? 0 : (stream == DMA1_Stream4) ? 1 : 2;
+}
+
+// The flag constants of the streams share bits, only the transfer complete ones are kept
+static bool tcFlag(uint32_t flag)
+{
+    return flag == DMA_FLAG_TCIF3 || flag == DMA_FLAG_TCIF4 || (flag & DMA_FLAG_TCIF0) == DMA_FLAG_TCIF0;
+}
+
+void DMA_Cmd(DMA_Stream_TypeDef *stream, int state)
+{
+    if (!state) {
+        stream->CR &= ~DMA_SxCR_EN;
+        return;
+    }
+
+    stream->CR |= DMA_SxCR_EN;
+    if (hostDmaStarted)
+        hostDmaStarted(stream);
+    dmaComplete[dmaIndex(stream)] = true;
+
+    // The FSMC stream disables itself at the end of a transfer
+    if (stream == DMA2_Stream0)
+        stream->CR &= ~DMA_SxCR_EN;
+}
+
+int DMA_GetFlagStatus(DMA_Stream_TypeDef *stream, uint32_t flag)
+{
+    return tcFlag(flag) && dmaComplete[dmaIndex(stream)];
+}
+
+void DMA_ClearFlag(DMA_Stream_TypeDef *stream, uint32_t flag)
+{
+    if (tcFlag(flag))
+        dmaComplete[dmaIndex(stream)] = false;
+}
+
+void FSMC_NORSRAMStructInit(FSMC_NORSRAMInitTypeDef *init) { memset(init, 0, sizeof(*init)); }
+void FSMC_NORSRAMInit(FSMC_NORSRAMInitTypeDef *init) { (void)init; }
+void FSMC_NORSRAMCmd(uint32_t bank, int state) { (void)bank; (void)state; }
@@ -0,0 +1,32 @@
+#pragma once
+
+// Host stand-in for the board.h of a target build. The Makefile picks the setup file with
+// -DSETUP, and the display HAL header follows from it as it would on a board
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stm32f4xx.h"
+
+#include SETUP
+#include "tft_espi.h"
+
+#if defined (EPD_DRIVER)
+#include "display_hal_epd.h"
+#elif defined (TFT_PARALLEL_16_BIT)
+#include "display_hal_fsmc.h"
+#else
+#include "display_hal_f4.h"
+#endif
+
+// board.c keeps a millisecond clock that only the delays move, so timings are exact
+extern uint32_t hostMs;
+extern void (*hostDmaStarted)(DMA_Stream_TypeDef *stream); // Sees each DMA stream start when set
+
+void delayWaitms(uint32_t ms);
+void delay(uint32_t ms);
+uint32_t getTicks(void);
@@ -0,0 +1,105 @@
+/***************************************************
+  Host test of the shared SPI2 bus.
+
+  Built with the real display_hal_f4.c and spi_bus.c
+  instead of the emulated panel, over the register
+  stubs of board.c. Each DMA burst and each job that
+  ends is logged with who had the bus. A sensor job
+  queued during a 10000 pixel fill must run after
+  the first SPI_BUS_CHUNK burst, with the display
+  deselected, and two jobs less urgent than the
+  display must wait for its release and then run in
+  the order they were queued. Queued alone, a less
+  urgent job must not cut into the fill.
+ ****************************************************/
+
+#include "board.h"
+#include "spi_bus.h"
+
+#define PIXELS 10000
+
+static spiDevice sensor = { GPIOC, GPIO_Pin_1, SPI_BaudRatePrescaler_16, 0, 0, NULL };
+static spiDevice card = { GPIOC, GPIO_Pin_2, SPI_BaudRatePrescaler_8, 0, 3, NULL };
+static spiDevice card2 = { GPIOC, GPIO_Pin_4, SPI_BaudRatePrescaler_8, 1, 3, NULL };
+
+static char log[256];
+static uint16_t pixels[PIXELS];
+static uint8_t rx[64];
+
+static const char *name(const spiDevice *dev)
+{
+    return (dev == &displayDevice) ? "display" : (dev == &sensor) ? "sensor" : (dev == &card) ? "card" :
+           (dev == &card2) ? "card2" : "none";
+}
+
+static void note(const char *what, uint32_t n)
+{
+    size_t len = strlen(log);
+    snprintf(log + len, sizeof(log) - len, "%s%s %u", len ? ", " : "", what, n);
+}
+
+static void started(DMA_Stream_TypeDef *stream)
+{
+    if (stream == DMA1_Stream4)
+        note(name(busOwner), stream->NDTR);
+}
+
+static void done(spiJob *job)
+{
+    // Deselected first, so nobody owns the bus
+    note(busOwner ? "owned" : name(job->dev), job->len);
+}
+
+// Compare the log with expect and start a new one
+static int check(const char *expect)
+{
+    int bad = strcmp(log, expect) || busOwner;
+
+    printf("%s\n", log);
+    if (bad)
+        printf("expected %s\n", expect);
+    log[0] = 0;
+    return bad;
+}
+
+int main(void)
+{
+    spiJob sensorJob = { &sensor, NULL, rx, 6, done, NULL };
+    spiJob cardJob = { &card, NULL, rx, 40, done, NULL };
+    spiJob card2Job = { &card2, NULL, rx, 2, done, NULL };
+    char expect[256];
+    int bad = 0;
+
+    displayHardwareInit();
+    busAddDevice(&sensor);
+    busAddDevice(&card);
+    busAddDevice(&card2);
+    hostDmaStarted = started;
+
+    CS_L;
+    busSubmit(&cardJob);
+    busSubmit(&sensorJob);
+    busSubmit(&card2Job);
+    displayTransfer16(pixels, PIXELS, false, false);
+    note("fill end", 0);
+    CS_H;
+
+    // The card's 40 bytes go by DMA, card2's 2 do not
+    snprintf(expect, sizeof(expect), "display %u, sensor 6, display %u, display %u, fill end 0, card 40, card 40, card2 2",
+             SPI_BUS_CHUNK, SPI_BUS_CHUNK, PIXELS - 2 * SPI_BUS_CHUNK);
+    bad += check(expect);
+
+    // Nothing more urgent than the display, nothing cuts in
+    CS_L;
+    busSubmit(&cardJob);
+    displayTransfer16(pixels, PIXELS, false, false);
+    note("fill end", 0);
+    CS_H;
+
+    snprintf(expect, sizeof(expect), "display %u, display %u, display %u, fill end 0, card 40, card 40", SPI_BUS_CHUNK,
+             SPI_BUS_CHUNK, PIXELS - 2 * SPI_BUS_CHUNK);
+    bad += check(expect);
+
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,76 @@
+/***************************************************
+  Host test of the SPI clock profiles and of
+  displayCalibrate().
+
+  Built with SPI_FREQUENCY at PCLK1/16, so there are
+  faster clocks to find. The emulated panel flips a
+  bit of each pixel written faster than
+  panelFastest. Calibration must pick that clock,
+  keep the configured one when nothing faster works
+  or even it fails, and, when a clock works, leave
+  the pixels it used as they were. Each read must switch to the read clock
+  and back, and drawing alone must not write the
+  prescaler.
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+
+#define BACKGROUND 0x1234
+
+static const struct {
+    uint16_t fastest; // panelFastest
+    uint16_t expect; // Calibrated displaySpeed() value
+} panels[] = {
+    { SPI_BaudRatePrescaler_2, SPI_BaudRatePrescaler_2 },
+    { SPI_BaudRatePrescaler_4, SPI_BaudRatePrescaler_4 },
+    { SPI_BaudRatePrescaler_8, SPI_BaudRatePrescaler_8 },
+    { SPI_BaudRatePrescaler_16, SPI_BaudRatePrescaler_16 }, // The configured clock
+    { SPI_BaudRatePrescaler_32, SPI_BaudRatePrescaler_16 }, // Even that fails
+};
+
+int main(void)
+{
+    int bad = 0;
+
+    for (uint32_t p = 0; p < sizeof(panels) / sizeof(panels[0]); p++) {
+        panelFastest = SPI_BaudRatePrescaler_2;
+        displayInit(TFT_WIDTH, TFT_HEIGHT);
+        fillScreen(BACKGROUND);
+
+        panelFastest = panels[p].fastest;
+        uint32_t freq = displayCalibrate();
+        int changed = 0;
+        for (int i = 0; i < panelWidth * panelHeight; i++)
+            changed += panelRam[i] != BACKGROUND;
+
+        printf("panel up to /%d: calibrated to /%d, %u Hz, %d pixels changed\n", 2 << (panels[p].fastest >> 3),
+               2 << (panels[p].expect >> 3), freq, changed);
+        bad += freq != displayFrequency(panels[p].expect);
+        bad += panels[p].fastest <= panels[p].expect && changed; // Restored unless no clock works
+    }
+
+    // Calibrated to /2, faster than the read clock
+    panelFastest = SPI_BaudRatePrescaler_2;
+    displayInit(TFT_WIDTH, TFT_HEIGHT);
+    displayCalibrate();
+    fillScreen(TFT_BLACK);
+
+    uint32_t speed = panelCount.speed;
+    for (int i = 0; i < 5; i++) {
+        bad += readPixel(5, 5) != ((i == 0) ? TFT_BLACK : i - 1);
+        fillRect(0, 0, 10, 10, i);
+    }
+    uint32_t reading = panelCount.speed - speed;
+
+    speed = panelCount.speed;
+    for (int i = 0; i < 5; i++)
+        fillRect(0, 0, 10, 10, i);
+    uint32_t drawing = panelCount.speed - speed;
+
+    printf("5 reads and fills: %u prescaler writes, 5 fills: %u\n", reading, drawing);
+    bad += reading != 10 || drawing != 0;
+
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+/***************************************************
+  Host test of pushImageColumns().
+
+  Column major images, whole and clipped by each
+  edge, are drawn with pushImageColumns() in every
+  rotation and must leave the panel RAM as
+  pushImage() of the transposed image does. The
+  emulated panel applies MADCTL MX, MY and MV, or
+  for the SSD1963 (panelFillOrder) takes MV as the
+  fill order only. Each call must flip MV and put
+  it back, two MADCTL writes, so a rectangle drawn
+  after lands as it should, and a rotation set
+  again must send nothing. Built with
+  COLUMN_FALLBACK, a runtime driver with its own
+  window function takes the column by column path,
+  which must give the same pixels without MADCTL
+  writes.
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+
+#define W 37
+#define H 23
+#define CLEAR 0x0821
+
+static uint16_t columns[W * H], rows[W * H], expect[PANEL_MAX_PIXELS];
+
+static void clear(void)
+{
+    for (int i = 0; i < PANEL_MAX_PIXELS; i++)
+        panelRam[i] = CLEAR;
+}
+
+#ifdef COLUMN_FALLBACK
+// CASET, PASET and RAMWR sent by the driver, as a controller with other window commands would
+static void window(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
+{
+    writecommand(TFT_CASET);
+    writedata(x0 >> 8);
+    writedata(x0);
+    writedata(x1 >> 8);
+    writedata(x1);
+    writecommand(TFT_PASET);
+    writedata(y0 >> 8);
+    writedata(y0);
+    writedata(y1 >> 8);
+    writedata(y1);
+    writecommand(TFT_RAMWR);
+}
+
+static tftDriver driver;
+#endif
+
+int main(void)
+{
+    int bad = 0;
+
+#if defined (ST7735_DRIVER)
+    panelSize(132, 162); // The controller RAM the offsets are into
+#elif defined (SSD1963_DRIVER)
+    panelFillOrder = true;
+#endif
+
+    displayInit(TFT_WIDTH, TFT_HEIGHT);
+#ifdef COLUMN_FALLBACK
+    driver = *displayDriver();
+    driver.window = window;
+    displayDriverTable(&driver, 1);
+    displayInit(TFT_WIDTH, TFT_HEIGHT);
+#endif
+
+    for (int i = 0; i < W * H; i++)
+        columns[i] = color565(i * 7, i * 3, i * 11) | 1;
+    for (int x = 0; x < W; x++)
+        for (int y = 0; y < H; y++)
+            rows[y * W + x] = columns[x * H + y];
+
+    for (uint8_t r = 0; r < 8; r++) {
+        setRotation(r);
+        const int places[][2] = { { 10, 20 }, { -5, -7 }, { width() - 30, height() - 9 }, { -20, height() / 2 },
+                                  { width() / 2, -15 } };
+        int differ = 0;
+
+        clear();
+        for (uint32_t p = 0; p < sizeof(places) / sizeof(places[0]); p++)
+            pushImage(places[p][0], places[p][1], W, H, rows);
+        fillRect(1, 2, 9, 3, TFT_RED);
+        memcpy(expect, panelRam, sizeof(expect));
+
+        clear();
+        panelCount.madctl = 0;
+        for (uint32_t p = 0; p < sizeof(places) / sizeof(places[0]); p++)
+            pushImageColumns(places[p][0], places[p][1], W, H, columns);
+        fillRect(1, 2, 9, 3, TFT_RED); // Drawn as before, so MADCTL is back
+        for (int i = 0; i < panelWidth * panelHeight; i++)
+            differ += panelRam[i] != expect[i];
+
+#ifdef COLUMN_FALLBACK
+        uint32_t writes = 0;
+#else
+        uint32_t writes = 2 * sizeof(places) / sizeof(places[0]);
+#endif
+        if (differ || panelCount.madctl != writes) {
+            printf("rotation %d: %d pixels differ, %u MADCTL writes\n", r, differ, panelCount.madctl);
+            bad++;
+        }
+    }
+
+    // Set again, nothing to send
+    setRotation(3);
+    panelCount.madctl = 0;
+    for (int i = 0; i < 10; i++)
+        setRotation(1);
+    printf("8 rotations, %d failed, setRotation(1) 10 times sent %u MADCTL writes\n", bad, panelCount.madctl);
+    bad += panelCount.madctl != 1;
+
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,206 @@
+/***************************************************
+  Host test of the ePaper framebuffer backend.
+
+  A mock panel keeps its own RAM, filled by the load
+  callback, and counts loads and refreshes. Loads
+  must be of whole bytes, and after every flush the
+  RAM must match what reads back from the
+  framebuffer. Six price labels drawn in landscape
+  must go out as one partial refresh, and drawing
+  them again as none. The 21st flush after a full
+  refresh must be a full one, and so must a flush
+  of most of the screen. Twenty scattered spots are
+  merged into at most EPD_REGIONS loads with one
+  refresh, and nothing is sent while the panel is
+  busy. Each rotation must put the first pixel in
+  its own corner and the grey levels must read
+  back. Built for 1 and 2 bits per pixel.
+ ****************************************************/
+
+#include "board.h"
+
+#define PER_BYTE (8 / EPD_BPP)
+#define STRIDE ((TFT_WIDTH + PER_BYTE - 1) / PER_BYTE)
+
+static struct {
+    uint8_t ram[STRIDE * TFT_HEIGHT];
+    uint32_t loads, loaded; // Load calls and the pixels in them
+    uint32_t misaligned; // Loads not of whole bytes
+    uint32_t partials, fulls;
+    bool busy;
+} mock;
+
+static void load(void *ctx, int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t *data, int32_t stride)
+{
+    (void)ctx;
+    if (x % PER_BYTE || (w % PER_BYTE && x + w != TFT_WIDTH))
+        mock.misaligned++;
+    for (int32_t j = 0; j < h; j++)
+        memcpy(&mock.ram[(y + j) * STRIDE + x / PER_BYTE], data + j * stride, (w + PER_BYTE - 1) / PER_BYTE);
+    mock.loads++;
+    mock.loaded += w * h;
+}
+
+static void refresh(void *ctx, bool full, int32_t x, int32_t y, int32_t w, int32_t h)
+{
+    (void)ctx;
+    (void)x;
+    (void)y;
+    (void)w;
+    (void)h;
+    if (full)
+        mock.fulls++;
+    else
+        mock.partials++;
+}
+
+static bool busy(void *ctx)
+{
+    (void)ctx;
+    return mock.busy;
+}
+
+static const epdPanel panel = { load, refresh, busy, NULL };
+
+static void counted(void)
+{
+    mock.loads = mock.loaded = mock.partials = mock.fulls = 0;
+}
+
+// Level of a native pixel in the mock RAM, 0 black to 3 white
+static uint8_t mockLevel(int x, int y)
+{
+    uint8_t shift = (PER_BYTE - 1 - x % PER_BYTE) * EPD_BPP;
+    uint8_t level = (mock.ram[y * STRIDE + x / PER_BYTE] >> shift) & ((1 << EPD_BPP) - 1);
+
+    return (EPD_BPP == 1) ? level * 3 : level;
+}
+
+static uint8_t colorLevel(uint16_t c)
+{
+    return (c == 0x0000) ? 0 : (c == 0x52AA) ? 1 : (c == 0xAD55) ? 2 : (c == 0xFFFF) ? 3 : 0xFF;
+}
+
+// Pixels that differ between the panel and the framebuffer
+static int shown(void)
+{
+    uint8_t r = getRotation();
+    int differ = 0;
+
+    setRotation(0);
+    for (int y = 0; y < TFT_HEIGHT; y++)
+        for (int x = 0; x < TFT_WIDTH; x++)
+            differ += mockLevel(x, y) != colorLevel(readPixel(x, y));
+    setRotation(r);
+    return differ;
+}
+
+static void labels(void)
+{
+    static const char *prices[] = { "1.99", "12.50", "0.89", "4.25", "7.00", "23.95" };
+
+    setTextColorAll(TFT_BLACK, TFT_WHITE, true);
+    for (int i = 0; i < 6; i++)
+        drawString(prices[i], 10 + (i % 3) * 60, 20 + (i / 3) * 30, 2);
+}
+
+int main(void)
+{
+    int bad = 0, differ = 0;
+
+    epdBegin(&panel);
+    displayInit(TFT_WIDTH, TFT_HEIGHT);
+    bad += !epdFlush() || mock.fulls != 1; // The first is full
+    differ += shown();
+
+    // Labels in landscape
+    setRotation(1);
+    counted();
+    labels();
+    epdFlush();
+    differ += shown();
+    printf("six labels: %u partial, %u full refreshes, %u loads of %u pixels\n", mock.partials, mock.fulls, mock.loads,
+           mock.loaded);
+    bad += mock.partials != 1 || mock.fulls || mock.loads > EPD_REGIONS;
+
+    counted();
+    labels();
+    epdFlush();
+    printf("the same labels again: %u refreshes, %u loads\n", mock.partials + mock.fulls, mock.loads);
+    bad += mock.partials + mock.fulls + mock.loads != 0;
+
+    // A full refresh every EPD_FULL_EVERY partials, counting the labels
+    int full = 0;
+    for (int n = 2; n <= EPD_FULL_EVERY + 1; n++) {
+        counted();
+        fillRect(n * 5, 100, 3, 3, (n & 1) ? TFT_BLACK : TFT_WHITE);
+        fillRect(n * 5 + 1, 101, 1, 1, TFT_BLACK);
+        epdFlush();
+        differ += shown();
+        if (mock.fulls) {
+            full = n;
+            break;
+        }
+    }
+    printf("full refresh on flush %d after the last one\n", full);
+    bad += full != EPD_FULL_EVERY + 1;
+
+    // Scattered spots
+    counted();
+    for (int i = 0; i < 20; i++)
+        fillRect((i * 71) % 134, (i * 37) % 114, 6, 6, TFT_BLACK); // Less than half the screen
+    epdFlush();
+    differ += shown();
+    printf("20 spots: %u partial, %u full refreshes, %u loads of %u pixels\n", mock.partials, mock.fulls, mock.loads,
+           mock.loaded);
+    bad += mock.partials != 1 || mock.fulls || mock.loads > EPD_REGIONS;
+
+    // Most of the screen
+    counted();
+    fillRect(0, 0, 200, 128, TFT_WHITE);
+    fillRect(0, 0, 200, 128, TFT_BLACK);
+    epdFlush();
+    differ += shown();
+    bad += mock.fulls != 1;
+
+    // Kept while busy
+    counted();
+    mock.busy = true;
+    fillRect(5, 5, 10, 10, TFT_WHITE);
+    bad += epdFlush() || mock.loads;
+    mock.busy = false;
+    bad += !epdFlush() || mock.partials != 1;
+    differ += shown();
+
+    // The first pixel of each rotation is in its own corner
+    static const int corner[4][2] = { { 0, 0 }, { TFT_WIDTH - 1, 0 }, { TFT_WIDTH - 1, TFT_HEIGHT - 1 }, { 0, TFT_HEIGHT - 1 } };
+    for (uint8_t r = 0; r < 4; r++) {
+        setRotation(r);
+        fillScreen(TFT_WHITE);
+        drawPixel(0, 0, TFT_BLACK);
+        epdFlush();
+        for (int y = 0; y < TFT_HEIGHT; y++)
+            for (int x = 0; x < TFT_WIDTH; x++)
+                differ += mockLevel(x, y) != ((x == corner[r][0] && y == corner[r][1]) ? 0 : 3);
+    }
+
+    // Grey levels
+    static const uint16_t greys[] = { TFT_BLACK, 0x4208, TFT_DARKGREY, TFT_LIGHTGREY, 0xBDF7, TFT_WHITE };
+    for (uint32_t i = 0; i < sizeof(greys) / sizeof(greys[0]); i++) {
+        uint32_t r = (greys[i] >> 11) << 3, g = ((greys[i] >> 5) & 0x3F) << 2, b = (greys[i] & 0x1F) << 3;
+        uint32_t l = (r * 77 + g * 150 + b * 29) >> 8;
+        uint8_t level = (EPD_BPP == 1) ? ((l >= 0x80) ? 3 : 0) : (l * 3 + 127) / 255;
+
+        drawPixel(7, 9, greys[i]);
+        bad += colorLevel(readPixel(7, 9)) != level;
+    }
+    epdFlush();
+    differ += shown();
+
+    printf("%d bpp, %d pixels differ between the panel and the framebuffer, %u loads not of whole bytes\n", EPD_BPP,
+           differ, mock.misaligned);
+    bad += differ || mock.misaligned;
+
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,190 @@
+/***************************************************
+  Host test of the flash font path.
+
+  A file stands in for the SPI flash: FreeSans12pt7b
+  is written to it as a setFlashFont() image (the
+  layout of Tools/gfxff_pack.py --bin, in two code
+  point ranges) and read back with fseek/fread.
+  Text drawn from it must match the same text
+  drawn from the font in RAM, also once more
+  glyphs are used than the cache holds, and an
+  image that fails its header check must leave the
+  selected font working.
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+
+#define IMAGE "flash_font.bin"
+#define BAD_IMAGE 0x10000 // Address with no image, the file holds zeros there
+
+static FILE *flash;
+static uint32_t reads, readBytes;
+
+static void flashRead(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    reads++;
+    readBytes += len;
+    memset(buf, 0xFF, len); // Erased flash past the end of the file
+    fseek(flash, addr, SEEK_SET);
+    if (fread(buf, 1, len, flash) != len)
+        clearerr(flash);
+}
+
+static void put16(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+// The font as an image, ranges split at split
+static bool writeImage(const GFXfont *font, uint16_t split)
+{
+    uint16_t glyphs = font->last - font->first + 1;
+    uint32_t bitmapBytes = 0, largest = 0;
+    int8_t ascent = 0, descent = 0;
+
+    for (uint16_t i = 0; i < glyphs; i++) {
+        const GFXglyph *g = &font->glyph[i];
+        uint32_t bytes = (g->width * g->height + 7) / 8;
+        if (g->bitmapOffset + bytes > bitmapBytes)
+            bitmapBytes = g->bitmapOffset + bytes;
+        if (bytes > largest)
+            largest = bytes;
+        if (-g->yOffset > ascent)
+            ascent = -g->yOffset;
+        if (g->height + g->yOffset > descent)
+            descent = g->height + g->yOffset;
+    }
+
+    uint32_t ranges = 32, table = ranges + 2 * 6, bitmaps = table + glyphs * 10;
+    uint8_t header[32] = "GFXF";
+    put16(header + 4, 1);
+    put16(header + 6, 2);
+    put16(header + 8, glyphs);
+    put16(header + 10, font->first);
+    put16(header + 12, font->last);
+    header[14] = font->yAdvance;
+    header[15] = ascent;
+    header[16] = descent;
+    put16(header + 18, largest);
+    put32(header + 20, ranges);
+    put32(header + 24, table);
+    put32(header + 28, bitmaps);
+
+    uint8_t range[12];
+    put16(range, font->first);
+    put16(range + 2, split - 1);
+    put16(range + 4, 0);
+    put16(range + 6, split);
+    put16(range + 8, font->last);
+    put16(range + 10, split - font->first);
+
+    FILE *f = fopen(IMAGE, "wb");
+    if (!f)
+        return false;
+    fwrite(header, 1, sizeof(header), f);
+    fwrite(range, 1, sizeof(range), f);
+    for (uint16_t i = 0; i < glyphs; i++) {
+        const GFXglyph *g = &font->glyph[i];
+        uint8_t entry[10] = { 0, 0, 0, 0, g->width, g->height, g->xAdvance, (uint8_t)g->xOffset, (uint8_t)g->yOffset, 0 };
+        put32(entry, g->bitmapOffset);
+        fwrite(entry, 1, sizeof(entry), f);
+    }
+    fwrite(font->bitmap, 1, bitmapBytes, f);
+
+    // Blank flash up to the bad image address
+    for (long pos = ftell(f); pos < BAD_IMAGE + 32; pos++)
+        fputc(0, f);
+    return fclose(f) == 0;
+}
+
+static const char *lines[] = {
+    "The quick brown fox jumps",
+    "over the lazy dog 0123456789",
+    "!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~",
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ",
+    "abcdefghijklmnopqrstuvwxyz",
+};
+
+#define LINES (sizeof(lines) / sizeof(lines[0]))
+
+// Text at a few places and colours, one frame of it
+static void scene(int16_t widths[LINES])
+{
+    fillScreen(TFT_BLACK);
+    setTextDatum(TL_DATUM);
+    for (uint32_t i = 0; i < LINES; i++) {
+        setTextColor(TFT_WHITE + i * 0x1234);
+        widths[i] = textWidth(lines[i], 1);
+        drawString(lines[i], 2 + i, 4 + 28 * i, 1);
+    }
+    setTextColorAll(TFT_YELLOW, TFT_BLUE, true);
+    drawString("Hg", width() - 30, height() - 30, 1);
+}
+
+static uint16_t reference[PANEL_MAX_PIXELS];
+
+static int compare(const char *what, const int16_t *widths, const int16_t *expect)
+{
+    int bad = 0;
+
+    for (int i = 0; i < panelWidth * panelHeight; i++)
+        bad += panelRam[i] != reference[i];
+    for (uint32_t i = 0; i < LINES; i++)
+        bad += widths[i] != expect[i];
+
+    printf("%s: %d pixels or widths differ, %lu reads of %lu bytes\n", what, bad, (unsigned long)reads,
+           (unsigned long)readBytes);
+    reads = readBytes = 0;
+    return bad;
+}
+
+int main(void)
+{
+    int16_t widths[LINES], expect[LINES];
+    int bad = 0;
+
+    if (!writeImage(&FreeSans12pt7b, 'P') || !(flash = fopen(IMAGE, "rb"))) {
+        printf("can not write %s\n", IMAGE);
+        return 1;
+    }
+
+    displayInit(TFT_WIDTH, TFT_HEIGHT);
+    setRotation(1);
+
+    setFreeFont(&FreeSans12pt7b);
+    scene(expect);
+    memcpy(reference, panelRam, sizeof(reference));
+
+    int lit = 0;
+    for (int i = 0; i < panelWidth * panelHeight; i++)
+        lit += reference[i] != TFT_BLACK;
+    printf("RAM font: %d pixels drawn\n", lit);
+
+    if (!setFlashFont(0, flashRead)) {
+        printf("image rejected\n");
+        return 1;
+    }
+    scene(widths);
+    bad += compare("flash font", widths, expect);
+
+    // The cache now holds the last glyphs drawn, the first lines have to be read again
+    if (setFlashFont(BAD_IMAGE, flashRead)) {
+        printf("blank image accepted\n");
+        bad++;
+    }
+    scene(widths);
+    bad += compare("after a rejected image", widths, expect);
+
+    fclose(flash);
+    remove(IMAGE);
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,67 @@
+/***************************************************
+  Host test of the FSMC parallel backend.
+
+  The library is built with display_hal_fsmc.c in
+  place of the SPI HAL, for each 16-bit parallel
+  setup in the Makefile. The FSMC bank is plain
+  memory mapped at its address, so a write only
+  leaves its last value behind: after a command the
+  RS low address must hold it, after a pixel the RS
+  high address must hold the colour. The init and
+  the DMA paths run but are not checked, as the
+  board DMA moves nothing.
+ ****************************************************/
+
+#include "board.h"
+#include <sys/mman.h>
+
+// NE1 with RS on A16, the default wiring, which a 16-bit bus puts at address bit 17
+#define CMD_ADDR 0x60000000UL
+#define DATA_ADDR 0x60020000UL
+#define BANK_SIZE (DATA_ADDR - CMD_ADDR + 2)
+
+static volatile uint16_t *cmd, *dat;
+
+static int expect(const char *what, volatile uint16_t *port, uint16_t value)
+{
+    if (*port == value)
+        return 0;
+    printf("%s: %04x, not %04x\n", what, *port, value);
+    return 1;
+}
+
+int main(void)
+{
+    int bad = 0;
+
+    if (mmap((void *)CMD_ADDR, BANK_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1,
+             0) != (void *)CMD_ADDR) {
+        printf("can not map the FSMC bank at %08lx\n", CMD_ADDR);
+        return 1;
+    }
+    cmd = (volatile uint16_t *)CMD_ADDR;
+    dat = (volatile uint16_t *)DATA_ADDR;
+
+    bad += !displayInit(TFT_WIDTH, TFT_HEIGHT);
+    setRotation(1);
+    fillScreen(TFT_BLACK);
+    pushImageDMA(0, 0, 8, 8, (const uint16_t[64]){ 0 });
+    dmaWait();
+
+    // A pixel is a window, RAMWR and the colour in one bus cycle
+    drawPixel(10, 20, 0xA5C3);
+    bad += expect("command after drawPixel()", cmd, TFT_RAMWR);
+    bad += expect("data after drawPixel()", dat, 0xA5C3);
+
+    fillRect(3, 4, 5, 1, 0x1234); // Short enough to go out without DMA
+    bad += expect("data after fillRect()", dat, 0x1234);
+
+    writecommand(TFT_INVON);
+    bad += expect("command", cmd, TFT_INVON);
+    writedata(0x5A);
+    bad += expect("parameter", dat, 0x5A);
+
+    printf("%dx%d on the FSMC, command at %08lx, data at %08lx\n", width(), height(), CMD_ADDR, DATA_ADDR);
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
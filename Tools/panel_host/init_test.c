@@ -0,0 +1,114 @@
+/***************************************************
+  Host test of the recorded, non-blocking init.
+
+  Every byte sent is traced with the ms it went out
+  at. displayInit() gives the trace of a blocking
+  init. displayInitUpdate(), polled once a ms
+  alongside a sensor that needs 200 ms to start,
+  must send the same bytes at the same times,
+  without moving the clock itself, and so draw its
+  first frame when the slower of the two is ready
+  rather than after both. The Makefile builds each
+  driver with the default table, which writes its
+  trace to TRACE, and with a 40-byte table, built
+  with TRACE_READ, whose trace must match it.
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+#include <time.h>
+
+#define SENSOR_MS 200 // Start-up time of the other device
+
+// Trace of a blocking displayInit(), *ms the time it took
+static char *blocking(size_t *len, uint32_t *ms)
+{
+    char *trace;
+
+    panelTrace = open_memstream(&trace, len);
+    hostMs = 0;
+    if (!displayInit(TFT_WIDTH, TFT_HEIGHT))
+        printf("displayInit() failed\n");
+    *ms = hostMs;
+    fclose(panelTrace);
+    panelTrace = NULL;
+    return trace;
+}
+
+int main(void)
+{
+    size_t len, pollLen;
+    uint32_t initMs;
+    char *trace = blocking(&len, &initMs), *polled;
+    uint32_t bytes = panelCount.bytes;
+    bool tft = true, moved = false;
+    uint32_t now, polls = 0;
+    struct timespec t0, t1;
+    double cpu = 0;
+    int bad = 0;
+
+    // The init polled from a main loop that also starts the sensor
+    panelTrace = open_memstream(&polled, &pollLen);
+    displayInitBegin(TFT_WIDTH, TFT_HEIGHT);
+    for (now = 0; tft || now < SENSOR_MS; now++) {
+        if (!tft)
+            continue;
+        hostMs = now;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        tft = displayInitUpdate(now);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        cpu += (t1.tv_sec - t0.tv_sec) * 1e6 + (t1.tv_nsec - t0.tv_nsec) / 1e3;
+        moved |= hostMs != now; // The library waited itself
+        polls++;
+    }
+    fclose(panelTrace);
+    panelTrace = NULL;
+
+    uint32_t ready = (initMs > SENSOR_MS) ? initMs : SENSOR_MS;
+    printf("%u bytes, blocking init %u ms, first frame at %u ms instead of %u ms sequential, %u polls, %.0fus "
+           "host CPU in the init\n", bytes, initMs, now, initMs + SENSOR_MS, polls, cpu);
+
+    if (displayInitFailed() || len == 0) {
+        printf("init failed\n");
+        bad++;
+    }
+    if (pollLen != len || memcmp(polled, trace, len)) {
+        printf("the polled init sent a different trace\n");
+        bad++;
+    }
+    if (moved) {
+        printf("displayInitUpdate() waited\n");
+        bad++;
+    }
+    bad += now > ready + 1;
+
+#ifdef TRACE_READ
+    // Same trace as the build with the default table
+    FILE *f = fopen(TRACE, "rb");
+    char *expect = malloc(len + 1);
+    size_t got = f ? fread(expect, 1, len + 1, f) : 0;
+    if (!f) {
+        printf("%s missing, run the default build first\n", TRACE);
+        bad++;
+    } else if (got != len || memcmp(expect, trace, len)) {
+        printf("different trace from %s with a %d-byte table\n", TRACE, INIT_TABLE_BYTES);
+        bad++;
+    }
+    if (f)
+        fclose(f);
+    free(expect);
+#else
+    FILE *f = fopen(TRACE, "wb");
+    if (!f || fwrite(trace, 1, len, f) != len) {
+        printf("can not write %s\n", TRACE);
+        bad++;
+    }
+    if (f)
+        fclose(f);
+#endif
+
+    free(trace);
+    free(polled);
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,251 @@
+/***************************************************
+  Host test of tft_jpeg.c against libjpeg.
+
+  Test images are encoded with libjpeg in each
+  sampling layout the decoder takes, with and
+  without restart intervals, and decoded by both.
+  libjpeg uses its accurate integer IDCT and plain
+  replication for the chroma, as tft_jpeg.c does,
+  so after the RGB565 rounding the two may only
+  differ by a step at full size. The image
+  is decoded from memory, from a reader returning
+  a few bytes at a time and straight to the panel.
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+#include <jpeglib.h>
+
+typedef struct {
+    const char *name;
+    int components, h, v; // Luma sampling factors, chroma is 1x1
+    int restart; // MCUs, 0 for none
+} layout;
+
+static const layout layouts[] = {
+    { "4:4:4", 3, 1, 1, 0 },
+    { "4:2:2", 3, 2, 1, 0 },
+    { "4:2:0", 3, 2, 2, 0 },
+    { "4:4:0", 3, 1, 2, 0 },
+    { "grey", 1, 1, 1, 0 },
+    { "4:2:0 restarts", 3, 2, 2, 3 },
+    { "4:4:4 restarts", 3, 1, 1, 1 },
+};
+
+#define LAYOUTS (sizeof(layouts) / sizeof(layouts[0]))
+#define W 203 // Not a whole number of MCUs either way
+#define H 141
+#define CHUNK 7 // Bytes per read, fewer than any marker segment
+
+static uint8_t rgb[W * H * 3];
+static uint16_t frame[W * H], expect[W * H];
+
+// Gradients, edges and noise, so every coefficient and all colours are used
+static void makeImage(void)
+{
+    uint32_t seed = 1;
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            uint8_t *p = &rgb[(y * W + x) * 3];
+            seed = seed * 1103515245 + 12345;
+            int noise = (seed >> 16) % 48;
+            p[0] = (x * 255 / W + noise) & 0xFF;
+            p[1] = ((x / 16 + y / 16) & 1) ? 220 : 30 + noise;
+            p[2] = (y * 255 / H) ^ ((x * y) & 0x3F);
+        }
+    }
+}
+
+static unsigned long encode(const layout *l, uint8_t **out)
+{
+    struct jpeg_compress_struct c;
+    struct jpeg_error_mgr err;
+    unsigned long size = 0;
+    uint8_t grey[W];
+
+    c.err = jpeg_std_error(&err);
+    jpeg_create_compress(&c);
+    jpeg_mem_dest(&c, out, &size);
+    c.image_width = W;
+    c.image_height = H;
+    c.input_components = l->components;
+    c.in_color_space = (l->components == 1) ? JCS_GRAYSCALE : JCS_RGB;
+    jpeg_set_defaults(&c);
+    jpeg_set_quality(&c, 90, TRUE);
+    c.comp_info[0].h_samp_factor = l->h;
+    c.comp_info[0].v_samp_factor = l->v;
+    for (int i = 1; i < l->components; i++)
+        c.comp_info[i].h_samp_factor = c.comp_info[i].v_samp_factor = 1;
+    c.restart_interval = l->restart;
+
+    jpeg_start_compress(&c, TRUE);
+    while (c.next_scanline < H) {
+        uint8_t *row = &rgb[c.next_scanline * W * 3];
+        if (l->components == 1) {
+            for (int x = 0; x < W; x++)
+                grey[x] = row[x * 3 + 1];
+            row = grey;
+        }
+        jpeg_write_scanlines(&c, &row, 1);
+    }
+    jpeg_finish_compress(&c);
+    jpeg_destroy_compress(&c);
+    return size;
+}
+
+// Reference decode into expect[], scaled by 1/scale
+static void reference(const uint8_t *data, unsigned long size, int scale, int *w, int *h)
+{
+    struct jpeg_decompress_struct d;
+    struct jpeg_error_mgr err;
+    uint8_t row[W * 3];
+    uint8_t *rows = row;
+
+    d.err = jpeg_std_error(&err);
+    jpeg_create_decompress(&d);
+    jpeg_mem_src(&d, data, size);
+    jpeg_read_header(&d, TRUE);
+    d.out_color_space = JCS_RGB;
+    d.dct_method = JDCT_ISLOW;
+    d.do_fancy_upsampling = FALSE;
+    d.scale_num = 1;
+    d.scale_denom = scale;
+
+    jpeg_start_decompress(&d);
+    *w = d.output_width;
+    *h = d.output_height;
+    while (d.output_scanline < d.output_height) {
+        int y = d.output_scanline;
+        jpeg_read_scanlines(&d, &rows, 1);
+        for (int x = 0; x < *w; x++)
+            expect[y * *w + x] = color565(row[x * 3], row[x * 3 + 1], row[x * 3 + 2]);
+    }
+    jpeg_finish_decompress(&d);
+    jpeg_destroy_decompress(&d);
+}
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t size, pos;
+} source;
+
+static uint32_t readChunk(void *ctx, uint8_t *buf, uint32_t len)
+{
+    source *s = ctx;
+
+    if (len > CHUNK)
+        len = CHUNK;
+    if (len > s->size - s->pos)
+        len = s->size - s->pos;
+    memcpy(buf, s->data + s->pos, len);
+    s->pos += len;
+    return len;
+}
+
+static int frameW;
+
+static void output(void *ctx, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data)
+{
+    (void)ctx;
+    for (int32_t r = 0; r < h; r++)
+        memcpy(&frame[(y + r) * frameW + x], &data[r * w], w * 2);
+}
+
+// Largest channel difference in RGB565 steps (green in 5-bit steps as the others), the
+// sum of them and how many pixels differ at all
+static int compare(const uint16_t *a, int w, int h, int *sum, int *differ)
+{
+    int worst = 0;
+
+    *sum = *differ = 0;
+    for (int i = 0; i < w * h; i++) {
+        int d[3] = { abs((a[i] >> 11) - (expect[i] >> 11)), abs(((a[i] >> 5) & 0x3F) - ((expect[i] >> 5) & 0x3F)) / 2,
+                     abs((a[i] & 0x1F) - (expect[i] & 0x1F)) };
+        for (int c = 0; c < 3; c++) {
+            if (d[c] > worst)
+                worst = d[c];
+            *sum += d[c];
+        }
+        *differ += a[i] != expect[i];
+    }
+    return worst;
+}
+
+static jpegDecoder jpeg;
+
+int main(void)
+{
+    int bad = 0;
+
+    displayInit(TFT_WIDTH, TFT_HEIGHT);
+    setRotation(1); // 320 x 240, the image fits
+    makeImage();
+
+    for (uint32_t i = 0; i < LAYOUTS; i++) {
+        const layout *l = &layouts[i];
+        uint8_t *data = NULL;
+        unsigned long size = encode(l, &data);
+
+        for (int scale = 1; scale <= 8; scale *= 2) {
+            int w, h, sum, differ, worst;
+            reference(data, size, scale, &w, &h);
+
+            frameW = w;
+            memset(frame, 0, sizeof(frame));
+            if (!jpegOpen(&jpeg, data, size, NULL, NULL) || jpeg.width != W || jpeg.height != H ||
+                !jpegDecode(&jpeg, 0, 0, scale, output)) {
+                printf("%s 1/%d: not decoded\n", l->name, scale);
+                bad++;
+                continue;
+            }
+            worst = compare(frame, w, h, &sum, &differ);
+            printf("%-15s 1/%d %3dx%-3d %6lu bytes: %5d of %5d pixels differ, by at most %d, %.2f on average\n",
+                   l->name, scale, w, h, size, differ, w * h, worst, sum / (3.0 * w * h));
+
+            // At full size the IDCTs only round differently. The reduced IDCTs of a scaled image
+            // differ more, and libjpeg upsamples its chroma where tft_jpeg.c decodes that at
+            // twice the size, so only the mean difference is held to a step there
+            bad += (scale == 1) ? worst > 1 : sum > 3 * w * h;
+
+            // Streamed input and drawing to the panel give the same pixels
+            memcpy(expect, frame, sizeof(frame));
+            source s = { data, size, 0 };
+            memset(frame, 0, sizeof(frame));
+            if (!jpegOpen(&jpeg, NULL, 0, readChunk, &s) || !jpegDecode(&jpeg, 0, 0, scale, output) ||
+                compare(frame, w, h, &sum, &differ) || differ) {
+                printf("%s 1/%d: streamed decode differs\n", l->name, scale);
+                bad++;
+            }
+
+            fillScreen(TFT_BLACK);
+            if (!jpegOpen(&jpeg, data, size, NULL, NULL) || !jpegDecode(&jpeg, 5, 7, scale, NULL)) {
+                bad++;
+                continue;
+            }
+            differ = 0;
+            for (int y = 0; y < h; y++)
+                for (int x = 0; x < w; x++)
+                    differ += readPixel(5 + x, 7 + y) != expect[y * w + x];
+            if (differ) {
+                printf("%s 1/%d: %d pixels differ on the panel\n", l->name, scale, differ);
+                bad++;
+            }
+        }
+        free(data);
+    }
+
+    // Truncated data has to end the decode, not hang it or read past the end
+    uint8_t *data = NULL;
+    unsigned long size = encode(&layouts[2], &data);
+    uint8_t *half = malloc(size / 2); // Exact size, for the sanitizers
+    memcpy(half, data, size / 2);
+    frameW = W;
+    if (jpegOpen(&jpeg, half, size / 2, NULL, NULL))
+        jpegDecode(&jpeg, 0, 0, 1, output);
+    free(half);
+    free(data);
+
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
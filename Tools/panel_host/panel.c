@@ -0,0 +1,321 @@
+/***************************************************
+  Emulated MIPI DCS panel for the host builds.
+
+  Every byte the library sends goes through one
+  decoder, DMA or not. A nowait transfer is only
+  read from its buffer when the library waits for
+  it, so a buffer reused too early shows up as
+  wrong pixels. Reads return the plain RGB666
+  format (TFT_READ_RGB666).
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+
+uint16_t panelRam[PANEL_MAX_PIXELS];
+int panelWidth = TFT_WIDTH, panelHeight = TFT_HEIGHT;
+uint32_t panelId;
+#ifdef SPI_18BIT_DRIVER
+bool panelRgb666 = true;
+#else
+bool panelRgb666;
+#endif
+bool panelFillOrder;
+uint16_t panelFastest = SPI_BaudRatePrescaler_2;
+FILE *panelTrace;
+panelCounters panelCount;
+
+spiDevice displayDevice;
+spiDevice *busOwner;
+
+static struct {
+    int cmd; // Last command, -1 after reset
+    int arg; // Data bytes since the command
+    uint8_t args[4];
+    int xs, xe, ys, ye; // Window
+    int cx, cy; // RAM pointer, in window coordinates
+    uint8_t pixel[3]; // Bytes of the pixel being written
+    uint8_t madctl;
+    uint16_t speed; // displaySpeed() value
+    uint16_t read; // Pixel being read back
+} dcs = { .cmd = -1 };
+
+static struct {
+    const void *buffer;
+    int len; // Items, 0 when nothing is in flight
+    bool incr, bytes;
+} dma;
+
+void panelSize(int w, int h)
+{
+    panelWidth = w;
+    panelHeight = h;
+}
+
+uint16_t panelPixel(int x, int y)
+{
+    if (x < 0 || y < 0 || x >= panelWidth || y >= panelHeight)
+        return 0;
+    return panelRam[y * panelWidth + x];
+}
+
+// RAM address of the pointer, MX, MY and MV applied, or -1 off the panel
+static int address(void)
+{
+    int c = dcs.cx, p = dcs.cy;
+
+    if (!panelFillOrder) {
+        if (dcs.madctl & 0x20)
+            c = dcs.cy, p = dcs.cx;
+        if (dcs.madctl & 0x40)
+            c = panelWidth - 1 - c;
+        if (dcs.madctl & 0x80)
+            p = panelHeight - 1 - p;
+    }
+
+    if (c < 0 || p < 0 || c >= panelWidth || p >= panelHeight)
+        return -1;
+    return p * panelWidth + c;
+}
+
+static void advance(void)
+{
+    // The SSD1963 keeps its window and only fills it column by column with MV
+    if (panelFillOrder && (dcs.madctl & 0x20)) {
+        if (++dcs.cy > dcs.ye) {
+            dcs.cy = dcs.ys;
+            if (++dcs.cx > dcs.xe)
+                dcs.cx = dcs.xs;
+        }
+        return;
+    }
+
+    if (++dcs.cx > dcs.xe) {
+        dcs.cx = dcs.xs;
+        if (++dcs.cy > dcs.ye)
+            dcs.cy = dcs.ys;
+    }
+}
+
+static void writePixel(uint16_t color)
+{
+    int a = address();
+
+    // Too fast a clock flips a bit, as a marginal panel would
+    if ((dcs.speed & SPI_CR1_BR) < panelFastest)
+        color ^= 0x0100;
+    if (a >= 0)
+        panelRam[a] = color;
+    advance();
+}
+
+static uint8_t readPixelByte(void)
+{
+    int k = dcs.arg++ - 1;
+
+    if (k < 0) // Dummy read
+        return 0;
+
+    switch (k % 3) {
+    case 0: {
+        int a = address();
+        dcs.read = (a >= 0) ? panelRam[a] : 0;
+        return (dcs.read >> 8) & 0xF8;
+    }
+    case 1:
+        return (dcs.read >> 3) & 0xFC;
+    default:
+        advance();
+        return (dcs.read << 3) & 0xF8;
+    }
+}
+
+static uint8_t command(uint8_t c)
+{
+    dcs.cmd = c;
+    dcs.arg = 0;
+    panelCount.commands++;
+
+    switch (c) {
+    case 0x01: // Software reset
+        dcs.madctl = 0;
+        break;
+    case 0x2A:
+    case 0x2B:
+        panelCount.windows++;
+        break;
+    case 0x2C:
+    case 0x2E:
+        dcs.cx = dcs.xs;
+        dcs.cy = dcs.ys;
+        break;
+    case 0x36:
+        panelCount.madctl++;
+        break;
+    }
+    return 0;
+}
+
+static uint8_t data(uint8_t d)
+{
+    switch (dcs.cmd) {
+    case 0x2A:
+    case 0x2B:
+        if (dcs.arg < 4)
+            dcs.args[dcs.arg++] = d;
+        if (dcs.arg == 4) {
+            int s = dcs.args[0] << 8 | dcs.args[1], e = dcs.args[2] << 8 | dcs.args[3];
+            if (dcs.cmd == 0x2A)
+                dcs.xs = s, dcs.xe = e;
+            else
+                dcs.ys = s, dcs.ye = e;
+            dcs.arg++;
+        }
+        return 0;
+
+    case 0x2C:
+        dcs.pixel[dcs.arg++] = d;
+        if (panelRgb666 && dcs.arg == 3) {
+            writePixel((dcs.pixel[0] & 0xF8) << 8 | (dcs.pixel[1] & 0xFC) << 3 | dcs.pixel[2] >> 3);
+            dcs.arg = 0;
+        } else if (!panelRgb666 && dcs.arg == 2) {
+            writePixel(dcs.pixel[0] << 8 | dcs.pixel[1]);
+            dcs.arg = 0;
+        }
+        return 0;
+
+    case 0x2E:
+        return readPixelByte();
+
+    case 0x36:
+        dcs.madctl = d;
+        return 0;
+
+    case 0x04: // RDDID, the ID follows one dummy clock
+        if (dcs.arg > 3)
+            return 0;
+        return ((panelId << 7) >> (24 - 8 * dcs.arg++)) & 0xFF;
+    }
+
+    dcs.arg++;
+    return 0;
+}
+
+static uint8_t byte(uint8_t d)
+{
+    bool isData = (DC_PORT->BSRR & DC_PIN_MASK) != 0;
+
+    panelCount.bytes++;
+    if (panelTrace)
+        fprintf(panelTrace, "%c%02x@%u\n", isData ? 'd' : 'C', d, (unsigned)hostMs);
+
+    return isData ? data(d) : command(d);
+}
+
+// Send the transfer left in flight, the library is now waiting for it
+static void dmaEnd(void)
+{
+    if (!dma.len)
+        return;
+
+    int len = dma.len;
+    dma.len = 0;
+
+    if (dma.bytes) {
+        const uint8_t *b = dma.buffer;
+        while (len--)
+            byte(*b++);
+        return;
+    }
+
+    const uint16_t *w = dma.buffer;
+    while (len--) {
+        byte(*w >> 8);
+        byte(*w & 0xFF);
+        if (dma.incr)
+            w++;
+    }
+}
+
+void displayHardwareInit(void)
+{
+    dmaEnd();
+}
+
+void displayHardwareReset(void)
+{
+    dmaEnd();
+    dcs.cmd = -1;
+    dcs.madctl = 0;
+}
+
+uint8_t displayTransfer8(uint8_t d)
+{
+    dmaEnd();
+    return byte(d);
+}
+
+void displayTransfer16(const uint16_t *buffer, int len, bool incr, bool nowait)
+{
+    dmaEnd();
+    dma = (typeof(dma)){ buffer, len, incr, false };
+    if (!nowait)
+        dmaEnd();
+}
+
+void displayTransfer16End(void)
+{
+    dmaEnd();
+}
+
+void displayTransfer16Slow(uint16_t *buffer, int len, bool incr)
+{
+    displayTransfer16(buffer, len, incr, false);
+}
+
+void displayTransfer8Buf(const uint8_t *buffer, int len, bool nowait)
+{
+    dmaEnd();
+    dma = (typeof(dma)){ buffer, len, true, true };
+    if (!nowait)
+        dmaEnd();
+}
+
+void displaySpeed(uint16_t prescaler)
+{
+    dmaEnd(); // The HAL waits for BSY before changing the clock
+    dcs.speed = prescaler;
+    panelCount.speed++;
+}
+
+// As display_hal_f4.c, PCLK1 of 42MHz divided by 2 to 256
+uint16_t displayPrescaler(uint32_t freq)
+{
+    uint16_t br = 0;
+
+    while (br < 7 && (42000000u >> (br + 1)) > freq)
+        br++;
+
+    return br << 3;
+}
+
+uint32_t displayFrequency(uint16_t prescaler)
+{
+    return 42000000u >> (((prescaler >> 3) & 7) + 1);
+}
+
+// Only the display is on this bus, its transfer ends before another device could take it
+void busSelect(spiDevice *dev)
+{
+    if (busOwner != dev)
+        dmaEnd();
+    busOwner = dev;
+}
+
+void busRelease(spiDevice *dev)
+{
+    if (busOwner != dev)
+        return;
+    dmaEnd();
+    busOwner = NULL;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// Emulated MIPI DCS panel behind the display HAL of display_hal_f4.h, built instead of
+// display_hal_f4.c and spi_bus.c. It decodes CASET, PASET, RAMWR, RAMRD, MADCTL and RDDID
+// into panelRam, everything else is only counted and traced
+
+#define PANEL_MAX_PIXELS (480 * 800)
+
+typedef struct {
+    uint32_t bytes; // Sent over the bus, commands and data
+    uint32_t commands;
+    uint32_t windows; // CASET and PASET commands
+    uint32_t madctl; // MADCTL writes
+    uint32_t speed; // displaySpeed() calls
+} panelCounters;
+
+extern uint16_t panelRam[PANEL_MAX_PIXELS]; // RGB565, panelWidth wide in the native orientation
+extern int panelWidth, panelHeight;
+extern uint32_t panelId; // RDDID answer, 24 bits
+extern bool panelRgb666; // Takes 3 bytes a pixel in RAMWR, as the SPI ILI9481/86/88
+extern bool panelFillOrder; // MV only changes the fill order, as the SSD1963
+extern uint16_t panelFastest; // Fastest displaySpeed() value that works, faster ones corrupt pixels
+extern FILE *panelTrace; // Each byte as C2a@ms or d00@ms when set
+extern panelCounters panelCount;
+
+void panelSize(int w, int h); // Controller RAM size, the default is TFT_WIDTH x TFT_HEIGHT
+uint16_t panelPixel(int x, int y); // Native orientation
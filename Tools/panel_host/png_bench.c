@@ -0,0 +1,85 @@
+/***************************************************
+  Host benchmark of tft_png.c against libpng.
+
+  Full screen images of each common kind are
+  decoded repeatedly by tft_png.c, blended over
+  black into a sink that takes the rows, and by
+  libpng to 8-bit RGBA. The times are of the host
+  CPU, only the ratio says anything about a
+  target.
+ ****************************************************/
+
+#include "board.h"
+#include <time.h>
+#include "png_image.h"
+
+#define W 320
+#define H 240
+#define RUNS 40
+
+static const struct {
+    const char *name;
+    int colorType, depth;
+    bool trns;
+} kinds[] = {
+    { "RGB", 2, 8, false },
+    { "RGBA", 6, 8, false },
+    { "indexed 8-bit", 3, 8, false },
+    { "indexed 4-bit tRNS", 3, 4, true },
+    { "grey", 0, 8, false },
+};
+
+#define KINDS (sizeof(kinds) / sizeof(kinds[0]))
+
+static uint32_t rows;
+
+static void sink(void *ctx, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data)
+{
+    (void)ctx;
+    (void)x;
+    (void)y;
+    (void)w;
+    (void)data;
+    rows += h;
+}
+
+static double seconds(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static pngDecoder png;
+
+int main(void)
+{
+    int bad = 0;
+
+    printf("%-20s %8s %10s %10s %6s\n", "image", "bytes", "tft_png", "libpng", "ratio");
+
+    for (uint32_t k = 0; k < KINDS; k++) {
+        pngSpec spec = { kinds[k].colorType, kinds[k].depth, kinds[k].trns, false, W, H, 6, false, 0 };
+        uint8_t *data = NULL;
+        unsigned long size = pngEncode(&spec, &data);
+        int w, h;
+
+        rows = 0;
+        double start = seconds();
+        for (int i = 0; i < RUNS; i++)
+            bad += !pngOpen(&png, data, size, NULL, NULL) || !pngDecode(&png, 0, 0, TFT_BLACK, sink);
+        double tft = (seconds() - start) / RUNS;
+        bad += rows != (uint32_t)H * RUNS; // Blended, so one call a row
+
+        start = seconds();
+        for (int i = 0; i < RUNS; i++)
+            free(pngReference(data, size, &w, &h));
+        double lib = (seconds() - start) / RUNS;
+
+        printf("%-20s %8lu %8.2fms %8.2fms %6.2f\n", kinds[k].name, size, tft * 1e3, lib * 1e3, tft / lib);
+        free(data);
+    }
+
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+/***************************************************
+  Mutation fuzzer for tft_png.c.
+
+  Small images of every colour type are encoded by
+  libpng, then bytes are flipped, chunks cut short
+  and runs of data copied over others. Each result
+  is decoded from an allocation of its exact size
+  and through a reader, built with the address and
+  undefined behaviour sanitizers. The decoder must
+  return, with either answer, and never touch
+  memory it does not own.
+
+  png_fuzz [iterations [seed]]
+ ****************************************************/
+
+#include "board.h"
+#include "png_image.h"
+
+static const pngSpec seeds[] = {
+    { 0, 1, false, false, 13, 7, 9, false, 0 },
+    { 0, 16, true, false, 9, 5, 6, true, 0 },
+    { 2, 8, true, false, 17, 6, 9, false, 40 },
+    { 3, 2, true, false, 21, 4, 0, false, 0 },
+    { 3, 8, false, false, 11, 9, 9, false, 0 },
+    { 4, 16, false, false, 7, 7, 6, true, 0 },
+    { 6, 8, false, false, 15, 8, 9, false, 30 },
+};
+
+#define SEEDS (sizeof(seeds) / sizeof(seeds[0]))
+
+static uint32_t random32;
+
+static uint32_t next(uint32_t n)
+{
+    random32 ^= random32 << 13;
+    random32 ^= random32 >> 17;
+    random32 ^= random32 << 5;
+    return random32 % n;
+}
+
+static void mutate(uint8_t *d, unsigned long *size)
+{
+    for (int m = 1 + next(4); m > 0; m--) {
+        unsigned long at = 8 + next(*size - 8); // Keep the signature most of the time
+
+        switch (next(5)) {
+        case 0: // Flip bits
+            d[at] ^= 1 << next(8);
+            break;
+        case 1: // Any byte
+            d[at] = next(256);
+            break;
+        case 2: // Extreme values, for lengths and codes
+            d[at] = next(2) ? 0xFF : 0;
+            break;
+        case 3: { // Copy a run over another
+            unsigned long from = next(*size), len = 1 + next(16);
+            if (from + len <= *size && at + len <= *size)
+                memmove(d + at, d + from, len);
+            break;
+        }
+        default: // Cut short
+            *size = at;
+            return;
+        }
+    }
+}
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t size, pos;
+} source;
+
+static uint32_t readSome(void *ctx, uint8_t *buf, uint32_t len)
+{
+    source *s = ctx;
+
+    len = 1 + next(len);
+    if (len > s->size - s->pos)
+        len = s->size - s->pos;
+    memcpy(buf, s->data + s->pos, len);
+    s->pos += len;
+    return len;
+}
+
+static uint32_t pixels;
+static volatile uint16_t checksum;
+
+static void sink(void *ctx, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data)
+{
+    (void)ctx;
+    (void)x;
+    (void)y;
+
+    for (int32_t i = 0; i < w * h; i++)
+        checksum += data[i]; // The whole run must be readable
+    pixels += w * h;
+}
+
+static pngDecoder png;
+
+int main(int argc, char **argv)
+{
+    long iterations = (argc > 1) ? atol(argv[1]) : 20000;
+    random32 = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+    uint8_t *images[SEEDS];
+    unsigned long sizes[SEEDS];
+    long opened = 0, decoded = 0;
+
+    if (!random32)
+        random32 = 1;
+
+    for (uint32_t i = 0; i < SEEDS; i++)
+        sizes[i] = pngEncode(&seeds[i], &images[i]);
+
+    for (long n = 0; n < iterations; n++) {
+        uint32_t k = next(SEEDS);
+        unsigned long size = sizes[k];
+        uint8_t *d = malloc(size);
+
+        memcpy(d, images[k], size);
+        mutate(d, &size);
+
+        if (pngOpen(&png, d, size, NULL, NULL)) {
+            opened++;
+            decoded += pngDecode(&png, 0, 0, next(2) ? PNG_NO_BACKGROUND : 0x1234, sink);
+        }
+
+        source s = { d, size, 0 };
+        if (pngOpen(&png, NULL, 0, readSome, &s))
+            pngDecode(&png, 0, 0, PNG_NO_BACKGROUND, sink);
+
+        free(d);
+    }
+
+    printf("%ld mutated images, %ld opened, %ld decoded without error, %lu pixels\n", iterations, opened, decoded,
+           (unsigned long)pixels);
+
+    for (uint32_t i = 0; i < SEEDS; i++)
+        free(images[i]);
+    return 0;
+}
@@ -0,0 +1,173 @@
+/***************************************************
+  Test PNGs for the host builds, encoded and
+  decoded by libpng.
+ ****************************************************/
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <png.h>
+#include <zlib.h>
+#include "png_image.h"
+
+typedef struct {
+    uint8_t *data;
+    unsigned long size, space;
+} pngBuffer;
+
+static void pngWrite(png_structp png, png_bytep data, png_size_t len)
+{
+    pngBuffer *b = png_get_io_ptr(png);
+
+    if (b->size + len > b->space) {
+        b->space = 2 * (b->size + len);
+        b->data = realloc(b->data, b->space);
+    }
+    memcpy(b->data + b->size, data, len);
+    b->size += len;
+}
+
+static void pngFlush(png_structp png)
+{
+    (void)png;
+}
+
+// Sample c of pixel x,y, depth bits. The tRNS key is sample value 1 of every channel
+static uint32_t sample(const pngSpec *s, int x, int y, int c, uint32_t *seed)
+{
+    uint32_t max = (1u << s->depth) - 1;
+
+    *seed = *seed * 1103515245 + 12345;
+    if (s->trns && s->colorType != 3 && (x + y) % 7 == 0)
+        return 1;
+    if (c == 3 || (c == 1 && s->colorType == 4)) // Alpha, all levels along the row
+        return (x * 257 / 3 + y) * max / 255 % (max + 1);
+    if ((y & 3) == 0) // Noise rows
+        return (*seed >> 8) & max;
+    return ((x + c * 40) * max / (s->width + 80) + y) & max;
+}
+
+unsigned long pngEncode(const pngSpec *s, uint8_t **out)
+{
+    static const int channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    int n = channels[s->colorType];
+    int rowBytes = (s->width * n * s->depth + 7) / 8;
+    uint8_t *rows = calloc(s->height, rowBytes);
+    pngBuffer b = { NULL, 0, 0 };
+    uint32_t seed = s->colorType * 100 + s->depth;
+
+    for (int y = 0; y < s->height; y++) {
+        uint8_t *row = rows + y * rowBytes;
+        for (int x = 0; x < s->width; x++) {
+            for (int c = 0; c < n; c++) {
+                uint32_t v = sample(s, x, y, c, &seed);
+                int bit = (x * n + c) * s->depth;
+                if (s->depth == 16) {
+                    row[bit / 8] = v >> 8;
+                    row[bit / 8 + 1] = v;
+                } else {
+                    row[bit / 8] |= v << (8 - s->depth - bit % 8);
+                }
+            }
+        }
+    }
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png_create_info_struct(png);
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        free(rows);
+        free(b.data);
+        return 0;
+    }
+
+    png_set_write_fn(png, &b, pngWrite, pngFlush);
+    png_set_IHDR(png, info, s->width, s->height, s->depth, s->colorType,
+                 s->interlace ? PNG_INTERLACE_ADAM7 : PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_set_filter(png, 0, PNG_ALL_FILTERS);
+    png_set_compression_level(png, s->level);
+    png_set_compression_strategy(png, s->fixed ? Z_FIXED : Z_DEFAULT_STRATEGY);
+    if (s->idat)
+        png_set_compression_buffer_size(png, s->idat);
+
+    if (s->colorType == 3) {
+        png_color palette[256];
+        png_byte alpha[256];
+        int colors = 1 << s->depth;
+        for (int i = 0; i < colors; i++) {
+            palette[i].red = i * 255 / (colors - 1);
+            palette[i].green = 255 - palette[i].red;
+            palette[i].blue = i * 97;
+            alpha[i] = i * 255 / (colors - 1); // Includes 0 and 255
+        }
+        png_set_PLTE(png, info, palette, colors);
+        if (s->trns)
+            png_set_tRNS(png, info, alpha, colors > 2 ? colors - 1 : 1, NULL);
+    } else if (s->trns) {
+        png_color_16 key = { 0, 1, 1, 1, 1 };
+        png_set_tRNS(png, info, NULL, 0, &key);
+    }
+
+    png_write_info(png, info);
+    for (int pass = png_set_interlace_handling(png); pass > 0; pass--)
+        for (int y = 0; y < s->height; y++)
+            png_write_row(png, rows + y * rowBytes);
+    png_write_end(png, info);
+    png_destroy_write_struct(&png, &info);
+    free(rows);
+
+    *out = b.data;
+    return b.size;
+}
+
+typedef struct {
+    const uint8_t *data;
+    unsigned long size, pos;
+} pngSource;
+
+static void pngRead(png_structp png, png_bytep data, png_size_t len)
+{
+    pngSource *s = png_get_io_ptr(png);
+
+    if (len > s->size - s->pos)
+        png_error(png, "short");
+    memcpy(data, s->data + s->pos, len);
+    s->pos += len;
+}
+
+uint8_t *pngReference(const uint8_t *data, unsigned long size, int *width, int *height)
+{
+    pngSource s = { data, size, 0 };
+    uint8_t *volatile image = NULL;
+
+    png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    png_infop info = png_create_info_struct(png);
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, NULL);
+        free(image);
+        return NULL;
+    }
+
+    png_set_read_fn(png, &s, pngRead);
+    png_read_info(png, info);
+    png_set_expand(png);
+    png_set_strip_16(png);
+    png_set_gray_to_rgb(png);
+    png_set_add_alpha(png, 0xFF, PNG_FILLER_AFTER);
+    png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+
+    *width = png_get_image_width(png, info);
+    *height = png_get_image_height(png, info);
+    image = malloc(*width * *height * 4);
+    png_bytep rows[*height];
+    for (int y = 0; y < *height; y++)
+        rows[y] = image + y * *width * 4;
+    png_read_image(png, rows);
+    png_read_end(png, NULL);
+    png_destroy_read_struct(&png, &info, NULL);
+
+    return image;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+// Test PNGs made with libpng for png_test.c, png_bench.c and png_fuzz.c
+
+typedef struct {
+    int colorType; // PNG colour type, 0 grey, 2 RGB, 3 indexed, 4 grey and alpha, 6 RGBA
+    int depth;
+    bool trns; // Add a tRNS chunk, grey, RGB and indexed only
+    bool interlace; // Adam7, which tft_png.c rejects
+    int width, height;
+    int level; // zlib compression level, 0 gives stored blocks
+    bool fixed; // Only fixed Huffman codes
+    int idat; // Largest IDAT chunk, 0 for the libpng default
+} pngSpec;
+
+// Encode a test image, the caller frees *out. Gradients and noise, with the tRNS key colour
+// and every alpha level present. Returns the size, 0 on error
+unsigned long pngEncode(const pngSpec *spec, uint8_t **out);
+
+// Decode with libpng to 8-bit RGBA, palettes expanded, tRNS made alpha and 16-bit samples cut
+// to their top byte as tft_png.c does. The caller frees the result, NULL on error
+uint8_t *pngReference(const uint8_t *data, unsigned long size, int *width, int *height);
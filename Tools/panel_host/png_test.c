@@ -0,0 +1,201 @@
+/***************************************************
+  Host test of tft_png.c against libpng.
+
+  Every colour type and bit depth, with and without
+  tRNS, is encoded by libpng with each filter and
+  with stored, fixed and dynamic Huffman blocks in
+  many small IDAT chunks. The pixels tft_png.c
+  gives must be the libpng decode in RGB565, with
+  transparency blended over a background colour or
+  pixels under 50% alpha left undrawn. The image is
+  decoded from memory, from a reader returning a
+  few bytes at a time and straight to the panel.
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+#include "png_image.h"
+
+#define BG 0x3186 // Background colour
+#define UNDRAWN 0x0821 // Left where nothing was drawn, not a colour the images produce
+#define CHUNK 5 // Bytes per read
+
+static const struct {
+    int colorType, depth;
+} formats[] = {
+    { 0, 1 }, { 0, 2 }, { 0, 4 }, { 0, 8 }, { 0, 16 },
+    { 2, 8 }, { 2, 16 },
+    { 3, 1 }, { 3, 2 }, { 3, 4 }, { 3, 8 },
+    { 4, 8 }, { 4, 16 },
+    { 6, 8 }, { 6, 16 },
+};
+
+#define FORMATS (sizeof(formats) / sizeof(formats[0]))
+
+static const struct {
+    const char *name;
+    int level;
+    bool fixed;
+} codings[] = {
+    { "stored", 0, false },
+    { "fixed", 6, true },
+    { "dynamic", 9, false },
+};
+
+#define CODINGS (sizeof(codings) / sizeof(codings[0]))
+
+static uint16_t frame[PNG_MAX_WIDTH * 64], expect[PNG_MAX_WIDTH * 64];
+static int frameW;
+
+static void output(void *ctx, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data)
+{
+    (void)ctx;
+    for (int32_t r = 0; r < h; r++)
+        memcpy(&frame[(y + r) * frameW + x], &data[r * w], w * 2);
+}
+
+typedef struct {
+    const uint8_t *data;
+    uint32_t size, pos;
+} source;
+
+static uint32_t readChunk(void *ctx, uint8_t *buf, uint32_t len)
+{
+    source *s = ctx;
+
+    if (len > CHUNK)
+        len = CHUNK;
+    if (len > s->size - s->pos)
+        len = s->size - s->pos;
+    memcpy(buf, s->data + s->pos, len);
+    s->pos += len;
+    return len;
+}
+
+// The libpng pixels as tft_png.c draws them over bg, or undrawn under 50% alpha
+static void expected(const uint8_t *rgba, int n, uint32_t bg)
+{
+    for (int i = 0; i < n; i++, rgba += 4) {
+        uint16_t c = color565(rgba[0], rgba[1], rgba[2]);
+        if (bg > 0xFFFF)
+            expect[i] = (rgba[3] >= 128) ? c : UNDRAWN;
+        else
+            expect[i] = (rgba[3] == 255) ? c : alphaBlend(rgba[3], c, bg);
+    }
+}
+
+static int differences(int n)
+{
+    int differ = 0;
+
+    for (int i = 0; i < n; i++)
+        differ += frame[i] != expect[i];
+    return differ;
+}
+
+static pngDecoder png;
+
+// Decode one image each way with bg, count the failures
+static int check(const char *name, const uint8_t *data, unsigned long size, const uint8_t *rgba, int w, int h,
+                 uint32_t bg)
+{
+    int bad = 0, differ;
+
+    frameW = w;
+    expected(rgba, w * h, bg);
+
+    for (int i = 0; i < w * h; i++)
+        frame[i] = UNDRAWN;
+    if (!pngOpen(&png, data, size, NULL, NULL) || png.width != w || png.height != h ||
+        !pngDecode(&png, 0, 0, bg, output)) {
+        printf("%s: not decoded\n", name);
+        return 1;
+    }
+    if ((differ = differences(w * h))) {
+        printf("%s: %d of %d pixels differ\n", name, differ, w * h);
+        bad++;
+    }
+
+    source s = { data, size, 0 };
+    for (int i = 0; i < w * h; i++)
+        frame[i] = UNDRAWN;
+    if (!pngOpen(&png, NULL, 0, readChunk, &s) || !pngDecode(&png, 0, 0, bg, output) || differences(w * h)) {
+        printf("%s: streamed decode differs\n", name);
+        bad++;
+    }
+
+    fillScreen(UNDRAWN);
+    if (!pngOpen(&png, data, size, NULL, NULL) || !pngDecode(&png, 0, 7, bg, NULL)) {
+        printf("%s: not drawn\n", name);
+        return bad + 1;
+    }
+    differ = 0;
+    for (int y = 0; y < h; y++)
+        for (int x = 0; x < w; x++)
+            differ += readPixel(x, 7 + y) != expect[y * w + x];
+    if (differ) {
+        printf("%s: %d pixels differ on the panel\n", name, differ);
+        bad++;
+    }
+
+    return bad;
+}
+
+int main(void)
+{
+    int bad = 0, images = 0;
+
+    displayInit(TFT_WIDTH, TFT_HEIGHT);
+    setRotation(1); // 320 x 240, the widest image fits
+
+    for (uint32_t f = 0; f < FORMATS; f++) {
+        int colorType = formats[f].colorType, depth = formats[f].depth;
+        static const int channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+        int bytes = channels[colorType] * depth / 8; // 16-bit RGB and RGBA fit fewer pixels in a row
+        int widest = (bytes > 4) ? PNG_MAX_WIDTH * 4 / bytes : PNG_MAX_WIDTH;
+        const int widths[] = { 1, 37, widest };
+
+        for (int trns = 0; trns <= (colorType < 4); trns++) {
+            for (uint32_t c = 0; c < CODINGS; c++) {
+                for (int i = 0; i < 3; i++) {
+                    pngSpec spec = { colorType, depth, trns, false, widths[i], 29, codings[c].level,
+                                     codings[c].fixed, 61 };
+                    uint8_t *data = NULL, *rgba;
+                    unsigned long size = pngEncode(&spec, &data);
+                    int w, h;
+                    char name[80];
+
+                    snprintf(name, sizeof(name), "type %d depth %2d%s %s %dx%d", colorType, depth,
+                             trns ? " tRNS" : "", codings[c].name, spec.width, spec.height);
+                    if (!size || !(rgba = pngReference(data, size, &w, &h))) {
+                        printf("%s: libpng failed\n", name);
+                        bad++;
+                        free(data);
+                        continue;
+                    }
+
+                    bad += check(name, data, size, rgba, w, h, BG);
+                    bad += check(name, data, size, rgba, w, h, PNG_NO_BACKGROUND);
+                    images++;
+                    free(rgba);
+                    free(data);
+                }
+            }
+        }
+    }
+    printf("%d images, each decoded 6 ways\n", images);
+
+    // Interlaced and too wide images are refused
+    pngSpec adam7 = { 2, 8, false, true, 40, 20, 6, false, 0 };
+    pngSpec wide = { 6, 16, false, false, PNG_MAX_WIDTH / 2 + 1, 4, 6, false, 0 };
+    uint8_t *data = NULL;
+    unsigned long size = pngEncode(&adam7, &data);
+    bad += pngOpen(&png, data, size, NULL, NULL);
+    free(data);
+    size = pngEncode(&wide, &data);
+    bad += pngOpen(&png, data, size, NULL, NULL);
+    free(data);
+
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
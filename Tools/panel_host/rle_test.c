@@ -0,0 +1,201 @@
+/***************************************************
+  Host test of pushImageRLE().
+
+  Icons with a transparency mask are coded in the
+  span layout of Tools/rle565_pack.py and drawn at
+  random places, partly off the screen and inside
+  viewports with and without their own datum, in
+  every rotation. The panel must hold what drawing
+  each opaque pixel with drawPixel() gives. The
+  commands sent are counted against those of
+  pushMaskedImage() for the same icon.
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+
+#define PLACES 300
+#define ICON_MAX (100 * 48)
+
+typedef struct {
+    const char *name;
+    int w, h;
+    uint16_t pixels[ICON_MAX];
+    uint8_t mask[ICON_MAX / 8 + 48]; // Rows padded to whole bytes, as pushMaskedImage() takes
+    uint16_t rle[2 + ICON_MAX * 3];
+} icon;
+
+static icon icons[4];
+static uint16_t expect[PANEL_MAX_PIXELS];
+static uint32_t random32 = 1;
+
+static uint32_t next(uint32_t n)
+{
+    random32 ^= random32 << 13;
+    random32 ^= random32 >> 17;
+    random32 ^= random32 << 5;
+    return random32 % n;
+}
+
+static bool opaque(const icon *ic, int x, int y)
+{
+    return ic->mask[y * ((ic->w + 7) / 8) + x / 8] & (0x80 >> (x & 7));
+}
+
+// Set the mask with shape(), then make the span list
+static void makeIcon(icon *ic, const char *name, int w, int h, bool (*shape)(int x, int y, int w, int h))
+{
+    uint16_t *d = ic->rle;
+
+    ic->name = name;
+    ic->w = w;
+    ic->h = h;
+    memset(ic->mask, 0, sizeof(ic->mask));
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            ic->pixels[y * w + x] = color565(x * 255 / w, y * 255 / h, (x ^ y) * 8);
+            if (shape(x, y, w, h))
+                ic->mask[y * ((w + 7) / 8) + x / 8] |= 0x80 >> (x & 7);
+        }
+    }
+
+    *d++ = w;
+    *d++ = h;
+    for (int y = 0; y < h; y++) {
+        uint16_t *count = d++;
+        int last = 0; // End of the previous span
+        *count = 0;
+        for (int x = 0; x < w;) {
+            if (!opaque(ic, x, y)) {
+                x++;
+                continue;
+            }
+            int start = x;
+            while (x < w && opaque(ic, x, y))
+                x++;
+            *d++ = start - last;
+            *d++ = x - start;
+            memcpy(d, &ic->pixels[y * w + start], (x - start) * 2);
+            d += x - start;
+            last = x;
+            (*count)++;
+        }
+    }
+}
+
+static bool ring(int x, int y, int w, int h)
+{
+    int dx = 2 * x - w + 1, dy = 2 * y - h + 1, r = dx * dx + dy * dy;
+    return (r >= 28 * 28 && r <= 46 * 46) || r < 36;
+}
+
+static bool dot(int x, int y, int w, int h)
+{
+    int dx = 2 * x - w + 1, dy = 2 * y - h + 1;
+    return dx * dx + dy * dy < 15 * 15;
+}
+
+static bool holes(int x, int y, int w, int h)
+{
+    (void)w;
+    (void)h;
+    return next(10) < 6 || x == 0 || y == 0;
+}
+
+// A row of each kind: empty, full, runs of every length
+static bool bars(int x, int y, int w, int h)
+{
+    (void)w;
+    (void)h;
+    return y == 1 || (y > 1 && (x / (y + 1)) & 1);
+}
+
+static const uint16_t background = 0x1082;
+
+static void clear(void)
+{
+    for (int i = 0; i < PANEL_MAX_PIXELS; i++)
+        panelRam[i] = background;
+}
+
+// What drawing each opaque pixel gives
+static void reference(const icon *ic, int x, int y)
+{
+    clear();
+    for (int j = 0; j < ic->h; j++)
+        for (int i = 0; i < ic->w; i++)
+            if (opaque(ic, i, j))
+                drawPixel(x + i, y + j, ic->pixels[j * ic->w + i]);
+    memcpy(expect, panelRam, sizeof(expect));
+}
+
+static int compare(void)
+{
+    int differ = 0;
+
+    for (int i = 0; i < panelWidth * panelHeight; i++)
+        differ += panelRam[i] != expect[i];
+    return differ;
+}
+
+int main(void)
+{
+    int bad = 0;
+
+    displayInit(TFT_WIDTH, TFT_HEIGHT);
+    makeIcon(&icons[0], "ring 48x48", 48, 48, ring);
+    makeIcon(&icons[1], "dot 16x16", 16, 16, dot);
+    makeIcon(&icons[2], "holes 37x21", 37, 21, holes);
+    makeIcon(&icons[3], "bars 100x9", 100, 9, bars);
+
+    for (int k = 0; k < 4; k++) {
+        const icon *ic = &icons[k];
+        int differ = 0;
+
+        for (int n = 0; n < PLACES; n++) {
+            setRotation(n & 3);
+            int x = next(width() + ic->w) - ic->w, y = next(height() + ic->h) - ic->h;
+
+            switch (next(3)) {
+            case 0:
+                resetViewport();
+                break;
+            case 1: // Viewport coordinates from the screen corner
+                setViewport(next(width() / 2), next(height() / 2), 20 + next(width() / 2), 20 + next(height() / 2), false);
+                break;
+            default: // From the viewport corner
+                setViewport(next(width() / 2), next(height() / 2), 20 + next(width() / 2), 20 + next(height() / 2), true);
+                x = next(getViewportWidth() + ic->w) - ic->w;
+                y = next(getViewportHeight() + ic->h) - ic->h;
+                break;
+            }
+
+            reference(ic, x, y);
+            clear();
+            pushImageRLE(x, y, ic->rle);
+            differ += compare() != 0;
+        }
+
+        // Bus commands for one icon on screen against pushMaskedImage()
+        setRotation(0);
+        resetViewport();
+        clear();
+        panelCount = (panelCounters){ 0 };
+        pushImageRLE(10, 10, ic->rle);
+        uint32_t rle = panelCount.commands, rleBytes = panelCount.bytes;
+        memcpy(expect, panelRam, sizeof(expect));
+
+        clear();
+        panelCount = (panelCounters){ 0 };
+        pushMaskedImage(10, 10, ic->w, ic->h, ic->pixels, (uint8_t *)ic->mask);
+        bool same = !compare();
+
+        printf("%-12s %d of %d places differ, %3u commands %5u bytes, pushMaskedImage() %3u commands %5u bytes%s\n",
+               ic->name, differ, PLACES, rle, rleBytes, panelCount.commands, panelCount.bytes,
+               same ? "" : ", different pixels");
+        bad += differ || !same || rle > panelCount.commands;
+    }
+
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,184 @@
+/***************************************************
+  Host test of pushImageRotated().
+
+  An image with transparent pixels, a transparent
+  row and a transparent band of columns in its
+  lower half is drawn about the pivot at every
+  whole degree. Each
+  screen pixel is checked against a double
+  precision inverse mapping of its centre. At 0,
+  90, 180 and 270 degrees the output must be exact,
+  with and without a background, also in a
+  viewport with its own datum. At other angles the
+  16.16 stepping may only pick a different pixel
+  where the centre is within 0.005 of a pixel
+  edge; those cases are counted. The rows go out as
+  deferred DMA, so a line buffer written while in
+  flight shows up as wrong pixels, as it did when
+  the buffers were swapped after the empty row.
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+#include <math.h>
+#include <time.h>
+
+#define W 61
+#define H 37
+#define PX 20 // Image pixel put on the pivot
+#define PY 11
+#define KEY 0xF81F // Transparent colour
+#define CLEAR 0x0821
+#define NEAR 0.005 // Distance from a pixel edge where rounding may pick the neighbour
+
+static uint16_t image[W * H], expect[PANEL_MAX_PIXELS];
+
+static void makeImage(void)
+{
+    uint32_t seed = 7;
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            seed = seed * 1103515245 + 12345;
+            uint16_t c = color565(x * 4, y * 7, (x * y) & 0xFF);
+            if (c == KEY)
+                c ^= 1;
+            if (y == 9 || (y >= 20 && x >= 40 && x < 44) || (seed >> 16) % 60 == 0)
+                c = KEY;
+            image[y * W + x] = c;
+        }
+    }
+}
+
+static void clear(void)
+{
+    for (int i = 0; i < PANEL_MAX_PIXELS; i++)
+        panelRam[i] = CLEAR;
+}
+
+typedef struct {
+    int mismatched, far, pixels; // far: not within NEAR of a pixel edge
+} result;
+
+static uint16_t rotated[PANEL_MAX_PIXELS];
+static int16_t nearX[PANEL_MAX_PIXELS], nearY[PANEL_MAX_PIXELS];
+
+static int differences(const uint16_t *a, const uint16_t *b)
+{
+    int differ = 0;
+
+    for (int i = 0; i < panelWidth * panelHeight; i++)
+        differ += a[i] != b[i];
+    return differ;
+}
+
+// Blank the pixels rounding may move, in both frames
+static void maskNear(int n)
+{
+    memcpy(panelRam, expect, sizeof(expect));
+    for (int i = 0; i < n; i++)
+        drawPixel(nearX[i], nearY[i], CLEAR);
+    memcpy(expect, panelRam, sizeof(expect));
+
+    memcpy(panelRam, rotated, sizeof(rotated));
+    for (int i = 0; i < n; i++)
+        drawPixel(nearX[i], nearY[i], CLEAR);
+}
+
+// The double precision mapping drawn with drawPixel(), then compared with pushImageRotated()
+static result check(int angle, int32_t bg)
+{
+    double rad = angle * M_PI / 180, ca = cos(rad), sa = sin(rad);
+    int xp = getPivotX(), yp = getPivotY();
+    int reach = W + H; // Bounding box of any angle
+    int near = 0;
+    result r;
+
+    clear();
+    for (int y = yp - reach; y <= yp + reach; y++) {
+        for (int x = xp - reach; x <= xp + reach; x++) {
+            double u = PX + 0.5 + (x - xp) * ca + (y - yp) * sa;
+            double v = PY + 0.5 - (x - xp) * sa + (y - yp) * ca;
+            if ((fabs(u - round(u)) < NEAR && u > -1 && u < W + 1) ||
+                (fabs(v - round(v)) < NEAR && v > -1 && v < H + 1)) {
+                nearX[near] = x;
+                nearY[near++] = y;
+            }
+            if (u < 0 || v < 0 || u >= W || v >= H)
+                continue;
+            uint16_t c = image[(int)v * W + (int)u];
+            if (c != KEY)
+                drawPixel(x, y, c);
+        }
+    }
+    memcpy(expect, panelRam, sizeof(expect));
+
+    clear();
+    pushImageRotated(W, H, image, PX, PY, angle, KEY, bg);
+    memcpy(rotated, panelRam, sizeof(rotated));
+
+    r.pixels = 0;
+    for (int i = 0; i < panelWidth * panelHeight; i++)
+        r.pixels += expect[i] != CLEAR;
+    r.mismatched = differences(rotated, expect);
+    maskNear(near);
+    r.far = differences(panelRam, expect);
+    return r;
+}
+
+int main(void)
+{
+    int bad = 0;
+
+    displayInit(TFT_WIDTH, TFT_HEIGHT);
+    setRotation(1);
+    makeImage();
+
+    // Right angles, exact
+    for (int vp = 0; vp < 3; vp++) {
+        if (vp == 0)
+            resetViewport();
+        else
+            setViewport(100, 70, 120, 90, vp == 2); // Cuts the image on every side
+        setPivot(vp == 2 ? 40 : 150, vp == 2 ? 30 : 110);
+
+        for (int angle = 0; angle < 360; angle += 90) {
+            for (int withBg = 0; withBg < 2; withBg++) {
+                result r = check(angle, withBg ? TFT_BLACK : -1);
+                if (r.mismatched) {
+                    printf("%d degrees%s%s: %d of %d pixels differ\n", angle, withBg ? " with background" : "",
+                           vp ? " in a viewport" : "", r.mismatched, r.pixels);
+                    bad++;
+                }
+            }
+        }
+    }
+
+    // Every other angle, measured
+    resetViewport();
+    setPivot(150, 110);
+    long pixels = 0, mismatched = 0, far = 0;
+    for (int angle = -180; angle < 180; angle++) {
+        if (angle % 90 == 0)
+            continue;
+        result r = check(angle, -1);
+        pixels += r.pixels;
+        mismatched += r.mismatched;
+        far += r.far;
+    }
+    printf("other angles: %ld of %ld pixels differ from the double mapping, %ld of them further than %.3f from a "
+           "pixel edge\n", mismatched, pixels, far, NEAR);
+    bad += far != 0;
+
+    // Host time, the emulated panel included
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int angle = 0; angle < 360; angle++)
+        pushImageRotated(W, H, image, PX, PY, angle, KEY, -1);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double us = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e3 / 360;
+    printf("%.1fus an image of %d pixels on the host\n", us, W * H);
+
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
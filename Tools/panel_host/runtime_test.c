@@ -0,0 +1,126 @@
+/***************************************************
+  Host test of TFT_RUNTIME_DRIVER.
+
+  The emulated panel answers RDDID with the ID of an
+  ST7789, then with 0, which no table entry but the
+  last (the ILI9341) matches. Each init must send
+  what the compile-time build of that driver sent,
+  byte for byte and at the same ms, apart from the
+  RDDID read. The traces are those init_test wrote.
+  Then pixels drawn in each rotation must read back
+  with readPixel() and readRect().
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+
+static const struct {
+    uint32_t id; // RDDID answer
+    uint16_t driver; // Expected in displayDriver()->id
+    const char *trace; // Of the compile-time build
+} panels[] = {
+    { 0x858552, 0x7789, "init_ST7789.trace" },
+    { 0, 0x9341, "init_ILI9341.trace" },
+};
+
+// Drop the RDDID command and the bytes read after it
+static size_t dropRddid(char *trace, size_t len)
+{
+    char *out = trace, *end = trace + len;
+    bool rddid = false;
+
+    for (char *line = trace; line < end;) {
+        char *next = memchr(line, '\n', end - line);
+        next = next ? next + 1 : end;
+        if (line[0] == 'C')
+            rddid = !strncmp(line, "C04@", 4);
+        if (!rddid) {
+            memmove(out, line, next - line);
+            out += next - line;
+        }
+        line = next;
+    }
+    return out - trace;
+}
+
+static char *readFile(const char *name, size_t *len)
+{
+    FILE *f = fopen(name, "rb");
+    char *data = NULL;
+
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    *len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(*len + 1);
+    if (fread(data, 1, *len, f) != *len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+// Pixels drawn in every rotation must read back
+static int roundTrip(void)
+{
+    static uint16_t rect[20 * 10];
+    int differ = 0;
+
+    for (uint8_t r = 0; r < 4; r++) {
+        setRotation(r);
+        fillScreen(TFT_BLACK);
+        for (int i = 0; i < 200; i++) {
+            int x = (i * 37) % width(), y = (i * 53) % height();
+            uint16_t c = color565(i, 255 - i, i * 3);
+            drawPixel(x, y, c);
+            differ += readPixel(x, y) != c;
+        }
+
+        fillRect(width() - 20, height() - 10, 20, 10, TFT_ORANGE);
+        drawPixel(width() - 1, height() - 1, TFT_BLUE);
+        readRect(width() - 20, height() - 10, 20, 10, rect);
+        for (int i = 0; i < 20 * 10; i++) {
+            uint16_t c = (i == 20 * 10 - 1) ? TFT_BLUE : TFT_ORANGE;
+            differ += rect[i] != (uint16_t)(c << 8 | c >> 8); // readRect() gives the bytes swapped
+        }
+    }
+    return differ;
+}
+
+int main(void)
+{
+    int bad = 0;
+
+    for (uint32_t p = 0; p < sizeof(panels) / sizeof(panels[0]); p++) {
+        char *trace, *expect;
+        size_t len, expectLen;
+
+        panelId = panels[p].id;
+        panelTrace = open_memstream(&trace, &len);
+        hostMs = 0;
+        bool done = displayInit(TFT_WIDTH, TFT_HEIGHT);
+        uint32_t ms = hostMs;
+        fclose(panelTrace);
+        panelTrace = NULL;
+        len = dropRddid(trace, len);
+
+        expect = readFile(panels[p].trace, &expectLen);
+        if (!expect) {
+            printf("%s missing, run init_test first\n", panels[p].trace);
+            return 1;
+        }
+
+        int differ = roundTrip();
+        bool same = len == expectLen && !memcmp(trace, expect, len);
+        printf("RDDID %06x: driver %04x, init %s %s in %u ms, %d pixels read back wrong\n", panels[p].id,
+               displayDriver()->id, same ? "the same as" : "differs from", panels[p].trace, ms, differ);
+        bad += !done || !same || displayDriver()->id != panels[p].driver || differ;
+        free(trace);
+        free(expect);
+    }
+
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+/***************************************************
+  Host test of the 18-bit colour SPI path.
+
+  The same scene is drawn by an ILI9341 build, which
+  sends RGB565, and an ILI9486 build, which sends
+  RGB666 through SPI_18BIT_DRIVER. Each reads its
+  240x320 frame back, the first writes it to a file
+  and the second must match it. The scene has fills
+  of one colour repeated, spans either side of the
+  DMA length, images longer than both line buffers,
+  text and smooth graphics, all cut by a viewport.
+  The 18-bit build overwrites the pushImageDMA()
+  source as soon as the call returns, which must
+  not change what is drawn.
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+
+#define W 240
+#define H 320
+
+#define FRAME "scene_16.frame" // Drawn by scene_test_16
+
+static uint16_t image[100 * 60], frame[W * H], expect[W * H];
+
+static void makeImage(uint32_t seed)
+{
+    for (int i = 0; i < 100 * 60; i++) {
+        seed = seed * 1103515245 + 12345;
+        image[i] = (i % 100 < 50) ? color565(i % 100 * 5, i / 100 * 4, seed >> 24) : seed >> 16;
+    }
+}
+
+int main(void)
+{
+    displayInit(TFT_WIDTH, TFT_HEIGHT);
+    setRotation(0);
+    fillScreen(TFT_NAVY);
+
+    // Fills, the same colour again and short spans
+    for (int i = 0; i < 12; i++)
+        fillRect(5 + i * 19, 5, 17, 40 + i * 3, (i & 3) ? TFT_ORANGE : color565(i * 20, 255 - i * 20, i * 7));
+    for (int i = 0; i < 40; i++)
+        drawFastHLine(3, 90 + i, 1 + i, color565(i * 6, i, 255 - i * 6));
+    drawPixel(0, 0, TFT_WHITE);
+    drawPixel(W - 1, H - 1, TFT_WHITE);
+
+    // Images of 16, 17 and over 512 pixels, and by DMA
+    makeImage(1);
+    pushImage(60, 90, 16, 1, image);
+    pushImage(60, 93, 17, 1, image + 100);
+    pushImage(60, 100, 100, 60, image);
+    makeImage(2);
+    pushImageDMA(130, 170, 100, 60, image);
+#ifdef SPI_18BIT_DRIVER
+    makeImage(3); // The source is free once pushImageDMA() returns
+    dmaWait();
+#else
+    dmaWait();
+    makeImage(3);
+#endif
+    pushImage(10, 240, 100, 30, image);
+
+    // Text and smooth graphics
+    setTextColorAll(TFT_YELLOW, TFT_DARKGREEN, true);
+    drawString("RGB666 2.5", 10, 175, 4);
+    setTextColor(TFT_CYAN);
+    drawString("over SPI", 10, 205, 2);
+    fillSmoothCircle(190, 280, 30, TFT_RED, TFT_NAVY);
+    drawWideLine(20, 300, 220, 250, 5, TFT_GREEN, TFT_NAVY);
+    fillRectVGradient(200, 60, 35, 100, TFT_MAGENTA, TFT_BLUE);
+
+    // Cut by a viewport
+    setViewport(30, 280, 120, 30, true);
+    fillRect(-10, -10, 300, 300, TFT_DARKGREY);
+    pushImage(-20, -5, 100, 60, image);
+    drawString("cut", 60, 10, 4);
+    resetViewport();
+
+    for (int y = 0; y < H; y++)
+        for (int x = 0; x < W; x++)
+            frame[y * W + x] = readPixel(x, y);
+
+#ifdef SPI_18BIT_DRIVER
+    FILE *f = fopen(FRAME, "rb");
+    if (!f || fread(expect, sizeof(expect), 1, f) != 1) {
+        printf("run scene_test_16 first to draw " FRAME "\n");
+        return 1;
+    }
+    fclose(f);
+
+    int differ = 0;
+    for (int i = 0; i < W * H; i++)
+        differ += frame[i] != expect[i];
+    printf("%u bytes sent, %d pixels differ from the RGB565 build\n", (unsigned)panelCount.bytes, differ);
+    printf("%s\n", differ ? "FAIL" : "ok");
+    return differ ? 1 : 0;
+#else
+    FILE *f = fopen(FRAME, "wb");
+    if (!f || fwrite(frame, sizeof(frame), 1, f) != 1) {
+        printf("can not write " FRAME "\n");
+        return 1;
+    }
+    fclose(f);
+
+    printf("%u bytes sent, frame in " FRAME "\nok\n", (unsigned)panelCount.bytes);
+    return 0;
+#endif
+}
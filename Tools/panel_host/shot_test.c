@@ -0,0 +1,181 @@
+/***************************************************
+  Host test of tft_shot.c.
+
+  A scene drawn on the panel, and an RGB565 buffer,
+  are captured as BMP and as PNG, whole and in part,
+  with shotCapture() and one shotStep() at a time.
+  The BMP header and rows are parsed here and must
+  give back the pixels exactly. The PNG is read by
+  libpng, which checks every chunk CRC and the
+  Adler-32, and must give each RGB565 pixel widened
+  to 8 bits. A sink that fails part way must stop
+  the capture with shot->error set.
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+#include "png_image.h"
+
+#define OFF_W 200
+#define OFF_H 100
+#define FILE_MAX (1024 * 1024)
+
+static uint8_t file[FILE_MAX];
+static uint32_t size, failAt, refused;
+static uint16_t offscreen[OFF_W * OFF_H];
+static screenShot shot;
+
+static bool sink(void *ctx, const uint8_t *buf, uint32_t len)
+{
+    (void)ctx;
+    if (size + len > FILE_MAX || (failAt && size + len > failAt)) {
+        refused++;
+        return false;
+    }
+    memcpy(file + size, buf, len);
+    size += len;
+    return true;
+}
+
+static uint32_t get16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t get32(const uint8_t *p)
+{
+    return get16(p) | get16(p + 2) << 16;
+}
+
+// Pixel the capture should hold, black off the screen
+static uint16_t pixel(const uint16_t *source, int x, int y)
+{
+    if (source)
+        return source[y * OFF_W + x];
+    if (x < 0 || y < 0 || x >= width() || y >= height())
+        return 0;
+    return readPixel(x, y);
+}
+
+static int checkBmp(const uint16_t *source, int x, int y, int w, int h)
+{
+    uint32_t offset = get32(file + 10), stride = (w * 2 + 3) & ~3;
+
+    if (file[0] != 'B' || file[1] != 'M' || get32(file + 2) != size || offset != 66 ||
+        (int32_t)get32(file + 18) != w || (int32_t)get32(file + 22) != -h || get16(file + 28) != 16 ||
+        get32(file + 30) != 3 || get32(file + 54) != 0xF800 || get32(file + 58) != 0x07E0 ||
+        get32(file + 62) != 0x001F || size != offset + stride * h) {
+        printf("bad BMP header\n");
+        return 1;
+    }
+
+    int differ = 0;
+    for (int j = 0; j < h; j++)
+        for (int i = 0; i < w; i++)
+            differ += get16(file + offset + j * stride + i * 2) != pixel(source, x + i, y + j);
+    return differ;
+}
+
+static int checkPng(const uint16_t *source, int x, int y, int w, int h)
+{
+    int pw, ph;
+    uint8_t *rgba = pngReference(file, size, &pw, &ph);
+
+    if (!rgba || pw != w || ph != h) {
+        printf("PNG not read by libpng\n");
+        free(rgba);
+        return 1;
+    }
+
+    int differ = 0;
+    for (int j = 0; j < h; j++) {
+        for (int i = 0; i < w; i++) {
+            uint16_t c = pixel(source, x + i, y + j);
+            const uint8_t *p = rgba + (j * w + i) * 4;
+            int r = c >> 11, g = c >> 5 & 0x3F, b = c & 0x1F;
+            differ += p[0] != (r << 3 | r >> 2) || p[1] != (g << 2 | g >> 4) || p[2] != (b << 3 | b >> 2);
+        }
+    }
+    free(rgba);
+    return differ;
+}
+
+int main(void)
+{
+    static const struct {
+        int x, y, w, h;
+        bool source;
+    } areas[] = {
+        { 0, 0, 320, 240, false },
+        { 200, 150, 77, 33, false },
+        { 290, 220, 45, 30, false }, // Off the right and bottom edges
+        { 0, 0, 1, 1, false },
+        { 10, 20, 151, 70, true },
+        { 0, 0, OFF_W, OFF_H, true },
+    };
+    uint32_t seed = 3;
+    int bad = 0;
+
+    displayInit(TFT_WIDTH, TFT_HEIGHT);
+    setRotation(1);
+    for (int i = 0; i < 60; i++) {
+        seed = seed * 1103515245 + 12345;
+        fillRect(seed >> 8 & 0xFF, seed >> 16 & 0xFF, 10 + (seed & 63), 10 + (seed >> 24 & 63), seed >> 12);
+    }
+    setTextColor(TFT_WHITE);
+    drawString("Capture", 10, 10, 4);
+    for (int i = 0; i < OFF_W * OFF_H; i++) {
+        seed = seed * 1103515245 + 12345;
+        offscreen[i] = seed >> 16;
+    }
+
+    for (uint32_t a = 0; a < sizeof(areas) / sizeof(areas[0]); a++) {
+        for (uint8_t format = SHOT_BMP; format <= SHOT_PNG; format++) {
+            for (int stepped = 0; stepped < 2; stepped++) {
+                const uint16_t *source = areas[a].source ? offscreen : NULL;
+                int x = areas[a].x, y = areas[a].y, w = areas[a].w, h = areas[a].h, steps = 0;
+                bool done;
+
+                size = 0;
+                if (stepped) {
+                    done = shotOpen(&shot, x, y, w, h, format, source, OFF_W, sink, NULL);
+                    while (shotStep(&shot))
+                        steps++;
+                    done = done && !shot.error;
+                } else {
+                    done = shotCapture(&shot, x, y, w, h, format, source, OFF_W, sink, NULL);
+                }
+
+                int differ = !done || shot.bytes != size;
+                if (!differ)
+                    differ = (format == SHOT_BMP) ? checkBmp(source, x, y, w, h) : checkPng(source, x, y, w, h);
+                printf("%s %3dx%-3d at %3d,%-3d %s%s: %6u bytes%s\n", format == SHOT_BMP ? "BMP" : "PNG", w, h, x,
+                       y, source ? "buffer" : "panel ", stepped ? ", stepped" : "", size, differ ? ", differs" : "");
+                bad += differ != 0;
+
+                // Each step reads one strip
+                int strip = SHOT_STRIP_PIXELS / w;
+                if (stepped && steps != (h + strip - 1) / strip - 1) {
+                    printf("%d steps\n", steps);
+                    bad++;
+                }
+            }
+        }
+    }
+
+    // A sink that fails stops the capture, and nothing more is written
+    size = 0;
+    failAt = 5000;
+    refused = 0;
+    bool done = shotCapture(&shot, 0, 0, 320, 240, SHOT_PNG, NULL, 0, sink, NULL);
+    printf("sink failing at %u bytes: %s with %u bytes, called %u times after refusing\n", failAt,
+           done ? "completed" : "stopped", shot.bytes, refused - 1);
+    bad += done || !shot.error || shot.bytes != size || refused != 1;
+    failAt = 0;
+
+    // Too wide an area is refused
+    bad += shotCapture(&shot, 0, 0, SHOT_MAX_WIDTH + 1, 3, SHOT_PNG, NULL, 0, sink, NULL);
+
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
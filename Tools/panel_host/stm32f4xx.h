@@ -0,0 +1,231 @@
+#pragma once
+
+// Host stand-in for the parts of the STM32F4 SPL the library uses. The registers are plain
+// structs defined in board.c and the SPL calls are stubs there. On a 64-bit host the
+// addresses the HALs store in DMA registers are truncated, nothing is ever read through them
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t MODER, OTYPER, OSPEEDR, PUPDR, IDR, ODR, BSRR, LCKR, AFR[2];
+} GPIO_TypeDef;
+
+typedef struct {
+    volatile uint32_t CR1, CR2, SR, DR, CRCPR, RXCRCR, TXCRCR, I2SCFGR, I2SPR;
+} SPI_TypeDef;
+
+typedef struct {
+    volatile uint32_t CR, NDTR, PAR, M0AR, M1AR, FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+    volatile uint32_t BWTR[7];
+} FSMC_Bank1E_TypeDef;
+
+typedef struct {
+    volatile uint32_t CTRL, CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    volatile uint32_t DHCSR, DCRSR, DCRDR, DEMCR;
+} CoreDebug_Type;
+
+extern GPIO_TypeDef hostGPIOA, hostGPIOB, hostGPIOC, hostGPIOD, hostGPIOE;
+extern SPI_TypeDef hostSPI2;
+extern DMA_Stream_TypeDef hostDMA1_Stream3, hostDMA1_Stream4, hostDMA2_Stream0;
+extern FSMC_Bank1E_TypeDef hostFSMC_Bank1E;
+extern DWT_Type hostDWT;
+extern CoreDebug_Type hostCoreDebug;
+
+#define GPIOA (&hostGPIOA)
+#define GPIOB (&hostGPIOB)
+#define GPIOC (&hostGPIOC)
+#define GPIOD (&hostGPIOD)
+#define GPIOE (&hostGPIOE)
+#define SPI2 (&hostSPI2)
+#define DMA1_Stream3 (&hostDMA1_Stream3)
+#define DMA1_Stream4 (&hostDMA1_Stream4)
+#define DMA2_Stream0 (&hostDMA2_Stream0)
+#define FSMC_Bank1E (&hostFSMC_Bank1E)
+#define DWT (&hostDWT)
+#define CoreDebug (&hostCoreDebug)
+
+#define RESET 0
+#define DISABLE 0
+#define ENABLE 1
+
+// GPIO
+typedef struct {
+    uint32_t GPIO_Pin, GPIO_Mode, GPIO_Speed, GPIO_OType, GPIO_PuPd;
+} GPIO_InitTypeDef;
+
+#define GPIO_Pin_0 0x0001
+#define GPIO_Pin_1 0x0002
+#define GPIO_Pin_2 0x0004
+#define GPIO_Pin_3 0x0008
+#define GPIO_Pin_4 0x0010
+#define GPIO_Pin_5 0x0020
+#define GPIO_Pin_6 0x0040
+#define GPIO_Pin_7 0x0080
+#define GPIO_Pin_8 0x0100
+#define GPIO_Pin_9 0x0200
+#define GPIO_Pin_10 0x0400
+#define GPIO_Pin_11 0x0800
+#define GPIO_Pin_12 0x1000
+#define GPIO_Pin_13 0x2000
+#define GPIO_Pin_14 0x4000
+#define GPIO_Pin_15 0x8000
+#define GPIO_PinSource13 13
+#define GPIO_PinSource14 14
+#define GPIO_PinSource15 15
+#define GPIO_Mode_OUT 1
+#define GPIO_Mode_AF 2
+#define GPIO_Speed_100MHz 3
+#define GPIO_AF_SPI2 5
+#define GPIO_AF_FSMC 12
+
+// RCC
+typedef struct {
+    uint32_t SYSCLK_Frequency, HCLK_Frequency, PCLK1_Frequency, PCLK2_Frequency;
+} RCC_ClocksTypeDef;
+
+#define RCC_AHB1Periph_GPIOA 0x00000001
+#define RCC_AHB1Periph_GPIOB 0x00000002
+#define RCC_AHB1Periph_GPIOC 0x00000004
+#define RCC_AHB1Periph_GPIOD 0x00000008
+#define RCC_AHB1Periph_GPIOE 0x00000010
+#define RCC_AHB1Periph_DMA1 0x00200000
+#define RCC_AHB1Periph_DMA2 0x00400000
+#define RCC_AHB3Periph_FSMC 0x00000001
+#define RCC_APB1Periph_SPI2 0x00004000
+
+// SPI
+typedef struct {
+    uint16_t SPI_Direction, SPI_Mode, SPI_DataSize, SPI_CPOL, SPI_CPHA, SPI_NSS;
+    uint16_t SPI_BaudRatePrescaler, SPI_FirstBit, SPI_CRCPolynomial;
+} SPI_InitTypeDef;
+
+#define SPI_Direction_2Lines_FullDuplex 0x0000
+#define SPI_Mode_Master 0x0104
+#define SPI_DataSize_8b 0x0000
+#define SPI_DataSize_16b 0x0800
+#define SPI_CPOL_Low 0x0000
+#define SPI_CPOL_High 0x0002
+#define SPI_CPHA_1Edge 0x0000
+#define SPI_CPHA_2Edge 0x0001
+#define SPI_NSS_Soft 0x0200
+#define SPI_BaudRatePrescaler_2 0x0000
+#define SPI_BaudRatePrescaler_4 0x0008
+#define SPI_BaudRatePrescaler_8 0x0010
+#define SPI_BaudRatePrescaler_16 0x0018
+#define SPI_BaudRatePrescaler_32 0x0020
+#define SPI_BaudRatePrescaler_64 0x0028
+#define SPI_BaudRatePrescaler_128 0x0030
+#define SPI_BaudRatePrescaler_256 0x0038
+#define SPI_FirstBit_MSB 0x0000
+#define SPI_CR1_CPHA 0x0001
+#define SPI_CR1_CPOL 0x0002
+#define SPI_CR1_BR 0x0038
+#define SPI_CR1_SPE 0x0040
+#define SPI_I2S_FLAG_RXNE 0x0001
+#define SPI_I2S_FLAG_TXE 0x0002
+#define SPI_I2S_FLAG_BSY 0x0080
+#define SPI_I2S_DMAReq_Rx 0x0001
+#define SPI_I2S_DMAReq_Tx 0x0002
+
+// DMA
+typedef struct {
+    uint32_t DMA_Channel, DMA_PeripheralBaseAddr, DMA_Memory0BaseAddr, DMA_DIR, DMA_BufferSize;
+    uint32_t DMA_PeripheralInc, DMA_MemoryInc, DMA_PeripheralDataSize, DMA_MemoryDataSize, DMA_Mode;
+    uint32_t DMA_Priority, DMA_FIFOMode, DMA_FIFOThreshold, DMA_MemoryBurst, DMA_PeripheralBurst;
+} DMA_InitTypeDef;
+
+#define DMA_Channel_0 0x00000000
+#define DMA_DIR_PeripheralToMemory 0x00000000
+#define DMA_DIR_MemoryToPeripheral 0x00000040
+#define DMA_DIR_MemoryToMemory 0x00000080
+#define DMA_PeripheralInc_Disable 0x00000000
+#define DMA_PeripheralInc_Enable 0x00000200
+#define DMA_MemoryInc_Disable 0x00000000
+#define DMA_MemoryInc_Enable 0x00000400
+#define DMA_PeripheralDataSize_Byte 0x00000000
+#define DMA_PeripheralDataSize_HalfWord 0x00000800
+#define DMA_MemoryDataSize_Byte 0x00000000
+#define DMA_MemoryDataSize_HalfWord 0x00002000
+#define DMA_Mode_Normal 0x00000000
+#define DMA_Priority_High 0x00020000
+#define DMA_FIFOMode_Disable 0x00000000
+#define DMA_FIFOMode_Enable 0x00000004
+#define DMA_FIFOThreshold_1QuarterFull 0x00000000
+#define DMA_FIFOThreshold_Full 0x00000003
+#define DMA_MemoryBurst_Single 0x00000000
+#define DMA_PeripheralBurst_Single 0x00000000
+#define DMA_SxCR_EN 0x00000001
+#define DMA_SxCR_PINC 0x00000200
+#define DMA_SxCR_MINC 0x00000400
+#define DMA_SxCR_PSIZE 0x00001800
+#define DMA_SxCR_MSIZE 0x00006000
+#define DMA_FLAG_FEIF0 0x10800001
+#define DMA_FLAG_DMEIF0 0x10800004
+#define DMA_FLAG_TEIF0 0x10000008
+#define DMA_FLAG_HTIF0 0x10000010
+#define DMA_FLAG_TCIF0 0x10000020
+#define DMA_FLAG_TCIF3 0x08000000
+#define DMA_FLAG_TCIF4 0x20000020
+
+// FSMC
+typedef struct {
+    uint32_t FSMC_AddressSetupTime, FSMC_AddressHoldTime, FSMC_DataSetupTime;
+    uint32_t FSMC_BusTurnAroundDuration, FSMC_CLKDivision, FSMC_DataLatency, FSMC_AccessMode;
+} FSMC_NORSRAMTimingInitTypeDef;
+
+typedef struct {
+    uint32_t FSMC_Bank, FSMC_DataAddressMux, FSMC_MemoryType, FSMC_MemoryDataWidth;
+    uint32_t FSMC_BurstAccessMode, FSMC_AsynchronousWait, FSMC_WaitSignalPolarity, FSMC_WrapMode;
+    uint32_t FSMC_WaitSignalActive, FSMC_WriteOperation, FSMC_WaitSignal, FSMC_ExtendedMode;
+    uint32_t FSMC_WriteBurst;
+    FSMC_NORSRAMTimingInitTypeDef *FSMC_ReadWriteTimingStruct;
+    FSMC_NORSRAMTimingInitTypeDef *FSMC_WriteTimingStruct;
+} FSMC_NORSRAMInitTypeDef;
+
+#define FSMC_Bank1_NORSRAM1 0x00000000
+#define FSMC_DataAddressMux_Disable 0x00000000
+#define FSMC_MemoryType_SRAM 0x00000000
+#define FSMC_MemoryDataWidth_16b 0x00000010
+#define FSMC_BurstAccessMode_Disable 0x00000000
+#define FSMC_WriteOperation_Enable 0x00001000
+#define FSMC_ExtendedMode_Enable 0x00004000
+#define FSMC_WriteBurst_Disable 0x00000000
+#define FSMC_AccessMode_A 0x00000000
+#define FSMC_BWTR1_DATAST 0x0000FF00
+
+// Core
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+#define DWT_CTRL_CYCCNTENA_Msk 1UL
+
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t mask) { (void)mask; }
+static inline void __disable_irq(void) {}
+
+void RCC_GetClocksFreq(RCC_ClocksTypeDef *clocks);
+void RCC_AHB1PeriphClockCmd(uint32_t periph, int state);
+void RCC_AHB3PeriphClockCmd(uint32_t periph, int state);
+void RCC_APB1PeriphClockCmd(uint32_t periph, int state);
+void GPIO_StructInit(GPIO_InitTypeDef *init);
+void GPIO_Init(GPIO_TypeDef *port, GPIO_InitTypeDef *init);
+void GPIO_PinAFConfig(GPIO_TypeDef *port, uint16_t source, uint8_t af);
+void SPI_StructInit(SPI_InitTypeDef *init);
+void SPI_I2S_DeInit(SPI_TypeDef *spi);
+void SPI_Init(SPI_TypeDef *spi, SPI_InitTypeDef *init);
+void SPI_Cmd(SPI_TypeDef *spi, int state);
+void SPI_I2S_DMACmd(SPI_TypeDef *spi, uint16_t req, int state);
+uint16_t SPI_I2S_ReceiveData(SPI_TypeDef *spi);
+void DMA_DeInit(DMA_Stream_TypeDef *stream);
+void DMA_StructInit(DMA_InitTypeDef *init);
+void DMA_Init(DMA_Stream_TypeDef *stream, DMA_InitTypeDef *init);
+void DMA_Cmd(DMA_Stream_TypeDef *stream, int state);
+int DMA_GetFlagStatus(DMA_Stream_TypeDef *stream, uint32_t flag);
+void DMA_ClearFlag(DMA_Stream_TypeDef *stream, uint32_t flag);
+void FSMC_NORSRAMStructInit(FSMC_NORSRAMInitTypeDef *init);
+void FSMC_NORSRAMInit(FSMC_NORSRAMInitTypeDef *init);
+void FSMC_NORSRAMCmd(uint32_t bank, int state);
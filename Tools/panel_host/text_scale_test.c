@@ -0,0 +1,153 @@
+/***************************************************
+  Host test of scaled text and pushImageScaled().
+
+  Text is drawn at size 1 and read back, then at
+  larger sizes. Each must be the size 1 text with
+  every pixel made a size x size square, drawn
+  with fillRect(), for fonts 1, 2, 4, 6, 7 and 8,
+  with and without a background and inside a
+  viewport that cuts it. Images scaled by whole
+  numbers with pushImageScaled() must likewise be
+  their pixels magnified.
+ ****************************************************/
+
+#include "board.h"
+#include "panel.h"
+
+#define CLEAR 0x0821 // Panel colour where nothing is drawn
+#define FG 0xFFE0
+#define BG 0x001F
+#define MAX_W 160
+#define MAX_H 80
+
+static const struct {
+    uint8_t font;
+    const char *text;
+    uint8_t sizes; // Largest size that still fits
+} cases[] = {
+    { 1, "Hg!~ 09aZ", 4 },
+    { 2, "Text 42,gj", 4 },
+    { 4, "Ag 7%", 3 },
+    { 6, "1:2p", 2 },
+    { 7, "3-.4", 2 },
+    { 8, "5:6", 2 },
+};
+
+#define CASES (sizeof(cases) / sizeof(cases[0]))
+
+static uint16_t small[MAX_H][MAX_W], expect[PANEL_MAX_PIXELS];
+
+static void clear(void)
+{
+    for (int i = 0; i < PANEL_MAX_PIXELS; i++)
+        panelRam[i] = CLEAR;
+}
+
+static int compare(void)
+{
+    int differ = 0;
+
+    for (int i = 0; i < panelWidth * panelHeight; i++)
+        differ += panelRam[i] != expect[i];
+    return differ;
+}
+
+// Every pixel of the size 1 capture that was drawn, made size x size at x,y
+static void magnify(int x, int y, int w, int h, int size)
+{
+    clear();
+    for (int j = 0; j < h; j++)
+        for (int i = 0; i < w; i++)
+            if (small[j][i] != CLEAR)
+                fillRect(x + i * size, y + j * size, size, size, small[j][i]);
+    memcpy(expect, panelRam, sizeof(expect));
+}
+
+static void viewport(bool cut)
+{
+    if (cut)
+        setViewport(17, 9, 190, 150, false); // Cuts the larger text at the top, left and right
+    else
+        resetViewport();
+}
+
+int main(void)
+{
+    int bad = 0, runs = 0;
+
+    displayInit(TFT_WIDTH, TFT_HEIGHT);
+    setRotation(1);
+    setTextDatum(TL_DATUM);
+
+    for (uint32_t c = 0; c < CASES; c++) {
+        for (int bg = 0; bg < 2; bg++) {
+            // Size 1, read back from the panel
+            resetViewport();
+            clear();
+            setTextSize(1);
+            if (bg)
+                setTextColorAll(FG, BG, true);
+            else
+                setTextColor(FG);
+            int w = drawString(cases[c].text, 0, 0, cases[c].font), h = fontHeight(cases[c].font);
+            if (w > MAX_W || h > MAX_H) {
+                printf("font %d: %dx%d does not fit\n", cases[c].font, w, h);
+                return 1;
+            }
+            for (int y = 0; y < h; y++)
+                for (int x = 0; x < w; x++)
+                    small[y][x] = readPixel(x, y);
+
+            for (int size = 2; size <= cases[c].sizes; size++) {
+                for (int cut = 0; cut < 2; cut++) {
+                    int x = 11 - 3 * size, y = 13 - 4 * size; // Off the viewport for the larger sizes
+
+                    viewport(cut);
+                    magnify(x, y, w, h, size);
+
+                    clear();
+                    setTextSize(size);
+                    drawString(cases[c].text, x, y, cases[c].font);
+                    int differ = compare();
+                    if (differ) {
+                        printf("font %d size %d%s%s: %d pixels differ\n", cases[c].font, size,
+                               bg ? " with background" : "", cut ? " in a viewport" : "", differ);
+                        bad++;
+                    }
+                    runs++;
+                }
+            }
+        }
+    }
+    printf("%d scaled strings\n", runs);
+    resetViewport();
+    setTextSize(1);
+
+    // Whole ratios of an image, and bilinear at 1:1 where it has nothing to blend
+    static uint16_t image[23 * 17];
+    for (int i = 0; i < 23 * 17; i++)
+        image[i] = color565(i * 7, i * 13, i * 29);
+    for (int y = 0; y < 17; y++)
+        for (int x = 0; x < 23; x++)
+            small[y][x] = image[y * 23 + x];
+
+    for (int size = 1; size <= 5; size++) {
+        for (int smooth = 0; smooth <= (size == 1); smooth++) {
+            for (int cut = 0; cut < 2; cut++) {
+                viewport(cut);
+                magnify(-5, 3, 23, 17, size);
+                clear();
+                pushImageScaled(-5, 3, 23, 17, image, 23 * size, 17 * size, smooth);
+                int differ = compare();
+                if (differ) {
+                    printf("image x%d%s%s: %d pixels differ\n", size, smooth ? " smooth" : "",
+                           cut ? " in a viewport" : "", differ);
+                    bad++;
+                }
+            }
+        }
+    }
+
+    printf("%s\n", bad ? "FAIL" : "ok");
+    return bad ? 1 : 0;
+}
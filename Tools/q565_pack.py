@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""
+Convert a PNG into Q565, the lossless RGB565 image format drawn by
+q565Decode() when LOAD_Q565 is defined.
+
+Usage:
+  q565_pack.py icon.png Name > Name.h
+  q565_pack.py icon.png Name --bg 0x202020 --bin icon.q565 > Name.h
+
+Pixels are converted to RGB565 by truncation, as color565() does, and any
+alpha is blended with --bg (RGB888, default black) first. Only the PNG
+reader in this file is used, no imaging library is needed.
+
+The generated array is drawn with:
+  #include "Name.h"
+  q565Decoder q;
+  if (q565Open(&q, Name, sizeof(Name), NULL, NULL))
+    q565Decode(&q, x, y, NULL);
+
+Format, all values little endian:
+  header  8 bytes: "Q565", u16 width, u16 height
+  then a stream of ops, each giving one or more pixels in row order. The
+  previous pixel starts as 0 and a 64 entry table of recent colours
+  starts zeroed. Every pixel not given by a run is stored in the table at
+  hash(c) = (c * 0x9E37 & 0xFFFF) >> 10.
+  00iiiiii           table entry i
+  01rrggbb           previous pixel plus r, g and b, each -2..1 (+2 coded)
+  10gggggg rrrrbbbb  green delta -32..31 (+32), red and blue deltas
+                     minus half the green delta, -8..7 (+8)
+  11nnnnnn           repeat the previous pixel n + 1 times, n < 62
+  11111110 u16       raw RGB565 pixel
+  11111111 u16       repeat the previous pixel u16 times
+  Deltas wrap within the 5 or 6 bits of each channel.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+
+def read_png(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:8] != b"\x89PNG\r\n\x1a\n":
+        raise SystemExit("%s: not a PNG" % path)
+
+    pos = 8
+    idat = b""
+    palette = []
+    trns = None
+    while pos < len(data):
+        length, kind = struct.unpack(">I4s", data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + length]
+        pos += 12 + length
+        if kind == b"IHDR":
+            width, height, depth, ctype, _, _, interlace = struct.unpack(">IIBBBBB", body)
+        elif kind == b"PLTE":
+            palette = [tuple(body[i:i + 3]) for i in range(0, length, 3)]
+        elif kind == b"tRNS":
+            trns = body
+        elif kind == b"IDAT":
+            idat += body
+        elif kind == b"IEND":
+            break
+    if interlace:
+        raise SystemExit("%s: interlaced PNGs are not supported" % path)
+
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[ctype]
+    bpp = max(1, channels * depth // 8)
+    stride = (width * channels * depth + 7) // 8
+    raw = zlib.decompress(idat)
+
+    # Unfilter
+    rows = []
+    prev = bytearray(stride)
+    for y in range(height):
+        kind = raw[y * (stride + 1)]
+        row = bytearray(raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)])
+        for i in range(stride):
+            a = row[i - bpp] if i >= bpp else 0
+            b = prev[i]
+            c = prev[i - bpp] if i >= bpp else 0
+            if kind == 1:
+                row[i] = (row[i] + a) & 255
+            elif kind == 2:
+                row[i] = (row[i] + b) & 255
+            elif kind == 3:
+                row[i] = (row[i] + ((a + b) >> 1)) & 255
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                row[i] = (row[i] + (a if pa <= pb and pa <= pc else b if pb <= pc else c)) & 255
+        rows.append(row)
+        prev = row
+
+    # Samples to RGBA, 16-bit samples keep their high byte
+    pixels = []
+    for row in rows:
+        if depth < 8:
+            samples = [(row[(x * depth) >> 3] >> (8 - depth - (x * depth & 7))) & ((1 << depth) - 1)
+                       for x in range(width)]
+        else:
+            step = depth // 8
+            samples = row[::step]
+        for x in range(width):
+            if ctype == 3:
+                i = samples[x]
+                r, g, b = palette[i] if i < len(palette) else (0, 0, 0)
+                a = trns[i] if trns is not None and i < len(trns) else 255
+            elif ctype == 0:
+                v = samples[x]
+                key = trns is not None and v == struct.unpack(">H", trns[:2])[0] >> (8 if depth == 16 else 0)
+                v = v * 255 // ((1 << depth) - 1) if depth < 8 else v
+                r = g = b = v
+                a = 0 if key else 255
+            elif ctype == 4:
+                r = g = b = samples[x * 2]
+                a = samples[x * 2 + 1]
+            else:
+                r, g, b = samples[x * channels:x * channels + 3]
+                a = samples[x * channels + 3] if ctype == 6 else 255
+                if ctype == 2 and trns is not None:
+                    key = struct.unpack(">HHH", trns[:6])
+                    if depth == 16:
+                        key = tuple(k >> 8 for k in key)
+                    if (r, g, b) == key:
+                        a = 0
+            pixels.append((r, g, b, a))
+    return width, height, pixels
+
+
+def to565(pixel, bg):
+    r, g, b, a = pixel
+    if a < 255:
+        r = (r * a + bg[0] * (255 - a) + 127) // 255
+        g = (g * a + bg[1] * (255 - a) + 127) // 255
+        b = (b * a + bg[2] * (255 - a) + 127) // 255
+    return (r & 0xF8) << 8 | (g & 0xFC) << 3 | b >> 3
+
+
+def q565_hash(c):
+    return (c * 0x9E37 & 0xFFFF) >> 10
+
+
+def wrap(v, bits):
+    half = 1 << (bits - 1)
+    return ((v + half) & ((1 << bits) - 1)) - half
+
+
+def encode(width, height, colors):
+    out = bytearray(b"Q565" + struct.pack("<HH", width, height))
+    table = [0] * 64
+    prev = 0
+    run = 0
+
+    def flush(run):
+        while run > 0:
+            n = min(run, 0xFFFF)
+            if n <= 62:
+                out.append(0xC0 | (n - 1))
+            else:
+                out.append(0xFF)
+                out.extend(struct.pack("<H", n))
+            run -= n
+
+    for c in colors:
+        if c == prev:
+            run += 1
+            continue
+        flush(run)
+        run = 0
+
+        h = q565_hash(c)
+        if table[h] == c:
+            out.append(h)
+        else:
+            table[h] = c
+            dr = wrap((c >> 11) - (prev >> 11), 5)
+            dg = wrap(((c >> 5) & 63) - ((prev >> 5) & 63), 6)
+            db = wrap((c & 31) - (prev & 31), 5)
+            drg = wrap(dr - (dg >> 1), 5)
+            dbg = wrap(db - (dg >> 1), 5)
+            if -2 <= dr <= 1 and -2 <= dg <= 1 and -2 <= db <= 1:
+                out.append(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2))
+            elif -8 <= drg <= 7 and -8 <= dbg <= 7:
+                out.append(0x80 | (dg + 32))
+                out.append((drg + 8) << 4 | (dbg + 8))
+            else:
+                out.append(0xFE)
+                out.extend(struct.pack("<H", c))
+        prev = c
+    flush(run)
+    return bytes(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("image", help="PNG file")
+    ap.add_argument("name", help="C identifier of the generated array")
+    ap.add_argument("--bg", default="0x000000", help="RGB888 colour that alpha is blended with")
+    ap.add_argument("--bin", help="also write the encoded image to this file")
+    args = ap.parse_args()
+
+    bg = int(args.bg, 0)
+    bg = (bg >> 16 & 255, bg >> 8 & 255, bg & 255)
+    width, height, pixels = read_png(args.image)
+    if width > 0xFFFF or height > 0xFFFF:
+        raise SystemExit("image too large")
+    data = encode(width, height, [to565(p, bg) for p in pixels])
+
+    out = sys.stdout
+    out.write("// Generated by Tools/q565_pack.py from %s, %dx%d\n\n" % (args.image.split("/")[-1], width, height))
+    out.write("const uint8_t %s[] PROGMEM = {\n" % args.name)
+    for i in range(0, len(data), 12):
+        out.write("  " + ", ".join("0x%02X" % b for b in data[i:i + 12]) + ",\n")
+    out.write("};\n\n")
+    out.write("// %d bytes, %d as a raw RGB565 array\n" % (len(data), width * height * 2))
+
+    if args.bin:
+        with open(args.bin, "wb") as f:
+            f.write(data)
+    sys.stderr.write("%s: %d bytes, %.1fx smaller than raw RGB565\n" % (
+        args.name, len(data), width * height * 2.0 / len(data)))
+
+
+if __name__ == "__main__":
+    main()
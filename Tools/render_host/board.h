@@ -0,0 +1,31 @@
+#pragma once
+
+// Host stand-in for the board.h of a target build, enough for tft_server.c. The drawing
+// functions it calls are declared here and recorded by ring_test.c instead of drawn
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define LOAD_RENDER_SERVER
+#define RENDER_PTHREAD
+#define RENDER_QUEUE_LEN 8 // Small, so producers keep meeting a full ring
+#define RENDER_QUEUES 3
+
+#include "tft_server.h"
+
+void fillScreen(uint32_t color);
+void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+void drawLine(int32_t xs, int32_t ys, int32_t xe, int32_t ye, uint32_t color);
+void drawPixel(int32_t x, int32_t y, uint32_t color);
+void drawCircle(int32_t x, int32_t y, int32_t r, uint32_t color);
+void fillCircle(int32_t x, int32_t y, int32_t r, uint32_t color);
+void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data);
+void dmaWait(void);
+void setTextColorAll(uint16_t fgcolor, uint16_t bgcolor, bool bgfill);
+void setTextDatum(uint8_t datum);
+void setTextSize(uint8_t size);
+int16_t drawString(const char *string, int32_t x, int32_t y, uint8_t font);
@@ -0,0 +1,209 @@
+/***************************************************
+  Host test of the render server queues.
+
+  The drawing calls made by the server are only
+  checked, no display is needed. Each producer
+  thread queues numbered commands, the server thread
+  must run every one of them once and in order per
+  queue. Build and run with make, or make tsan.
+ ****************************************************/
+
+#include "board.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#define COMMANDS 100000 // Per producer
+
+static struct {
+    int32_t next[RENDER_QUEUES]; // Command number expected from each producer
+    int32_t step; // Between the numbers of one producer's commands
+    uint32_t runs, errors;
+    uint32_t textColor;
+} seen;
+
+static int fenced;
+
+// Producer k sends command i as x = k, y = i, with the op picked by i
+static void check(uint8_t op, int32_t k, int32_t i, uint32_t color)
+{
+    seen.runs++;
+    if (k < 0 || k >= RENDER_QUEUES || i != seen.next[k] || op != i % 4 || color != (uint32_t)(k << 16 | (i & 0xFFFF))) {
+        if (seen.errors++ < 10)
+            printf("bad command: queue %ld, number %ld, expected %ld\n", (long)k, (long)i,
+                   (long)(k >= 0 && k < RENDER_QUEUES ? seen.next[k] : -1));
+        return;
+    }
+    seen.next[k] += seen.step;
+}
+
+void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
+{
+    check(w == 1 && h == 2 ? 0 : 0xFF, x, y, color);
+}
+
+void drawLine(int32_t xs, int32_t ys, int32_t xe, int32_t ye, uint32_t color)
+{
+    check(xe == -xs && ye == -ys ? 1 : 0xFF, xs, ys, color);
+}
+
+void drawCircle(int32_t x, int32_t y, int32_t r, uint32_t color)
+{
+    check(r == 3 ? 2 : 0xFF, x, y, color);
+}
+
+void setTextColorAll(uint16_t fgcolor, uint16_t bgcolor, bool bgfill)
+{
+    seen.textColor = bgcolor << 16 | fgcolor;
+    (void)bgfill;
+}
+
+// Text of command i from producer k, 64 bytes
+static void label(char *buf, int32_t k, int32_t i)
+{
+    snprintf(buf, 64, "%d %d abcdefghijklmnopqrstuvwxyz", (int)k, (int)i);
+}
+
+int16_t drawString(const char *string, int32_t x, int32_t y, uint8_t font)
+{
+    char expect[64];
+
+    // Longer than RENDER_TEXT_MAX, it must arrive cut to fit
+    label(expect, x, y);
+    expect[RENDER_TEXT_MAX - 1] = 0;
+    check(!strcmp(string, expect) && font == 2 ? 3 : 0xFF, x, y, seen.textColor);
+    return 0;
+}
+
+void fillScreen(uint32_t color) { check(0xFF, -1, 0, color); }
+void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color) { (void)w; (void)h; check(0xFF, x, y, color); }
+void drawPixel(int32_t x, int32_t y, uint32_t color) { check(0xFF, x, y, color); }
+void fillCircle(int32_t x, int32_t y, int32_t r, uint32_t color) { (void)r; check(0xFF, x, y, color); }
+void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data) { (void)w; (void)h; (void)data; check(0xFF, x, y, 0); }
+void dmaWait(void) {}
+void setTextDatum(uint8_t datum) { (void)datum; }
+void setTextSize(uint8_t size) { (void)size; }
+
+static void fence(void *ctx)
+{
+    (void)ctx;
+    __atomic_add_fetch(&fenced, 1, __ATOMIC_RELEASE);
+}
+
+static renderQueue queue[RENDER_QUEUES];
+
+static void *producer(void *arg)
+{
+    int32_t k = (int32_t)(intptr_t)arg;
+    renderQueue *q = &queue[k];
+    char text[64];
+
+    for (int32_t i = 0; i < COMMANDS; i++) {
+        uint32_t color = k << 16 | (i & 0xFFFF);
+
+        switch (i % 4) {
+        case 0:
+            renderFillRect(q, k, i, 1, 2, color);
+            break;
+        case 1:
+            renderLine(q, k, i, -k, -i, color);
+            break;
+        case 2:
+            renderCircle(q, k, i, 3, color, false);
+            break;
+        case 3:
+            label(text, k, i);
+            renderText(q, text, k, i, 2, 0, 1, color & 0xFFFF, color >> 16, true);
+            break;
+        }
+    }
+    renderCall(q, fence, NULL);
+    return NULL;
+}
+
+static void *server(void *arg)
+{
+    (void)arg;
+    renderServe();
+    return NULL;
+}
+
+// Port that only counts, for the single threaded checks
+static uint32_t wakes;
+static void countWake(void *ctx) { (void)ctx; wakes++; }
+static void noWait(void *ctx) { (void)ctx; }
+
+static void fillCommand(renderCmd *c, int32_t i)
+{
+    *c = (renderCmd){ .op = RENDER_FILL_RECT, .x = 0, .y = i, .w = 1, .h = 2, .color = i & 0xFFFF };
+}
+
+static bool fullRing(void)
+{
+    renderPort port = { noWait, countWake, noWait, NULL };
+    renderCmd c;
+    uint32_t pushed = 0;
+
+    renderBegin(&port);
+    renderAttach(&queue[0]);
+
+    memset(&seen, 0, sizeof(seen));
+    seen.step = 4; // Fill commands only
+    while (pushed < 2 * RENDER_QUEUE_LEN) {
+        fillCommand(&c, pushed * 4);
+        if (!renderPush(&queue[0], &c))
+            break;
+        pushed++;
+    }
+    if (pushed != RENDER_QUEUE_LEN || wakes != pushed) {
+        printf("full ring: %lu pushed, %lu wakes, expected %u\n", (unsigned long)pushed, (unsigned long)wakes,
+               RENDER_QUEUE_LEN);
+        return false;
+    }
+
+    // A slot is free again only once its command has run
+    uint32_t run = renderRun();
+    fillCommand(&c, pushed * 4);
+    if (run != RENDER_QUEUE_LEN || seen.runs != run || seen.errors || !renderPush(&queue[0], &c)) {
+        printf("full ring: %lu run, %lu errors\n", (unsigned long)run, (unsigned long)seen.errors);
+        return false;
+    }
+
+    return renderRun() == 1 && !seen.errors;
+}
+
+int main(void)
+{
+    pthread_t serve, produce[RENDER_QUEUES];
+    renderPort port;
+
+    if (!fullRing())
+        return 1;
+
+    renderPthreadPort(&port);
+    renderBegin(&port);
+    for (int k = 0; k < RENDER_QUEUES; k++)
+        renderAttach(&queue[k]);
+
+    memset(&seen, 0, sizeof(seen));
+    seen.step = 1;
+    pthread_create(&serve, NULL, server, NULL);
+    for (int k = 0; k < RENDER_QUEUES; k++)
+        pthread_create(&produce[k], NULL, producer, (void *)(intptr_t)k);
+    for (int k = 0; k < RENDER_QUEUES; k++)
+        pthread_join(produce[k], NULL);
+
+    while (__atomic_load_n(&fenced, __ATOMIC_ACQUIRE) < RENDER_QUEUES)
+        sched_yield();
+    renderStop();
+    pthread_join(serve, NULL);
+
+    for (int k = 0; k < RENDER_QUEUES; k++)
+        if (seen.next[k] != COMMANDS)
+            seen.errors++;
+
+    printf("%lu commands from %d queues, %lu errors\n", (unsigned long)seen.runs, RENDER_QUEUES,
+           (unsigned long)seen.errors);
+    return seen.errors ? 1 : 0;
+}
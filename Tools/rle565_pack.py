@@ -0,0 +1,92 @@
+#!/usr/bin/env python3
+"""
+Convert a PNG with transparency into the opaque span format drawn by
+pushImageRLE().
+
+Usage:
+  rle565_pack.py icon.png Name > Name.h
+  rle565_pack.py icon.png Name --bg 0x202020 --threshold 64 > Name.h
+  rle565_pack.py sprite.png Name --key 0xFF00FF > Name.h
+
+Pixels with alpha below --threshold (default 128) are transparent, the
+rest are blended with --bg (RGB888, default black) and converted to
+RGB565 as color565() does. Images without alpha can use --key to make
+one RGB888 colour transparent.
+
+The generated array is drawn with:
+  #include "Name.h"
+  pushImageRLE(x, y, Name);
+
+Layout, 16-bit words: width, height, then for each row the span count
+followed by skip, length and length RGB565 pixels for each span. skip is
+the number of transparent pixels since the previous span (or the row
+start), trailing transparent pixels are not stored.
+"""
+
+import argparse
+import os
+import sys
+
+from q565_pack import read_png, to565
+
+
+def encode(width, height, pixels, threshold, bg, key):
+    words = [width, height]
+    spans = 0
+    for y in range(height):
+        row = pixels[y * width:(y + 1) * width]
+        opaque = [p[3] >= threshold and (key is None or p[:3] != key) for p in row]
+        runs = []
+        x = 0
+        while x < width:
+            if not opaque[x]:
+                x += 1
+                continue
+            start = x
+            while x < width and opaque[x]:
+                x += 1
+            runs.append((start, x))
+        words.append(len(runs))
+        end = 0
+        for start, stop in runs:
+            words.append(start - end)
+            words.append(stop - start)
+            # Kept pixels are treated as fully opaque over bg
+            words.extend(to565(row[i], bg) for i in range(start, stop))
+            end = stop
+        spans += len(runs)
+    return words, spans
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument("image", help="PNG file")
+    ap.add_argument("name", help="C identifier of the generated array")
+    ap.add_argument("--bg", default="0x000000", help="RGB888 colour that partly transparent pixels are blended with")
+    ap.add_argument("--threshold", type=int, default=128, help="lowest alpha drawn, 1 to 255")
+    ap.add_argument("--key", help="RGB888 colour that is transparent")
+    args = ap.parse_args()
+
+    bg = int(args.bg, 0)
+    bg = (bg >> 16 & 255, bg >> 8 & 255, bg & 255)
+    key = None
+    if args.key:
+        key = int(args.key, 0)
+        key = (key >> 16 & 255, key >> 8 & 255, key & 255)
+    width, height, pixels = read_png(args.image)
+    if width > 0xFFFF or height > 0xFFFF:
+        raise SystemExit("image too large")
+    words, spans = encode(width, height, pixels, max(1, args.threshold), bg, key)
+
+    out = sys.stdout
+    out.write("// Generated by Tools/rle565_pack.py from %s, %dx%d, %d spans\n\n" % (
+        os.path.basename(args.image), width, height, spans))
+    out.write("const uint16_t %s[] PROGMEM = {\n" % args.name)
+    for i in range(0, len(words), 12):
+        out.write("  " + ", ".join("0x%04X" % w for w in words[i:i + 12]) + ",\n")
+    out.write("};\n\n")
+    out.write("// %d bytes, %d as a raw RGB565 array\n" % (len(words) * 2, width * height * 2))
+
+
+if __name__ == "__main__":
+    main()
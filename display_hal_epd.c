@@ -0,0 +1,437 @@
+#include <string.h>
+#include "board.h"
+
+#ifdef EPD_DRIVER
+
+// The drawing code talks MIPI DCS as to any other panel, the window, memory write and read
+// commands are decoded here against a framebuffer in the panel's native orientation
+
+#define EPD_PIXELS_PER_BYTE (8 / EPD_BPP)
+#define EPD_STRIDE ((TFT_WIDTH + EPD_PIXELS_PER_BYTE - 1) / EPD_PIXELS_PER_BYTE)
+
+typedef struct {
+    int16_t x0, y0, x1, y1; // Inclusive
+} epdArea;
+
+static uint8_t frame[EPD_STRIDE * TFT_HEIGHT];
+
+static struct {
+    const epdPanel *panel;
+
+    uint8_t cmd; // Last command
+    uint8_t args; // Parameter bytes since
+    uint32_t param; // Parameter bytes so far
+    uint16_t color; // First byte of a pixel sent a byte at a time
+
+    uint8_t rotation;
+    bool invert;
+    int32_t xs, xe, ys, ye; // Window, rotated coordinates
+    int32_t x, y; // Next pixel
+
+    epdArea changed; // Pixels changed by the current memory write
+    bool changing;
+
+    epdArea area[EPD_REGIONS]; // Changed since the last flush
+    uint8_t areas;
+    bool full; // Next flush is a full refresh
+    uint16_t partials; // Since the last full refresh
+} epd;
+
+bool displayCommand;
+
+// Grey level 0 (black) to 3 (white) from the green weighted luma of a 565 colour
+static inline uint8_t epdLevel(uint16_t color)
+{
+    uint32_t r = (color >> 11) << 3, g = ((color >> 5) & 0x3F) << 2, b = (color & 0x1F) << 3;
+    uint32_t l = (r * 77 + g * 150 + b * 29) >> 8;
+
+#if EPD_BPP == 1
+    return (l >= 0x80) ? 3 : 0;
+#else
+    return (l * 3 + 127) / 255;
+#endif
+}
+
+static inline uint16_t epdColor(uint8_t level)
+{
+    static const uint16_t grey[4] = { 0x0000, 0x52AA, 0xAD55, 0xFFFF };
+
+    return grey[level];
+}
+
+// Rotated coordinates to the framebuffer, false when off the panel
+static inline bool epdMap(int32_t x, int32_t y, int32_t *px, int32_t *py)
+{
+    switch (epd.rotation) {
+    case 1:
+        *px = TFT_WIDTH - 1 - y;
+        *py = x;
+        break;
+    case 2:
+        *px = TFT_WIDTH - 1 - x;
+        *py = TFT_HEIGHT - 1 - y;
+        break;
+    case 3:
+        *px = y;
+        *py = TFT_HEIGHT - 1 - x;
+        break;
+    default:
+        *px = x;
+        *py = y;
+        break;
+    }
+
+    return (uint32_t)*px < TFT_WIDTH && (uint32_t)*py < TFT_HEIGHT;
+}
+
+static void epdAdd(epdArea a)
+{
+    uint8_t i = 0;
+
+    // Take in every area this one touches, which may then touch others
+    while (i < epd.areas) {
+        epdArea *b = &epd.area[i];
+
+        if (a.x0 <= b->x1 + 1 && b->x0 <= a.x1 + 1 && a.y0 <= b->y1 + 1 && b->y0 <= a.y1 + 1) {
+            if (b->x0 < a.x0) a.x0 = b->x0;
+            if (b->y0 < a.y0) a.y0 = b->y0;
+            if (b->x1 > a.x1) a.x1 = b->x1;
+            if (b->y1 > a.y1) a.y1 = b->y1;
+            *b = epd.area[--epd.areas];
+            i = 0;
+        }
+        else
+            i++;
+    }
+
+    if (epd.areas == EPD_REGIONS) {
+        // No room, merge with the area that adds the least to the total
+        uint32_t best = UINT32_MAX;
+        uint8_t n = 0;
+
+        for (i = 0; i < epd.areas; i++) {
+            epdArea *b = &epd.area[i];
+            int32_t w = ((a.x1 > b->x1) ? a.x1 : b->x1) - ((a.x0 < b->x0) ? a.x0 : b->x0) + 1;
+            int32_t h = ((a.y1 > b->y1) ? a.y1 : b->y1) - ((a.y0 < b->y0) ? a.y0 : b->y0) + 1;
+            uint32_t cost = w * h - (b->x1 - b->x0 + 1) * (b->y1 - b->y0 + 1);
+
+            if (cost < best) {
+                best = cost;
+                n = i;
+            }
+        }
+
+        epdArea b = epd.area[n];
+        epd.area[n] = epd.area[--epd.areas];
+        a.x0 = (a.x0 < b.x0) ? a.x0 : b.x0;
+        a.y0 = (a.y0 < b.y0) ? a.y0 : b.y0;
+        a.x1 = (a.x1 > b.x1) ? a.x1 : b.x1;
+        a.y1 = (a.y1 > b.y1) ? a.y1 : b.y1;
+        epdAdd(a);
+        return;
+    }
+
+    epd.area[epd.areas++] = a;
+}
+
+// End of a memory write, what it changed joins the areas to refresh
+static void epdCommit(void)
+{
+    if (epd.changing) {
+        epd.changing = false;
+        epdAdd(epd.changed);
+    }
+}
+
+static void epdPixel(uint16_t color)
+{
+    int32_t px, py;
+
+    if (epd.y > epd.ye)
+        return;
+
+    if (epdMap(epd.x, epd.y, &px, &py)) {
+        uint8_t *p = &frame[py * EPD_STRIDE + px / EPD_PIXELS_PER_BYTE];
+        uint8_t shift = (EPD_PIXELS_PER_BYTE - 1 - px % EPD_PIXELS_PER_BYTE) * EPD_BPP;
+        uint8_t mask = ((1 << EPD_BPP) - 1) << shift;
+        uint8_t bits = (epdLevel(color) << shift) & mask;
+
+        if (epd.invert)
+            bits ^= mask;
+
+        // Only pixels that change need refreshing, redrawing the same text costs nothing
+        if ((*p & mask) != bits) {
+            *p = (*p & ~mask) | bits;
+
+            if (!epd.changing) {
+                epd.changing = true;
+                epd.changed.x0 = epd.changed.x1 = px;
+                epd.changed.y0 = epd.changed.y1 = py;
+            }
+            else {
+                if (px < epd.changed.x0) epd.changed.x0 = px;
+                if (px > epd.changed.x1) epd.changed.x1 = px;
+                if (py < epd.changed.y0) epd.changed.y0 = py;
+                if (py > epd.changed.y1) epd.changed.y1 = py;
+            }
+        }
+    }
+
+    if (++epd.x > epd.xe) {
+        epd.x = epd.xs;
+        epd.y++;
+    }
+}
+
+static void epdAll(void)
+{
+    epd.areas = 0;
+    epd.changing = false;
+    epdAdd((epdArea){ 0, 0, TFT_WIDTH - 1, TFT_HEIGHT - 1 });
+}
+
+void displayHardwareInit(void)
+{
+    memset(frame, 0xFF, sizeof(frame));
+    epd.rotation = 0;
+    epd.invert = false;
+    epd.areas = 0;
+    epd.changing = false;
+    epd.full = true;
+}
+
+// No bus clock
+void displaySpeed(uint16_t prescaler)
+{
+}
+
+uint16_t displayPrescaler(uint32_t freq)
+{
+    return 0;
+}
+
+uint32_t displayFrequency(uint16_t prescaler)
+{
+    return 0;
+}
+
+uint8_t displayTransfer8(uint8_t dat)
+{
+    if (displayCommand) {
+        epdCommit();
+        epd.cmd = dat;
+        epd.args = 0;
+        epd.param = 0;
+
+        switch (dat) {
+        case TFT_SWRST:
+            displayHardwareInit();
+            break;
+        case TFT_INVON:
+        case TFT_INVOFF:
+            if (epd.invert != (dat == TFT_INVON)) {
+                epd.invert = !epd.invert;
+                for (uint32_t i = 0; i < sizeof(frame); i++)
+                    frame[i] = ~frame[i];
+                epdAll();
+            }
+            break;
+        case TFT_RAMWR:
+        case TFT_RAMRD:
+            epd.x = epd.xs;
+            epd.y = epd.ys;
+            break;
+        }
+
+        return 0;
+    }
+
+    switch (epd.cmd) {
+    case TFT_CASET:
+    case TFT_PASET:
+        epd.param = epd.param << 8 | dat;
+        if (++epd.args == 4) {
+            if (epd.cmd == TFT_CASET) {
+                epd.xs = epd.param >> 16;
+                epd.xe = epd.param & 0xFFFF;
+            }
+            else {
+                epd.ys = epd.param >> 16;
+                epd.ye = epd.param & 0xFFFF;
+            }
+        }
+        break;
+    case TFT_MADCTL:
+        epd.rotation = dat & 3;
+        break;
+    case TFT_RAMWR:
+        if (epd.args++ & 1)
+            epdPixel(epd.color | dat);
+        else
+            epd.color = dat << 8;
+        break;
+    }
+
+    // Reads of anything but pixels (the dummy byte, IDs) are 0
+    return 0;
+}
+
+void displayWrite16(uint16_t color)
+{
+    if (!displayCommand && epd.cmd == TFT_RAMWR) {
+        epdPixel(color);
+        return;
+    }
+
+    displayTransfer8(color >> 8);
+    displayTransfer8(color);
+}
+
+uint16_t displayRead16(void)
+{
+    int32_t px, py;
+    uint16_t color = 0;
+
+    if (epd.cmd != TFT_RAMRD || epd.y > epd.ye)
+        return 0;
+
+    if (epdMap(epd.x, epd.y, &px, &py)) {
+        uint8_t shift = (EPD_PIXELS_PER_BYTE - 1 - px % EPD_PIXELS_PER_BYTE) * EPD_BPP;
+        uint8_t level = (frame[py * EPD_STRIDE + px / EPD_PIXELS_PER_BYTE] >> shift) & ((1 << EPD_BPP) - 1);
+
+        if (epd.invert)
+            level ^= (1 << EPD_BPP) - 1;
+#if EPD_BPP == 1
+        level *= 3;
+#endif
+        color = epdColor(level);
+    }
+
+    if (++epd.x > epd.xe) {
+        epd.x = epd.xs;
+        epd.y++;
+    }
+
+    return color;
+}
+
+void displayTransfer16(const uint16_t *buffer, int len, bool incr, bool nowait)
+{
+    if (epd.cmd != TFT_RAMWR)
+        return;
+
+    while (len-- > 0) {
+        epdPixel(*buffer);
+        if (incr)
+            buffer++;
+    }
+}
+
+// Nothing runs in the background
+void displayTransfer16End(void)
+{
+}
+
+void displayTransfer16Slow(uint16_t *buffer, int len, bool incr)
+{
+    displayTransfer16(buffer, len, incr, false);
+}
+
+void displayTransfer8Buf(const uint8_t *buffer, int len, bool nowait)
+{
+    while (len-- > 0)
+        displayTransfer8(*buffer++);
+}
+
+/***************************************************************************************
+** Function name:           epdBegin
+** Description:             Set the panel, the first flush is a full refresh
+***************************************************************************************/
+void epdBegin(const epdPanel *panel)
+{
+    epd.panel = panel;
+    epd.full = true;
+}
+
+/***************************************************************************************
+** Function name:           epdRefreshFull
+** Description:             Make the next flush a full refresh, e.g. after a screen change
+***************************************************************************************/
+void epdRefreshFull(void)
+{
+    epd.full = true;
+}
+
+/***************************************************************************************
+** Function name:           epdBusy
+** Description:             True while the panel is refreshing
+***************************************************************************************/
+bool epdBusy(void)
+{
+    return epd.panel && epd.panel->busy(epd.panel->ctx);
+}
+
+/***************************************************************************************
+** Function name:           epdFlush
+** Description:             Show everything drawn since the last flush with one refresh
+***************************************************************************************/
+// Changed areas are loaded one by one and refreshed together, a partial refresh of the
+// area covering them all, so many small updates cost a single slow refresh cycle. Every
+// EPD_FULL_EVERY partial refreshes, or when the area is most of the screen, the whole
+// screen gets a full refresh instead. Returns false, keeping the changes for the next
+// call, while the panel is still busy
+bool epdFlush(void)
+{
+    const epdPanel *panel = epd.panel;
+
+    if (!panel || panel->busy(panel->ctx))
+        return false;
+
+    epdCommit();
+
+    if (!epd.areas && !epd.full)
+        return true;
+
+    // Loads are whole bytes wide
+    epdArea all = { TFT_WIDTH, TFT_HEIGHT, -1, -1 };
+    for (uint8_t i = 0; i < epd.areas; i++) {
+        epdArea *a = &epd.area[i];
+
+        a->x0 -= a->x0 % EPD_PIXELS_PER_BYTE;
+        a->x1 += EPD_PIXELS_PER_BYTE - 1 - a->x1 % EPD_PIXELS_PER_BYTE;
+        if (a->x1 >= TFT_WIDTH)
+            a->x1 = TFT_WIDTH - 1;
+
+        if (a->x0 < all.x0) all.x0 = a->x0;
+        if (a->y0 < all.y0) all.y0 = a->y0;
+        if (a->x1 > all.x1) all.x1 = a->x1;
+        if (a->y1 > all.y1) all.y1 = a->y1;
+    }
+
+    if (epd.partials >= EPD_FULL_EVERY ||
+        (uint32_t)(all.x1 - all.x0 + 1) * (all.y1 - all.y0 + 1) * 100 > (uint32_t)TFT_WIDTH * TFT_HEIGHT * EPD_FULL_PERCENT)
+        epd.full = true;
+
+    if (epd.full) {
+        panel->load(panel->ctx, 0, 0, TFT_WIDTH, TFT_HEIGHT, frame, EPD_STRIDE);
+        panel->refresh(panel->ctx, true, 0, 0, TFT_WIDTH, TFT_HEIGHT);
+        epd.full = false;
+        epd.partials = 0;
+    }
+    else {
+        for (uint8_t i = 0; i < epd.areas; i++) {
+            epdArea *a = &epd.area[i];
+
+            panel->load(panel->ctx, a->x0, a->y0, a->x1 - a->x0 + 1, a->y1 - a->y0 + 1,
+                        &frame[a->y0 * EPD_STRIDE + a->x0 / EPD_PIXELS_PER_BYTE], EPD_STRIDE);
+        }
+        panel->refresh(panel->ctx, false, all.x0, all.y0, all.x1 - all.x0 + 1, all.y1 - all.y0 + 1);
+        epd.partials++;
+    }
+
+    epd.areas = 0;
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,74 @@
+#pragma once
+
+// ePaper panels, include this instead of display_hal_f4.h and build display_hal_epd.c, with
+// EPD_DRIVER in the setup file. Drawing goes into a 1 or 2 bits per pixel framebuffer here,
+// the areas that changed are collected and epdFlush() sends them to the panel through an
+// epdPanel, which holds the controller specific part (SSD1680, UC8151, ...)
+
+#define SPI_HAS_TRANSACTION 1
+#define SUPPORT_TRANSACTIONS
+
+#ifndef EPD_REGIONS
+#define EPD_REGIONS 8 // Changed areas kept apart, beyond this the two closest are merged
+#endif
+
+#ifndef EPD_FULL_EVERY
+#define EPD_FULL_EVERY 20 // Partial refreshes between full ones, which clear the ghosting
+#endif
+
+#ifndef EPD_FULL_PERCENT
+#define EPD_FULL_PERCENT 50 // A flush covering more of the screen than this is a full refresh
+#endif
+
+// The panel, all coordinates are in its native orientation
+typedef struct {
+    // Write the area x, y, w, h of the framebuffer to the panel RAM, x and w are whole bytes
+    // and the rows start stride bytes apart at data (MSB first, 1 is white)
+    void (*load)(void *ctx, int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t *data, int32_t stride);
+    // Start showing the panel RAM, the area x, y, w, h only unless full
+    void (*refresh)(void *ctx, bool full, int32_t x, int32_t y, int32_t w, int32_t h);
+    // True while a refresh is running
+    bool (*busy)(void *ctx);
+    void *ctx;
+} epdPanel;
+
+// Set by DC_C and DC_D, commands are decoded by displayTransfer8()
+extern bool displayCommand;
+
+// No bus, the panel has its own
+#define CS_L
+#define CS_H
+
+#define RES_L
+#define RES_H
+
+#define DC_C displayCommand = true
+#define DC_D displayCommand = false
+
+#define SPI_MODE0 0
+
+#define tft_Write_8(C) displayTransfer8(C)
+#define tft_Write_16(C) displayWrite16(C)
+#define tft_Write_32D(C) displayTransfer8((C) >> 8); displayTransfer8(C); displayTransfer8((C) >> 8); displayTransfer8(C)
+#define tft_Write_32C(C,D) displayTransfer8((C) >> 8); displayTransfer8(C); displayTransfer8((D) >> 8); displayTransfer8(D)
+#define tft_Read_8() displayTransfer8(0)
+#define tft_Read_16() displayRead16()
+
+#define DISPLAY_DMA_BENEFIT_LENGTH  (16)
+
+void displayHardwareInit(void);
+void displaySpeed(uint16_t prescaler);
+uint16_t displayPrescaler(uint32_t freq); // displaySpeed() value for the fastest clock up to freq
+uint32_t displayFrequency(uint16_t prescaler); // Clock a displaySpeed() value gives
+uint8_t displayTransfer8(uint8_t dat);
+void displayTransfer16(const uint16_t *buffer, int len, bool incr, bool nowait);
+void displayTransfer16End(void);
+void displayTransfer16Slow(uint16_t *buffer, int len, bool incr);
+void displayTransfer8Buf(const uint8_t *buffer, int len, bool nowait);
+void displayWrite16(uint16_t color);
+uint16_t displayRead16(void);
+
+void epdBegin(const epdPanel *panel); // Set the panel that epdFlush() sends to
+bool epdFlush(void); // Refresh what changed, false (changes kept) while the panel is busy
+void epdRefreshFull(void); // Make the next flush a full refresh
+bool epdBusy(void); // The panel is still refreshing
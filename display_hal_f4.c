@@ -1,49 +1,44 @@
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include "stm32f4xx.h"
 #include "display_hal_f4.h"
+#include "tft_stats.h"
 
 #if defined(STM32F401xx) || defined(STM32F40_41xxx) /* TODO add additional F4-based platforms */
 
 #define SPI_SPEED SPI_BaudRatePrescaler_2
 #define SPIx_TX_DMA_STREAM      DMA1_Stream4
-#define SPIx_RXTX_DMA_CHANNEL   DMA_Channel_0
 #define SPIx_TX_DMA_FLAG_TCIF   DMA_FLAG_TCIF4
 
+#define FONT_FLASH_READ 0x03 // Serial NOR "Read Data" command, 24-bit address
+
+static uint32_t spiClock; // SPI2 input clock, PCLK1
+
+spiDevice displayDevice = { CS_PORT, CS_PIN_MASK, SPI_SPEED, 3, DISPLAY_BUS_PRIORITY, displayTransfer16End };
+#ifdef FONT_CS_PORT
+static spiDevice fontDevice = { FONT_CS_PORT, FONT_CS_PIN_MASK, SPI_SPEED, 3, FONT_BUS_PRIORITY, NULL };
+#endif
+
 void displayHardwareInit(void)
 {
     GPIO_InitTypeDef gpio;
-    SPI_InitTypeDef spi;
-    DMA_InitTypeDef dma;
+    RCC_ClocksTypeDef clocks;
+
+    RCC_GetClocksFreq(&clocks);
+    spiClock = clocks.PCLK1_Frequency;
 
-    RCC_APB1PeriphClockCmd(RCC_APB1Periph_SPI2, ENABLE);
     RCC_AHB1PeriphClockCmd(RCC_POWER_GPIO, ENABLE);
-    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA1, ENABLE);
 
-    GPIO_PinAFConfig(GPIOB, GPIO_PinSource13, GPIO_AF_SPI2);
-    GPIO_PinAFConfig(GPIOB, GPIO_PinSource14, GPIO_AF_SPI2);
-    GPIO_PinAFConfig(GPIOB, GPIO_PinSource15, GPIO_AF_SPI2);
+    busInit();
 
-    GPIO_StructInit(&gpio);
-    gpio.GPIO_Mode = GPIO_Mode_AF;
-    gpio.GPIO_Speed = GPIO_Speed_100MHz;
-    // SPI pins configuration
-    gpio.GPIO_Pin = GPIO_Pin_13 | GPIO_Pin_14 | GPIO_Pin_15;;
-    GPIO_Init(GPIOB, &gpio);
-
-    // FONT_CS + LCD_RES + LCD_DC
-#ifdef FONT_CS_PORT
-    FONT_CS_H;
-#endif
+    // LCD_RES + LCD_DC
     DC_D;
     RES_H;
 
+    GPIO_StructInit(&gpio);
     gpio.GPIO_Mode = GPIO_Mode_OUT;
-
-#ifdef FONT_CS_PORT
-    gpio.GPIO_Pin = FONT_CS_PIN_MASK;
-    GPIO_Init(FONT_CS_PORT, &gpio);
-#endif
+    gpio.GPIO_Speed = GPIO_Speed_100MHz;
 
     // LCD_DC
     gpio.GPIO_Pin = DC_PIN_MASK;
@@ -53,52 +48,18 @@ void displayHardwareInit(void)
     gpio.GPIO_Pin = RES_PIN_MASK;
     GPIO_Init(RES_PORT, &gpio);
 
-    // LCD_CS
-    gpio.GPIO_Pin = CS_PIN_MASK;
-    GPIO_Init(CS_PORT, &gpio);
-
-    SPI_StructInit(&spi);
-    SPI_I2S_DeInit(SPI2);
-    spi.SPI_Direction = SPI_Direction_2Lines_FullDuplex;
-    spi.SPI_DataSize = SPI_DataSize_8b;
-    spi.SPI_CPOL = SPI_CPOL_High;
-    spi.SPI_CPHA = SPI_CPHA_2Edge;
-    spi.SPI_NSS = SPI_NSS_Soft;
-    spi.SPI_BaudRatePrescaler = SPI_SPEED;
-    spi.SPI_FirstBit = SPI_FirstBit_MSB;
-    spi.SPI_CRCPolynomial = 7;
-    spi.SPI_Mode = SPI_Mode_Master;
-    SPI_Init(SPI2, &spi);
-
-    DMA_DeInit(SPIx_TX_DMA_STREAM);
-    DMA_StructInit(&dma);
-    dma.DMA_BufferSize = 1;
-    dma.DMA_FIFOMode = DMA_FIFOMode_Disable;
-    dma.DMA_FIFOThreshold = DMA_FIFOThreshold_1QuarterFull;
-    dma.DMA_MemoryBurst = DMA_MemoryBurst_Single;
-    dma.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
-    dma.DMA_MemoryInc = DMA_MemoryInc_Disable;
-    dma.DMA_Mode = DMA_Mode_Normal;
-    dma.DMA_PeripheralBaseAddr = (uint32_t)(&(SPI2->DR));
-    dma.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
-    dma.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
-    dma.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
-    dma.DMA_Priority = DMA_Priority_High;
-    // Configure TX DMA
-    dma.DMA_Channel = SPIx_RXTX_DMA_CHANNEL;
-    dma.DMA_DIR = DMA_DIR_MemoryToPeripheral;
-    dma.DMA_Memory0BaseAddr = 0;
-    DMA_Init(SPIx_TX_DMA_STREAM, &dma);
-    // Enable SPI
-    SPI_Cmd(SPI2, ENABLE);
-    SPI_I2S_DMACmd(SPI2, SPI_I2S_DMAReq_Tx, ENABLE);
+    // LCD_CS + FONT_CS
+    busAddDevice(&displayDevice);
+#ifdef FONT_CS_PORT
+    busAddDevice(&fontDevice);
+#endif
 }
 
 static void dff(uint16_t datasize)
 {
     uint16_t tmpreg;
 
-    while (SPI2->SR & SPI_I2S_FLAG_BSY);
+    STAT_WAIT(while (SPI2->SR & SPI_I2S_FLAG_BSY));
 
     tmpreg = SPI2->CR1;
 
@@ -117,61 +78,72 @@ static void dff(uint16_t datasize)
     SPI2->CR1 = tmpreg;
 }
 
+// The core selects the display around its transfers, but another device may have taken the
+// bus since, e.g. a job run by busRelease() from inside a startWrite() block
+#define DISPLAY_CLAIM if (busOwner != &displayDevice) busSelect(&displayDevice)
+
 uint8_t displayTransfer8(uint8_t dat)
 {
-    while (!(SPI2->SR & SPI_I2S_FLAG_TXE));
-    SPI2->DR = dat;
-    while (!(SPI2->SR & SPI_I2S_FLAG_RXNE));
-    return (uint8_t)(SPI2->DR);
+    DISPLAY_CLAIM;
+    STAT_ADD(bytes, 1);
+    return busTransfer8(dat);
 }
 
+// Long transfers go in SPI_BUS_CHUNK bursts with more urgent queued jobs run in between. With
+// nowait the last burst is still going on return, displayTransfer16End() waits for it
 void displayTransfer16(const uint16_t *buffer, int len, bool incr, bool nowait)
 {
-    uint16_t xfersize = 0xFFFF;
-    uint32_t tmpreg = 0;
+    uint16_t chunk = nowait ? 0xFFFF : SPI_BUS_CHUNK;
+    uint16_t xfersize;
+    uint32_t tmpreg;
 
+    DISPLAY_CLAIM;
+    STAT_ADD(dma, 1);
+    STAT_ADD(bytes, len * 2);
     dff(SPI_DataSize_16b);
 
-    // set start address
-    SPIx_TX_DMA_STREAM->M0AR = (uint32_t)buffer;
-
-    // enable fixed/incr mode
-    tmpreg = SPIx_TX_DMA_STREAM->CR;
-    tmpreg &= ~(DMA_SxCR_MINC);
-    if (incr)
-        tmpreg |= DMA_MemoryInc_Enable;
-    SPIx_TX_DMA_STREAM->CR = tmpreg;
+    while (len > 0) {
+        xfersize = (len > chunk) ? chunk : (uint16_t)len;
 
-    do {
-        if (len > 0xFFFF)
-            xfersize = 0xFFFF;
-        else
-            xfersize = (uint16_t)(len & 0xFFFF);
+        // Set up every burst, jobs run in between use the stream too
+        SPIx_TX_DMA_STREAM->M0AR = (uint32_t)buffer;
 
-        if (xfersize == 0)
-            break;
+        // enable fixed/incr mode, half word items
+        tmpreg = SPIx_TX_DMA_STREAM->CR;
+        tmpreg &= ~(DMA_SxCR_MINC | DMA_SxCR_MSIZE | DMA_SxCR_PSIZE);
+        tmpreg |= DMA_MemoryDataSize_HalfWord | DMA_PeripheralDataSize_HalfWord;
+        if (incr)
+            tmpreg |= DMA_MemoryInc_Enable;
+        SPIx_TX_DMA_STREAM->CR = tmpreg;
 
         SPIx_TX_DMA_STREAM->NDTR = xfersize;
 
         SPI_I2S_DMACmd(SPI2, SPI_I2S_DMAReq_Tx, ENABLE);
         DMA_Cmd(SPIx_TX_DMA_STREAM, ENABLE);
 
-        if (nowait)
+        len -= xfersize;
+        if (nowait && !len)
             return;
 
-        while (DMA_GetFlagStatus(SPIx_TX_DMA_STREAM, SPIx_TX_DMA_FLAG_TCIF) == RESET);
-        while (!(SPI2->SR & SPI_I2S_FLAG_TXE));
-        while (SPI2->SR & SPI_I2S_FLAG_BSY);
+        STAT_WAIT(while (DMA_GetFlagStatus(SPIx_TX_DMA_STREAM, SPIx_TX_DMA_FLAG_TCIF) == RESET);
+                  while (!(SPI2->SR & SPI_I2S_FLAG_TXE));
+                  while (SPI2->SR & SPI_I2S_FLAG_BSY));
 
         DMA_ClearFlag(SPIx_TX_DMA_STREAM, SPIx_TX_DMA_FLAG_TCIF);
         DMA_Cmd(SPIx_TX_DMA_STREAM, DISABLE);
         // wait for DMA to really disable
         while (SPIx_TX_DMA_STREAM->CR & DMA_SxCR_EN);
 
-        len -= xfersize;
-        if (len && incr)
-            SPIx_TX_DMA_STREAM->M0AR += (xfersize * sizeof(uint16_t));
-    } while (len > 0);
+        if (incr)
+            buffer += xfersize;
+
+        if (len && busWaiting(&displayDevice)) {
+            SPI_I2S_ReceiveData(SPI2);
+            dff(SPI_DataSize_8b);
+            busYield(&displayDevice);
+            dff(SPI_DataSize_16b);
+        }
+    }
 
     // clear rx buffer
     SPI_I2S_ReceiveData(SPI2);
@@ -179,11 +151,16 @@ void displayTransfer16(const uint16_t *buffer, int len, bool incr, bool nowait)
     dff(SPI_DataSize_8b);
 }
 
+// Also the idle hook of displayDevice, so returns at once with no burst in flight
 void displayTransfer16End(void)
 {
-    while (DMA_GetFlagStatus(SPIx_TX_DMA_STREAM, SPIx_TX_DMA_FLAG_TCIF) == RESET);
-    while (!(SPI2->SR & SPI_I2S_FLAG_TXE));
-    while (SPI2->SR & SPI_I2S_FLAG_BSY);
+    if (!(SPIx_TX_DMA_STREAM->CR & DMA_SxCR_EN) &&
+        DMA_GetFlagStatus(SPIx_TX_DMA_STREAM, SPIx_TX_DMA_FLAG_TCIF) == RESET)
+        return;
+
+    STAT_WAIT(while (DMA_GetFlagStatus(SPIx_TX_DMA_STREAM, SPIx_TX_DMA_FLAG_TCIF) == RESET);
+              while (!(SPI2->SR & SPI_I2S_FLAG_TXE));
+              while (SPI2->SR & SPI_I2S_FLAG_BSY));
 
     DMA_ClearFlag(SPIx_TX_DMA_STREAM, SPIx_TX_DMA_FLAG_TCIF);
     DMA_Cmd(SPIx_TX_DMA_STREAM, DISABLE);
@@ -200,6 +177,9 @@ void displayTransfer16Slow(uint16_t *buffer, int len, bool incr)
 {
     int i;
 
+    DISPLAY_CLAIM;
+    STAT_ADD(slow, 1);
+    STAT_ADD(bytes, len * 2);
     dff(SPI_DataSize_16b);
     for (i = 0; i < len; i++) {
         SPI2->DR = *buffer;
@@ -211,21 +191,93 @@ void displayTransfer16Slow(uint16_t *buffer, int len, bool incr)
     dff(SPI_DataSize_8b);
 }
 
-void displaySpeed(uint16_t prescaler)
+// Send len bytes by DMA with the SPI left in 8-bit mode, for 18-bit colour. Bursts and nowait
+// as for displayTransfer16()
+void displayTransfer8Buf(const uint8_t *buffer, int len, bool nowait)
 {
-    uint16_t tmpreg;
+    uint16_t chunk = nowait ? 0xFFFF : SPI_BUS_CHUNK;
+    uint16_t xfersize;
+    uint32_t tmpreg;
 
+    DISPLAY_CLAIM;
+    STAT_ADD(dma, 1);
+    STAT_ADD(bytes, len);
     while (SPI2->SR & SPI_I2S_FLAG_BSY);
 
-    tmpreg = SPI2->CR1;
+    while (len > 0) {
+        xfersize = (len > chunk) ? chunk : (uint16_t)len;
 
-    // mask BR
-    tmpreg &= ~((uint16_t)0x0038); // BR[2:0]
-    SPI2->CR1 = tmpreg;
+        SPIx_TX_DMA_STREAM->M0AR = (uint32_t)buffer;
 
-    // set prescaler
-    tmpreg |= prescaler;
-    SPI2->CR1 = tmpreg;
+        // incr mode, byte items
+        tmpreg = SPIx_TX_DMA_STREAM->CR;
+        tmpreg &= ~(DMA_SxCR_MSIZE | DMA_SxCR_PSIZE);
+        tmpreg |= DMA_SxCR_MINC;
+        SPIx_TX_DMA_STREAM->CR = tmpreg;
+
+        SPIx_TX_DMA_STREAM->NDTR = xfersize;
+
+        SPI_I2S_DMACmd(SPI2, SPI_I2S_DMAReq_Tx, ENABLE);
+        DMA_Cmd(SPIx_TX_DMA_STREAM, ENABLE);
+
+        len -= xfersize;
+        if (nowait && !len)
+            return;
+
+        while (DMA_GetFlagStatus(SPIx_TX_DMA_STREAM, SPIx_TX_DMA_FLAG_TCIF) == RESET);
+        while (!(SPI2->SR & SPI_I2S_FLAG_TXE));
+        while (SPI2->SR & SPI_I2S_FLAG_BSY);
+
+        DMA_ClearFlag(SPIx_TX_DMA_STREAM, SPIx_TX_DMA_FLAG_TCIF);
+        DMA_Cmd(SPIx_TX_DMA_STREAM, DISABLE);
+        // wait for DMA to really disable
+        while (SPIx_TX_DMA_STREAM->CR & DMA_SxCR_EN);
+
+        buffer += xfersize;
+
+        if (len && busWaiting(&displayDevice)) {
+            SPI_I2S_ReceiveData(SPI2);
+            busYield(&displayDevice);
+        }
+    }
+
+    // clear rx buffer
+    SPI_I2S_ReceiveData(SPI2);
+}
+
+#ifdef FONT_CS_PORT
+// Read len bytes at addr from the serial NOR on FONT_CS, sharing SPI2 with the display.
+// Selecting it deselects the display, long reads are done by DMA
+void fontFlashRead(uint32_t addr, uint8_t *buf, uint32_t len)
+{
+    uint8_t cmd[4] = { FONT_FLASH_READ, addr >> 16, addr >> 8, addr };
+
+    busSelect(&fontDevice);
+    busTransfer(cmd, NULL, sizeof(cmd));
+    busTransfer(NULL, buf, len);
+    busRelease(&fontDevice);
+}
+#endif
+
+void displaySpeed(uint16_t prescaler)
+{
+    displayDevice.prescaler = prescaler;
+    busUpdate(&displayDevice);
+}
+// The SPI_BaudRatePrescaler_ value for the fastest clock not above freq, PCLK1 / 2 to / 256
+uint16_t displayPrescaler(uint32_t freq)
+{
+    uint16_t br = 0;
+
+    while (br < 7 && (spiClock >> (br + 1)) > freq)
+        br++;
+
+    return br << 3;
+}
+
+uint32_t displayFrequency(uint16_t prescaler)
+{
+    return spiClock >> (((prescaler >> 3) & 7) + 1);
 }
 
 #endif
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "spi_bus.h"
+
 #define SPI_HAS_TRANSACTION 1
 #define SUPPORT_TRANSACTIONS
 
@@ -39,15 +41,23 @@
 
 #endif
 
-#define CS_L CS_PORT->BSRR = CS_PIN_MASK << 16
-#define CS_H CS_PORT->BSRR = CS_PIN_MASK
+#ifndef DISPLAY_BUS_PRIORITY
+#define DISPLAY_BUS_PRIORITY 2 // spiDevice priority, jobs below this cut into long pixel transfers
+#endif
+
+#ifndef FONT_BUS_PRIORITY
+#define FONT_BUS_PRIORITY 1
+#endif
+
+extern spiDevice displayDevice;
+
+// The display shares SPI2, see spi_bus.h
+#define CS_L busSelect(&displayDevice)
+#define CS_H busRelease(&displayDevice)
 
 #define RES_L RES_PORT->BSRR = RES_PIN_MASK << 16
 #define RES_H RES_PORT->BSRR = RES_PIN_MASK
 
-#define FONT_CS_L FONT_CS_PORT->BSRR = FONT_CS_PIN_MASK << 16
-#define FONT_CS_H FONT_CS_PORT->BSRR = FONT_CS_PIN_MASK
-
 #define DC_DELAY
 
 #define DC_C DC_DELAY; DC_PORT->BSRR = DC_PIN_MASK << 16
@@ -56,9 +66,15 @@
 #define SPI_MODE0 0
 
 #define tft_Write_8(C) displayTransfer8(C)
+#ifdef SPI_18BIT_DRIVER
+// 18-bit colour panels take each colour as 3 bytes of RGB666, the low bits of each are ignored
+#define tft_Write_16(C) displayTransfer8(((C) & 0xF800) >> 8); displayTransfer8(((C) & 0x07E0) >> 3); displayTransfer8(((C) & 0x001F) << 3)
+#else
 #define tft_Write_16(C) displayTransfer8(C >> 8); displayTransfer8(C & 0xff)
-#define tft_Write_32D(C) tft_Write_16(C); tft_Write_16(C)
-#define tft_Write_32C(C,D) tft_Write_16(C); tft_Write_16(D)
+#endif
+// Window coordinates, always two 16-bit words
+#define tft_Write_32D(C) displayTransfer8((C) >> 8); displayTransfer8(C); displayTransfer8((C) >> 8); displayTransfer8(C)
+#define tft_Write_32C(C,D) displayTransfer8((C) >> 8); displayTransfer8(C); displayTransfer8((D) >> 8); displayTransfer8(D)
 #define tft_Read_8() displayTransfer8(0xAA)
 
 #define DISPLAY_DMA_BENEFIT_LENGTH  (16)
@@ -66,7 +82,13 @@
 void displayHardwareInit(void);
 void displayHardwareReset(void);
 void displaySpeed(uint16_t prescaler);
+uint16_t displayPrescaler(uint32_t freq); // displaySpeed() value for the fastest clock up to freq
+uint32_t displayFrequency(uint16_t prescaler); // Clock a displaySpeed() value gives
 uint8_t displayTransfer8(uint8_t dat);
 void displayTransfer16(const uint16_t *buffer, int len, bool incr, bool nowait);
 void displayTransfer16End(void);
 void displayTransfer16Slow(uint16_t *buffer, int len, bool incr);
+void displayTransfer8Buf(const uint8_t *buffer, int len, bool nowait);
+#ifdef FONT_CS_PORT
+void fontFlashRead(uint32_t addr, uint8_t *buf, uint32_t len);
+#endif
@@ -0,0 +1,225 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32f4xx.h"
+#include "display_hal_fsmc.h"
+
+#if defined(STM32F40_41xxx)
+
+// Memory to memory DMA is only on DMA2, any channel
+#define FSMC_DMA_STREAM         DMA2_Stream0
+#define FSMC_DMA_CHANNEL        DMA_Channel_0
+#define FSMC_DMA_FLAGS          (DMA_FLAG_TCIF0 | DMA_FLAG_HTIF0 | DMA_FLAG_TEIF0 | DMA_FLAG_DMEIF0 | DMA_FLAG_FEIF0)
+
+// HCLK cycles, a write takes ADDSET + DATAST + 1 so 4 cycles is 24ns at 168MHz (about 40 Mpixel/s,
+// fine for the SSD1963). Slower controllers need more, the ILI9481 write cycle is 100ns
+#ifndef FSMC_WRITE_ADDSET
+#define FSMC_WRITE_ADDSET 1
+#endif
+#ifndef FSMC_WRITE_DATAST
+#define FSMC_WRITE_DATAST 2
+#endif
+// Reads from the panel are much slower
+#ifndef FSMC_READ_ADDSET
+#define FSMC_READ_ADDSET 4
+#endif
+#ifndef FSMC_READ_DATAST
+#define FSMC_READ_DATAST 30
+#endif
+
+volatile uint16_t *displayPort = (volatile uint16_t *)FSMC_DATA_ADDR;
+
+static uint32_t hclk;
+
+static void fsmcPins(GPIO_TypeDef *port, uint16_t pins)
+{
+    GPIO_InitTypeDef gpio;
+
+    for (uint8_t i = 0; i < 16; i++)
+        if (pins & (1 << i))
+            GPIO_PinAFConfig(port, i, GPIO_AF_FSMC);
+
+    GPIO_StructInit(&gpio);
+    gpio.GPIO_Mode = GPIO_Mode_AF;
+    gpio.GPIO_Speed = GPIO_Speed_100MHz;
+    gpio.GPIO_Pin = pins;
+    GPIO_Init(port, &gpio);
+}
+
+void displayHardwareInit(void)
+{
+    GPIO_InitTypeDef gpio;
+    FSMC_NORSRAMInitTypeDef fsmc;
+    FSMC_NORSRAMTimingInitTypeDef readTiming, writeTiming;
+    DMA_InitTypeDef dma;
+    RCC_ClocksTypeDef clocks;
+
+    RCC_GetClocksFreq(&clocks);
+    hclk = clocks.HCLK_Frequency;
+
+    RCC_AHB1PeriphClockCmd(RCC_POWER_GPIO, ENABLE);
+    RCC_AHB3PeriphClockCmd(RCC_AHB3Periph_FSMC, ENABLE);
+    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA2, ENABLE);
+
+    fsmcPins(GPIOD, FSMC_PINS_D);
+    fsmcPins(GPIOE, FSMC_PINS_E);
+
+    // LCD_RES
+    RES_H;
+    GPIO_StructInit(&gpio);
+    gpio.GPIO_Mode = GPIO_Mode_OUT;
+    gpio.GPIO_Speed = GPIO_Speed_100MHz;
+    gpio.GPIO_Pin = RES_PIN_MASK;
+    GPIO_Init(RES_PORT, &gpio);
+
+    // SRAM mode, mode A timings so reads and writes can differ
+    readTiming.FSMC_AddressSetupTime = FSMC_READ_ADDSET;
+    readTiming.FSMC_AddressHoldTime = 0;
+    readTiming.FSMC_DataSetupTime = FSMC_READ_DATAST;
+    readTiming.FSMC_BusTurnAroundDuration = 0;
+    readTiming.FSMC_CLKDivision = 0;
+    readTiming.FSMC_DataLatency = 0;
+    readTiming.FSMC_AccessMode = FSMC_AccessMode_A;
+
+    writeTiming = readTiming;
+    writeTiming.FSMC_AddressSetupTime = FSMC_WRITE_ADDSET;
+    writeTiming.FSMC_DataSetupTime = FSMC_WRITE_DATAST;
+
+    FSMC_NORSRAMStructInit(&fsmc);
+    fsmc.FSMC_Bank = FSMC_Bank1_NORSRAM1 + 2 * (FSMC_NE - 1);
+    fsmc.FSMC_DataAddressMux = FSMC_DataAddressMux_Disable;
+    fsmc.FSMC_MemoryType = FSMC_MemoryType_SRAM;
+    fsmc.FSMC_MemoryDataWidth = FSMC_MemoryDataWidth_16b;
+    fsmc.FSMC_BurstAccessMode = FSMC_BurstAccessMode_Disable;
+    fsmc.FSMC_WriteOperation = FSMC_WriteOperation_Enable;
+    fsmc.FSMC_ExtendedMode = FSMC_ExtendedMode_Enable;
+    fsmc.FSMC_WriteBurst = FSMC_WriteBurst_Disable;
+    fsmc.FSMC_ReadWriteTimingStruct = &readTiming;
+    fsmc.FSMC_WriteTimingStruct = &writeTiming;
+    FSMC_NORSRAMInit(&fsmc);
+    FSMC_NORSRAMCmd(fsmc.FSMC_Bank, ENABLE);
+
+    // Pixels are copied to the data address, the "peripheral" side is the source in this mode
+    DMA_DeInit(FSMC_DMA_STREAM);
+    DMA_StructInit(&dma);
+    dma.DMA_Channel = FSMC_DMA_CHANNEL;
+    dma.DMA_DIR = DMA_DIR_MemoryToMemory;
+    dma.DMA_BufferSize = 1;
+    dma.DMA_FIFOMode = DMA_FIFOMode_Enable;
+    dma.DMA_FIFOThreshold = DMA_FIFOThreshold_Full;
+    dma.DMA_MemoryBurst = DMA_MemoryBurst_Single;
+    dma.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    dma.DMA_MemoryInc = DMA_MemoryInc_Disable;
+    dma.DMA_Memory0BaseAddr = FSMC_DATA_ADDR;
+    dma.DMA_Mode = DMA_Mode_Normal;
+    dma.DMA_PeripheralBaseAddr = 0;
+    dma.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
+    dma.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    dma.DMA_PeripheralInc = DMA_PeripheralInc_Enable;
+    dma.DMA_Priority = DMA_Priority_High;
+    DMA_Init(FSMC_DMA_STREAM, &dma);
+}
+
+// The stream disables itself at the end of a transfer, its flags must be clear before the next
+static void fsmcDmaWait(void)
+{
+    while (FSMC_DMA_STREAM->CR & DMA_SxCR_EN);
+    DMA_ClearFlag(FSMC_DMA_STREAM, FSMC_DMA_FLAGS);
+}
+
+uint8_t displayTransfer8(uint8_t dat)
+{
+    tft_Write_8(dat);
+    return 0;
+}
+
+void displayTransfer16(const uint16_t *buffer, int len, bool incr, bool nowait)
+{
+    uint16_t xfersize;
+
+    // Let a transfer left running by nowait end
+    fsmcDmaWait();
+
+    FSMC_DMA_STREAM->PAR = (uint32_t)buffer;
+    FSMC_DMA_STREAM->M0AR = (uint32_t)displayPort;
+
+    // A fill repeats one source word
+    if (incr)
+        FSMC_DMA_STREAM->CR |= DMA_SxCR_PINC;
+    else
+        FSMC_DMA_STREAM->CR &= ~DMA_SxCR_PINC;
+
+    while (len > 0) {
+        xfersize = (len > 0xFFFF) ? 0xFFFF : (uint16_t)len;
+
+        FSMC_DMA_STREAM->NDTR = xfersize;
+        DMA_Cmd(FSMC_DMA_STREAM, ENABLE);
+
+        len -= xfersize;
+        if (nowait && !len)
+            return;
+
+        fsmcDmaWait();
+
+        if (incr)
+            FSMC_DMA_STREAM->PAR += xfersize * sizeof(uint16_t);
+    }
+}
+
+void displayTransfer16End(void)
+{
+    fsmcDmaWait();
+}
+
+void displayTransfer16Slow(uint16_t *buffer, int len, bool incr)
+{
+    volatile uint16_t *port = displayPort;
+
+    if (incr)
+        while (len--)
+            *port = *buffer++;
+    else
+        while (len--)
+            *port = *buffer;
+}
+
+// Bytes are one bus cycle each, only init arguments come here so they are not worth a DMA setup
+void displayTransfer8Buf(const uint8_t *buffer, int len, bool nowait)
+{
+    volatile uint16_t *port = displayPort;
+
+    (void)nowait; // The bus write finishes with the store, there is nothing to wait for
+
+    while (len-- > 0)
+        *port = *buffer++;
+}
+
+// Write data phase in HCLK cycles, 1 to 255, the FSMC equivalent of the SPI prescaler
+void displaySpeed(uint16_t prescaler)
+{
+    uint32_t bwtr = FSMC_Bank1E->BWTR[2 * (FSMC_NE - 1)];
+
+    bwtr &= ~FSMC_BWTR1_DATAST;
+    bwtr |= (uint32_t)(prescaler & 0xFF) << 8;
+    FSMC_Bank1E->BWTR[2 * (FSMC_NE - 1)] = bwtr;
+}
+
+// Data phase for the fastest write cycle (ADDSET + DATAST + 1 HCLK cycles) up to freq. Reads
+// have their own timing so the read profile only slows the command writes around them
+uint16_t displayPrescaler(uint32_t freq)
+{
+    uint32_t cycles = freq ? (hclk + freq - 1) / freq : 255;
+
+    if (cycles < FSMC_WRITE_ADDSET + 2)
+        return 1;
+    if (cycles > FSMC_WRITE_ADDSET + 256)
+        return 255;
+
+    return cycles - FSMC_WRITE_ADDSET - 1;
+}
+
+uint32_t displayFrequency(uint16_t prescaler)
+{
+    return hclk / (FSMC_WRITE_ADDSET + prescaler + 1);
+}
+
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+// 16-bit 8080 parallel panels (SSD1963, ILI9481, ...) on the FSMC, include this instead of
+// display_hal_f4.h and build display_hal_fsmc.c, with TFT_PARALLEL_16_BIT in the setup file.
+// Commands and data are writes to two addresses told apart by the FSMC address line wired to RS.
+// Only the F405/F407/F415/F417 (STM32F40_41xxx) are supported. The F42x/F43x have the FMC
+// instead, which the SPL drives through stm32f4xx_fmc.h with different names
+
+#define SPI_HAS_TRANSACTION 1
+#define SUPPORT_TRANSACTIONS
+
+#if defined(STM32F40_41xxx)
+/* F407 target, FSMC bank 1 NE1 (PD7) with RS on A16 (PD11) */
+
+#define RCC_POWER_GPIO (RCC_AHB1Periph_GPIOA | RCC_AHB1Periph_GPIOD | RCC_AHB1Periph_GPIOE)
+
+#define RES_PORT GPIOA
+#define RES_PIN_MASK (GPIO_Pin_8)
+
+#ifndef FSMC_NE
+#define FSMC_NE 1 // Chip select NE1-NE4, picks the bank 1 sub-bank
+#endif
+
+#ifndef FSMC_RS_LINE
+#define FSMC_RS_LINE 16 // FSMC address line wired to RS
+#endif
+
+// NOE, NWE, NE1, A16 and D0-D15
+#ifndef FSMC_PINS_D
+#define FSMC_PINS_D (GPIO_Pin_0 | GPIO_Pin_1 | GPIO_Pin_4 | GPIO_Pin_5 | GPIO_Pin_7 | GPIO_Pin_8 | \
+                     GPIO_Pin_9 | GPIO_Pin_10 | GPIO_Pin_11 | GPIO_Pin_14 | GPIO_Pin_15)
+#endif
+#ifndef FSMC_PINS_E
+#define FSMC_PINS_E (GPIO_Pin_7 | GPIO_Pin_8 | GPIO_Pin_9 | GPIO_Pin_10 | GPIO_Pin_11 | GPIO_Pin_12 | \
+                     GPIO_Pin_13 | GPIO_Pin_14 | GPIO_Pin_15)
+#endif
+
+#else
+
+#error unsupported platform!
+
+#endif
+
+// The 16-bit bus puts HADDR[25:1] on A[24:0], so RS on line n is address bit n + 1
+#define FSMC_CMD_ADDR (0x60000000UL + 0x04000000UL * (FSMC_NE - 1))
+#define FSMC_DATA_ADDR (FSMC_CMD_ADDR | (1UL << (FSMC_RS_LINE + 1)))
+
+// Where tft_Write_ goes, set by DC_C and DC_D
+extern volatile uint16_t *displayPort;
+
+// Reads come straight from the data register, one bus cycle each
+static inline uint16_t displayRead16(void)
+{
+    return *displayPort;
+}
+
+static inline uint8_t displayRead8(void)
+{
+    return *displayPort;
+}
+
+// NE is driven by the FSMC for every access
+#define CS_L
+#define CS_H
+
+#define RES_L RES_PORT->BSRR = RES_PIN_MASK << 16
+#define RES_H RES_PORT->BSRR = RES_PIN_MASK
+
+#define DC_C displayPort = (volatile uint16_t *)FSMC_CMD_ADDR
+#define DC_D displayPort = (volatile uint16_t *)FSMC_DATA_ADDR
+
+#define SPI_MODE0 0
+
+// Commands and their parameters are one bus cycle per byte, pixels one cycle each
+#define tft_Write_8(C) *displayPort = (uint8_t)(C)
+#define tft_Write_16(C) *displayPort = (uint16_t)(C)
+#define tft_Write_32D(C) tft_Write_8((C) >> 8); tft_Write_8(C); tft_Write_8((C) >> 8); tft_Write_8(C)
+#define tft_Write_32C(C,D) tft_Write_8((C) >> 8); tft_Write_8(C); tft_Write_8((D) >> 8); tft_Write_8(D)
+#define tft_Read_8() displayRead8()
+#define tft_Read_16() displayRead16()
+
+#define DISPLAY_DMA_BENEFIT_LENGTH  (16)
+
+void displayHardwareInit(void);
+void displayHardwareReset(void);
+void displaySpeed(uint16_t prescaler);
+uint16_t displayPrescaler(uint32_t freq); // displaySpeed() value for the fastest clock up to freq
+uint32_t displayFrequency(uint16_t prescaler); // Clock a displaySpeed() value gives
+uint8_t displayTransfer8(uint8_t dat);
+void displayTransfer16(const uint16_t *buffer, int len, bool incr, bool nowait);
+void displayTransfer16End(void);
+void displayTransfer16Slow(uint16_t *buffer, int len, bool incr);
+void displayTransfer8Buf(const uint8_t *buffer, int len, bool nowait);
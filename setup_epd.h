@@ -0,0 +1,12 @@
+#pragma once
+
+// A 2.9" 128x296 black and white ePaper panel drawn through a framebuffer (display_hal_epd.c)
+#define EPD_DRIVER
+#define TFT_WIDTH  128
+#define TFT_HEIGHT 296
+#define EPD_BPP    1
+
+#define LOAD_GLCD   // Font 1. Original Adafruit 8 pixel font needs ~1820 bytes in FLASH
+#define LOAD_FONT2  // Font 2. Small 16 pixel high font, needs ~3534 bytes in FLASH, 96 characters
+#define LOAD_FONT4  // Font 4. Medium 26 pixel high font, needs ~5848 bytes in FLASH, 96 characters
+#define LOAD_GFXFF  // FreeFonts. Include access to the 48 Adafruit_GFX free fonts FF1 to FF48 and custom fonts
@@ -0,0 +1,16 @@
+#pragma once
+
+// Define the TFT display driver, an 800x480 panel on the 16-bit FSMC bus (display_hal_fsmc.c)
+#define SSD1963_800_DRIVER
+#define TFT_PARALLEL_16_BIT
+
+#define SPI_FREQUENCY      42000000 // FSMC write cycle, 4 HCLK cycles at 168MHz
+#define SPI_READ_FREQUENCY 42000000 // Reads have their own FSMC timing
+
+#define LOAD_GLCD   // Font 1. Original Adafruit 8 pixel font needs ~1820 bytes in FLASH
+#define LOAD_FONT2  // Font 2. Small 16 pixel high font, needs ~3534 bytes in FLASH, 96 characters
+#define LOAD_FONT4  // Font 4. Medium 26 pixel high font, needs ~5848 bytes in FLASH, 96 characters
+#define LOAD_FONT6  // Font 6. Large 48 pixel font, needs ~2666 bytes in FLASH, only characters 1234567890:-.apm
+#define LOAD_FONT7  // Font 7. 7 segment 48 pixel font, needs ~2438 bytes in FLASH, only characters 1234567890:-.
+#define LOAD_FONT8  // Font 8. Large 75 pixel font needs ~3256 bytes in FLASH, only characters 1234567890:-.
+#define LOAD_GFXFF  // FreeFonts. Include access to the 48 Adafruit_GFX free fonts FF1 to FF48 and custom fonts
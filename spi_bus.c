@@ -0,0 +1,315 @@
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "stm32f4xx.h"
+#include "spi_bus.h"
+
+#if defined(STM32F401xx) || defined(STM32F40_41xxx)
+
+#define BUS_TX_DMA_STREAM       DMA1_Stream4
+#define BUS_RX_DMA_STREAM       DMA1_Stream3
+#define BUS_DMA_CHANNEL         DMA_Channel_0
+#define BUS_TX_DMA_FLAG_TCIF    DMA_FLAG_TCIF4
+#define BUS_RX_DMA_FLAG_TCIF    DMA_FLAG_TCIF3
+
+spiDevice *busOwner; // Its CS is low
+
+static struct {
+    spiJob *queue[SPI_BUS_JOBS]; // Most urgent first, in submit order for equal priority
+    volatile uint8_t count;
+    bool running; // Jobs are being run, stops busRelease() inside a job starting more
+    bool ready;
+} bus;
+
+void busInit(void)
+{
+    GPIO_InitTypeDef gpio;
+    SPI_InitTypeDef spi;
+    DMA_InitTypeDef dma;
+
+    if (bus.ready)
+        return;
+    bus.ready = true;
+
+    RCC_APB1PeriphClockCmd(RCC_APB1Periph_SPI2, ENABLE);
+    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_GPIOB, ENABLE);
+    RCC_AHB1PeriphClockCmd(RCC_AHB1Periph_DMA1, ENABLE);
+
+    GPIO_PinAFConfig(GPIOB, GPIO_PinSource13, GPIO_AF_SPI2);
+    GPIO_PinAFConfig(GPIOB, GPIO_PinSource14, GPIO_AF_SPI2);
+    GPIO_PinAFConfig(GPIOB, GPIO_PinSource15, GPIO_AF_SPI2);
+
+    GPIO_StructInit(&gpio);
+    gpio.GPIO_Mode = GPIO_Mode_AF;
+    gpio.GPIO_Speed = GPIO_Speed_100MHz;
+    gpio.GPIO_Pin = GPIO_Pin_13 | GPIO_Pin_14 | GPIO_Pin_15;
+    GPIO_Init(GPIOB, &gpio);
+
+    // Mode 3 at PCLK1 / 2 until a device is selected
+    SPI_StructInit(&spi);
+    SPI_I2S_DeInit(SPI2);
+    spi.SPI_Direction = SPI_Direction_2Lines_FullDuplex;
+    spi.SPI_DataSize = SPI_DataSize_8b;
+    spi.SPI_CPOL = SPI_CPOL_High;
+    spi.SPI_CPHA = SPI_CPHA_2Edge;
+    spi.SPI_NSS = SPI_NSS_Soft;
+    spi.SPI_BaudRatePrescaler = SPI_BaudRatePrescaler_2;
+    spi.SPI_FirstBit = SPI_FirstBit_MSB;
+    spi.SPI_CRCPolynomial = 7;
+    spi.SPI_Mode = SPI_Mode_Master;
+    SPI_Init(SPI2, &spi);
+
+    DMA_DeInit(BUS_TX_DMA_STREAM);
+    DMA_StructInit(&dma);
+    dma.DMA_BufferSize = 1;
+    dma.DMA_FIFOMode = DMA_FIFOMode_Disable;
+    dma.DMA_FIFOThreshold = DMA_FIFOThreshold_1QuarterFull;
+    dma.DMA_MemoryBurst = DMA_MemoryBurst_Single;
+    dma.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+    dma.DMA_MemoryInc = DMA_MemoryInc_Disable;
+    dma.DMA_Mode = DMA_Mode_Normal;
+    dma.DMA_PeripheralBaseAddr = (uint32_t)(&(SPI2->DR));
+    dma.DMA_PeripheralBurst = DMA_PeripheralBurst_Single;
+    dma.DMA_PeripheralDataSize = DMA_PeripheralDataSize_HalfWord;
+    dma.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+    dma.DMA_Priority = DMA_Priority_High;
+    // Configure TX DMA
+    dma.DMA_Channel = BUS_DMA_CHANNEL;
+    dma.DMA_DIR = DMA_DIR_MemoryToPeripheral;
+    dma.DMA_Memory0BaseAddr = 0;
+    DMA_Init(BUS_TX_DMA_STREAM, &dma);
+
+    // Configure RX DMA, byte items
+    DMA_DeInit(BUS_RX_DMA_STREAM);
+    dma.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+    dma.DMA_MemoryInc = DMA_MemoryInc_Enable;
+    dma.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+    dma.DMA_DIR = DMA_DIR_PeripheralToMemory;
+    DMA_Init(BUS_RX_DMA_STREAM, &dma);
+
+    // Enable SPI
+    SPI_Cmd(SPI2, ENABLE);
+    SPI_I2S_DMACmd(SPI2, SPI_I2S_DMAReq_Tx, ENABLE);
+}
+
+void busAddDevice(spiDevice *dev)
+{
+    GPIO_InitTypeDef gpio;
+
+    dev->csPort->BSRR = dev->csPin;
+
+    GPIO_StructInit(&gpio);
+    gpio.GPIO_Mode = GPIO_Mode_OUT;
+    gpio.GPIO_Speed = GPIO_Speed_100MHz;
+    gpio.GPIO_Pin = dev->csPin;
+    GPIO_Init(dev->csPort, &gpio);
+}
+
+// Set the clock and mode of dev, the SPI is stopped while CPOL changes
+static void busApply(const spiDevice *dev)
+{
+    uint16_t cr1 = SPI2->CR1;
+    uint16_t tmpreg = (cr1 & ~(SPI_CR1_BR | SPI_CR1_CPOL | SPI_CR1_CPHA)) | dev->prescaler | (dev->mode & 3);
+
+    if (tmpreg == cr1)
+        return;
+
+    while (SPI2->SR & SPI_I2S_FLAG_BSY);
+
+    SPI2->CR1 = tmpreg & ~SPI_CR1_SPE;
+    SPI2->CR1 = tmpreg;
+}
+
+void busSelect(spiDevice *dev)
+{
+    spiDevice *prev = busOwner;
+
+    if (prev == dev)
+        return;
+
+    if (prev) {
+        if (prev->idle)
+            prev->idle();
+        while (SPI2->SR & SPI_I2S_FLAG_BSY);
+        prev->csPort->BSRR = prev->csPin;
+    }
+
+    busApply(dev);
+    busOwner = dev;
+    dev->csPort->BSRR = (uint32_t)dev->csPin << 16;
+}
+
+void busRelease(spiDevice *dev)
+{
+    if (busOwner != dev)
+        return;
+
+    if (dev->idle)
+        dev->idle();
+    while (SPI2->SR & SPI_I2S_FLAG_BSY);
+
+    dev->csPort->BSRR = dev->csPin;
+    busOwner = NULL;
+
+    if (bus.count)
+        busPoll();
+}
+
+void busUpdate(spiDevice *dev)
+{
+    if (busOwner == dev)
+        busApply(dev);
+}
+
+uint8_t busTransfer8(uint8_t dat)
+{
+    while (!(SPI2->SR & SPI_I2S_FLAG_TXE));
+    SPI2->DR = dat;
+    while (!(SPI2->SR & SPI_I2S_FLAG_RXNE));
+    return (uint8_t)(SPI2->DR);
+}
+
+// Exchange len bytes with the selected device, TX and RX DMA together for long ones
+void busTransfer(const uint8_t *tx, uint8_t *rx, uint32_t len)
+{
+    static const uint8_t dummy = 0xFF;
+    static uint8_t sink;
+    uint16_t xfersize;
+    uint32_t tmpreg;
+    uint8_t dat;
+
+    if (len <= SPI_BUS_DMA_MIN) {
+        while (len--) {
+            dat = busTransfer8(tx ? *tx++ : 0xFF);
+            if (rx)
+                *rx++ = dat;
+        }
+        return;
+    }
+
+    while (SPI2->SR & SPI_I2S_FLAG_BSY);
+    // clear rx buffer
+    SPI_I2S_ReceiveData(SPI2);
+
+    // byte items, a missing buffer is a fixed byte
+    tmpreg = BUS_TX_DMA_STREAM->CR & ~(DMA_SxCR_MINC | DMA_SxCR_MSIZE | DMA_SxCR_PSIZE);
+    BUS_TX_DMA_STREAM->CR = tmpreg | (tx ? DMA_SxCR_MINC : 0);
+    BUS_TX_DMA_STREAM->M0AR = tx ? (uint32_t)tx : (uint32_t)&dummy;
+
+    tmpreg = BUS_RX_DMA_STREAM->CR & ~(DMA_SxCR_MINC | DMA_SxCR_MSIZE | DMA_SxCR_PSIZE);
+    BUS_RX_DMA_STREAM->CR = tmpreg | (rx ? DMA_SxCR_MINC : 0);
+    BUS_RX_DMA_STREAM->M0AR = rx ? (uint32_t)rx : (uint32_t)&sink;
+
+    do {
+        xfersize = (len > 0xFFFF) ? 0xFFFF : (uint16_t)len;
+
+        BUS_RX_DMA_STREAM->NDTR = xfersize;
+        BUS_TX_DMA_STREAM->NDTR = xfersize;
+
+        SPI_I2S_DMACmd(SPI2, SPI_I2S_DMAReq_Rx, ENABLE);
+        DMA_Cmd(BUS_RX_DMA_STREAM, ENABLE);
+        DMA_Cmd(BUS_TX_DMA_STREAM, ENABLE);
+
+        while (DMA_GetFlagStatus(BUS_RX_DMA_STREAM, BUS_RX_DMA_FLAG_TCIF) == RESET);
+
+        DMA_ClearFlag(BUS_RX_DMA_STREAM, BUS_RX_DMA_FLAG_TCIF);
+        DMA_ClearFlag(BUS_TX_DMA_STREAM, BUS_TX_DMA_FLAG_TCIF);
+        DMA_Cmd(BUS_RX_DMA_STREAM, DISABLE);
+        DMA_Cmd(BUS_TX_DMA_STREAM, DISABLE);
+        // wait for DMA to really disable
+        while (BUS_RX_DMA_STREAM->CR & DMA_SxCR_EN);
+        while (BUS_TX_DMA_STREAM->CR & DMA_SxCR_EN);
+
+        len -= xfersize;
+        if (tx)
+            BUS_TX_DMA_STREAM->M0AR += xfersize;
+        if (rx)
+            BUS_RX_DMA_STREAM->M0AR += xfersize;
+    } while (len > 0);
+
+    SPI_I2S_DMACmd(SPI2, SPI_I2S_DMAReq_Rx, DISABLE);
+    while (SPI2->SR & SPI_I2S_FLAG_BSY);
+}
+
+bool busSubmit(spiJob *job)
+{
+    uint32_t primask = __get_PRIMASK();
+    int i;
+
+    __disable_irq();
+
+    if (bus.count >= SPI_BUS_JOBS) {
+        __set_PRIMASK(primask);
+        return false;
+    }
+
+    // Behind every job of the same or a more urgent priority
+    for (i = bus.count; i > 0 && bus.queue[i - 1]->dev->priority > job->dev->priority; i--)
+        bus.queue[i] = bus.queue[i - 1];
+    bus.queue[i] = job;
+    bus.count++;
+
+    __set_PRIMASK(primask);
+    return true;
+}
+
+// Take the first job if its priority is below limit
+static spiJob *busTake(uint16_t limit)
+{
+    uint32_t primask = __get_PRIMASK();
+    spiJob *job = NULL;
+    int i;
+
+    __disable_irq();
+
+    if (bus.count && bus.queue[0]->dev->priority < limit) {
+        job = bus.queue[0];
+        bus.count--;
+        for (i = 0; i < bus.count; i++)
+            bus.queue[i] = bus.queue[i + 1];
+    }
+
+    __set_PRIMASK(primask);
+    return job;
+}
+
+static void busRun(uint16_t limit)
+{
+    spiJob *job;
+
+    bus.running = true;
+    while ((job = busTake(limit)) != NULL) {
+        busSelect(job->dev);
+        busTransfer(job->tx, job->rx, job->len);
+        busRelease(job->dev);
+        if (job->done)
+            job->done(job);
+    }
+    bus.running = false;
+}
+
+void busPoll(void)
+{
+    if (bus.running || busOwner)
+        return;
+
+    busRun(0x100);
+}
+
+bool busWaiting(const spiDevice *dev)
+{
+    return bus.count && !bus.running && bus.queue[0]->dev->priority < dev->priority;
+}
+
+// Called by the owner between transfers, the panels keep their RAM write going through a
+// CS pulse so pixel streams carry on where they stopped
+void busYield(spiDevice *dev)
+{
+    if (!busWaiting(dev))
+        return;
+
+    busRun(dev->priority);
+    busSelect(dev);
+}
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+// SPI2 shared between the display, the font flash and any other devices on it (SD card,
+// sensors). Each device has its own CS, clock and mode, selecting one deselects whoever had
+// the bus. Transfers that can wait are queued as jobs, most urgent first, and run whenever
+// the bus is released, from busPoll(), or between the chunks of a long display transfer
+
+#ifndef SPI_BUS_JOBS
+#define SPI_BUS_JOBS 8 // Queued jobs
+#endif
+
+#ifndef SPI_BUS_CHUNK
+#define SPI_BUS_CHUNK 4096 // Longest display DMA burst in items (up to 0xFFFF), jobs can run between
+#endif
+
+#ifndef SPI_BUS_DMA_MIN
+#define SPI_BUS_DMA_MIN 16 // busTransfer() lengths above this go by DMA
+#endif
+
+typedef struct {
+    GPIO_TypeDef *csPort;
+    uint16_t csPin;
+    uint16_t prescaler; // SPI_BaudRatePrescaler_ value
+    uint8_t mode; // SPI mode 0-3, CPOL in bit 1 and CPHA in bit 0
+    uint8_t priority; // Lower runs first, a job only cuts into a device of higher value
+    void (*idle)(void); // Waits for a transfer the device left running, or NULL
+} spiDevice;
+
+typedef struct spiJob {
+    spiDevice *dev;
+    const uint8_t *tx; // NULL sends 0xFF
+    uint8_t *rx; // NULL drops what is read
+    uint32_t len;
+    void (*done)(struct spiJob *job); // Called with the device deselected, or NULL
+    void *ctx;
+} spiJob;
+
+extern spiDevice *busOwner; // Has the bus, NULL when free
+
+void busInit(void); // SPI2, its pins and DMA streams, called again it does nothing
+void busAddDevice(spiDevice *dev); // Set up the CS pin, high
+void busSelect(spiDevice *dev); // Take the bus, waiting for the last owner's transfer to end
+void busRelease(spiDevice *dev); // Let the bus go once dev is idle, queued jobs run before this returns
+void busUpdate(spiDevice *dev); // Apply a changed prescaler or mode if dev has the bus
+uint8_t busTransfer8(uint8_t dat);
+void busTransfer(const uint8_t *tx, uint8_t *rx, uint32_t len);
+bool busSubmit(spiJob *job); // Queue a job, safe from interrupts, false when full
+void busPoll(void); // Run the queued jobs if the bus is free
+bool busWaiting(const spiDevice *dev); // A job more urgent than dev is queued
+void busYield(spiDevice *dev); // Run the jobs more urgent than dev, then give it the bus back
@@ -0,0 +1,169 @@
+/***************************************************
+  Delta coded animation clip player for the TFT
+  library.
+
+  A clip is a keyframe followed by frames that only
+  hold the rectangles which changed since the frame
+  before, each coded as runs and literal RGB565
+  pixels, see Tools/clip565_pack.py for the format.
+  Rectangles are expanded in bands of whole rows
+  that alternate between two buffers, one sent by
+  DMA while the other is filled.
+ ****************************************************/
+
+#include "board.h"
+
+#ifdef LOAD_CLIP
+
+/***************************************************************************************
+** Function name:           clipByte
+** Description:             Fetch the next byte of the clip, 0 past the end
+***************************************************************************************/
+static uint8_t clipByte(clipPlayer *c)
+{
+    if (c->inPos >= c->inLen) {
+        if (c->read)
+            c->inLen = c->read(c->ctx, c->buffer, CLIP_INPUT_BUFFER);
+        else
+            c->inLen = 0;
+        c->inPos = 0;
+        if (!c->inLen) {
+            c->eof = true;
+            return 0;
+        }
+    }
+
+    return c->in[c->inPos++];
+}
+
+static uint16_t clipWord(clipPlayer *c)
+{
+    uint16_t w = clipByte(c);
+    return w | clipByte(c) << 8;
+}
+
+/***************************************************************************************
+** Function name:           clipOpen
+** Description:             Check the header and read the clip size and frame rate
+***************************************************************************************/
+bool clipOpen(clipPlayer *clip, const uint8_t *data, uint32_t size, imageReadCallback read, void *ctx)
+{
+    memset(clip, 0, sizeof(clipPlayer));
+
+    clip->in = data ? data : clip->buffer;
+    clip->inLen = data ? size : 0;
+    clip->read = data ? NULL : read;
+    clip->ctx = ctx;
+
+    if (clipByte(clip) != 'C' || clipByte(clip) != '5' || clipByte(clip) != '6' || clipByte(clip) != '5')
+        return false;
+
+    clip->width = clipWord(clip);
+    clip->height = clipWord(clip);
+    clip->frames = clipWord(clip);
+    clip->period = clipWord(clip);
+    clip->start = clip->inPos;
+
+    return !clip->eof && clip->width && clip->height && clip->frames && clip->width <= CLIP_OUTPUT_PIXELS;
+}
+
+/***************************************************************************************
+** Function name:           clipFrame
+** Description:             Draw the rectangles of the next frame with the top left at x,y
+***************************************************************************************/
+bool clipFrame(clipPlayer *clip, int32_t x, int32_t y)
+{
+    if (clip->frame >= clip->frames) {
+        if (!clip->loop || clip->read)
+            return false;
+        clip->inPos = clip->start; // The first frame is a keyframe
+        clip->frame = 0;
+    }
+
+    uint16_t rects = clipWord(clip);
+    bool ok = !clip->eof;
+
+    while (ok && rects--) {
+        uint16_t rx = clipWord(clip);
+        uint16_t ry = clipWord(clip);
+        uint16_t w = clipWord(clip);
+        uint16_t h = clipWord(clip);
+
+        if (!w || !h || rx + w > clip->width || ry + h > clip->height) {
+            ok = false;
+            break;
+        }
+
+        uint16_t rows = CLIP_OUTPUT_PIXELS / w; // Rows per band
+        uint16_t color = 0;
+        uint16_t run = 0, lit = 0; // Pixels left in the current op
+
+        for (uint16_t row = 0; row < h; row += rows) {
+            uint16_t bh = (h - row < rows) ? h - row : rows;
+            uint16_t *ptr = clip->out[clip->cur];
+            uint16_t *end = ptr + w * bh;
+
+            while (ptr < end && !clip->eof) {
+                if (run) { // Ops may continue into the next band
+                    uint16_t n = (run < end - ptr) ? run : end - ptr;
+                    run -= n;
+                    while (n--)
+                        *ptr++ = color;
+                } else if (lit) {
+                    lit--;
+                    *ptr++ = clipWord(clip);
+                } else {
+                    uint16_t op = clipWord(clip);
+                    if (op & 0x8000) {
+                        run = op & 0x7FFF;
+                        color = clipWord(clip);
+                    } else
+                        lit = op;
+                }
+            }
+
+            if (clip->eof)
+                break;
+
+            pushImageDMA(x + rx, y + ry + row, w, bh, clip->out[clip->cur]);
+            clip->cur ^= 1; // Fill the other buffer while this one is sent
+        }
+
+        if (clip->eof || run || lit) // Truncated, or an op runs past the rectangle
+            ok = false;
+    }
+
+    if (!ok) {
+        clip->eof = true;
+        clip->frame = clip->frames;
+        clip->loop = false;
+        return false;
+    }
+
+    clip->frame++;
+    return true;
+}
+
+/***************************************************************************************
+** Function name:           clipUpdate
+** Description:             Draw the next frame when it is due, counting missed periods
+***************************************************************************************/
+bool clipUpdate(clipPlayer *clip, int32_t x, int32_t y, uint32_t now)
+{
+    if (clip->running && (int32_t)(now - clip->due) < 0)
+        return true;
+
+    if (!clip->running || !clip->period) {
+        clip->due = now + clip->period;
+        clip->running = true;
+    } else {
+        // Stay on the frame grid, each whole period already passed had no new frame
+        uint32_t late = (now - clip->due) / clip->period;
+        clip->dropped += late;
+        clip->due += (late + 1) * clip->period;
+    }
+
+    return clipFrame(clip, x, y);
+}
+
+#endif // LOAD_CLIP
@@ -0,0 +1,52 @@
+#pragma once
+
+// Delta coded RGB565 animation clip player, see tft_clip.c
+
+#ifdef LOAD_CLIP
+
+#ifndef CLIP_INPUT_BUFFER
+#define CLIP_INPUT_BUFFER 256 // Bytes fetched per imageReadCallback call
+#endif
+
+#ifndef CLIP_OUTPUT_PIXELS
+#define CLIP_OUTPUT_PIXELS 640 // Pixels in each of the two output buffers, at least the clip width
+#endif
+
+typedef struct {
+    uint16_t width, height; // Clip size, valid after clipOpen()
+    uint16_t frames; // Frame count, the first is a keyframe
+    uint16_t period; // ms per frame
+    bool loop; // Set to start again after the last frame, clips in memory only
+    uint16_t frame; // Next frame to draw
+    uint32_t dropped; // Frame periods that passed with no new frame drawn by clipUpdate()
+
+    // Data source
+    const uint8_t *in;
+    uint32_t inLen, inPos;
+    imageReadCallback read;
+    void *ctx; // Passed to the read callback
+    bool eof;
+    uint32_t start; // Offset of the first frame in memory, to loop
+
+    bool running; // clipUpdate() has drawn a frame, due is valid
+    uint32_t due; // clipUpdate() time of the next frame
+
+    uint8_t cur; // out[] index to fill next, the other may still be sent by DMA
+    uint16_t out[2][CLIP_OUTPUT_PIXELS];
+    uint8_t buffer[CLIP_INPUT_BUFFER];
+} clipPlayer;
+
+// Read the header of a clip (made by Tools/clip565_pack.py) held in memory (data, size) or, if
+// data is NULL, fetched through read(ctx, ...). Fails if the clip is wider than CLIP_OUTPUT_PIXELS
+bool clipOpen(clipPlayer *clip, const uint8_t *data, uint32_t size, imageReadCallback read, void *ctx);
+
+// Draw the changed areas of the next frame with the clip's top left at x,y. The last area may
+// still be going out by DMA on return. Returns false after the last frame or on bad data
+bool clipFrame(clipPlayer *clip, int32_t x, int32_t y);
+
+// Call from the main loop with a free running ms clock, draws the next frame when it is due. A
+// frame drawn late is drawn at once and the periods it missed are added to dropped, frames are
+// never skipped as each is coded against the one before. Returns false once the clip has ended
+bool clipUpdate(clipPlayer *clip, int32_t x, int32_t y, uint32_t now);
+
+#endif // LOAD_CLIP
@@ -16,16 +16,30 @@
 
 #include "board.h"
 #include <math.h>
+#include <stdarg.h>
 
-#ifdef STM32F401xx
+// The ePaper framebuffer HAL replaces the SPI one, board.h includes display_hal_epd.h
+#if defined(STM32F401xx) && !defined(EPD_DRIVER)
 #include "display_hal_f4.h"
 #endif
 
 #define transpose(type, a, b) do { type _c; _c = a; a = b; b = _c; } while(0)
+
+// MADCTL MV swaps the column and page counters, used by pushImageColumns()
+#if !defined (ILI9225_DRIVER) && !defined (SSD1351_DRIVER) && !defined (RM68120_DRIVER) && !defined (EPD_DRIVER)
+#define TFT_MADCTL_MV
+#endif
+
 #define random(x) rand()
 
-static void initInternal(uint8_t tc);
-static void commandList(const uint8_t *addr); // Send a initialisation sequence to TFT stored in FLASH
+static void initRecord(void);
+static void commandList(const uint8_t *addr); // Record an initialisation sequence stored in FLASH
+static void applyRotation(uint8_t m);
+static void writeUnicode(uint16_t uniCode);
+static void setSpanWindow(int32_t x0, int32_t x1, int32_t y);
+#ifdef LOAD_AAFF
+static int16_t drawAAGlyph(uint16_t uniCode, int32_t x, int32_t y);
+#endif
 
 // Create a null default font in case some fonts not used (to prevent crash)
 static const uint8_t widtbl_null[1] = {0};
@@ -117,6 +131,10 @@ static uint8_t textfont; // Current selected font number
 static uint8_t textsize; // Current font size multiplier
 static uint8_t textdatum; // Text reference datum
 static uint8_t rotation; // Display rotation (0-3)
+static uint8_t rotationSent = 0xFF; // setRotation() value the TFT has, 0xFF until the first
+#ifdef TFT_MADCTL_MV
+static uint8_t madctl; // MADCTL value sent for it, see pushImageColumns()
+#endif
 
 static uint8_t decoderState = 0; // UTF8 decoder state        - not for user access
 static uint16_t decoderBuffer; // Unicode code-point buffer - not for user access
@@ -125,10 +143,50 @@ static uint16_t decoderBuffer; // Unicode code-point buffer - not for user acces
 static uint8_t tabcolor; // ST7735 screen protector "tab" colour (now invalid)
 static uint8_t colstart = 0, rowstart = 0; // Screen display area to CGRAM area coordinate offsets
 
+// Driver initialisation state. The driver's init code is recorded into a command table which
+// displayInitStep() sends, each delay in it ending a step
+enum { INIT_RESET, INIT_RESET_LOW, INIT_RESET_HIGH, INIT_SEND, INIT_ROTATED, INIT_DONE, INIT_FAILED };
+
+static struct {
+    uint8_t step;
+    bool running; // displayInitUpdate() has set due
+    uint32_t due;
+
+    // Recorder, ops are the commands, data bytes and delays met in one run of the init code
+    uint16_t ops;
+    uint16_t skip; // Ops sent from earlier tables, the table filled up before their end
+    uint16_t entry, entryOp; // Table offset and op number of the last command recorded
+    bool open; // A command has been recorded in this run
+    bool full; // Record again from skip once this table is sent
+    bool failed; // A command can not be recorded, too long for the table or over 126 arguments
+    bool recorded;
+    uint16_t lead; // ms of delay met before the first command recorded
+
+    // Each entry is a command, its argument count (bit 7 set if a delay follows), the
+    // arguments and the delay in ms as a little endian u16
+    uint16_t len, pos;
+    uint8_t table[INIT_TABLE_BYTES];
+} ini;
+
+#ifdef TFT_RUNTIME_DRIVER
+#include "TFT_Drivers/Runtime_Drivers.h"
+
+static const tftDriver *driverTable = builtinDrivers;
+static uint8_t driverCount = sizeof(builtinDrivers) / sizeof(tftDriver);
+static const tftDriver *drv = &builtinDrivers[sizeof(builtinDrivers) / sizeof(tftDriver) - 1];
+#endif
+
 static getColorCallback getColor = NULL; // Smooth font callback function pointer
 
 static bool locked, inTransaction, lockTransaction; // SPI transaction and mutex lock flags
 
+// SPI clock profiles, displaySpeed() values for SPI_FREQUENCY and SPI_READ_FREQUENCY
+static struct {
+    uint16_t write, read;
+    uint16_t now; // The bus is running at
+} spiClock;
+static bool dmaPending; // A pushImageDMA() transfer is running, the TFT stays selected until dmaWait()
+
 static int32_t _init_width, _init_height; // Display w/h as input, used by setRotation()
 static int32_t _width, _height; // Display w/h as modified by current rotation
 static int32_t addr_row, addr_col; // Window position - used to minimise window commands
@@ -172,6 +230,48 @@ static bool _fillbg; // Fill background flag (just for for smooth fonts at the m
 static GFXfont *gfxFont;
 #endif
 
+#ifndef PRINT_BUFFER_SIZE
+#define PRINT_BUFFER_SIZE 64 // Bytes held by the print stream before they are drawn
+#endif
+
+static char printBuf[PRINT_BUFFER_SIZE]; // Print stream, see printString()
+static uint16_t printLen;
+
+#ifdef LOAD_AAFF
+static const AAfont *aaFont; // Selected anti-aliased font, NULL if none
+#endif
+
+#ifdef LOAD_FLASH_FONT
+#ifndef FLASH_FONT_CACHE_GLYPHS
+#define FLASH_FONT_CACHE_GLYPHS 32 // Number of glyphs held in RAM
+#endif
+#ifndef FLASH_FONT_CACHE_SLOT
+#define FLASH_FONT_CACHE_SLOT 128 // Bitmap bytes per cached glyph, must fit the largest glyph
+#endif
+
+#define FLASH_FONT_HEADER 32 // Image header size, see Tools/gfxff_pack.py
+#define FLASH_FONT_RANGE   6 // first, last, glyphIndex
+#define FLASH_FONT_GLYPH  10 // bitmapOffset, width, height, xAdvance, xOffset, yOffset, pad
+
+typedef struct {
+    GFXglyph glyph; // Must be first, bitmapOffset is rebased to the cache slot
+    uint32_t flashOffset; // Bitmap offset in the font image
+    uint16_t code; // Unicode code point
+    uint16_t stamp; // Last use, for least recently used replacement
+    bool valid; // Metrics loaded
+    bool loaded; // Bitmap loaded
+} flashGlyph;
+
+static GFXfont flashFont; // RAM font header, the bitmap pointer is the cache pool
+static fontReadCallback flashRead; // Reads the font image, fontFlashRead() for the FONT_CS device
+static uint32_t flashFontAddr; // Image start address
+static uint32_t flashRanges, flashGlyphs, flashBitmaps; // Table offsets in the image
+static uint16_t flashRangeCount;
+static uint16_t flashStamp;
+static flashGlyph flashCache[FLASH_FONT_CACHE_GLYPHS];
+static uint8_t flashCacheBitmap[FLASH_FONT_CACHE_GLYPHS][FLASH_FONT_CACHE_SLOT];
+#endif
+
 #ifndef SPI_BUSY_CHECK
 #define SPI_BUSY_CHECK
 #endif
@@ -209,6 +309,331 @@ static uint16_t fastBlend(uint16_t alpha, uint16_t fgc, uint16_t bgc)
     return (rxb & 0xF81F) | (xgx & 0x07E0);
 }
 
+#ifdef LOAD_FLASH_FONT
+/***************************************************************************************
+** Function name:           flashImageRead
+** Description:             Read from a font image, deselecting the TFT around the access
+***************************************************************************************/
+// The font flash shares the SPI bus so glyph fetches slot in between display transfers
+static void flashImageRead(fontReadCallback reader, uint32_t address, void *buf, uint32_t len)
+{
+    bool selected;
+
+    dmaWait(); // A pushImageDMA() burst must not meet the NOR command on the bus
+    selected = !locked;
+
+    if (selected) {
+        SPI_BUSY_CHECK;
+        CS_H;
+    }
+
+    reader(address, (uint8_t *)buf, len);
+
+    if (selected)
+        CS_L;
+}
+
+/***************************************************************************************
+** Function name:           flashFontRead
+** Description:             Read from the selected font image
+***************************************************************************************/
+static void flashFontRead(uint32_t offset, void *buf, uint32_t len)
+{
+    flashImageRead(flashRead, flashFontAddr + offset, buf, len);
+}
+
+static uint16_t flashWord(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t flashDword(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/***************************************************************************************
+** Function name:           flashFontGlyph
+** Description:             Get glyph metrics from the cache, fetch from flash on a miss
+***************************************************************************************/
+static GFXglyph *flashFontGlyph(uint16_t uniCode)
+{
+    flashGlyph *e = flashCache;
+    flashGlyph *victim = flashCache;
+
+    flashStamp++;
+
+    for (uint32_t i = 0; i < FLASH_FONT_CACHE_GLYPHS; i++, e++) {
+        if (e->valid && e->code == uniCode) {
+            e->stamp = flashStamp;
+            return &e->glyph;
+        }
+        if (!e->valid || (uint16_t)(flashStamp - e->stamp) > (uint16_t)(flashStamp - victim->stamp))
+            victim = e;
+        if (!victim->valid)
+            break;
+    }
+
+    // Binary search the range table in flash
+    uint8_t buf[FLASH_FONT_GLYPH];
+    int32_t lo = 0;
+    int32_t hi = flashRangeCount - 1;
+    int32_t index = -1;
+
+    while (lo <= hi) {
+        int32_t mid = (lo + hi) >> 1;
+        flashFontRead(flashRanges + mid * FLASH_FONT_RANGE, buf, FLASH_FONT_RANGE);
+        if (uniCode < flashWord(buf))
+            hi = mid - 1;
+        else if (uniCode > flashWord(buf + 2))
+            lo = mid + 1;
+        else {
+            index = flashWord(buf + 4) + uniCode - flashWord(buf);
+            break;
+        }
+    }
+
+    if (index < 0)
+        return NULL;
+
+    flashFontRead(flashGlyphs + index * FLASH_FONT_GLYPH, buf, FLASH_FONT_GLYPH);
+
+    e = victim;
+    e->code = uniCode;
+    e->stamp = flashStamp;
+    e->valid = true;
+    e->loaded = false;
+    e->flashOffset = flashDword(buf);
+    e->glyph.bitmapOffset = (e - flashCache) * FLASH_FONT_CACHE_SLOT;
+    e->glyph.width = buf[4];
+    e->glyph.height = buf[5];
+    e->glyph.xAdvance = buf[6];
+    e->glyph.xOffset = (int8_t)buf[7];
+    e->glyph.yOffset = (int8_t)buf[8];
+
+    // Crop glyphs too big for a cache slot rather than overrun it
+    if (e->glyph.width && ((e->glyph.width * e->glyph.height + 7) >> 3) > FLASH_FONT_CACHE_SLOT)
+        e->glyph.height = (FLASH_FONT_CACHE_SLOT * 8) / e->glyph.width;
+
+    return &e->glyph;
+}
+
+/***************************************************************************************
+** Function name:           flashFontBitmap
+** Description:             Make sure the bitmap of a cached glyph is in RAM
+***************************************************************************************/
+static void flashFontBitmap(GFXglyph *glyph)
+{
+    flashGlyph *e = (flashGlyph *)glyph;
+
+    if (e->loaded)
+        return;
+
+    flashFontRead(flashBitmaps + e->flashOffset, flashCacheBitmap[e - flashCache], (glyph->width * glyph->height + 7) >> 3);
+    e->loaded = true;
+}
+#endif
+
+#ifdef LOAD_GFXFF
+/***************************************************************************************
+** Function name:           gfxGlyph
+** Description:             Find the glyph of a code point in the current GFX free font
+***************************************************************************************/
+// Returns NULL if the font has no glyph for uniCode. Contiguous fonts are indexed
+// directly, sparse fonts binary search their sorted range table so lookup is O(log n)
+static GFXglyph *gfxGlyph(uint16_t uniCode)
+{
+#ifdef LOAD_FLASH_FONT
+    if (gfxFont == &flashFont)
+        return flashFontGlyph(uniCode);
+#endif
+
+    if ((uniCode < pgm_read_word(&gfxFont->first)) || (uniCode > pgm_read_word(&gfxFont->last)))
+        return NULL;
+
+    GFXglyph *glyphs = (GFXglyph *)pgm_read_dword(&gfxFont->glyph);
+    GFXrange *range = (GFXrange *)pgm_read_dword(&gfxFont->range);
+
+    if (range == NULL)
+        return &glyphs[uniCode - pgm_read_word(&gfxFont->first)];
+
+    int32_t lo = 0;
+    int32_t hi = (int32_t)pgm_read_word(&gfxFont->rangeCount) - 1;
+
+    while (lo <= hi) {
+        int32_t mid = (lo + hi) >> 1;
+        if (uniCode < pgm_read_word(&range[mid].first))
+            hi = mid - 1;
+        else if (uniCode > pgm_read_word(&range[mid].last))
+            lo = mid + 1;
+        else
+            return &glyphs[pgm_read_word(&range[mid].glyphIndex) + uniCode - pgm_read_word(&range[mid].first)];
+    }
+
+    return NULL;
+}
+#endif
+
+#ifdef LOAD_AAFF
+/***************************************************************************************
+** Function name:           aaGlyph
+** Description:             Find the glyph of a code point in the current anti-aliased font
+***************************************************************************************/
+static AAglyph *aaGlyph(uint16_t uniCode)
+{
+    if ((uniCode < pgm_read_word(&aaFont->first)) || (uniCode > pgm_read_word(&aaFont->last)))
+        return NULL;
+
+    AAglyph *glyphs = (AAglyph *)pgm_read_dword(&aaFont->glyph);
+    AArange *range = (AArange *)pgm_read_dword(&aaFont->range);
+
+    if (range == NULL)
+        return &glyphs[uniCode - pgm_read_word(&aaFont->first)];
+
+    int32_t lo = 0;
+    int32_t hi = (int32_t)pgm_read_word(&aaFont->rangeCount) - 1;
+
+    while (lo <= hi) {
+        int32_t mid = (lo + hi) >> 1;
+        if (uniCode < pgm_read_word(&range[mid].first))
+            hi = mid - 1;
+        else if (uniCode > pgm_read_word(&range[mid].last))
+            lo = mid + 1;
+        else
+            return &glyphs[pgm_read_word(&range[mid].glyphIndex) + uniCode - pgm_read_word(&range[mid].first)];
+    }
+
+    return NULL;
+}
+
+// Run length decoder state for one anti-aliased glyph, see Fonts/AAFF/aafont.h
+typedef struct {
+    const uint8_t *ptr; // Next byte of the RLE stream
+    uint8_t count; // Pixels left in the current run
+    uint8_t mode; // 0 = no coverage, 1 = full coverage, 2 = literal coverage values
+    uint8_t bits; // Literal bits left in data
+    uint8_t data; // Current literal byte
+} aaDecoder;
+
+/***************************************************************************************
+** Function name:           aaDecodeRow
+** Description:             Decode the next glyph row into 8-bit alpha values
+***************************************************************************************/
+static void aaDecodeRow(aaDecoder *d, uint8_t *alpha, int32_t w, uint8_t bpp)
+{
+    uint8_t scale = (bpp == 2) ? 85 : 17; // Expand coverage to 0-255
+    uint8_t mask = (1 << bpp) - 1;
+
+    while (w > 0) {
+        if (d->count == 0) {
+            uint8_t op = pgm_read_byte(d->ptr++);
+            if (op & 0x80) {
+                d->mode = 2;
+                d->count = (op & 0x7F) + 1;
+                d->bits = 0; // Literals start on a byte boundary
+            } else {
+                d->mode = op >> 6;
+                d->count = (op & 0x3F) + 1;
+            }
+        }
+
+        if (d->mode < 2) {
+            uint8_t n = (d->count < w) ? d->count : w;
+            memset(alpha, d->mode ? 255 : 0, n);
+            alpha += n;
+            w -= n;
+            d->count -= n;
+        } else {
+            if (d->bits == 0) {
+                d->data = pgm_read_byte(d->ptr++);
+                d->bits = 8;
+            }
+            d->bits -= bpp;
+            *alpha++ = ((d->data >> d->bits) & mask) * scale;
+            w--;
+            d->count--;
+        }
+    }
+}
+#endif
+
+#ifdef SPI_18BIT_DRIVER
+// 18-bit colour panels take 3 bytes of RGB666 per pixel over SPI. RGB565 is widened into one of
+// two DMA line buffers while the other is sent, and fills repeat a colour pattern held in both
+static uint8_t rgb666[2][RGB666_PIXELS * 3];
+static int32_t rgb666Fill = -1; // Colour repeated through rgb666[], -1 if it holds pixels
+
+// Send len pixels, with nowait the last buffer may still be going out by DMA on return
+static void pushPixels666(const uint16_t *data, uint32_t len, bool nowait)
+{
+    uint8_t cur = 0;
+    bool busy = false;
+
+    rgb666Fill = -1;
+
+    while (len) {
+        uint32_t n = (len < RGB666_PIXELS) ? len : RGB666_PIXELS;
+        uint8_t *p = rgb666[cur];
+
+        len -= n;
+        while (n--) {
+            uint16_t c = *data++;
+            *p++ = (c >> 8) & 0xF8;
+            *p++ = (c >> 3) & 0xFC;
+            *p++ = c << 3;
+        }
+
+        if (busy)
+            displayTransfer16End();
+        displayTransfer8Buf(rgb666[cur], p - rgb666[cur], true);
+        busy = true;
+        cur ^= 1;
+    }
+
+    if (busy && !nowait)
+        displayTransfer16End();
+}
+
+static void pushBlock(uint16_t color, uint32_t len)
+{
+    if (len <= DISPLAY_DMA_BENEFIT_LENGTH) {
+        while (len--) {
+            tft_Write_16(color);
+        }
+        return;
+    }
+
+    if (rgb666Fill != color) { // Both buffers, as one, become the pattern
+        uint8_t *p = rgb666[0];
+        for (uint32_t i = 0; i < 2 * RGB666_PIXELS; i++) {
+            *p++ = (color >> 8) & 0xF8;
+            *p++ = (color >> 3) & 0xFC;
+            *p++ = color << 3;
+        }
+        rgb666Fill = color;
+    }
+
+    while (len) {
+        uint32_t n = (len < 2 * RGB666_PIXELS) ? len : 2 * RGB666_PIXELS;
+        displayTransfer8Buf(rgb666[0], n * 3, false);
+        len -= n;
+    }
+}
+
+// Write a set of pixels stored in memory
+static void pushPixels(const void *data_in, uint32_t len)
+{
+    const uint16_t *data = data_in;
+
+    if (len > DISPLAY_DMA_BENEFIT_LENGTH)
+        pushPixels666(data, len, false);
+    else
+        while (len--) {
+            tft_Write_16(*data);
+            data++;
+        }
+}
+#else
 static void pushBlock(uint16_t color, uint32_t len)
 {
     if (len > DISPLAY_DMA_BENEFIT_LENGTH)
@@ -225,13 +650,21 @@ static void pushPixels(const void *data_in, uint32_t len)
     else
         displayTransfer16Slow((uint16_t *)data_in, len, true);
 }
+#endif
 
-static void beginTransaction(uint32_t freq, uint8_t mode)
+// Switch the bus to a clock profile, the prescaler is only written when it changes
+static void beginTransaction(uint16_t speed)
 {
+    if (speed != spiClock.now) {
+        spiClock.now = speed;
+        displaySpeed(speed);
+    }
 }
 
+// Back to the write clock after a read
 static void endTransaction(void)
 {
+    beginTransaction(spiClock.write);
 }
 
 /***************************************************************************************
@@ -240,10 +673,12 @@ static void endTransaction(void)
 ***************************************************************************************/
 inline void begin_tft_write(void)
 {
+    dmaWait(); // A pushImageDMA() transfer must end before anything else is sent
+
     if (locked) {
         locked = false; // Flag to show SPI access now unlocked
 #if defined (SPI_HAS_TRANSACTION) && defined (SUPPORT_TRANSACTIONS)
-        beginTransaction(SPI_FREQUENCY, TFT_SPI_MODE);
+        beginTransaction(spiClock.write);
 #endif
         CS_L;
     }
@@ -274,10 +709,12 @@ inline void end_tft_write(void)
 // Reads require a lower SPI clock rate than writes
 inline void begin_tft_read(void)
 {
+    dmaWait();
+
 #if defined (SPI_HAS_TRANSACTION) && defined (SUPPORT_TRANSACTIONS)
     if (locked) {
         locked = false;
-        beginTransaction(SPI_READ_FREQUENCY, TFT_SPI_MODE);
+        beginTransaction(spiClock.read);
         CS_L;
     }
 #else
@@ -603,7 +1040,23 @@ bool clipWindow(int32_t *xs, int32_t *ys, int32_t *xe, int32_t *ye)
 ** Function name:           TFT_eSPI
 ** Description:             Constructor , we must use hardware SPI pins
 ***************************************************************************************/
-void displayInit(int16_t w, int16_t h)
+bool displayInit(int16_t w, int16_t h)
+{
+    int32_t ms;
+
+    displayInitBegin(w, h);
+
+    while ((ms = displayInitStep()) >= 0)
+        delayWaitms(ms);
+
+    return !displayInitFailed();
+}
+
+/***************************************************************************************
+** Function name:           displayInitBegin
+** Description:             Set the defaults and start the non-blocking initialisation
+***************************************************************************************/
+void displayInitBegin(int16_t w, int16_t h)
 {
     _init_width = _width = w; // Set by specific xxxxx_Defines.h file or by users sketch
     _init_height = _height = h; // Set by specific xxxxx_Defines.h file or by users sketch
@@ -671,67 +1124,134 @@ void displayInit(int16_t w, int16_t h)
 #ifdef LOAD_FONT8N
     fontsloaded |= 0x0200; // Bit 9 set
 #endif
-    initInternal(TAB_COLOUR);
+
+    memset(&ini, 0, sizeof(ini));
+    ini.step = INIT_RESET;
 }
 
 /***************************************************************************************
-** Function name:           init (tc is tab colour for ST7735 displays only)
-** Description:             Reset, then initialise the TFT display registers
+** Function name:           initCommand, initData, initDelay
+** Description:             Record the driver's init code into the command table
 ***************************************************************************************/
-static void initInternal(uint8_t tc)
+// Stop recording, the init can not be sent
+static void initFail(void)
 {
-    if (_booted) {
-        displayHardwareInit();
+    ini.failed = true;
+    ini.full = true;
+}
 
-        lockTransaction = false;
-        inTransaction = false;
-        locked = true;
+// Drop the command being recorded, it starts the next table
+static void initFull(void)
+{
+    if (!ini.entry) { // It is the first, it will not fit the next table either
+        initFail();
+        return;
+    }
 
-#if 0
+    ini.full = true;
+    ini.len = ini.entry;
+    ini.skip = ini.entryOp;
+}
 
-#if defined (TFT_CS)
-        // Set to output once again in case MISO is used for CS
-        if (TFT_CS >= 0) {
-            pinMode(TFT_CS, OUTPUT);
-            digitalWrite(TFT_CS, HIGH); // Chip select high (inactive)
-        }
-#endif
+static void initCommand(uint8_t c)
+{
+    if (ini.ops++ < ini.skip || ini.full)
+        return;
 
+    ini.entry = ini.len;
+    ini.entryOp = ini.ops - 1;
+    if (ini.len + 2 > INIT_TABLE_BYTES) {
+        initFull();
+        return;
+    }
 
-        // Set to output once again in case MISO is used for DC
-#if defined (TFT_DC)
-        if (TFT_DC >= 0) {
-            pinMode(TFT_DC, OUTPUT);
-            digitalWrite(TFT_DC, HIGH); // Data/Command high = data mode
-        }
-#endif
+    ini.open = true;
+    ini.table[ini.len++] = c;
+    ini.table[ini.len++] = 0;
+}
 
-#endif
+static void initData(uint8_t d)
+{
+    if (ini.ops++ < ini.skip || ini.full || !ini.open)
+        return;
 
-        _booted = false;
-        end_tft_write();
-    } // end of: if just _booted
+    // Drivers give the arguments of a command before any delay after it
+    uint8_t *n = &ini.table[ini.entry + 1];
+    if (*n >= 0x7F) {
+        initFail();
+        return;
+    }
 
-// Toggle RST low to reset
-#ifdef RES_PORT
-    writecommand(0x00); // Put SPI bus in known state for TFT with CS tied low
-    RES_H;
-    delayWaitms(5);
-    RES_L;
-    delayWaitms(20);
-    RES_H;
-#else
-    writecommand(TFT_SWRST); // Software reset
-#endif
+    if (ini.len + 1 > INIT_TABLE_BYTES) {
+        initFull();
+        return;
+    }
 
-    delayWaitms(150); // Wait for reset to complete
+    ini.table[ini.len++] = d;
+    (*n)++;
+}
 
-    begin_tft_write();
+static void initDelay(uint32_t ms)
+{
+    if (ini.ops++ < ini.skip || ini.full || !ms)
+        return;
+
+    if (!ini.open) { // Before the first command of this table
+        ini.lead += ms;
+        return;
+    }
+
+    uint8_t *n = &ini.table[ini.entry + 1];
+    if (*n & 0x80) { // Delays in a row add up
+        uint32_t total = ini.table[ini.len - 2] | ini.table[ini.len - 1] << 8;
+        total += ms;
+        if (total > 0xFFFF)
+            total = 0xFFFF;
+        ini.table[ini.len - 2] = total;
+        ini.table[ini.len - 1] = total >> 8;
+        return;
+    }
+
+    if (ini.len + 2 > INIT_TABLE_BYTES) {
+        initFull();
+        return;
+    }
+
+    *n |= 0x80;
+    ini.table[ini.len++] = ms;
+    ini.table[ini.len++] = ms >> 8;
+}
 
+/***************************************************************************************
+** Function name:           initRecord
+** Description:             Run the driver init code, recording from the first op not sent
+***************************************************************************************/
+// The init code is the driver's writecommand(), writedata() and delay() calls, recorded instead
+#define writecommand(c) initCommand(c)
+#define writedata(d) initData(d)
+#define delay(ms) initDelay(ms)
+#define delayWaitms(ms) initDelay(ms)
+#define begin_tft_write()
+#define end_tft_write()
+#define fillScreen(color) // Drawing is not init, it would go out on every recording pass
+
+static void initRecord(void)
+{
+    ini.ops = 0;
+    ini.len = ini.pos = 0;
+    ini.open = false;
+    ini.full = false;
+    ini.failed = false;
+    ini.recorded = true;
+
+    uint8_t tc = TAB_COLOUR;
     tc = tc; // Suppress warning
 
     // This loads the driver specific initialisation code  <<<<<<<<<<<<<<<<<<<<< ADD NEW DRIVERS TO THE LIST HERE <<<<<<<<<<<<<<<<<<<<<<<
-#if   defined (ILI9341_DRIVER) || defined(ILI9341_2_DRIVER) || defined (ILI9342_DRIVER)
+#if   defined (TFT_RUNTIME_DRIVER)
+    commandList(drv->init);
+
+#elif defined (ILI9341_DRIVER) || defined(ILI9341_2_DRIVER) || defined (ILI9342_DRIVER)
 #include "TFT_Drivers/ILI9341_Init.h"
 
 #elif defined (ST7735_DRIVER)
@@ -800,63 +1320,323 @@ static void initInternal(uint8_t tc)
 
 #ifdef TFT_INVERSION_OFF
     writecommand(TFT_INVOFF);
-#endif
-
-    end_tft_write();
-
-    setRotation(rotation);
-
-#if defined (TFT_BL) && defined (TFT_BACKLIGHT_ON)
-    if (TFT_BL >= 0) {
-        pinMode(TFT_BL, OUTPUT);
-        digitalWrite(TFT_BL, TFT_BACKLIGHT_ON);
-    }
-#else
-#if defined (TFT_BL) && defined (M5STACK)
-    // Turn on the back-light LED
-    if (TFT_BL >= 0) {
-        pinMode(TFT_BL, OUTPUT);
-        digitalWrite(TFT_BL, HIGH);
-    }
-#endif
 #endif
 }
 
+#undef writecommand
+#undef writedata
+#undef delay
+#undef delayWaitms
+#undef begin_tft_write
+#undef end_tft_write
+#undef fillScreen
+
 /***************************************************************************************
-** Function name:           setRotation
-** Description:             rotate the screen orientation m = 0-3 or 4-7 for BMP drawing
+** Function name:           initSend
+** Description:             Send table entries with CS held low, returns the delay ending them
 ***************************************************************************************/
-void setRotation(uint8_t m)
+static int32_t initSend(void)
 {
     begin_tft_write();
 
-    // This loads the driver specific rotation code  <<<<<<<<<<<<<<<<<<<<< ADD NEW DRIVERS TO THE LIST HERE <<<<<<<<<<<<<<<<<<<<<<<
-#if   defined (ILI9341_DRIVER) || defined(ILI9341_2_DRIVER) || defined (ILI9342_DRIVER)
-#include "TFT_Drivers/ILI9341_Rotation.h"
+    while (ini.pos < ini.len) {
+        uint8_t *e = &ini.table[ini.pos];
+        uint8_t n = e[1] & 0x7F;
 
-#elif defined (ST7735_DRIVER)
-#include "TFT_Drivers/ST7735_Rotation.h"
+        DC_C;
+        tft_Write_8(e[0]);
+        DC_D;
 
-#elif defined (ILI9163_DRIVER)
-#include "TFT_Drivers/ILI9163_Rotation.h"
+        if (n > DISPLAY_DMA_BENEFIT_LENGTH)
+            displayTransfer8Buf(e + 2, n, false);
+        else
+            for (uint8_t i = 0; i < n; i++)
+                tft_Write_8(e[2 + i]);
 
-#elif defined (S6D02A1_DRIVER)
-#include "TFT_Drivers/S6D02A1_Rotation.h"
+        ini.pos += 2 + n;
 
-#elif defined (ST7796_DRIVER)
-#include "TFT_Drivers/ST7796_Rotation.h"
+        if (e[1] & 0x80) {
+            int32_t ms = ini.table[ini.pos] | ini.table[ini.pos + 1] << 8;
+            ini.pos += 2;
+            end_tft_write();
+            return ms;
+        }
+    }
 
-#elif defined (ILI9486_DRIVER)
-#include "TFT_Drivers/ILI9486_Rotation.h"
+    end_tft_write();
+    return 0;
+}
 
-#elif defined (ILI9481_DRIVER)
-#include "TFT_Drivers/ILI9481_Rotation.h"
+#ifdef TFT_RUNTIME_DRIVER
+/***************************************************************************************
+** Function name:           detectDriver
+** Description:             Use the first table entry matching the controller's RDDID
+***************************************************************************************/
+static void detectDriver(void)
+{
+    uint32_t id = readDisplayID();
 
-#elif defined (ILI9488_DRIVER)
-#include "TFT_Drivers/ILI9488_Rotation.h"
+#ifdef SPI_18BIT_DRIVER
+    const uint8_t depth = 18;
+#else
+    const uint8_t depth = 16;
+#endif
 
-#elif defined (HX8357D_DRIVER)
-#include "TFT_Drivers/HX8357D_Rotation.h"
+    for (uint8_t i = 0; i < driverCount; i++) {
+        const tftDriver *d = &driverTable[i];
+        if (d->depth == depth && (id & d->rddidMask) == d->rddid) {
+            drv = d;
+            return;
+        }
+    }
+
+    drv = &driverTable[driverCount - 1];
+}
+
+/***************************************************************************************
+** Function name:           displayDriverTable
+** Description:             Replace the drivers tried by displayInit()
+***************************************************************************************/
+void displayDriverTable(const tftDriver *table, uint8_t count)
+{
+    if (!table || !count) {
+        table = builtinDrivers;
+        count = sizeof(builtinDrivers) / sizeof(tftDriver);
+    }
+
+    driverTable = table;
+    driverCount = count;
+    drv = &table[count - 1];
+}
+
+/***************************************************************************************
+** Function name:           displayDriver
+** Description:             Return the driver in use
+***************************************************************************************/
+const tftDriver *displayDriver(void)
+{
+    return drv;
+}
+#endif
+
+/***************************************************************************************
+** Function name:           displayInitStep
+** Description:             Do the next part of the initialisation, returns the ms to wait
+***************************************************************************************/
+int32_t displayInitStep(void)
+{
+    switch (ini.step) {
+    case INIT_RESET:
+        rotationSent = 0xFF; // MADCTL is lost by the reset
+        if (_booted) {
+            displayHardwareInit();
+
+            spiClock.write = displayPrescaler(SPI_FREQUENCY);
+            spiClock.read = displayPrescaler(SPI_READ_FREQUENCY);
+            spiClock.now = spiClock.write;
+            displaySpeed(spiClock.write);
+
+            lockTransaction = false;
+            inTransaction = false;
+            locked = true;
+#if 0
+#if defined (TFT_CS)
+            // Set to output once again in case MISO is used for CS
+            if (TFT_CS >= 0) {
+                pinMode(TFT_CS, OUTPUT);
+                digitalWrite(TFT_CS, HIGH); // Chip select high (inactive)
+            }
+#endif
+            // Set to output once again in case MISO is used for DC
+#if defined (TFT_DC)
+            if (TFT_DC >= 0) {
+                pinMode(TFT_DC, OUTPUT);
+                digitalWrite(TFT_DC, HIGH); // Data/Command high = data mode
+            }
+#endif
+#endif
+            _booted = false;
+            end_tft_write();
+        } // end of: if just _booted
+
+#ifdef RES_PORT
+        // Toggle RST low to reset
+        writecommand(0x00); // Put SPI bus in known state for TFT with CS tied low
+        RES_H;
+        ini.step = INIT_RESET_LOW;
+        return 5;
+#else
+        writecommand(TFT_SWRST); // Software reset
+        ini.step = INIT_SEND;
+        return 150; // Wait for reset to complete
+#endif
+
+    case INIT_RESET_LOW:
+        RES_L;
+        ini.step = INIT_RESET_HIGH;
+        return 20;
+
+    case INIT_RESET_HIGH:
+        RES_H;
+        ini.step = INIT_SEND;
+        return 150; // Wait for reset to complete
+
+    case INIT_SEND:
+#ifdef TFT_RUNTIME_DRIVER
+        if (!ini.recorded)
+            detectDriver();
+#endif
+
+        for (;;) {
+            if (ini.pos >= ini.len) {
+                if (ini.recorded && !ini.full)
+                    break;
+
+                initRecord();
+                if (ini.failed) {
+                    ini.step = INIT_FAILED;
+                    return -1;
+                }
+                if (ini.lead) {
+                    int32_t ms = ini.lead;
+                    ini.lead = 0;
+                    return ms;
+                }
+            }
+
+            int32_t ms = initSend();
+            if (ms)
+                return ms;
+        }
+
+        applyRotation(rotation);
+
+#if defined (TFT_BL) && defined (TFT_BACKLIGHT_ON)
+        if (TFT_BL >= 0) {
+            pinMode(TFT_BL, OUTPUT);
+            digitalWrite(TFT_BL, TFT_BACKLIGHT_ON);
+        }
+#else
+#if defined (TFT_BL) && defined (M5STACK)
+        // Turn on the back-light LED
+        if (TFT_BL >= 0) {
+            pinMode(TFT_BL, OUTPUT);
+            digitalWrite(TFT_BL, HIGH);
+        }
+#endif
+#endif
+
+        ini.step = INIT_ROTATED;
+        return 10;
+
+    case INIT_ROTATED:
+        ini.step = INIT_DONE;
+        break;
+    }
+
+    return -1;
+}
+
+/***************************************************************************************
+** Function name:           displayInitUpdate
+** Description:             Run the initialisation from the main loop, false once done
+***************************************************************************************/
+bool displayInitUpdate(uint32_t now)
+{
+    if (ini.step == INIT_DONE || ini.step == INIT_FAILED)
+        return false;
+
+    if (ini.running && (int32_t)(now - ini.due) < 0)
+        return true;
+
+    int32_t ms = displayInitStep();
+    if (ms < 0)
+        return false;
+
+    ini.due = now + ms;
+    ini.running = true;
+
+    return true;
+}
+
+bool displayInitFailed(void)
+{
+    return ini.step == INIT_FAILED;
+}
+
+/***************************************************************************************
+** Function name:           setRotation
+** Description:             rotate the screen orientation m = 0-3 or 4-7 for BMP drawing
+***************************************************************************************/
+void setRotation(uint8_t m)
+{
+    // The TFT is already set up, skip the MADCTL write and keep the cached window
+    if (m == rotationSent) {
+        resetViewport();
+        return;
+    }
+
+    applyRotation(m);
+    delayWaitms(10);
+}
+
+/***************************************************************************************
+** Function name:           applyRotation
+** Description:             Send the rotation, the TFT needs 10ms before drawing to it
+***************************************************************************************/
+static void applyRotation(uint8_t m)
+{
+    begin_tft_write();
+
+#ifdef TFT_MADCTL_MV
+    // Keep the MADCTL value the rotation code sends
+    uint8_t cmd = TFT_NOP;
+#define writecommand(c) writecommand(cmd = (c))
+#define writedata(d) writedata((cmd == TFT_MADCTL) ? (madctl = (d)) : (d))
+#endif
+
+    // This loads the driver specific rotation code  <<<<<<<<<<<<<<<<<<<<< ADD NEW DRIVERS TO THE LIST HERE <<<<<<<<<<<<<<<<<<<<<<<
+#if   defined (TFT_RUNTIME_DRIVER)
+    rotation = m % drv->rotations;
+
+    writecommand(TFT_MADCTL);
+#ifdef TFT_RGB_ORDER
+    writedata(drv->madctl[rotation] | TFT_MAD_COLOR_ORDER);
+#else
+    writedata(drv->madctl[rotation] | drv->colourOrder);
+#endif
+
+    _width = (rotation & 1) ? _init_height : _init_width;
+    _height = (rotation & 1) ? _init_width : _init_height;
+    colstart = drv->offset[rotation & 3][0];
+    rowstart = drv->offset[rotation & 3][1];
+
+#elif defined (ILI9341_DRIVER) || defined(ILI9341_2_DRIVER) || defined (ILI9342_DRIVER)
+#include "TFT_Drivers/ILI9341_Rotation.h"
+
+#elif defined (ST7735_DRIVER)
+#include "TFT_Drivers/ST7735_Rotation.h"
+
+#elif defined (ILI9163_DRIVER)
+#include "TFT_Drivers/ILI9163_Rotation.h"
+
+#elif defined (S6D02A1_DRIVER)
+#include "TFT_Drivers/S6D02A1_Rotation.h"
+
+#elif defined (ST7796_DRIVER)
+#include "TFT_Drivers/ST7796_Rotation.h"
+
+#elif defined (ILI9486_DRIVER)
+#include "TFT_Drivers/ILI9486_Rotation.h"
+
+#elif defined (ILI9481_DRIVER)
+#include "TFT_Drivers/ILI9481_Rotation.h"
+
+#elif defined (ILI9488_DRIVER)
+#include "TFT_Drivers/ILI9488_Rotation.h"
+
+#elif defined (HX8357D_DRIVER)
+#include "TFT_Drivers/HX8357D_Rotation.h"
 
 #elif defined (ST7789_DRIVER)
 #include "TFT_Drivers/ST7789_Rotation.h"
@@ -891,12 +1671,18 @@ void setRotation(uint8_t m)
 #elif defined (HX8357C_DRIVER)
 #include "TFT_Drivers/HX8357C_Rotation.h"
 
+#elif defined (EPD_DRIVER)
+#include "TFT_Drivers/EPD_Rotation.h"
+
 #endif
 
-    delayWaitms(10);
+#undef writecommand
+#undef writedata
 
     end_tft_write();
 
+    rotationSent = m;
+
     addr_row = 0xFFFF;
     addr_col = 0xFFFF;
 
@@ -948,8 +1734,12 @@ int32_t getOriginY(void)
 
 /***************************************************************************************
 ** Function name:           commandList, used for FLASH based lists only (e.g. ST7735)
-** Description:             Get initialisation commands from FLASH and send to TFT
+** Description:             Get initialisation commands from FLASH and record them
 ***************************************************************************************/
+#define writecommand(c) initCommand(c)
+#define writedata(d) initData(d)
+#define delayWaitms(ms) initDelay(ms)
+
 static void commandList(const uint8_t *addr)
 {
     uint8_t numCommands;
@@ -976,6 +1766,10 @@ static void commandList(const uint8_t *addr)
 
 }
 
+#undef writecommand
+#undef writedata
+#undef delayWaitms
+
 
 /***************************************************************************************
 ** Function name:           writecommand
@@ -1071,12 +1865,156 @@ uint32_t readcommand32(uint8_t cmd_function, uint8_t index)
     return reg;
 }
 
+/***************************************************************************************
+** Function name:           readDisplayID
+** Description:             Read the 24-bit RDDID (manufacturer, version and driver ID)
+***************************************************************************************/
+uint32_t readDisplayID(void)
+{
+    uint32_t id = 0;
+
+    begin_tft_read();
+
+    DC_C;
+    tft_Write_8(0x04); // RDDID
+    DC_D;
+
+#ifdef TFT_SDA_READ
+    begin_SDA_Read();
+#endif
+
+    for (uint8_t i = 0; i < 4; i++)
+        id = id << 8 | tft_Read_8();
+
+#ifdef TFT_SDA_READ
+    end_SDA_Read();
+#endif
+
+    end_tft_read();
+
+#ifdef TFT_PARALLEL_16_BIT
+    // A dummy read, then the ID a byte per read
+    return id & 0xFFFFFF;
+#else
+    // The ID follows a single dummy clock, not a dummy byte
+    return (id >> 7) & 0xFFFFFF;
+#endif
+}
+
+#define CAL_PIXELS 32 // Long enough to go by DMA
+
+/***************************************************************************************
+** Function name:           clockCheck
+** Description:             Write a test pattern at a write clock, true if it reads back
+***************************************************************************************/
+static bool clockCheck(uint16_t speed, uint32_t id)
+{
+    // Red equal to blue so the colour order does not matter, and all 16 bits toggled
+    static const uint16_t pattern[8] = { 0xFFFF, 0x0000, 0xAD55, 0x52AA, 0xF81F, 0x07E0, 0x0841, 0xF7BE };
+    uint16_t line[CAL_PIXELS], back[CAL_PIXELS];
+
+    for (uint8_t i = 0; i < CAL_PIXELS; i++)
+        line[i] = pattern[i % 8] ^ (i & 8 ? 0xFFFF : 0);
+
+    spiClock.write = speed;
+    beginTransaction(speed);
+
+    pushRect(0, 0, CAL_PIXELS, 1, line);
+    readRect(0, 0, CAL_PIXELS, 1, back);
+
+    // readRect() gives the bytes swapped
+    for (uint8_t i = 0; i < CAL_PIXELS; i++)
+        if (back[i] != (uint16_t)(line[i] << 8 | line[i] >> 8))
+            return false;
+
+    return readDisplayID() == id;
+}
+
+/***************************************************************************************
+** Function name:           displayCalibrate
+** Description:             Find the fastest write clock the TFT still takes, returns it
+***************************************************************************************/
+// Call after displayInit(), before drawing. From the fastest down, each clock writes a row
+// of pixels at 0,0 which is read back with the RDDID at the read clock. If the TFT can not
+// be read back (no MISO) at SPI_FREQUENCY that is kept
+uint32_t displayCalibrate(void)
+{
+    uint16_t configured = spiClock.write, best = configured, saved[CAL_PIXELS];
+    uint32_t id = readDisplayID();
+
+    readRect(0, 0, CAL_PIXELS, 1, saved);
+    for (uint8_t i = 0; i < CAL_PIXELS; i++) // Back to the order pushRect() sends
+        saved[i] = saved[i] << 8 | saved[i] >> 8;
+
+    if (clockCheck(configured, id)) {
+        uint32_t freq = UINT32_MAX;
+
+        while (1) {
+            uint16_t speed = displayPrescaler(freq);
+
+            freq = displayFrequency(speed);
+            if (freq <= displayFrequency(configured))
+                break;
+
+            if (clockCheck(speed, id)) {
+                best = speed;
+                break;
+            }
+            freq--;
+        }
+    }
+
+    spiClock.write = best;
+    beginTransaction(best);
+
+    pushRect(0, 0, CAL_PIXELS, 1, saved);
+
+    return displayFrequency(best);
+}
+
+#ifdef TFT_RUNTIME_DRIVER
+#define TFT_READ (drv->read)
+#else
+#define TFT_READ TFT_READ_FORMAT
+#endif
+
+/***************************************************************************************
+** Function name:           readColor
+** Description:             Read one pixel after TFT_RAMRD, format is a TFT_READ_ value
+***************************************************************************************/
+static inline uint16_t readColor(uint8_t format)
+{
+    if (format == TFT_READ_RGB565) {
+#ifdef tft_Read_16
+        return tft_Read_16();
+#else
+        uint16_t color = tft_Read_8() << 8;
+        return color | tft_Read_8();
+#endif
+    }
+
+    // Colour is in the top 6 bits of each byte as the TFT stores colours as 18 bits, or
+    // in bits 6 to 1 when the TFT adds an extra clock pulse (ST7735, ILI9488)
+    uint8_t r = tft_Read_8();
+    uint8_t g = tft_Read_8();
+    uint8_t b = tft_Read_8();
+
+    if (format == TFT_READ_RGB666_SHIFT) {
+        r <<= 1;
+        g <<= 1;
+        b <<= 1;
+    }
+
+    return color565(r, g, b);
+}
+
 /***************************************************************************************
 ** Function name:           read pixel (for SPI Interface II i.e. IM [3:0] = "1101")
 ** Description:             Read 565 pixel colours from a pixel
 ***************************************************************************************/
 uint16_t readPixel(int32_t x0, int32_t y0)
 {
+    STAT_CALL(STAT_READ_PIXEL);
     if (_vpOoB)
         return 0;
 
@@ -1108,26 +2046,7 @@ uint16_t readPixel(int32_t x0, int32_t y0)
     // Dummy read to throw away don't care value
     tft_Read_8();
 
-    //#if !defined (ILI9488_DRIVER)
-
-#if defined (ST7796_DRIVER)
-    // Read the 2 bytes
-    color = ((tft_Read_8()) << 8) | (tft_Read_8());
-#elif defined (ST7735_DRIVER)
-    // Read the 3 RGB bytes, colour is in LS 6 bits of the top 7 bits of each byte
-    // as the TFT stores colours as 18 bits
-    uint8_t r = tft_Read_8() << 1;
-    uint8_t g = tft_Read_8() << 1;
-    uint8_t b = tft_Read_8() << 1;
-    color = color565(r, g, b);
-#else
-    // Read the 3 RGB bytes, colour is actually only in the top 6 bits of each byte
-    // as the TFT stores colours as 18 bits
-    uint8_t r = tft_Read_8();
-    uint8_t g = tft_Read_8();
-    uint8_t b = tft_Read_8();
-    color = color565(r, g, b);
-#endif
+    color = readColor(TFT_READ);
 
     CS_H;
 
@@ -1157,6 +2076,7 @@ void setCallback(getColorCallback getCol)
 ***************************************************************************************/
 void readRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *data)
 {
+    STAT_CALL(STAT_READ_RECT);
     PI_CLIP ;
 
     // SPI interface
@@ -1190,36 +2110,7 @@ void readRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *data)
         uint16_t *line = data;
         while (lw--) {
 
-#if !defined (ILI9488_DRIVER)
-
-#if defined (ST7796_DRIVER)
-            // Read the 2 bytes
-            color = ((tft_Read_8()) << 8) | (tft_Read_8());
-#elif defined (ST7735_DRIVER)
-            // Read the 3 RGB bytes, colour is in LS 6 bits of the top 7 bits of each byte
-            // as the TFT stores colours as 18 bits
-            uint8_t r = tft_Read_8() << 1;
-            uint8_t g = tft_Read_8() << 1;
-            uint8_t b = tft_Read_8() << 1;
-            color = color565(r, g, b);
-#else
-            // Read the 3 RGB bytes, colour is actually only in the top 6 bits of each byte
-            // as the TFT stores colours as 18 bits
-            uint8_t r = tft_Read_8();
-            uint8_t g = tft_Read_8();
-            uint8_t b = tft_Read_8();
-            color = color565(r, g, b);
-#endif
-
-#else
-
-            // The 6 colour bits are in MS 6 bits of each byte but we do not include the extra clock pulse
-            // so we use a trick and mask the middle 6 bits of the byte, then only shift 1 place left
-            uint8_t r = (tft_Read_8() & 0x7E) << 1;
-            uint8_t g = (tft_Read_8() & 0x7E) << 1;
-            uint8_t b = (tft_Read_8() & 0x7E) << 1;
-            color = color565(r, g, b);
-#endif
+            color = readColor(TFT_READ);
 
             // Swapped colour byte order for compatibility with pushRect()
             *line++ = color << 8 | color >> 8;
@@ -1248,6 +2139,7 @@ void readRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *data)
 ***************************************************************************************/
 void pushRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *data)
 {
+    STAT_CALL(STAT_PUSH_RECT);
     bool swap = _swapBytes;
     _swapBytes = false;
     pushImage(x, y, w, h, data);
@@ -1260,6 +2152,7 @@ void pushRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *data)
 ***************************************************************************************/
 void pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data)
 {
+    STAT_CALL(STAT_PUSH_IMAGE);
     PI_CLIP;
 
     begin_tft_write();
@@ -1284,6 +2177,114 @@ void pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data)
     end_tft_write();
 }
 
+/***************************************************************************************
+** Function name:           pushImageColumns
+** Description:             plot a column major 16-bit colour image, w columns of h pixels
+***************************************************************************************/
+void pushImageColumns(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data)
+{
+    PI_CLIP;
+
+    begin_tft_write();
+    inTransaction = true;
+
+    data += dy + dx * h;
+
+#ifdef TFT_MADCTL_MV
+#ifdef TFT_RUNTIME_DRIVER
+    if (!drv->window)
+#endif
+    {
+        // With MV flipped the TFT fills the window a column at a time, so the
+        // image goes as it is instead of being transposed or sent column by column
+        writecommand(TFT_MADCTL);
+        writedata(madctl ^ TFT_MAD_MV);
+
+#if defined (SSD1963_DRIVER)
+        // MV only changes which counter steps first, the window stays
+        setWindow(x, y, x + dw - 1, y + dh - 1);
+#else
+        // MV exchanges the counters, so the window and offsets swap too
+        transpose(uint8_t, colstart, rowstart);
+        setWindow(y, x, y + dh - 1, x + dw - 1);
+        transpose(uint8_t, colstart, rowstart);
+#endif
+
+        if (dh == h)
+            pushPixels(data, dw * dh);
+        else {
+            while (dw--) {
+                pushPixels(data, dh);
+                data += h;
+            }
+        }
+
+        writecommand(TFT_MADCTL);
+        writedata(madctl);
+
+        inTransaction = lockTransaction;
+        end_tft_write();
+        return;
+    }
+#endif
+
+    // One single column window per column
+    while (dw--) {
+        setWindow(x, y, x, y + dh - 1);
+        pushPixels(data, dh);
+        data += h;
+        x++;
+    }
+
+    inTransaction = lockTransaction;
+    end_tft_write();
+}
+
+/***************************************************************************************
+** Function name:           pushImageDMA
+** Description:             start a 16-bit image transfer and return while DMA sends it
+***************************************************************************************/
+void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data)
+{
+    STAT_CALL(STAT_PUSH_IMAGE_DMA);
+    int32_t x0 = x, y0 = y;
+
+    dmaWait();
+
+    PI_CLIP;
+
+    // Cropped rows are not contiguous and a single DMA burst is limited to 0xFFFF pixels
+    if (dw != w || dw * dh > 0xFFFF || dw * dh <= DISPLAY_DMA_BENEFIT_LENGTH) {
+        pushImage(x0, y0, w, h, data);
+        return;
+    }
+
+    begin_tft_write();
+
+    setWindow(x, y, x + dw - 1, y + dh - 1);
+
+#ifdef SPI_18BIT_DRIVER
+    pushPixels666(data + dy * w, dw * dh, true); // Converted as it goes, data is free on return
+#else
+    displayTransfer16(data + dy * w, dw * dh, true, true);
+#endif
+    dmaPending = true;
+}
+
+/***************************************************************************************
+** Function name:           dmaWait
+** Description:             wait for a pushImageDMA() transfer to end and deselect the TFT
+***************************************************************************************/
+void dmaWait(void)
+{
+    if (!dmaPending)
+        return;
+
+    dmaPending = false;
+    displayTransfer16End();
+    end_tft_write();
+}
+
 /***************************************************************************************
 ** Function name:           pushImage
 ** Description:             plot 16-bit sprite or image with 1 colour being transparent
@@ -1662,16 +2663,84 @@ void pushImage8Trans(int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t *
                 }
                 px++;
             }
-            if (np) {
-                setWindow(sx, y, sx + np - 1, y);
-                pushBlock(bitmap_fg, np);
-                np = 0;
+            if (np) {
+                setWindow(sx, y, sx + np - 1, y);
+                pushBlock(bitmap_fg, np);
+                np = 0;
+            }
+            y++;
+            data += ww;
+        }
+    }
+    _swapBytes = swap; // Restore old value
+    inTransaction = lockTransaction;
+    end_tft_write();
+}
+
+/***************************************************************************************
+** Function name:           pushImagePal8
+** Description:             plot 8-bit palette indices through an RGB565 colour table
+***************************************************************************************/
+void pushImagePal8(int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t *data, const uint16_t *cmap)
+{
+    PI_CLIP;
+
+    begin_tft_write();
+    inTransaction = true;
+
+    setWindow(x, y, x + dw - 1, y + dh - 1);
+
+    // Line buffer makes plotting faster
+    uint16_t lineBuf[dw];
+
+    data += dx + dy * w;
+    while (dh--) {
+        for (int32_t i = 0; i < dw; i++)
+            lineBuf[i] = cmap[data[i]];
+
+        pushPixels(lineBuf, dw);
+        data += w;
+    }
+
+    inTransaction = lockTransaction;
+    end_tft_write();
+}
+
+/***************************************************************************************
+** Function name:           pushImagePal8Trans
+** Description:             plot 8-bit palette indices, only the runs not of index transp
+***************************************************************************************/
+void pushImagePal8Trans(int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t *data, uint8_t transp,
+                        const uint16_t *cmap)
+{
+    PI_CLIP;
+
+    begin_tft_write();
+    inTransaction = true;
+
+    // Line buffer makes plotting faster
+    uint16_t lineBuf[dw];
+
+    data += dx + dy * w;
+    while (dh--) {
+        int32_t px = 0;
+        while (px < dw) {
+            while (px < dw && data[px] == transp)
+                px++;
+            int32_t sx = px;
+            while (px < dw && data[px] != transp) {
+                lineBuf[px - sx] = cmap[data[px]];
+                px++;
+            }
+            if (px > sx) {
+                setSpanWindow(x + sx, x + px - 1, y);
+                pushPixels(lineBuf, px - sx);
             }
-            y++;
-            data += ww;
         }
+        y++;
+        data += w;
     }
-    _swapBytes = swap; // Restore old value
+
     inTransaction = lockTransaction;
     end_tft_write();
 }
@@ -1733,8 +2802,10 @@ void pushMaskedImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t
                 // Check if all bits are set (reduces shifts)
                 if (mbyte == 0xFF) {
                     setCount += bits;
-                    if (mptr >= eptr)
+                    if (mptr >= eptr) {
+                        mbyte = 0; // All bits used
                         break;
+                    }
                     mbyte = *mptr++;
                     //bits  = 8; // NR, bits always 8 here unless 1's shifted in
                     continue;
@@ -1754,8 +2825,8 @@ void pushMaskedImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t
                 xp += clearCount;
                 clearCount = 0;
                 pushImage(x + xp, y, setCount, 1, iptr + xp); // pushImage handles clipping
-                if (mptr >= eptr)
-                    break;
+                if (mptr >= eptr && !mbyte)
+                    break; // Otherwise the last byte still has set bits to the right of this run
                 xp += setCount;
             }
         } while (setCount || mptr < eptr);
@@ -1769,6 +2840,516 @@ void pushMaskedImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t
     end_tft_write();
 }
 
+/***************************************************************************************
+** Function name:           pushImageRLE
+** Description:             Render a transparent image stored as opaque spans per row
+***************************************************************************************/
+// data is width, height, then for each row the span count and for each span the
+// transparent pixels to skip, the opaque pixel count and the pixels themselves
+void pushImageRLE(int32_t x, int32_t y, const uint16_t *data)
+{
+    int32_t w = *data++;
+    int32_t h = *data++;
+
+    x += _xDatum;
+    y += _yDatum;
+
+    if (_vpOoB || x >= _vpW || y >= _vpH || x + w <= _vpX || y + h <= _vpY)
+        return;
+
+    bool clip = x < _vpX || x + w > _vpW; // Spans only need clipping at the sides
+
+    begin_tft_write();
+    inTransaction = true;
+
+    for (int32_t yp = y; yp < y + h && yp < _vpH; yp++) {
+        uint16_t spans = *data++;
+        bool visible = yp >= _vpY;
+        int32_t xp = x;
+
+        while (spans--) {
+            xp += *data++;
+            int32_t len = *data++;
+
+            if (visible) {
+                int32_t dx = 0, dw = len;
+                if (clip) {
+                    if (xp < _vpX) {
+                        dx = _vpX - xp;
+                        dw -= dx;
+                    }
+                    if (xp + len > _vpW)
+                        dw -= xp + len - _vpW;
+                }
+                if (dw > 0) {
+                    setSpanWindow(xp + dx, xp + dx + dw - 1, yp);
+                    pushPixels(data + dx, dw);
+                }
+            }
+
+            data += len;
+            xp += len;
+        }
+    }
+
+    inTransaction = lockTransaction;
+    end_tft_write();
+}
+
+/***************************************************************************************
+** Function name:           sheetRow
+** Description:             Fetch n pixel values of a sheet row from column sx
+***************************************************************************************/
+static void sheetRow(const uint8_t *row, uint8_t bpp, int32_t sx, int32_t n, uint16_t *val)
+{
+    if (bpp == 16) {
+        memcpy(val, (const uint16_t *)row + sx, n * 2);
+    } else if (bpp == 8) {
+        row += sx;
+        while (n--)
+            *val++ = *row++;
+    } else if (bpp == 4) {
+        row += sx >> 1;
+        if (sx & 1) { // Start on the low nibble
+            *val++ = *row++ & 0x0F;
+            n--;
+        }
+        while (n > 1) {
+            *val++ = *row >> 4;
+            *val++ = *row++ & 0x0F;
+            n -= 2;
+        }
+        if (n)
+            *val = *row >> 4;
+    } else {
+        row += sx >> 3;
+        uint8_t bit = 0x80 >> (sx & 7);
+        while (n--) {
+            *val++ = (*row & bit) != 0;
+            bit >>= 1;
+            if (!bit) {
+                bit = 0x80;
+                row++;
+            }
+        }
+    }
+}
+
+/***************************************************************************************
+** Function name:           sheetColor
+** Description:             Convert sheet pixel values to RGB565 colours
+***************************************************************************************/
+static void sheetColor(uint16_t *val, int32_t n, uint8_t bpp, const uint16_t *cmap)
+{
+    static const uint8_t blue[] = {0, 11, 21, 31}; // blue 2 to 5-bit colour lookup table
+
+    if (bpp == 16)
+        return;
+
+    while (n--) {
+        uint16_t v = *val;
+        if (cmap)
+            *val++ = cmap[v];
+        else if (bpp == 1)
+            *val++ = v ? bitmap_fg : bitmap_bg;
+        else // RGB332
+            *val++ = (v & 0xE0) << 8 | (v & 0xC0) << 5 | (v & 0x1C) << 6 | (v & 0x1C) << 3 | blue[v & 0x03];
+    }
+}
+
+/***************************************************************************************
+** Function name:           pushImageRect
+** Description:             plot an area of a 16, 8, 4 or 1 bit sheet with any row stride
+***************************************************************************************/
+void pushImageRect(int32_t x, int32_t y, const void *sheet, uint8_t bpp, int32_t stride,
+                   int32_t sx, int32_t sy, int32_t w, int32_t h, uint16_t *cmap, int32_t transparent)
+{
+    PI_CLIP;
+
+    if (bpp != 16 && bpp != 8 && bpp != 4 && bpp != 1)
+        return;
+
+    uint32_t rowBytes = (stride * bpp + 7) >> 3;
+    const uint8_t *row = (const uint8_t *)sheet + (sy + dy) * rowBytes;
+    sx += dx;
+
+    // As in pushImageTrans(), the little endian transparent colour is byte swapped for a big endian sheet
+    if (bpp == 16 && transparent >= 0 && !_swapBytes)
+        transparent = (transparent >> 8 | transparent << 8) & 0xFFFF;
+
+    begin_tft_write();
+    inTransaction = true;
+
+    // Line buffer makes plotting faster
+    uint16_t lineBuf[dw];
+
+    if (transparent < 0) { // One window for the whole area
+        setWindow(x, y, x + dw - 1, y + dh - 1);
+        while (dh--) {
+            if (bpp == 16) {
+                pushPixels((const uint16_t *)row + sx, dw);
+            } else {
+                sheetRow(row, bpp, sx, dw, lineBuf);
+                sheetColor(lineBuf, dw, bpp, cmap);
+                pushPixels(lineBuf, dw);
+            }
+            row += rowBytes;
+        }
+    } else {
+        while (dh--) {
+            sheetRow(row, bpp, sx, dw, lineBuf);
+
+            int32_t px = 0;
+            while (px < dw) {
+                while (px < dw && lineBuf[px] == transparent)
+                    px++;
+                int32_t start = px;
+                while (px < dw && lineBuf[px] != transparent)
+                    px++;
+                if (px > start) {
+                    sheetColor(lineBuf + start, px - start, bpp, cmap);
+                    setSpanWindow(x + start, x + px - 1, y);
+                    pushPixels(lineBuf + start, px - start);
+                }
+            }
+            y++;
+            row += rowBytes;
+        }
+    }
+
+    inTransaction = lockTransaction;
+    end_tft_write();
+}
+
+/***************************************************************************************
+** Function name:           atlasFind
+** Description:             Return the index of the named atlas entry, -1 if not found
+***************************************************************************************/
+int32_t atlasFind(const imageAtlas *atlas, const char *name)
+{
+    for (uint16_t i = 0; i < atlas->entries; i++) {
+        if (!strcmp(atlas->entry[i].name, name))
+            return i;
+    }
+
+    return -1;
+}
+
+/***************************************************************************************
+** Function name:           pushAtlas
+** Description:             plot one sub-image of a sprite sheet
+***************************************************************************************/
+void pushAtlas(int32_t x, int32_t y, const imageAtlas *atlas, int32_t index)
+{
+    if (index < 0 || index >= atlas->entries)
+        return;
+
+    const atlasEntry *e = &atlas->entry[index];
+    pushImageRect(x, y, atlas->sheet, atlas->bpp, atlas->stride, e->x, e->y, e->w, e->h, atlas->cmap, e->transparent);
+}
+
+/***************************************************************************************
+** Function name:           pushScaled
+** Description:             Scale a 16, 8, 4 or 1 bit image of sw x sh to fill w x h at x,y
+***************************************************************************************/
+// Nearest neighbour takes the source pixel under each destination pixel centre, stepping with
+// an integer DDA so sampling is exact, and sends the last line again while the source row is
+// unchanged. Bilinear steps in 16.16 fixed point, blends the four source pixels around the
+// centre and ignores transparent. Opaque areas are sent in one window
+static void pushScaled(int32_t x, int32_t y, int32_t w, int32_t h, const void *data, uint8_t bpp,
+                       int32_t sw, int32_t sh, const uint16_t *cmap, int32_t transparent, bool smooth)
+{
+    if (sw < 1 || sh < 1)
+        return;
+
+    PI_CLIP;
+
+    if (bpp != 16 && bpp != 8 && bpp != 4 && bpp != 1)
+        return;
+
+    uint32_t rowBytes = (sw * bpp + 7) >> 3;
+    int32_t k = (w % sw) ? 0 : w / sw; // Integer horizontal ratio
+
+    begin_tft_write();
+    inTransaction = true;
+
+    if (transparent < 0 || smooth)
+        setWindow(x, y, x + dw - 1, y + dh - 1);
+
+    uint16_t lineBuf[dw];
+    uint16_t srcBuf[bpp == 16 ? 1 : sw];
+
+    if (!smooth) {
+        // Source row of destination row j is (2j + 1) * sh / 2h, as a quotient and remainder
+        int32_t sy = (2 * dy + 1) * sh / (2 * h), remY = (2 * dy + 1) * sh % (2 * h);
+        int32_t last = -1;
+
+        for (; dh--; remY += 2 * (sh % h), sy += sh / h) {
+            if (remY >= 2 * h) {
+                remY -= 2 * h;
+                sy++;
+            }
+
+            // Opaque lines are sent again while the source row is the same
+            if (sy != last || transparent >= 0) {
+                const uint8_t *row = (const uint8_t *)data + sy * rowBytes;
+                const uint16_t *src = (const uint16_t *)row;
+                if (bpp != 16) {
+                    sheetRow(row, bpp, 0, sw, srcBuf);
+                    src = srcBuf;
+                }
+                last = sy;
+
+                if (k) { // Replicate each source pixel k times
+                    int32_t sx = dx / k, n = k - dx % k, i = 0;
+                    while (i < dw) {
+                        uint16_t v = src[sx++];
+                        while (n-- && i < dw)
+                            lineBuf[i++] = v;
+                        n = k;
+                    }
+                } else {
+                    int32_t sx = (2 * dx + 1) * sw / (2 * w), remX = (2 * dx + 1) * sw % (2 * w);
+                    for (int32_t i = 0; i < dw; i++) {
+                        lineBuf[i] = src[sx];
+                        sx += sw / w;
+                        remX += 2 * (sw % w);
+                        if (remX >= 2 * w) {
+                            remX -= 2 * w;
+                            sx++;
+                        }
+                    }
+                }
+
+                if (transparent < 0)
+                    sheetColor(lineBuf, dw, bpp, cmap);
+            }
+
+            if (transparent < 0) {
+                pushPixels(lineBuf, dw);
+                continue;
+            }
+
+            int32_t px = 0;
+            while (px < dw) {
+                while (px < dw && lineBuf[px] == transparent)
+                    px++;
+                int32_t start = px;
+                while (px < dw && lineBuf[px] != transparent)
+                    px++;
+                if (px > start) {
+                    sheetColor(lineBuf + start, px - start, bpp, cmap);
+                    setSpanWindow(x + start, x + px - 1, y);
+                    pushPixels(lineBuf + start, px - start);
+                }
+            }
+            y++;
+        }
+    } else {
+        uint16_t rows[2][dw]; // Source rows scaled horizontally
+        int32_t id[2] = {-1, -1}; // Source row held by each
+        uint32_t stepX = ((uint32_t)sw << 16) / w;
+        uint32_t stepY = ((uint32_t)sh << 16) / h;
+        int32_t maxX = (sw - 1) << 16, maxY = (sh - 1) << 16;
+        int32_t fy = dy * stepY + (stepY >> 1) - 0x8000;
+
+        while (dh--) {
+            int32_t cy = (fy < 0) ? 0 : (fy > maxY) ? maxY : fy;
+            int32_t y0 = cy >> 16;
+            int32_t y1 = (y0 < sh - 1) ? y0 + 1 : y0;
+            fy += stepY;
+
+            for (int32_t r = y0; r <= y1; r++) {
+                if (id[0] == r || id[1] == r)
+                    continue;
+                uint8_t b = (id[0] == y0 || id[0] == y1) ? 1 : 0; // Keep the other needed row
+                const uint8_t *row = (const uint8_t *)data + r * rowBytes;
+                const uint16_t *src = (const uint16_t *)row;
+                if (bpp != 16) {
+                    sheetRow(row, bpp, 0, sw, srcBuf);
+                    sheetColor(srcBuf, sw, bpp, cmap);
+                    src = srcBuf;
+                }
+                int32_t fx = dx * stepX + (stepX >> 1) - 0x8000;
+                for (int32_t i = 0; i < dw; i++) {
+                    int32_t cx = (fx < 0) ? 0 : (fx > maxX) ? maxX : fx;
+                    int32_t x0 = cx >> 16;
+                    int32_t x1 = (x0 < sw - 1) ? x0 + 1 : x0;
+                    rows[b][i] = fastBlend((cx >> 8) & 0xFF, src[x1], src[x0]);
+                    fx += stepX;
+                }
+                id[b] = r;
+            }
+
+            uint16_t *r0 = rows[id[0] == y0 ? 0 : 1];
+            uint16_t *r1 = rows[id[0] == y1 ? 0 : 1];
+            uint8_t a = (cy >> 8) & 0xFF;
+            for (int32_t i = 0; i < dw; i++)
+                lineBuf[i] = fastBlend(a, r1[i], r0[i]);
+            pushPixels(lineBuf, dw);
+        }
+    }
+
+    inTransaction = lockTransaction;
+    end_tft_write();
+}
+
+/***************************************************************************************
+** Function name:           pushImageScaled
+** Description:             plot a 16-bit image scaled to dw x dh
+***************************************************************************************/
+void pushImageScaled(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data, int32_t dw, int32_t dh, bool smooth)
+{
+    pushScaled(x, y, dw, dh, data, 16, w, h, NULL, -1, smooth);
+}
+
+/***************************************************************************************
+** Function name:           pushImage8Scaled
+** Description:             plot an 8, 4 or 1 bit image scaled to dw x dh
+***************************************************************************************/
+void pushImage8Scaled(int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t *data, uint8_t bpp, uint16_t *cmap,
+                      int32_t dw, int32_t dh, bool smooth)
+{
+    pushScaled(x, y, dw, dh, data, bpp, w, h, cmap, -1, smooth);
+}
+
+/***************************************************************************************
+** Function name:           rotSpan
+** Description:             Narrow x0..x1 to where c0 + x * d is in lo..hi, within a pixel
+***************************************************************************************/
+static void rotSpan(int32_t c0, int32_t d, int32_t lo, int32_t hi, int32_t *x0, int32_t *x1)
+{
+    if (!d) { // Constant along the row
+        if (c0 < lo || c0 >= hi)
+            *x1 = *x0 - 1;
+        return;
+    }
+
+    float a = (float)(lo - c0) / d;
+    float b = (float)(hi - c0) / d;
+    if (a > b) {
+        float t = a;
+        a = b;
+        b = t;
+    }
+
+    // The ends are widened by a pixel, the per pixel test settles them exactly
+    if (a - 1 > *x0)
+        *x0 = (int32_t)floorf(a) - 1;
+    if (b + 1 < *x1)
+        *x1 = (int32_t)ceilf(b) + 1;
+}
+
+/***************************************************************************************
+** Function name:           pushImageRotated
+** Description:             plot a 16-bit image rotated about its px,py put on the pivot
+***************************************************************************************/
+void pushImageRotated(int32_t w, int32_t h, const uint16_t *data, int32_t px, int32_t py, int16_t angle,
+                      int32_t transparent, int32_t bg)
+{
+    if (_vpOoB || w < 1 || h < 1)
+        return;
+
+    float rad = angle * (3.14159265359f / 180.0f);
+    float sa = sinf(rad), ca = cosf(rad);
+
+    // Screen pixel x,y samples the image at u = px + 0.5 + (x - xPivot) * cos + (y - yPivot) * sin,
+    // v = py + 0.5 - (x - xPivot) * sin + (y - yPivot) * cos, kept as 16.16 fixed point
+    int32_t c = lroundf(ca * 65536);
+    int32_t s = lroundf(sa * 65536);
+
+    // With a background the image gets a half pixel fringe blended by coverage
+    int32_t edge = (bg >= 0) ? 0x8000 : 0;
+    int32_t uMax = (w << 16) + edge;
+    int32_t vMax = (h << 16) + edge;
+
+    // Bounding box of the rotated image, in the same coordinates as the pivot
+    float ox = (w * 0.5f - px - 0.5f) * ca - (h * 0.5f - py - 0.5f) * sa;
+    float oy = (w * 0.5f - px - 0.5f) * sa + (h * 0.5f - py - 0.5f) * ca;
+    float hx = (w * fabsf(ca) + h * fabsf(sa)) * 0.5f;
+    float hy = (w * fabsf(sa) + h * fabsf(ca)) * 0.5f;
+
+    int32_t x0 = (int32_t)floorf(_xPivot + ox - hx) - 1;
+    int32_t x1 = (int32_t)ceilf(_xPivot + ox + hx) + 1;
+    int32_t y0 = (int32_t)floorf(_yPivot + oy - hy) - 1;
+    int32_t y1 = (int32_t)ceilf(_yPivot + oy + hy) + 1;
+
+    // Clip to the viewport
+    if (x0 < _vpX - _xDatum) x0 = _vpX - _xDatum;
+    if (x1 > _vpW - _xDatum - 1) x1 = _vpW - _xDatum - 1;
+    if (y0 < _vpY - _yDatum) y0 = _vpY - _yDatum;
+    if (y1 > _vpH - _yDatum - 1) y1 = _vpH - _yDatum - 1;
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    // A row is built in one buffer while the last span of the row before goes out by DMA from the other
+    uint16_t lineBuf[2][x1 - x0 + 1];
+    uint8_t cur = 0;
+
+    for (int32_t y = y0; y <= y1; y++) {
+        int32_t u0 = ((2 * px + 1) << 15) + (y - _yPivot) * s - _xPivot * c;
+        int32_t v0 = ((2 * py + 1) << 15) + (y - _yPivot) * c + _xPivot * s;
+
+        // Columns where the row crosses the image
+        int32_t xs = x0, xe = x1;
+        rotSpan(u0, c, -edge, uMax, &xs, &xe);
+        rotSpan(v0, -s, -edge, vMax, &xs, &xe);
+
+        uint16_t *line = lineBuf[cur];
+        int32_t u = u0 + xs * c;
+        int32_t v = v0 - xs * s;
+        int32_t start = xs;
+        bool sent = false;
+
+        for (int32_t x = xs; x <= xe + 1; x++, u += c, v -= s) {
+            bool draw = false;
+
+            if (x <= xe && u >= -edge && u < uMax && v >= -edge && v < vMax) {
+                int32_t i = u >> 16, j = v >> 16; // The fringe repeats the edge pixels
+                if (i < 0) i = 0;
+                if (i >= w) i = w - 1;
+                if (j < 0) j = 0;
+                if (j >= h) j = h - 1;
+
+                uint16_t color = data[j * w + i];
+
+                if (color != transparent) {
+                    draw = true;
+                    if (edge) {
+                        // Part of the pixel inside the image, across and down the image
+                        int32_t cu = u + edge, cv = v + edge;
+                        if (uMax - u < cu) cu = uMax - u;
+                        if (vMax - v < cv) cv = vMax - v;
+                        if (cu > 0x10000) cu = 0x10000;
+                        if (cv > 0x10000) cv = 0x10000;
+
+                        uint32_t alpha = ((cu >> 8) * (cv >> 8)) >> 8;
+                        if (!alpha)
+                            draw = false;
+                        else if (alpha < 256)
+                            color = fastBlend(alpha, color, bg);
+                    }
+                    line[x - x0] = color;
+                }
+            }
+
+            if (draw)
+                continue;
+            if (x > start) {
+                pushImageDMA(start, y, x - start, 1, line + start - x0);
+                sent = true;
+            }
+            start = x + 1;
+        }
+
+        // Only a buffer with a transfer running has to be left alone for the next row
+        if (sent)
+            cur ^= 1;
+    }
+
+    dmaWait(); // The line buffers are about to go
+}
+
 /***************************************************************************************
 ** Function name:           setSwapBytes
 ** Description:             Used by 16-bit pushImage() to swap byte order in colours
@@ -1809,7 +3390,15 @@ void readRectRGB(int32_t x0, int32_t y0, int32_t w, int32_t h, uint8_t *data)
     uint32_t len = w * h;
     while (len--) {
 
-#if !defined (ILI9488_DRIVER)
+#if defined (tft_Read_16)
+
+        // One RGB565 read per pixel, widened to 8 bits a colour
+        uint16_t color = tft_Read_16();
+        *data++ = (color >> 8) & 0xF8;
+        *data++ = (color >> 3) & 0xFC;
+        *data++ = color << 3;
+
+#elif !defined (ILI9488_DRIVER)
 
         // Read the 3 RGB bytes, colour is actually only in the top 6 bits of each byte
         // as the TFT stores colours as 18 bits
@@ -1845,6 +3434,7 @@ void readRectRGB(int32_t x0, int32_t y0, int32_t w, int32_t h, uint8_t *data)
 // Optimised midpoint circle algorithm
 void drawCircle(int32_t x0, int32_t y0, int32_t r, uint32_t color)
 {
+    STAT_CALL(STAT_DRAW_CIRCLE);
     if (r <= 0)
         return;
 
@@ -1981,6 +3571,7 @@ void drawCircleHelper(int32_t x0, int32_t y0, int32_t rr, uint8_t cornername, ui
 // Improved algorithm avoids repetition of lines
 void fillCircle(int32_t x0, int32_t y0, int32_t r, uint32_t color)
 {
+    STAT_CALL(STAT_FILL_CIRCLE);
     int32_t x = 0;
     int32_t dx = 1;
     int32_t dy = r + r;
@@ -2156,6 +3747,7 @@ void fillEllipse(int16_t x0, int16_t y0, int32_t rx, int32_t ry, uint16_t color)
 ***************************************************************************************/
 void fillScreen(uint32_t color)
 {
+    STAT_CALL(STAT_FILL_SCREEN);
     fillRect(0, 0, _width, _height, color);
 }
 
@@ -2166,6 +3758,7 @@ void fillScreen(uint32_t color)
 // Draw a rectangle
 void drawRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
 {
+    STAT_CALL(STAT_DRAW_RECT);
     //begin_tft_write();          // Sprite class can use this function, avoiding begin_tft_write()
     inTransaction = true;
 
@@ -2642,13 +4235,25 @@ int16_t textWidth(const char *string, uint8_t font)
 
     } else {
 
+#ifdef LOAD_AAFF
+        if (aaFont) { // Anti-aliased font, not scaled by textsize
+            while (*string) {
+                uniCode = decodeUTF8(*string++);
+                AAglyph *glyph = aaGlyph(uniCode);
+                if (glyph)
+                    str_width += pgm_read_byte(&glyph->xAdvance);
+            }
+            isDigits = false;
+            return str_width;
+        }
+#endif
+
 #ifdef LOAD_GFXFF
         if (gfxFont) { // New font
             while (*string) {
                 uniCode = decodeUTF8(*string++);
-                if ((uniCode >= pgm_read_word(&gfxFont->first)) && (uniCode <= pgm_read_word(&gfxFont->last))) {
-                    uniCode -= pgm_read_word(&gfxFont->first);
-                    GFXglyph *glyph = &(((GFXglyph *)pgm_read_dword(&gfxFont->glyph))[uniCode]);
+                GFXglyph *glyph = gfxGlyph(uniCode);
+                if (glyph) {
                     // If this is not the  last character or is a digit then use xAdvance
                     if (*string || isDigits)
                         str_width += pgm_read_byte(&glyph->xAdvance);
@@ -2688,6 +4293,10 @@ uint16_t fontsLoaded(void)
 ***************************************************************************************/
 int16_t fontHeight(int16_t font)
 {
+#ifdef LOAD_AAFF
+    if (font == 1 && aaFont)
+        return pgm_read_byte(&aaFont->yAdvance);
+#endif
 #ifdef LOAD_GFXFF
     if (font == 1) {
         if (gfxFont) { // New font
@@ -2704,6 +4313,7 @@ int16_t fontHeight(int16_t font)
 ***************************************************************************************/
 void drawChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uint32_t bg, uint8_t size)
 {
+    STAT_CALL(STAT_DRAW_CHAR);
     if (_vpOoB)
         return;
 
@@ -2755,35 +4365,19 @@ void drawChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uint32_t bg, uin
             }
 
             end_tft_write();
-        } else {
-            //begin_tft_write();          // Sprite class can use this function, avoiding begin_tft_write()
-            inTransaction = true;
-
-            for (int8_t i = 0; i < 6; i++) {
-                uint8_t line;
-                if (i == 5)
-                    line = 0x0;
-                else
-                    line = pgm_read_byte(font + (c * 5) + i);
-
-                if (size == 1 && !fillbg) { // default size
-                    for (int8_t j = 0; j < 8; j++) {
-                        if (line & 0x1)
-                            drawPixel(x + i, y + j, color);
-                        line >>= 1;
-                    }
-                } else { // big size or clipped
-                    for (int8_t j = 0; j < 8; j++) {
-                        if (line & 0x1)
-                            fillRect(x + (i * size), y + (j * size), size, size, color);
-                        else if (fillbg)
-                            fillRect(x + i * size, y + j * size, size, size, bg);
-                        line >>= 1;
-                    }
+        } else { // Scaled, clipped or without background
+            uint8_t glyph[8] = {0}; // Rows of the 6 x 8 cell, leftmost pixel in the top bit
+            uint16_t cmap[2] = {bg, color};
+
+            for (int8_t i = 0; i < 5; i++) {
+                uint8_t line = pgm_read_byte(font + (c * 5) + i);
+                for (int8_t j = 0; j < 8; j++) {
+                    if (line & (1 << j))
+                        glyph[j] |= 0x80 >> i;
                 }
             }
-            inTransaction = lockTransaction;
-            end_tft_write(); // Does nothing if Sprite class uses this function
+
+            pushScaled(x, y, 6 * size, 8 * size, glyph, 1, 6, 8, cmap, fillbg ? -1 : 0, false);
         }
 
 #ifdef LOAD_GFXFF
@@ -2793,15 +4387,19 @@ void drawChar(int32_t x, int32_t y, uint16_t c, uint32_t color, uint32_t bg, uin
 
 #ifdef LOAD_GFXFF
         // Filter out bad characters not present in font
-        if ((c >= pgm_read_word(&gfxFont->first)) && (c <= pgm_read_word(&gfxFont->last))) {
+        GFXglyph *glyph = gfxGlyph(c);
+        if (glyph) {
             //begin_tft_write();          // Sprite class can use this function, avoiding begin_tft_write()
             inTransaction = true;
 
-            c -= pgm_read_word(&gfxFont->first);
-            GFXglyph *glyph = &(((GFXglyph *)pgm_read_dword(&gfxFont->glyph))[c]);
             uint8_t *bitmap = (uint8_t *)pgm_read_dword(&gfxFont->bitmap);
 
-            uint32_t bo = pgm_read_word(&glyph->bitmapOffset);
+#ifdef LOAD_FLASH_FONT
+            if (gfxFont == &flashFont)
+                flashFontBitmap(glyph);
+#endif
+
+            uint32_t bo = pgm_read_dword(&glyph->bitmapOffset);
             uint8_t w = pgm_read_byte(&glyph->width),
                     h = pgm_read_byte(&glyph->height);
             //xa = pgm_read_byte(&glyph->xAdvance);
@@ -2890,10 +4488,18 @@ void setAddrWindow(int32_t x0, int32_t y0, int32_t w, int32_t h)
 // Chip select stays low, call begin_tft_write first. Use setAddrWindow() from sketches
 void setWindow(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
 {
+    STAT_CALL(STAT_SET_WINDOW);
     //begin_tft_write(); // Must be called before setWindow
     addr_row = 0xFFFF;
     addr_col = 0xFFFF;
 
+#ifdef TFT_RUNTIME_DRIVER
+    if (drv->window) {
+        drv->window(x0 + colstart, y0 + rowstart, x1 + colstart, y1 + rowstart);
+        return;
+    }
+#endif
+
 #if defined (ILI9225_DRIVER)
     if (rotation & 0x01) {
         transpose(int32_t, x0, y0);
@@ -2959,24 +4565,73 @@ void setWindow(int32_t x0, int32_t y0, int32_t x1, int32_t y1)
 #ifdef CGRAM_OFFSET
     x0 += colstart;
     x1 += colstart;
-    y0 += rowstart;
-    y1 += rowstart;
+    y0 += rowstart;
+    y1 += rowstart;
+#endif
+
+    SPI_BUSY_CHECK;
+    DC_C;
+    tft_Write_8(TFT_CASET);
+    DC_D;
+    tft_Write_32C(x0, x1);
+    DC_C;
+    tft_Write_8(TFT_PASET);
+    DC_D;
+    tft_Write_32C(y0, y1);
+    DC_C;
+    tft_Write_8(TFT_RAMWR);
+    DC_D;
+#endif
+    //end_tft_write(); // Must be called after setWindow
+}
+
+/***************************************************************************************
+** Function name:           setSpanWindow
+** Description:             define a one row window, the row is only sent when it changes
+***************************************************************************************/
+static void setSpanWindow(int32_t x0, int32_t x1, int32_t y)
+{
+#if defined (ILI9225_DRIVER) || defined (SSD1351_DRIVER) || defined (SSD1963_DRIVER) || defined (MULTI_TFT_SUPPORT) || defined (GC9A01_DRIVER)
+    setWindow(x0, y, x1, y);
+#else
+#ifdef TFT_RUNTIME_DRIVER
+    if (drv->window) {
+        setWindow(x0, y, x1, y);
+        return;
+    }
+#endif
+
+#ifdef CGRAM_OFFSET
+    int32_t yc = y + rowstart;
+#else
+    int32_t yc = y;
+#endif
+
+    // Same row limits as drawPixel() leaves in addr_row
+    if (addr_row != yc) {
+        setWindow(x0, y, x1, y);
+        addr_row = yc;
+        return;
+    }
+
+    STAT_CALL(STAT_SET_WINDOW); // Counted as a setWindow() too
+
+#ifdef CGRAM_OFFSET
+    x0 += colstart;
+    x1 += colstart;
 #endif
 
+    addr_col = 0xFFFF;
+
     SPI_BUSY_CHECK;
     DC_C;
     tft_Write_8(TFT_CASET);
     DC_D;
     tft_Write_32C(x0, x1);
     DC_C;
-    tft_Write_8(TFT_PASET);
-    DC_D;
-    tft_Write_32C(y0, y1);
-    DC_C;
     tft_Write_8(TFT_RAMWR);
     DC_D;
 #endif
-    //end_tft_write(); // Must be called after setWindow
 }
 
 /***************************************************************************************
@@ -3034,6 +4689,7 @@ void readAddrWindow(int32_t xs, int32_t ys, int32_t w, int32_t h)
 ***************************************************************************************/
 void drawPixel(int32_t x, int32_t y, uint32_t color)
 {
+    STAT_CALL(STAT_DRAW_PIXEL);
     if (_vpOoB)
         return;
 
@@ -3055,6 +4711,18 @@ void drawPixel(int32_t x, int32_t y, uint32_t color)
 #endif
 
     begin_tft_write();
+    STAT_ADD(calls[STAT_SET_WINDOW], 1); // The window below, its time stays with drawPixel()
+
+#ifdef TFT_RUNTIME_DRIVER
+    if (drv->window) {
+        addr_row = 0xFFFF;
+        addr_col = 0xFFFF;
+        drv->window(x, y, x, y);
+        tft_Write_16(color);
+        end_tft_write();
+        return;
+    }
+#endif
 
 #if defined (ILI9225_DRIVER)
     if (rotation & 0x01) {
@@ -3259,6 +4927,7 @@ void pushColorsSwap(uint16_t *data, uint32_t len, bool swap)
 // an efficient FastH/V Line draw routine for line segments of 2 pixels or more
 void drawLine(int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint32_t color)
 {
+    STAT_CALL(STAT_DRAW_LINE);
     if (_vpOoB)
         return;
 
@@ -4043,6 +5712,7 @@ inline float wedgeLineDistance(float xpax, float ypay, float bax, float bay, flo
 ***************************************************************************************/
 void drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color)
 {
+    STAT_CALL(STAT_FAST_VLINE);
     if (_vpOoB)
         return;
 
@@ -4080,6 +5750,7 @@ void drawFastVLine(int32_t x, int32_t y, int32_t h, uint32_t color)
 ***************************************************************************************/
 void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color)
 {
+    STAT_CALL(STAT_FAST_HLINE);
     if (_vpOoB)
         return;
 
@@ -4117,6 +5788,7 @@ void drawFastHLine(int32_t x, int32_t y, int32_t w, uint32_t color)
 ***************************************************************************************/
 void fillRect(int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
 {
+    STAT_CALL(STAT_FILL_RECT);
     if (_vpOoB)
         return;
 
@@ -4525,103 +6197,577 @@ size_t write(uint8_t utf8)
     if (utf8 == '\r')
         return 1;
 
-    if (uniCode == '\n')
+    writeUnicode(uniCode);
+
+    return 1;
+}
+
+/***************************************************************************************
+** Function name:           writeUnicode
+** Description:             draw a decoded character at the cursor and advance it
+***************************************************************************************/
+static void writeUnicode(uint16_t uniCode)
+{
+    bool newline = (uniCode == '\n');
+
+    if (newline)
         uniCode += 22; // Make it a valid space character to stop errors
 
-    uint16_t cwidth = 0;
-    uint16_t cheight = 0;
+    uint16_t cwidth = 0;
+    uint16_t cheight = 0;
+
+#ifdef LOAD_AAFF
+    if (aaFont && textfont == 1) {
+        if (newline) {
+            cursor_x = 0;
+            cursor_y += pgm_read_byte(&aaFont->yAdvance);
+        } else {
+            AAglyph *glyph = aaGlyph(uniCode);
+            if (!glyph)
+                return;
+            if (textwrapX && (cursor_x + pgm_read_byte(&glyph->xAdvance) > width())) {
+                cursor_x = 0;
+                cursor_y += pgm_read_byte(&aaFont->yAdvance);
+            }
+            if (textwrapY && (cursor_y >= (int32_t) height()))
+                cursor_y = 0;
+            cursor_x += drawAAGlyph(uniCode, cursor_x, cursor_y);
+        }
+        return;
+    }
+#endif
+
+#ifdef LOAD_GFXFF
+    if (!gfxFont) {
+#endif
+
+#ifdef LOAD_FONT2
+        if (textfont == 2) {
+            if (uniCode < 32 || uniCode > 127)
+                return;
+
+            cwidth = pgm_read_byte(widtbl_f16 + uniCode - 32);
+            cheight = chr_hgt_f16;
+            // Font 2 is rendered in whole byte widths so we must allow for this
+            cwidth = (cwidth + 6) / 8; // Width in whole bytes for font 2, should be + 7 but must allow for font width change
+            cwidth = cwidth * 8; // Width converted back to pixels
+        }
+#ifdef LOAD_RLE
+        else
+#endif
+#endif
+
+#ifdef LOAD_RLE
+        {
+            if ((textfont > 2) && (textfont < 9)) {
+                if (uniCode < 32 || uniCode > 127)
+                    return;
+                // Uses the fontinfo struct array to avoid lots of 'if' or 'switch' statements
+                cwidth = pgm_read_byte((uint8_t *)pgm_read_dword(&(fontdata[textfont].widthtbl)) + uniCode - 32);
+                cheight = pgm_read_byte(&fontdata[textfont].height);
+            }
+        }
+#endif
+
+#ifdef LOAD_GLCD
+        if (textfont == 1) {
+            cwidth = 6;
+            cheight = 8;
+        }
+#else
+        if (textfont == 1)
+            return;
+#endif
+
+        cheight = cheight * textsize;
+
+        if (newline) {
+            cursor_y += cheight;
+            cursor_x = 0;
+        } else {
+            if (textwrapX && (cursor_x + cwidth * textsize > width())) {
+                cursor_y += cheight;
+                cursor_x = 0;
+            }
+            if (textwrapY && (cursor_y >= (int32_t) height()))
+                cursor_y = 0;
+            cursor_x += drawCharUnicode(uniCode, cursor_x, cursor_y, textfont);
+        }
+
+#ifdef LOAD_GFXFF
+    } // Custom GFX font
+    else {
+        if (newline) {
+            cursor_x = 0;
+            cursor_y += (int16_t)textsize * (uint8_t)pgm_read_byte(&gfxFont->yAdvance);
+        } else {
+            GFXglyph *glyph = gfxGlyph(uniCode);
+            if (!glyph)
+                return;
+
+            uint8_t w = pgm_read_byte(&glyph->width),
+                    h = pgm_read_byte(&glyph->height);
+            if ((w > 0) && (h > 0)) { // Is there an associated bitmap?
+                int16_t xo = (int8_t)pgm_read_byte(&glyph->xOffset);
+                if (textwrapX && ((cursor_x + textsize * (xo + w)) > width())) {
+                    // Drawing character would go off right edge; wrap to new line
+                    cursor_x = 0;
+                    cursor_y += (int16_t)textsize * (uint8_t)pgm_read_byte(&gfxFont->yAdvance);
+                }
+                if (textwrapY && (cursor_y >= (int32_t) height()))
+                    cursor_y = 0;
+                drawChar(cursor_x, cursor_y, uniCode, textcolor, textbgcolor, textsize);
+            }
+            cursor_x += pgm_read_byte(&glyph->xAdvance) * (int16_t)textsize;
+        }
+    }
+#endif // LOAD_GFXFF
+}
+
+#ifdef LOAD_GLCD
+/***************************************************************************************
+** Function name:           printGlyphRun
+** Description:             draw GLCD characters at the cursor as one window and advance it
+***************************************************************************************/
+static void printGlyphRun(const uint16_t *codes, uint16_t n)
+{
+    if (!n)
+        return;
+
+    if (textwrapY && (cursor_y >= (int32_t) height()))
+        cursor_y = 0;
+
+    int32_t w = 6 * n;
+    int32_t xd = cursor_x + _xDatum;
+    int32_t yd = cursor_y + _yDatum;
+
+    if (xd < _vpX || yd < _vpY || xd + w > _vpW || yd + 8 > _vpH) {
+        // Partly outside the viewport, drawChar() clips each character
+        for (uint16_t k = 0; k < n; k++)
+            cursor_x += drawCharUnicode(codes[k], cursor_x, cursor_y, 1);
+        return;
+    }
+
+    uint16_t lineBuf[w];
+
+    setWindow(xd, yd, xd + w - 1, yd + 7);
+
+    for (uint8_t j = 0; j < 8; j++) {
+        uint16_t *ptr = lineBuf;
+        for (uint16_t k = 0; k < n; k++) {
+            uint16_t c = codes[k];
+            if (!_cp437 && c > 175)
+                c++;
+            for (uint8_t i = 0; i < 5; i++)
+                *ptr++ = ((pgm_read_byte(font + (c * 5) + i) >> j) & 1) ? textcolor : textbgcolor;
+            *ptr++ = textbgcolor;
+        }
+        pushPixels(lineBuf, w);
+    }
+
+    cursor_x += w;
+}
+#endif
+
+/***************************************************************************************
+** Function name:           printFlush
+** Description:             draw the buffered print stream, a line per transaction
+***************************************************************************************/
+void printFlush(void)
+{
+    if (!printLen)
+        return;
+
+#ifdef LOAD_GLCD
+    // Background filled size 1 GLCD text is drawn as runs of characters sharing one window
+    bool merge = (textfont == 1) && (textsize == 1) && (textcolor != textbgcolor);
+#ifdef LOAD_GFXFF
+    merge = merge && !gfxFont;
+#endif
+#ifdef LOAD_AAFF
+    merge = merge && !aaFont;
+#endif
+    uint16_t codes[PRINT_BUFFER_SIZE];
+    uint16_t n = 0;
+#endif
+
+    begin_tft_write();
+    inTransaction = true;
+
+    for (uint16_t i = 0; i < printLen && !_vpOoB; i++) {
+        uint8_t utf8 = printBuf[i];
+        uint16_t uniCode = decodeUTF8(utf8);
+
+        if (!uniCode || utf8 == '\r')
+            continue;
+
+#ifdef LOAD_GLCD
+        if (merge && uniCode != '\n' && uniCode < 256) {
+            if (textwrapX && (cursor_x + 6 * (n + 1) > width())) {
+                printGlyphRun(codes, n);
+                n = 0;
+                cursor_x = 0;
+                cursor_y += 8;
+            }
+            codes[n++] = uniCode;
+            continue;
+        }
+
+        printGlyphRun(codes, n);
+        n = 0;
+#endif
+        writeUnicode(uniCode);
+    }
+
+#ifdef LOAD_GLCD
+    if (!_vpOoB)
+        printGlyphRun(codes, n);
+#endif
+
+    inTransaction = lockTransaction;
+    end_tft_write();
+
+    printLen = 0;
+}
+
+/***************************************************************************************
+** Function name:           printChar
+** Description:             add a byte to the print stream, drawn at a newline or when full
+***************************************************************************************/
+static void printChar(char c)
+{
+    printBuf[printLen++] = c;
+
+    if ((c == '\n') || (printLen >= PRINT_BUFFER_SIZE))
+        printFlush();
+}
+
+/***************************************************************************************
+** Function name:           printString
+** Description:             draw a UTF-8 string through the buffered print stream
+***************************************************************************************/
+size_t printString(const char *string)
+{
+    size_t n = 0;
+
+    while (string[n])
+        printChar(string[n++]);
+
+    printFlush(); // Nothing is left to be drawn after a later cursor, colour or font change
+    return n;
+}
+
+/***************************************************************************************
+** Function name:           printInteger
+** Description:             add a padded unsigned number to the print stream
+***************************************************************************************/
+static int printInteger(uint64_t value, uint8_t base, bool upper, bool negative, int width, char pad, bool left)
+{
+    char digits[22];
+    int n = 0;
+    int count = 0;
+
+    do {
+        uint8_t d;
+        if (value >> 32) { // 64-bit division is a library call, only %ll values need it
+            d = value % base;
+            value /= base;
+        } else {
+            uint32_t v = value;
+            d = v % base;
+            value = v / base;
+        }
+        digits[n++] = (d < 10) ? '0' + d : (upper ? 'A' : 'a') + d - 10;
+    } while (value);
+
+    width -= n + negative;
+
+    if (negative && pad == '0') {
+        printChar('-');
+        count++;
+    }
+    while (!left && width-- > 0) {
+        printChar(pad);
+        count++;
+    }
+    if (negative && pad != '0') {
+        printChar('-');
+        count++;
+    }
+    while (n) {
+        printChar(digits[--n]);
+        count++;
+    }
+    while (left && width-- > 0) {
+        printChar(' ');
+        count++;
+    }
+
+    return count;
+}
+
+/***************************************************************************************
+** Function name:           printPadded
+** Description:             add a string of len characters to the print stream, space padded
+***************************************************************************************/
+static int printPadded(const char *str, int len, int width, bool left)
+{
+    int count = len;
+
+    for (int i = len; !left && i < width; i++) {
+        printChar(' ');
+        count++;
+    }
+    for (int i = 0; i < len; i++)
+        printChar(str[i]);
+    for (int i = len; left && i < width; i++) {
+        printChar(' ');
+        count++;
+    }
+
+    return count;
+}
+
+/***************************************************************************************
+** Function name:           printFormat
+** Description:             printf() style output to the print stream, no heap is used
+***************************************************************************************/
+int printFormat(const char *format, ...)
+{
+    va_list args;
+    int count = 0;
+
+    va_start(args, format);
+
+    while (*format) {
+        if (*format != '%') {
+            printChar(*format++);
+            count++;
+            continue;
+        }
+        format++;
+
+        bool left = false;
+        char pad = ' ';
+        int width = 0;
+        int precision = -1;
+
+        for (;; format++) {
+            if (*format == '-')
+                left = true;
+            else if (*format == '0')
+                pad = '0';
+            else
+                break;
+        }
+        if (left)
+            pad = ' ';
+
+        if (*format == '*') {
+            width = va_arg(args, int);
+            format++;
+        }
+        while (*format >= '0' && *format <= '9')
+            width = width * 10 + *format++ - '0';
+
+        if (*format == '.') {
+            precision = 0;
+            format++;
+            while (*format >= '0' && *format <= '9')
+                precision = precision * 10 + *format++ - '0';
+        }
+
+        int longs = 0;
+        while (*format == 'l' || *format == 'h' || *format == 'z')
+            if (*format++ == 'l')
+                longs++; // int, long and size_t are all 32 bits on this target, long long is 64
+        bool wide = longs > 1;
+
+        char spec = *format;
+        if (spec)
+            format++;
+
+        switch (spec) {
+        case 'd':
+        case 'i': {
+            long long value = wide ? va_arg(args, long long) : va_arg(args, int);
+            uint64_t mag = (value < 0) ? 0 - (uint64_t)value : (uint64_t)value;
+            count += printInteger(mag, 10, false, value < 0, width, pad, left);
+            break;
+        }
+        case 'u':
+            count += printInteger(wide ? va_arg(args, unsigned long long) : va_arg(args, unsigned int), 10, false,
+                                  false, width, pad, left);
+            break;
+        case 'x':
+        case 'X':
+            count += printInteger(wide ? va_arg(args, unsigned long long) : va_arg(args, unsigned int), 16,
+                                  spec == 'X', false, width, pad, left);
+            break;
+        case 'p':
+            count += printInteger((uintptr_t)va_arg(args, void *), 16, false, false, 8, '0', false);
+            break;
+        case 'f': {
+            double value = va_arg(args, double);
+            if (precision < 0)
+                precision = 6;
+            if (precision > 9)
+                precision = 9;
+            if (isnan(value)) {
+                count += printPadded("nan", 3, width, left);
+                break;
+            }
+            bool negative = value < 0;
+            if (negative)
+                value = -value;
+            if (isinf(value)) {
+                count += printPadded(negative ? "-inf" : "inf", negative ? 4 : 3, width, left);
+                break;
+            }
+            if (!(value < 4294967295.0))
+                value = 4294967295.0; // Integer part is 32 bits
+            uint32_t scale = 1;
+            for (int i = 0; i < precision; i++)
+                scale *= 10;
+            uint64_t fixed = (uint64_t)(value * scale + 0.5);
+            uint32_t whole = fixed / scale;
+            uint32_t frac = fixed % scale;
+            int start = count;
+            int fracWidth = precision ? precision + 1 : 0;
+            count += printInteger(whole, 10, false, negative, left ? 0 : width - fracWidth, pad, false);
+            if (precision) {
+                printChar('.');
+                count++;
+                count += printInteger(frac, 10, false, false, precision, '0', false);
+            }
+            while (left && count - start < width) {
+                printChar(' ');
+                count++;
+            }
+            break;
+        }
+        case 'c':
+            printChar((char)va_arg(args, int));
+            count++;
+            break;
+        case 's': {
+            const char *str = va_arg(args, const char *);
+            int len = 0;
+            if (!str)
+                str = "(null)";
+            while (str[len] && (precision < 0 || len < precision))
+                len++;
+            count += printPadded(str, len, width, left);
+            break;
+        }
+        case '%':
+            printChar('%');
+            count++;
+            break;
+        default:
+            break;
+        }
+    }
+
+    va_end(args);
+
+    printFlush();
+    return count;
+}
+
+
+
+#ifdef LOAD_AAFF
+/***************************************************************************************
+** Function name:           drawAAGlyph
+** Description:             Draw an anti-aliased glyph with top of line at x,y
+***************************************************************************************/
+static int16_t drawAAGlyph(uint16_t uniCode, int32_t x, int32_t y)
+{
+    AAglyph *glyph = aaGlyph(uniCode);
 
-#ifdef LOAD_GFXFF
-    if (!gfxFont) {
-#endif
+    if (!glyph)
+        return 0;
 
-#ifdef LOAD_FONT2
-        if (textfont == 2) {
-            if (uniCode < 32 || uniCode > 127)
-                return 1;
+    uint8_t w = pgm_read_byte(&glyph->width),
+            h = pgm_read_byte(&glyph->height),
+            xa = pgm_read_byte(&glyph->xAdvance);
+    int8_t xo = pgm_read_byte(&glyph->xOffset),
+           yo = pgm_read_byte(&glyph->yOffset);
+    uint8_t bpp = pgm_read_byte(&aaFont->bpp);
 
-            cwidth = pgm_read_byte(widtbl_f16 + uniCode - 32);
-            cheight = chr_hgt_f16;
-            // Font 2 is rendered in whole byte widths so we must allow for this
-            cwidth = (cwidth + 6) / 8; // Width in whole bytes for font 2, should be + 7 but must allow for font width change
-            cwidth = cwidth * 8; // Width converted back to pixels
-        }
-#ifdef LOAD_RLE
-        else
-#endif
-#endif
+    aaDecoder dec = { (uint8_t *)pgm_read_dword(&aaFont->data) + (uint32_t)pgm_read_dword(&glyph->dataOffset), 0, 0, 0, 0 };
 
-#ifdef LOAD_RLE
-        {
-            if ((textfont > 2) && (textfont < 9)) {
-                if (uniCode < 32 || uniCode > 127)
-                    return 1;
-                // Uses the fontinfo struct array to avoid lots of 'if' or 'switch' statements
-                cwidth = pgm_read_byte((uint8_t *)pgm_read_dword(&(fontdata[textfont].widthtbl)) + uniCode - 32);
-                cheight = pgm_read_byte(&fontdata[textfont].height);
-            }
-        }
-#endif
+    int32_t gx = x + xo; // Glyph bitmap top left
+    int32_t gy = y + pgm_read_byte(&aaFont->ascent) + yo;
+    uint8_t alpha[w ? w : 1];
 
-#ifdef LOAD_GLCD
-        if (textfont == 1) {
-            cwidth = 6;
-            cheight = 8;
-        }
-#else
-        if (textfont == 1)
-            return 1;
-#endif
+    begin_tft_write();
+    inTransaction = true;
 
-        cheight = cheight * textsize;
+    if (textcolor != textbgcolor) {
+        // Fill the character cell, widened to include any glyph overhang, one row at a time
+        int32_t cx = (gx < x) ? gx : x;
+        int32_t cw = ((gx + w > x + xa) ? gx + w : x + xa) - cx;
+        int32_t ch = pgm_read_byte(&aaFont->yAdvance);
+        uint16_t lineBuf[cw];
 
-        if (utf8 == '\n') {
-            cursor_y += cheight;
-            cursor_x = 0;
-        } else {
-            if (textwrapX && (cursor_x + cwidth * textsize > width())) {
-                cursor_y += cheight;
-                cursor_x = 0;
+        int32_t xd = cx + _xDatum;
+        int32_t yd = y + _yDatum;
+        bool clip = xd < _vpX || yd < _vpY || xd + cw > _vpW || yd + ch > _vpH;
+
+        if (!clip)
+            setWindow(xd, yd, xd + cw - 1, yd + ch - 1);
+
+        for (int32_t row = 0; row < ch; row++) {
+            int32_t gr = y + row - gy;
+            for (int32_t i = 0; i < cw; i++)
+                lineBuf[i] = textbgcolor;
+
+            if (gr >= 0 && gr < h) {
+                uint16_t *linePtr = lineBuf + gx - cx;
+                aaDecodeRow(&dec, alpha, w, bpp);
+                for (int32_t i = 0; i < w; i++) {
+                    if (alpha[i] == 255)
+                        linePtr[i] = textcolor;
+                    else if (alpha[i])
+                        linePtr[i] = fastBlend(alpha[i], textcolor, textbgcolor);
+                }
             }
-            if (textwrapY && (cursor_y >= (int32_t) height()))
-                cursor_y = 0;
-            cursor_x += drawCharUnicode(uniCode, cursor_x, cursor_y, textfont);
-        }
-
-#ifdef LOAD_GFXFF
-    } // Custom GFX font
-    else {
-        if (utf8 == '\n') {
-            cursor_x = 0;
-            cursor_y += (int16_t)textsize * (uint8_t)pgm_read_byte(&gfxFont->yAdvance);
-        } else {
-            if (uniCode > pgm_read_word(&gfxFont->last))
-                return 1;
-            if (uniCode < pgm_read_word(&gfxFont->first))
-                return 1;
 
-            uint16_t c2 = uniCode - pgm_read_word(&gfxFont->first);
-            GFXglyph *glyph = &(((GFXglyph *)pgm_read_dword(&gfxFont->glyph))[c2]);
-            uint8_t w = pgm_read_byte(&glyph->width),
-                    h = pgm_read_byte(&glyph->height);
-            if ((w > 0) && (h > 0)) { // Is there an associated bitmap?
-                int16_t xo = (int8_t)pgm_read_byte(&glyph->xOffset);
-                if (textwrapX && ((cursor_x + textsize * (xo + w)) > width())) {
-                    // Drawing character would go off right edge; wrap to new line
-                    cursor_x = 0;
-                    cursor_y += (int16_t)textsize * (uint8_t)pgm_read_byte(&gfxFont->yAdvance);
+            if (clip)
+                pushImage(cx, y + row, cw, 1, lineBuf);
+            else
+                pushPixels(lineBuf, cw);
+        }
+    } else {
+        // Transparent background, solid spans are filled and edge pixels blended one by one
+        for (int32_t row = 0; row < h; row++) {
+            aaDecodeRow(&dec, alpha, w, bpp);
+            int32_t i = 0;
+            while (i < w) {
+                if (alpha[i] == 255) {
+                    int32_t s = i;
+                    while (i < w && alpha[i] == 255)
+                        i++;
+                    drawFastHLine(gx + s, gy + row, i - s, textcolor);
+                    continue;
                 }
-                if (textwrapY && (cursor_y >= (int32_t) height()))
-                    cursor_y = 0;
-                drawChar(cursor_x, cursor_y, uniCode, textcolor, textbgcolor, textsize);
+                if (alpha[i]) {
+                    uint32_t bg = getColor ? getColor(gx + i, gy + row) : 0x00FFFFFF;
+                    drawPixelAlpha(gx + i, gy + row, textcolor, alpha[i], bg);
+                }
+                i++;
             }
-            cursor_x += pgm_read_byte(&glyph->xAdvance) * (int16_t)textsize;
         }
     }
-#endif // LOAD_GFXFF
 
-    return 1;
+    inTransaction = lockTransaction;
+    end_tft_write();
+
+    return xa;
 }
+#endif
 
 
 /***************************************************************************************
@@ -4636,6 +6782,10 @@ int16_t drawCharUnicode(uint16_t uniCode, int32_t x, int32_t y, uint8_t font)
         return 0;
 
     if (font == 1) {
+#ifdef LOAD_AAFF
+        if (aaFont)
+            return drawAAGlyph(uniCode, x, y);
+#endif
 #ifdef LOAD_GLCD
 #ifndef LOAD_GFXFF
         drawChar(x, y, uniCode, textcolor, textbgcolor, textsize);
@@ -4656,9 +6806,8 @@ int16_t drawCharUnicode(uint16_t uniCode, int32_t x, int32_t y, uint8_t font)
             return 0;
 #endif
         } else {
-            if ((uniCode >= pgm_read_word(&gfxFont->first)) && (uniCode <= pgm_read_word(&gfxFont->last))) {
-                uint16_t c2 = uniCode - pgm_read_word(&gfxFont->first);
-                GFXglyph *glyph = &(((GFXglyph *)pgm_read_dword(&gfxFont->glyph))[c2]);
+            GFXglyph *glyph = gfxGlyph(uniCode);
+            if (glyph) {
                 return pgm_read_byte(&glyph->xAdvance) * textsize;
             } else {
                 return 0;
@@ -4807,123 +6956,58 @@ int16_t drawCharUnicode(uint16_t uniCode, int32_t x, int32_t y, uint8_t font)
 #ifdef LOAD_RLE  //674 bytes of code
         // Font is not 2 and hence is RLE encoded
     {
-        begin_tft_write();
-        inTransaction = true;
-
         w *= height; // Now w is total number of pixels in the character
-        if (textcolor == textbgcolor && !clip) {
+        if (textcolor != textbgcolor && textsize == 1 && !clip) {
+            // Text colour != background and textsize = 1 and character is within viewport area
+            // so use faster drawing of characters and background using block write
+            begin_tft_write();
 
-            int32_t px = 0, py = pY; // To hold character block start and end column and row values
-            int32_t pc = 0; // Pixel count
-            uint8_t np = textsize * textsize; // Number of pixels in a drawn pixel
+            setWindow(xd, yd, xd + width - 1, yd + height - 1);
 
-            uint8_t tnp = 0; // Temporary copy of np for while loop
-            uint8_t ts = textsize - 1; // Temporary copy of textsize
-            // 16-bit pixel count so maximum font size is equivalent to 180x180 pixels in area
-            // w is total number of pixels to plot to fill character block
-            while (pc < w) {
-                line = pgm_read_byte((uint8_t *)flash_address);
-                flash_address++;
+            // Maximum font size is equivalent to 180x180 pixels in area
+            while (w > 0) {
+                line = pgm_read_byte((uint8_t *)flash_address++); // 8 bytes smaller when incrementing here
                 if (line & 0x80) {
                     line &= 0x7F;
                     line++;
-                    if (ts) {
-                        px = xd + textsize * (pc % width); // Keep these px and py calculations outside the loop as they are slow
-                        py = yd + textsize * (pc / width);
-                    } else {
-                        px = xd + pc % width; // Keep these px and py calculations outside the loop as they are slow
-                        py = yd + pc / width;
-                    }
-                    while (line--) { // In this case the while(line--) is faster
-                        pc++; // This is faster than putting pc+=line before while()?
-                        setWindow(px, py, px + ts, py + ts);
-
-                        if (ts) {
-                            tnp = np;
-                            while (tnp--) {
-                                tft_Write_16(textcolor);
-                            }
-                        } else {
-                            tft_Write_16(textcolor);
-                        }
-                        px += textsize;
-
-                        if (px >= (xd + width * textsize)) {
-                            px = xd;
-                            py += textsize;
-                        }
-                    }
+                    w -= line;
+                    pushBlock(textcolor, line);
                 } else {
                     line++;
-                    pc += line;
+                    w -= line;
+                    pushBlock(textbgcolor, line);
                 }
             }
+
+            end_tft_write();
         } else {
-            // Text colour != background and textsize = 1 and character is within viewport area
-            // so use faster drawing of characters and background using block write
-            if (textcolor != textbgcolor && textsize == 1 && !clip) {
-                setWindow(xd, yd, xd + width - 1, yd + height - 1);
-
-                // Maximum font size is equivalent to 180x180 pixels in area
-                while (w > 0) {
-                    line = pgm_read_byte((uint8_t *)flash_address++); // 8 bytes smaller when incrementing here
-                    if (line & 0x80) {
-                        line &= 0x7F;
-                        line++;
-                        w -= line;
-                        pushBlock(textcolor, line);
-                    } else {
-                        line++;
-                        w -= line;
-                        pushBlock(textbgcolor, line);
-                    }
-                }
-            } else {
-                int32_t px = 0, py = 0; // To hold character pixel coords
-                int32_t tx = 0, ty = 0; // To hold character TFT pixel coords
-                int32_t pc = 0; // Pixel count
-                int32_t pl = 0; // Pixel line length
-                uint16_t pcol = 0; // Pixel color
-                bool pf = true; // Flag for plotting
-                while (pc < w) {
-                    line = pgm_read_byte((uint8_t *)flash_address);
-                    flash_address++;
-                    if (line & 0x80) {
-                        pcol = textcolor;
-                        line &= 0x7F;
-                        pf = true;
-                    } else {
-                        pcol = textbgcolor;
-                        if (textcolor == textbgcolor)
-                            pf = false;
-                    }
-                    line++;
-                    px = pc % width;
-                    tx = x + textsize * px;
-                    py = pc / width;
-                    ty = y + textsize * py;
-
-                    pl = 0;
-                    pc += line;
-                    while (line--) {
-                        pl++;
-                        if ((px + pl) >= width) {
-                            if (pf)
-                                fillRect(tx, ty, pl * textsize, textsize, pcol);
-                            pl = 0;
-                            px = 0;
-                            tx = x;
-                            py ++;
-                            ty += textsize;
-                        }
+            // Expand the runs into a 1bpp bitmap and scale it, without the background if it
+            // is the text colour
+            int32_t rowBytes = (width + 7) >> 3;
+            uint8_t glyph[rowBytes * height];
+            uint16_t cmap[2] = {textbgcolor, textcolor};
+            int32_t px = 0, py = 0; // Character pixel coords
+            int32_t pc = 0; // Pixel count
+
+            memset(glyph, 0, rowBytes * height);
+            while (pc < w) {
+                line = pgm_read_byte((uint8_t *)flash_address++);
+                bool set = line & 0x80;
+                line = (line & 0x7F) + 1;
+                while (line-- && pc < w) {
+                    if (set)
+                        glyph[py * rowBytes + (px >> 3)] |= 0x80 >> (px & 7);
+                    pc++;
+                    if (++px == width) {
+                        px = 0;
+                        py++;
                     }
-                    if (pl && pf)
-                        fillRect(tx, ty, pl * textsize, textsize, pcol);
                 }
             }
+
+            pushScaled(x, y, width * textsize, height * textsize, glyph, 1, width, height, cmap,
+                       textcolor == textbgcolor ? 0 : -1, false);
         }
-        inTransaction = lockTransaction;
-        end_tft_write();
     }
     // End of RLE font rendering
 #endif
@@ -4949,6 +7033,7 @@ int16_t drawCharUnicode(uint16_t uniCode, int32_t x, int32_t y, uint8_t font)
 // With font number. Note: font number is over-ridden if a smooth font is loaded
 int16_t drawString(const char *string, int32_t poX, int32_t poY, uint8_t font)
 {
+    STAT_CALL(STAT_DRAW_STRING);
     int16_t sumX = 0;
     uint8_t padding = 1, baseline = 0;
     uint16_t cwidth = textWidth(string, font); // Find the pixel width of the string in the font
@@ -5045,9 +7130,8 @@ int16_t drawString(const char *string, int32_t poX, int32_t poY, uint8_t font)
         while (n < len && c2 == 0)
             c2 = decodeUTF8Buffer((uint8_t *)string, &n, len - n);
 
-        if ((c2 >= pgm_read_word(&gfxFont->first)) && (c2 <= pgm_read_word(&gfxFont->last))) {
-            c2 -= pgm_read_word(&gfxFont->first);
-            GFXglyph *glyph = &(((GFXglyph *)pgm_read_dword(&gfxFont->glyph))[c2]);
+        GFXglyph *glyph = gfxGlyph(c2);
+        if (glyph) {
             xo = pgm_read_byte(&glyph->xOffset) * textsize;
             // Adjust for negative xOffset
             if (xo > 0)
@@ -5141,6 +7225,298 @@ int16_t drawString(const char *string, int32_t poX, int32_t poY, uint8_t font)
 }
 
 
+/***************************************************************************************
+** Function name:           glyphAdvance
+** Description:             Pixel advance of a code point, as returned by drawCharUnicode()
+***************************************************************************************/
+static int16_t glyphAdvance(uint16_t uniCode, uint8_t font)
+{
+    if (font == 1) {
+#ifdef LOAD_AAFF
+        if (aaFont) {
+            AAglyph *glyph = aaGlyph(uniCode);
+            return glyph ? pgm_read_byte(&glyph->xAdvance) : 0;
+        }
+#endif
+#ifdef LOAD_GFXFF
+        if (gfxFont) {
+            GFXglyph *glyph = gfxGlyph(uniCode);
+            return glyph ? pgm_read_byte(&glyph->xAdvance) * textsize : 0;
+        }
+#endif
+#ifdef LOAD_GLCD
+        return 6 * textsize;
+#else
+        return 0;
+#endif
+    }
+
+    // Fonts that are not loaded only have a single entry width table
+    if ((font > 1) && (font < 9) && (fontsloaded & (1 << font)) && (uniCode > 31) && (uniCode < 128))
+        return pgm_read_byte((uint8_t *)pgm_read_dword(&(fontdata[font].widthtbl)) + uniCode - 32) * textsize;
+
+    return 0;
+}
+
+/***************************************************************************************
+** Function name:           addLayoutLine
+** Description:             Append a line to a text layout
+***************************************************************************************/
+static void addLayoutLine(textLayout *layout, uint16_t start, uint16_t end, int32_t width, uint16_t spaces, bool hard, bool ellipsis)
+{
+    textLine *line = &layout->line[layout->lineCount++];
+
+    line->start = start;
+    line->end = end;
+    line->width = width;
+    line->spaces = spaces;
+    line->hard = hard;
+    line->ellipsis = ellipsis;
+}
+
+/***************************************************************************************
+** Function name:           layoutText
+** Description:             Word wrap a string into a box, measuring each glyph once
+***************************************************************************************/
+uint16_t layoutText(textLayout *layout, const char *string, int32_t x, int32_t y, int32_t w, int32_t h, uint8_t font, uint8_t align, int16_t lineSpacing, bool ellipsis)
+{
+    layout->string = string;
+    layout->x = x;
+    layout->y = y;
+    layout->w = w;
+    layout->h = h;
+    layout->font = font;
+    layout->align = align;
+    layout->lineHeight = fontHeight(font) + lineSpacing;
+    layout->truncated = false;
+    layout->lineCount = 0;
+
+    // The last line does not need the spacing below it
+    int32_t maxLines = (layout->lineHeight > 0) ? (h + lineSpacing) / layout->lineHeight : 0;
+    if (maxLines > TEXT_LAYOUT_LINES)
+        maxLines = TEXT_LAYOUT_LINES;
+    if (maxLines < 1 || w < 1) {
+        layout->truncated = (*string != 0);
+        return 0;
+    }
+
+    int32_t ellipsisW = ellipsis ? 3 * glyphAdvance('.', font) : 0;
+
+    uint16_t len = strlen(string);
+    uint16_t n = 0;
+
+    uint16_t start = 0; // Current line start
+    int32_t lw = 0; // Current line width
+    uint16_t spaces = 0; // Spaces in the current line
+
+    uint16_t brk = 0, brkNext = 0; // Last break opportunity, start and end of the space run
+    int32_t brkW = 0, brkNextW = 0; // Line width before and after the space run
+    uint16_t brkSpaces = 0; // Spaces before the break
+    bool lastSpace = false;
+
+    uint16_t fitEnd = 0; // Last position where the line plus an ellipsis still fits
+    int32_t fitW = 0;
+
+    while (n < len) {
+        uint16_t pos = n;
+        uint16_t uniCode = decodeUTF8Buffer((uint8_t *)string, &n, len - n);
+
+        if (uniCode == '\r' || uniCode == 0)
+            continue;
+
+        bool lastLine = (layout->lineCount == maxLines - 1);
+
+        if (uniCode == '\n') {
+            if (lastLine && n < len) {
+                // More text follows but there is no room for it
+                layout->truncated = true;
+                if (ellipsis) {
+                    if (lw + ellipsisW > w)
+                        addLayoutLine(layout, start, fitEnd, fitW + ellipsisW, spaces, true, true);
+                    else
+                        addLayoutLine(layout, start, pos, lw + ellipsisW, spaces, true, true);
+                } else
+                    addLayoutLine(layout, start, pos, lw, spaces, true, false);
+                return layout->lineCount;
+            }
+            addLayoutLine(layout, start, pos, lw, spaces, true, false);
+            start = fitEnd = brk = n;
+            lw = fitW = 0;
+            spaces = 0;
+            lastSpace = false;
+            continue;
+        }
+
+        int16_t adv = glyphAdvance(uniCode, font);
+
+        // Wrap until the glyph fits, a word longer than the box is broken between glyphs
+        while ((lw + adv > w) && (lw > 0)) {
+            lastLine = (layout->lineCount == maxLines - 1);
+            if (lastLine) {
+                layout->truncated = true;
+                if (ellipsis)
+                    addLayoutLine(layout, start, fitEnd, fitW + ellipsisW, spaces, true, true);
+                else if (brk > start)
+                    addLayoutLine(layout, start, brk, brkW, brkSpaces, true, false);
+                else
+                    addLayoutLine(layout, start, pos, lw, spaces, true, false);
+                return layout->lineCount;
+            }
+
+            if (brk > start) {
+                addLayoutLine(layout, start, brk, brkW, brkSpaces, false, false);
+                start = brkNext;
+                lw -= brkNextW;
+                spaces -= brkSpaces + (brkNext - brk);
+            } else {
+                addLayoutLine(layout, start, pos, lw, spaces, false, false);
+                start = pos;
+                lw = 0;
+                spaces = 0;
+            }
+            brk = fitEnd = start;
+            fitW = 0;
+            if (lw + ellipsisW <= w) {
+                fitEnd = pos;
+                fitW = lw;
+            }
+            lastSpace = false;
+        }
+
+        if (uniCode == ' ') {
+            // Break before the first space of a run, continue after the last one
+            if (!lastSpace) {
+                brk = pos;
+                brkW = lw;
+                brkSpaces = spaces;
+            }
+            brkNext = n;
+            brkNextW = lw + adv;
+            spaces++;
+            lastSpace = true;
+        } else
+            lastSpace = false;
+
+        // Spaces at the start of a wrapped line are dropped
+        if (uniCode == ' ' && start == pos && layout->lineCount && !layout->line[layout->lineCount - 1].hard) {
+            start = n;
+            brk = fitEnd = n;
+            spaces--;
+            lastSpace = false;
+            continue;
+        }
+
+        lw += adv;
+
+        if (lw + ellipsisW <= w) {
+            fitEnd = n;
+            fitW = lw;
+        }
+    }
+
+    if (start < len || layout->lineCount == 0)
+        addLayoutLine(layout, start, len, lw, spaces, true, false);
+
+    return layout->lineCount;
+}
+
+/***************************************************************************************
+** Function name:           drawLayout
+** Description:             Render the lines of a text layout
+***************************************************************************************/
+void drawLayout(const textLayout *layout)
+{
+    const char *string = layout->string;
+    uint8_t font = layout->font;
+    bool fill = (textcolor != textbgcolor);
+    int32_t fh = fontHeight(font);
+    int32_t y = layout->y;
+    int32_t yb = 0; // Offset from line top to where glyphs are drawn
+    bool freeFont = false;
+
+#ifdef LOAD_GFXFF
+    if (font == 1 && gfxFont) {
+        freeFont = true; // Free font glyphs do not fill their background
+        yb = glyph_ab * textsize;
+    }
+#endif
+
+    begin_tft_write();
+    inTransaction = true;
+
+    for (uint16_t i = 0; i < layout->lineCount; i++) {
+        const textLine *line = &layout->line[i];
+        int32_t gap = layout->w - line->width;
+        int32_t lx = layout->x;
+        int32_t extra = 0, rem = 0;
+        int32_t lh = layout->lineHeight;
+
+        if (y + lh > layout->y + layout->h)
+            lh = layout->y + layout->h - y;
+
+        switch (layout->align) {
+            case TEXT_ALIGN_CENTRE:
+                lx += gap / 2;
+                break;
+            case TEXT_ALIGN_RIGHT:
+                lx += gap;
+                break;
+            case TEXT_ALIGN_JUSTIFY:
+                if (!line->hard && line->spaces && gap > 0) {
+                    extra = gap / line->spaces;
+                    rem = gap % line->spaces;
+                }
+                break;
+        }
+
+        if (fill) {
+            if (freeFont)
+                fillRect(layout->x, y, layout->w, lh, textbgcolor);
+            else {
+                fillRect(layout->x, y, lx - layout->x, lh, textbgcolor);
+                fillRect(lx + line->width, y, layout->x + layout->w - lx - line->width, lh, textbgcolor);
+                if (lh > fh)
+                    fillRect(lx, y + fh, line->width, lh - fh, textbgcolor);
+            }
+        }
+
+        int32_t px = lx;
+        uint16_t n = line->start;
+
+        while (n < line->end) {
+            uint16_t uniCode = decodeUTF8Buffer((uint8_t *)string, &n, line->end - n);
+            if (uniCode == '\r')
+                continue;
+            px += drawCharUnicode(uniCode, px, y + yb, font);
+            if (uniCode == ' ' && (extra || rem)) {
+                int32_t e = extra;
+                if (rem) {
+                    e++;
+                    rem--;
+                }
+                if (fill && !freeFont)
+                    fillRect(px, y, e, fh, textbgcolor);
+                px += e;
+            }
+        }
+
+        if (line->ellipsis) {
+            for (uint8_t d = 0; d < 3; d++)
+                px += drawCharUnicode('.', px, y + yb, font);
+        }
+
+        y += layout->lineHeight;
+    }
+
+    // Clear the rest of the box
+    if (fill && y < layout->y + layout->h)
+        fillRect(layout->x, y, layout->w, layout->y + layout->h - y, textbgcolor);
+
+    inTransaction = lockTransaction;
+    end_tft_write();
+}
+
+
 /***************************************************************************************
 ** Function name:           drawCentreString (deprecated, use setTextDatum())
 ** Descriptions:            draw string centred on dX
@@ -5284,11 +7660,21 @@ void setFreeFont(const GFXfont *f)
 
     textfont = 1;
     gfxFont = (GFXfont *)f;
+#ifdef LOAD_AAFF
+    aaFont = NULL;
+#endif
 
     glyph_ab = 0;
     glyph_bb = 0;
     uint16_t numChars = pgm_read_word(&gfxFont->last) - pgm_read_word(&gfxFont->first);
 
+    // Sparse fonts hold fewer glyphs than the code point extents suggest
+    GFXrange *range = (GFXrange *)pgm_read_dword(&gfxFont->range);
+    if (range && pgm_read_word(&gfxFont->rangeCount)) {
+        uint16_t n = pgm_read_word(&gfxFont->rangeCount) - 1;
+        numChars = pgm_read_word(&range[n].glyphIndex) + pgm_read_word(&range[n].last) - pgm_read_word(&range[n].first) + 1;
+    }
+
     // Find the biggest above and below baseline offsets
     for (uint16_t c = 0; c < numChars; c++) {
         GFXglyph *glyph1 = &(((GFXglyph *)pgm_read_dword(&gfxFont->glyph))[c]);
@@ -5310,7 +7696,62 @@ void setTextFont(uint8_t f)
 {
     textfont = (f > 0) ? f : 1; // Don't allow font 0
     gfxFont = NULL;
+#ifdef LOAD_AAFF
+    aaFont = NULL;
+#endif
+}
+
+#ifdef LOAD_FLASH_FONT
+/***************************************************************************************
+** Function name:           setFlashFont
+** Description:             Select a GFX font image stored in external flash
+***************************************************************************************/
+bool setFlashFont(uint32_t address, fontReadCallback reader)
+{
+#ifdef FONT_CS_PORT
+    if (reader == NULL)
+        reader = fontFlashRead;
+#endif
+    if (reader == NULL)
+        return false;
+
+    uint8_t header[FLASH_FONT_HEADER];
+
+    // The current font stays selected unless the new image is valid
+    flashImageRead(reader, address, header, FLASH_FONT_HEADER);
+
+    if (memcmp(header, "GFXF", 4) || flashWord(header + 4) != 1 || flashWord(header + 6) == 0)
+        return false;
+
+    flashRead = reader;
+    flashFontAddr = address;
+
+    // Drop glyphs cached from a previous font
+    memset(flashCache, 0, sizeof(flashCache));
+
+    flashRangeCount = flashWord(header + 6);
+    flashFont.first = flashWord(header + 10);
+    flashFont.last = flashWord(header + 12);
+    flashFont.yAdvance = header[14];
+    flashFont.bitmap = (uint8_t *)flashCacheBitmap;
+    flashFont.glyph = NULL;
+    flashRanges = flashDword(header + 20);
+    flashGlyphs = flashDword(header + 24);
+    flashBitmaps = flashDword(header + 28);
+
+    textfont = 1;
+    gfxFont = &flashFont;
+#ifdef LOAD_AAFF
+    aaFont = NULL;
+#endif
+
+    // Baseline offsets are precomputed by the converter, scanning every glyph would mean reading them all
+    glyph_ab = header[15];
+    glyph_bb = header[16];
+
+    return true;
 }
+#endif
 
 #else
 
@@ -5334,5 +7775,20 @@ void setFreeFont(uint8_t font)
 void setTextFont(uint8_t f)
 {
     textfont = (f > 0) ? f : 1; // Don't allow font 0
+#ifdef LOAD_AAFF
+    aaFont = NULL;
+#endif
+}
+#endif
+
+#ifdef LOAD_AAFF
+/***************************************************************************************
+** Function name:           setAAFont
+** Description:             Select an anti-aliased font as font 1
+***************************************************************************************/
+void setAAFont(const AAfont *f)
+{
+    setTextFont(1); // Also deselects any GFX free font
+    aaFont = f;
 }
 #endif
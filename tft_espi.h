@@ -23,11 +23,19 @@
 #define TFT_BGR 0   // Colour order Blue-Green-Red
 #define TFT_RGB 1   // Colour order Red-Green-Blue
 
-// Invoke 18-bit colour for selected displays
-#if defined (ILI9481_DRIVER) || defined (ILI9486_DRIVER) || defined (ILI9488_DRIVER)
+// Invoke 18-bit colour for selected displays, on a 16-bit parallel bus they take RGB565
+#if (defined (ILI9481_DRIVER) || defined (ILI9486_DRIVER) || defined (ILI9488_DRIVER)) && !defined (TFT_PARALLEL_16_BIT)
 #define SPI_18BIT_DRIVER
 #endif
 
+#ifndef RGB666_PIXELS
+#define RGB666_PIXELS 256 // Pixels in each of the two 18-bit colour DMA line buffers
+#endif
+
+#ifndef INIT_TABLE_BYTES
+#define INIT_TABLE_BYTES 256 // Init commands recorded at a time, longer sequences are sent in parts
+#endif
+
 // Load the right driver definition - do not tinker here !
 #if defined(ILI9341_DRIVER) || defined(ILI9341_2_DRIVER) || defined(ILI9342_DRIVER)
 #include <TFT_Drivers/ILI9341_Defines.h>
@@ -105,9 +113,55 @@
 #define  TFT_DRIVER 0x0000
 #endif
 
+// How pixels come back after TFT_RAMRD
+#define TFT_READ_RGB666       0 // 3 bytes, colour in the top 6 bits of each
+#define TFT_READ_RGB565       1 // 2 bytes, one read on a 16-bit parallel bus
+#define TFT_READ_RGB666_SHIFT 2 // 3 bytes, colour in bits 6 to 1 of each
+
+#if defined (ST7796_DRIVER) || defined (TFT_PARALLEL_16_BIT) || defined (EPD_DRIVER)
+#define TFT_READ_FORMAT TFT_READ_RGB565
+#elif defined (ST7735_DRIVER) || defined (ILI9488_DRIVER)
+#define TFT_READ_FORMAT TFT_READ_RGB666_SHIFT
+#else
+#define TFT_READ_FORMAT TFT_READ_RGB666
+#endif
+
+// With TFT_RUNTIME_DRIVER the controller is detected by displayInit() and driven from a tftDriver
+// table. The driver selected above still provides the generic TFT_ command values, so use one of
+// the MIPI DCS controllers (e.g. ILI9341_DRIVER). Offsets then come from the table
+#if defined (TFT_RUNTIME_DRIVER) && !defined (CGRAM_OFFSET)
+#define CGRAM_OFFSET
+#endif
+
+typedef struct {
+    uint16_t id; // As TFT_DRIVER, e.g. 0x7789
+    uint32_t rddid, rddidMask; // Used if (readDisplayID() & rddidMask) == rddid, mask 0 matches any
+    const uint8_t *init; // Init sequence in the ST7735_Init.h commandList() format
+    uint8_t madctl[8]; // TFT_MADCTL value for each rotation, without the colour order bit
+    uint8_t rotations; // 4 or 8
+    uint8_t colourOrder; // TFT_MAD_RGB or TFT_MAD_BGR, unless TFT_RGB_ORDER is set
+    uint8_t offset[4][2]; // colstart and rowstart for rotations 0-3
+    // Set the address window and start a RAM write, coordinates already offset. NULL for the
+    // CASET/PASET/RAMWR fast path
+    void (*window)(int32_t x0, int32_t y0, int32_t x1, int32_t y1);
+    uint8_t read; // TFT_READ_ format
+    uint8_t depth; // Bits per pixel written, entries not matching the build (18 with SPI_18BIT_DRIVER) are skipped
+} tftDriver;
+
 // Callback prototype for smooth font pixel colour read
 typedef uint16_t (*getColorCallback)(uint16_t x, uint16_t y);
 
+// Callback prototype for reading a font image from external storage (e.g. SPI flash)
+typedef void (*fontReadCallback)(uint32_t addr, uint8_t *buf, uint32_t len);
+
+// Callbacks used by the image decoders to fetch compressed data (returns bytes read, 0 at the end)
+// and to hand over decoded RGB565 rectangles instead of drawing them on the TFT
+typedef uint32_t (*imageReadCallback)(void *ctx, uint8_t *buf, uint32_t len);
+typedef void (*imageOutputCallback)(void *ctx, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data);
+
+// Byte sink for encoded screen captures, returns false to abort the capture
+typedef bool (*imageWriteCallback)(void *ctx, const uint8_t *buf, uint32_t len);
+
 // Handle FLASH based storage e.g. PROGMEM
 #define pgm_read_byte(addr)   (*(const unsigned char *)(addr))
 
@@ -210,12 +264,35 @@ typedef uint16_t (*getColorCallback)(uint16_t x, uint16_t y);
 #endif
 #endif
 
+// Fonts in external SPI flash are rendered by the free font code
+#ifdef LOAD_FLASH_FONT
+#ifndef LOAD_GFXFF
+#define LOAD_GFXFF
+#endif
+#endif
+
 #ifdef LOAD_GFXFF
 // We can include all the free fonts and they will only be built into
 // the sketch if they are used
 #include <Fonts/GFXFF/gfxfont.h>
 #endif // #ifdef LOAD_GFXFF
 
+#ifdef LOAD_AAFF
+// Anti-aliased fonts made by Tools/aaff_pack.py, only built into the sketch if used
+#include <Fonts/AAFF/aafont.h>
+#endif
+
+// Image decoders and players, enabled with LOAD_JPEG, LOAD_PNG, LOAD_Q565, LOAD_GIF and LOAD_CLIP,
+// and screen capture with LOAD_SCREENSHOT
+#include "tft_jpeg.h"
+#include "tft_png.h"
+#include "tft_q565.h"
+#include "tft_gif.h"
+#include "tft_clip.h"
+#include "tft_shot.h"
+#include "tft_server.h"
+#include "tft_stats.h"
+
 /***************************************************************************************
 **                         Section 5: Font datum enumeration
 ***************************************************************************************/
@@ -236,6 +313,54 @@ typedef uint16_t (*getColorCallback)(uint16_t x, uint16_t y);
 #define C_BASELINE 10 // Centre character baseline
 #define R_BASELINE 11 // Right character baseline
 
+// Horizontal alignment of lines for layoutText()
+#define TEXT_ALIGN_LEFT    0
+#define TEXT_ALIGN_CENTRE  1
+#define TEXT_ALIGN_RIGHT   2
+#define TEXT_ALIGN_JUSTIFY 3 // Last line of a paragraph is left aligned
+
+#ifndef TEXT_LAYOUT_LINES
+#define TEXT_LAYOUT_LINES 8 // Maximum number of lines held by a textLayout
+#endif
+
+// One laid out line, refers to a byte range of the laid out string
+typedef struct {
+    uint16_t start, end; // Byte range of the line in the string
+    int16_t width; // Pixel width of the line, including any ellipsis
+    uint16_t spaces; // Number of spaces, for justification
+    bool hard; // Ended by a new line or end of text, so never justified
+    bool ellipsis; // Truncated line, "..." is drawn after it
+} textLine;
+
+// Result of layoutText(), caller allocated so layout needs no heap
+typedef struct {
+    const char *string; // Must remain valid until drawLayout()
+    int32_t x, y, w, h; // Bounding box
+    int16_t lineHeight; // Font height plus line spacing
+    uint8_t font; // Font number
+    uint8_t align; // TEXT_ALIGN_xxx
+    bool truncated; // Text did not fit in the box
+    uint16_t lineCount; // Number of valid entries in line[]
+    textLine line[TEXT_LAYOUT_LINES];
+} textLayout;
+
+// Named sub-image of an imageAtlas sheet
+typedef struct {
+    const char *name;
+    uint16_t x, y, w, h; // Rectangle within the sheet
+    int32_t transparent; // Colour (16bpp) or index (8, 4 and 1bpp) that is not drawn, -1 for none
+} atlasEntry;
+
+// Sprite sheet with a table of sub-images, drawn with pushAtlas()
+typedef struct {
+    const void *sheet;
+    uint8_t bpp; // 16, 8, 4 or 1
+    uint16_t stride; // Sheet row length in pixels, 4 and 1bpp rows start on a whole byte
+    uint16_t *cmap; // Palette of 8 and 4bpp sheets, NULL for RGB332 8bpp
+    const atlasEntry *entry;
+    uint16_t entries;
+} imageAtlas;
+
 /***************************************************************************************
 **                         Section 6: Colour enumeration
 ***************************************************************************************/
@@ -274,7 +399,24 @@ typedef uint16_t (*getColorCallback)(uint16_t x, uint16_t y);
 **                         Section 8: Class member and support functions
 ***************************************************************************************/
 
-void displayInit(int16_t w, int16_t h);
+// Reset and initialise the TFT, blocking until done. False if a driver command could not be
+// recorded: more than 126 arguments, or longer than INIT_TABLE_BYTES on its own
+bool displayInit(int16_t w, int16_t h);
+
+// Or start it with displayInitBegin() and call displayInitUpdate(ms) from the main loop until it returns
+// false, ms from a free running clock. The resets and driver delays are then waited out by other work.
+// displayInitStep() does the next part, returning the ms to wait before calling it again or -1 when done
+void displayInitBegin(int16_t w, int16_t h);
+bool displayInitUpdate(uint32_t now);
+int32_t displayInitStep(void);
+bool displayInitFailed(void); // The init stopped before sending a command it could not record
+
+#ifdef TFT_RUNTIME_DRIVER
+// Drivers tried in order by displayInit(), call before it to replace the built-in ST7789 and ILI9341 table
+void displayDriverTable(const tftDriver *table, uint8_t count);
+// The driver in use, the table's last entry until displayInit() has detected one
+const tftDriver *displayDriver(void);
+#endif
 
 // init() and begin() are equivalent, begin() included for backwards compatibility
 // Sketch defined tab colour option is for ST7735 displays only
@@ -426,7 +568,7 @@ void drawXBitmap(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t
 void drawXBitmapBG(int16_t x, int16_t y, const uint8_t *bitmap, int16_t w, int16_t h, uint16_t fgcolor, uint16_t bgcolor);
 void setBitmapColor(uint16_t fgcolor, uint16_t bgcolor); // Define the 2 colours for 1bpp sprites
 
-// Set TFT pivot point (use when rendering rotated sprites)
+// Set TFT pivot point (use when rendering rotated images with pushImageRotated())
 void setPivot(int16_t x, int16_t y);
 int16_t getPivotX(void), // Get pivot x
         getPivotY(void); // Get pivot y
@@ -440,18 +582,54 @@ void pushRect(int32_t x, int32_t y, int32_t w, int32_t h, uint16_t *data);
 // These are used to render images stored in FLASH (PROGMEM)
 void pushImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data);
 void pushImageTrans(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data, uint16_t transparent);
+// Column major image, w columns of h pixels (e.g. scope traces, text rendered sideways). Sent
+// as one burst with the TFT's row/column exchange (MADCTL MV) flipped while it is drawn
+void pushImageColumns(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data);
+// Start sending an image by DMA and return at once so the next block can be prepared meanwhile.
+// data must stay unchanged until dmaWait(), which any other TFT access calls first. On 18-bit
+// colour panels the image is converted while it is sent and only the last line buffer is left going
+void pushImageDMA(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data);
+void dmaWait(void);
 
 // They are not intended to be used with user sketches (but could be)
 // Set bpp8 true for 8bpp sprites, false otherwise. The cmap pointer must be specified for 4bpp
 void pushImage8(int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t *data, bool bpp8, uint16_t *cmap);
 void pushImage8Trans(int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t *data, uint8_t transparent, bool bpp8, uint16_t *cmap);
+// 8-bit palette indices looked up in a table of up to 256 RGB565 colours, the transparent
+// version sends only the runs of other indices
+void pushImagePal8(int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t *data, const uint16_t *cmap);
+void pushImagePal8Trans(int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t *data, uint8_t transparent,
+                        const uint16_t *cmap);
 // FLASH version
 
 // Render a 16-bit colour image with a 1bpp mask
 void pushMaskedImage(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *img, uint8_t *mask);
+// Render a transparent image coded as opaque spans per row by Tools/rle565_pack.py
+void pushImageRLE(int32_t x, int32_t y, const uint16_t *data);
+// Render the w x h area at sx,sy of a 16, 8, 4 or 1bpp sheet with rows stride pixels long.
+// 8 and 4bpp pixels index cmap (8bpp without one is RGB332), 1bpp uses cmap[0] and cmap[1] or
+// the setBitmapColor() colours. Pixels equal to transparent (colour or index) are skipped, -1
+// draws them all. A 16bpp transparent colour follows setSwapBytes() as in pushImageTrans()
+void pushImageRect(int32_t x, int32_t y, const void *sheet, uint8_t bpp, int32_t stride,
+                   int32_t sx, int32_t sy, int32_t w, int32_t h, uint16_t *cmap, int32_t transparent);
+// Render a w x h image scaled to fill dw x dh, nearest neighbour or bilinear if smooth is true.
+// The 8 (RGB332 without a cmap), 4 and 1bpp version takes the same pixels as pushImageRect()
+void pushImageScaled(int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data, int32_t dw, int32_t dh, bool smooth);
+void pushImage8Scaled(int32_t x, int32_t y, int32_t w, int32_t h, const uint8_t *data, uint8_t bpp, uint16_t *cmap,
+                      int32_t dw, int32_t dh, bool smooth);
+// Render a w x h image rotated clockwise by angle degrees about its pixel px,py, which is put on
+// the setPivot() point. Pixels equal to transparent are skipped, -1 draws them all. If bg is a
+// colour (not -1) the image edges are anti-aliased against it. Rows go out by DMA
+void pushImageRotated(int32_t w, int32_t h, const uint16_t *data, int32_t px, int32_t py, int16_t angle,
+                      int32_t transparent, int32_t bg);
+// Find an atlas entry by name, returns its index or -1
+int32_t atlasFind(const imageAtlas *atlas, const char *name);
+// Render atlas entry index with its top left at x,y
+void pushAtlas(int32_t x, int32_t y, const imageAtlas *atlas, int32_t index);
 
 // This next function has been used successfully to dump the TFT screen to a PC for documentation purposes
 // It reads a screen area and returns the 3 RGB 8-bit colour values of each pixel in the buffer
+// (shotOpen() and shotStep() with LOAD_SCREENSHOT stream a capture in strips instead)
 // Set w and h to 1 to read 1 pixel's colour. The data buffer must be at least w * h * 3 bytes
 void readRectRGB(int32_t x, int32_t y, int32_t w, int32_t h, uint8_t *data);
 
@@ -470,6 +648,13 @@ int16_t drawString(const char *string, int32_t x, int32_t y, uint8_t font); // D
 int16_t drawCentreString(const char *string, int32_t x, int32_t y, uint8_t font); // Deprecated, use setTextDatum() and drawString()
 int16_t drawRightString(const char *string, int32_t x, int32_t y, uint8_t font); // Deprecated, use setTextDatum() and drawString()
 
+// Word wrap a string into the box x,y,w,h in one measuring pass, lines are separated by lineSpacing extra pixels
+// If the text does not fit and ellipsis is true the last line is cut short and ends with "..."
+// Returns the number of lines, the layout can then be drawn any number of times without re-measuring
+uint16_t layoutText(textLayout *layout, const char *string, int32_t x, int32_t y, int32_t w, int32_t h, uint8_t font, uint8_t align, int16_t lineSpacing, bool ellipsis);
+// Render a layout with the current text colours, background (if not transparent) is filled over the whole box
+void drawLayout(const textLayout *layout);
+
 
 // Text rendering and font handling support functions
 void setCursor(int16_t x, int16_t y, uint8_t font); // Set cursor and font number for tft.print()
@@ -497,6 +682,22 @@ void setFreeFont(uint8_t font); // Not used, historical fix to prevent an error
 void setTextFont(uint8_t font); // Set the font number to use in future
 #endif
 
+#ifdef LOAD_AAFF
+// Select an anti-aliased font, then used as font 1 by drawString(), the print stream and layoutText()
+// Glyphs are not scaled by setTextSize(), setTextFont() or setFreeFont() deselect it
+// With a transparent background (same text and background colour) edge pixels are blended with the
+// colour from the setCallback() function, or read back from the TFT if no callback is set
+void setAAFont(const AAfont *f);
+#endif
+
+#ifdef LOAD_FLASH_FONT
+// Select a font image made by "Tools/gfxff_pack.py --bin" stored at address in external flash
+// Glyphs are fetched on demand into a RAM cache, see FLASH_FONT_CACHE_GLYPHS/FLASH_FONT_CACHE_SLOT
+// A NULL reader uses fontFlashRead() on the FONT_CS device, any other reader (e.g. fread() of the
+// image file on a host build) can stand in for the flash chip. Returns false if no image is found
+bool setFlashFont(uint32_t address, fontReadCallback reader);
+#endif
+
 int16_t textWidth(const char *string, uint8_t font); // Returns pixel width of string in specified font
 int16_t fontHeight(int16_t font); // Returns pixel height of specified font
 
@@ -507,6 +708,16 @@ uint16_t decodeUTF8(uint8_t c);
 // Support function to UTF8 decode and draw characters piped through print stream
 size_t write(uint8_t);
 
+// Buffered print stream, text is held until a newline, a full buffer (PRINT_BUFFER_SIZE)
+// or the end of the call and then drawn at the cursor a line per transaction, so nothing is
+// pending when the call returns. Background filled size 1 GLCD text is sent as runs of
+// characters sharing one window
+size_t printString(const char *string);
+// printf() style print stream output without heap use, supports %d %i %u %x %X %c %s %p %f %%
+// with '-' and '0' flags, width (or *) and precision. Returns the number of characters output
+int printFormat(const char *format, ...);
+void printFlush(void); // Draw any buffered text now, the print calls do this before returning
+
 // Used by Smooth font class to fetch a pixel colour for the anti-aliasing
 void setCallback(getColorCallback getCol);
 
@@ -519,6 +730,9 @@ void writedata(uint8_t d); // Send data with DC/RS set high
 uint8_t readcommand8(uint8_t cmd_function, uint8_t index); // read 8 bits from TFT
 uint16_t readcommand16(uint8_t cmd_function, uint8_t index); // read 16 bits from TFT
 uint32_t readcommand32(uint8_t cmd_function, uint8_t index); // read 32 bits from TFT
+uint32_t readDisplayID(void); // RDDID, e.g. 0x858552 for the ST7789V
+// Raise the write clock to the fastest the TFT reads back correctly, see tft_espi.c
+uint32_t displayCalibrate(void);
 
 // Colour conversion
 // Convert 8-bit red, green and blue to 16 bits
@@ -0,0 +1,379 @@
+/***************************************************
+  Animated GIF player for the TFT library.
+
+  Frames are LZW decoded in fixed RAM (the 4096
+  entry code table and a string stack) a row at a
+  time into palette indices, which pushImagePal8()
+  expands through the RGB565 colour table. Only the
+  rectangle each frame covers is drawn, transparent
+  pixels are skipped so the previous frame shows
+  through, and the disposal method of each frame is
+  applied before the next one is drawn.
+ ****************************************************/
+
+#include "board.h"
+
+#ifdef LOAD_GIF
+
+/***************************************************************************************
+** Function name:           gifByte
+** Description:             Fetch the next byte of the file, 0 past the end
+***************************************************************************************/
+static uint8_t gifByte(gifDecoder *g)
+{
+    if (g->inPos >= g->inLen) {
+        if (g->read)
+            g->inLen = g->read(g->ctx, g->buffer, GIF_INPUT_BUFFER);
+        else
+            g->inLen = 0;
+        g->inPos = 0;
+        if (!g->inLen) {
+            g->eof = true;
+            return 0;
+        }
+    }
+
+    return g->in[g->inPos++];
+}
+
+static uint16_t gifWord(gifDecoder *g)
+{
+    uint16_t w = gifByte(g);
+    return w | gifByte(g) << 8;
+}
+
+static void gifSkip(gifDecoder *g, uint32_t n)
+{
+    while (n-- && !g->eof)
+        gifByte(g);
+}
+
+// Skip data sub-blocks up to and including the zero length terminator
+static void gifBlocks(gifDecoder *g)
+{
+    uint8_t len;
+    while ((len = gifByte(g)) && !g->eof)
+        gifSkip(g, len);
+}
+
+static void gifPalette(gifDecoder *g, uint16_t *cmap, uint16_t n)
+{
+    for (uint16_t i = 0; i < n; i++) {
+        uint8_t r = gifByte(g);
+        uint8_t gr = gifByte(g);
+        cmap[i] = color565(r, gr, gifByte(g));
+    }
+}
+
+/***************************************************************************************
+** Function name:           gifCode
+** Description:             Read the next LZW code from the sub-blocks, -1 at their end
+***************************************************************************************/
+static int32_t gifCode(gifDecoder *g, uint8_t size)
+{
+    while (g->bitCnt < size) {
+        if (!g->blockLeft) {
+            g->blockLeft = gifByte(g);
+            if (!g->blockLeft || g->eof)
+                return -1;
+        }
+        g->blockLeft--;
+        g->bitBuf |= (uint32_t)gifByte(g) << g->bitCnt;
+        g->bitCnt += 8;
+    }
+
+    int32_t code = g->bitBuf & ((1 << size) - 1);
+    g->bitBuf >>= size;
+    g->bitCnt -= size;
+    return code;
+}
+
+/***************************************************************************************
+** Function name:           gifFrame
+** Description:             Decode the image data of a frame and draw it row by row
+***************************************************************************************/
+static bool gifFrame(gifDecoder *g, int32_t x, int32_t y, uint16_t fx, uint16_t fy, uint16_t fw, uint16_t fh,
+                     bool interlace, uint16_t *cmap)
+{
+    static const uint8_t passStart[] = {0, 4, 2, 1};
+    static const uint8_t passStep[] = {8, 8, 4, 2};
+
+    uint8_t minSize = gifByte(g);
+    if (minSize < 2 || minSize > 8)
+        return false;
+
+    // Columns and rows that fall on the logical screen
+    uint16_t vw = (fx < g->width) ? g->width - fx : 0;
+    if (vw > fw)
+        vw = fw;
+    if (vw > GIF_MAX_WIDTH)
+        vw = GIF_MAX_WIDTH;
+
+    uint16_t clear = 1 << minSize;
+    uint16_t next = clear + 2;
+    uint8_t size = minSize + 1;
+    int32_t prev = -1;
+    uint8_t first = 0;
+
+    uint16_t col = 0, row = 0;
+    uint8_t pass = 0;
+    bool done = !fw || !fh; // All rows filled, any further pixels are ignored
+
+    g->blockLeft = 0;
+    g->bitBuf = 0;
+    g->bitCnt = 0;
+
+    for (;;) {
+        int32_t code = gifCode(g, size);
+        if (code < 0) // Data ended without an end code
+            return !g->eof;
+
+        if (code == clear) {
+            next = clear + 2;
+            size = minSize + 1;
+            prev = -1;
+            continue;
+        }
+        if (code == clear + 1) // End of information
+            break;
+
+        uint8_t *sp = g->stack;
+        uint16_t c = code;
+
+        if (prev < 0) { // First code after a clear must be a colour
+            if (code > clear)
+                return false;
+            first = code;
+            *sp++ = first;
+        } else {
+            if (code > next)
+                return false;
+            if (code == next) { // String of the previous code plus its own first colour
+                *sp++ = first;
+                c = prev;
+            }
+            while (c > clear) {
+                *sp++ = g->suffix[c];
+                c = g->prefix[c];
+            }
+            first = c;
+            *sp++ = first;
+
+            if (next < 4096) {
+                g->prefix[next] = prev;
+                g->suffix[next] = first;
+                next++;
+                if (next == (1 << size) && size < 12)
+                    size++;
+            }
+        }
+        prev = code;
+
+        if (done)
+            continue;
+
+        // The string is on the stack last colour first
+        while (sp > g->stack) {
+            uint8_t index = *--sp;
+            if (col < vw)
+                g->line[col] = index;
+            if (++col < fw)
+                continue;
+
+            if (vw && fy + row < g->height) {
+                if (g->transparent >= 0)
+                    pushImagePal8Trans(x + fx, y + fy + row, vw, 1, g->line, g->transparent, cmap);
+                else
+                    pushImagePal8(x + fx, y + fy + row, vw, 1, g->line, cmap);
+            }
+
+            col = 0;
+            if (interlace) {
+                row += passStep[pass];
+                while (row >= fh && pass < 3) {
+                    pass++;
+                    row = passStart[pass];
+                }
+            } else
+                row++;
+
+            if (row >= fh) {
+                done = true;
+                break;
+            }
+        }
+    }
+
+    gifSkip(g, g->blockLeft);
+    gifBlocks(g);
+
+    return !g->eof;
+}
+
+/***************************************************************************************
+** Function name:           gifDispose
+** Description:             Apply the disposal method of the previous frame
+***************************************************************************************/
+static void gifDispose(gifDecoder *g, int32_t x, int32_t y)
+{
+    if (!g->pw || !g->ph)
+        return;
+
+    if (g->prevDisposal == 2)
+        fillRect(x + g->px, y + g->py, g->pw, g->ph, g->bg);
+#ifdef GIF_RESTORE_PIXELS
+    else if (g->prevDisposal == 3)
+        pushRect(x + g->px, y + g->py, g->pw, g->ph, g->restore);
+#endif
+}
+
+/***************************************************************************************
+** Function name:           gifOpen
+** Description:             Read the header, logical screen and global colour table
+***************************************************************************************/
+bool gifOpen(gifDecoder *gif, const uint8_t *data, uint32_t size, imageReadCallback read, void *ctx)
+{
+    memset(gif, 0, sizeof(gifDecoder));
+
+    gif->in = data ? data : gif->buffer;
+    gif->inLen = data ? size : 0;
+    gif->read = data ? NULL : read;
+    gif->ctx = ctx;
+    gif->transparent = -1;
+    gif->loops = -1;
+
+    if (gifByte(gif) != 'G' || gifByte(gif) != 'I' || gifByte(gif) != 'F' || gifByte(gif) != '8')
+        return false;
+    gifSkip(gif, 2); // "7a" or "9a"
+
+    gif->width = gifWord(gif);
+    gif->height = gifWord(gif);
+    uint8_t flags = gifByte(gif);
+    uint8_t bgIndex = gifByte(gif);
+    gifByte(gif); // Aspect ratio
+
+    if (flags & 0x80) {
+        gifPalette(gif, gif->global, 2 << (flags & 7));
+        gif->bg = gif->global[bgIndex];
+    }
+
+    gif->start = gif->inPos;
+
+    return !gif->eof && gif->width && gif->height;
+}
+
+/***************************************************************************************
+** Function name:           gifStep
+** Description:             Draw the next frame, returns its delay in ms or -1 at the end
+***************************************************************************************/
+int32_t gifStep(gifDecoder *gif, int32_t x, int32_t y)
+{
+    while (!gif->eof) {
+        uint8_t block = gifByte(gif);
+
+        if (block == 0x21) { // Extension
+            uint8_t label = gifByte(gif);
+            uint8_t len = gifByte(gif);
+
+            if (label == 0xF9 && len >= 4) { // Graphic control
+                uint8_t flags = gifByte(gif);
+                gif->delay = gifWord(gif) * 10;
+                uint8_t index = gifByte(gif);
+                gif->disposal = (flags >> 2) & 7;
+                gif->transparent = (flags & 1) ? index : -1;
+                gifSkip(gif, len - 4);
+            } else if (label == 0xFF && len == 11) { // Application, looks for NETSCAPE2.0
+                const char *id = "NETSCAPE2.0";
+                bool netscape = true;
+                while (*id)
+                    netscape &= gifByte(gif) == *id++;
+                len = gifByte(gif); // Next sub-block
+                if (netscape && len >= 3) {
+                    uint8_t sub = gifByte(gif); // Sub-block id, 1 is the loop count
+                    uint16_t count = gifWord(gif);
+                    if (sub == 1)
+                        gif->loops = count;
+                    gifSkip(gif, len - 3);
+                } else
+                    gifSkip(gif, len);
+            } else
+                gifSkip(gif, len);
+            if (len)
+                gifBlocks(gif);
+        } else if (block == 0x2C) { // Image
+            uint16_t fx = gifWord(gif);
+            uint16_t fy = gifWord(gif);
+            uint16_t fw = gifWord(gif);
+            uint16_t fh = gifWord(gif);
+            uint8_t flags = gifByte(gif);
+            uint16_t *cmap = gif->global;
+
+            if (flags & 0x80) {
+                gifPalette(gif, gif->local, 2 << (flags & 7));
+                cmap = gif->local;
+            }
+
+            gifDispose(gif, x, y);
+
+            // Keep the part of the frame on the logical screen for the next disposal
+            gif->px = fx;
+            gif->py = fy;
+            gif->pw = (fx < gif->width) ? ((fw < gif->width - fx) ? fw : gif->width - fx) : 0;
+            gif->ph = (fy < gif->height) ? ((fh < gif->height - fy) ? fh : gif->height - fy) : 0;
+            gif->prevDisposal = gif->disposal;
+#ifdef GIF_RESTORE_PIXELS
+            if (gif->disposal == 3 && gif->pw * gif->ph <= GIF_RESTORE_PIXELS) {
+                readRect(x + fx, y + fy, gif->pw, gif->ph, gif->restore);
+                // readRect() gives the bytes swapped, pushRect() takes them native
+                for (int32_t i = 0; i < gif->pw * gif->ph; i++)
+                    gif->restore[i] = gif->restore[i] << 8 | gif->restore[i] >> 8;
+            } else
+#endif
+            if (gif->disposal == 3)
+                gif->prevDisposal = 1;
+
+            if (!gifFrame(gif, x, y, fx, fy, fw, fh, flags & 0x40, cmap))
+                break;
+
+            int32_t delay = gif->delay;
+            gif->disposal = 0;
+            gif->transparent = -1;
+            gif->delay = 0;
+            gif->frames = true;
+            return delay;
+        } else if (block == 0x3B && !gif->read && gif->frames && gif->loops >= 0 &&
+                   (!gif->loops || ++gif->played <= gif->loops)) {
+            gif->inPos = gif->start; // Trailer, play again
+            gif->frames = false;
+        } else // Trailer or bad data
+            break;
+    }
+
+    gif->eof = true;
+    return -1;
+}
+
+/***************************************************************************************
+** Function name:           gifUpdate
+** Description:             Draw the next frame when it is due
+***************************************************************************************/
+bool gifUpdate(gifDecoder *gif, int32_t x, int32_t y, uint32_t now)
+{
+    if (gif->running && (int32_t)(now - gif->due) < 0)
+        return true;
+
+    int32_t delay = gifStep(gif, x, y);
+    if (delay < 0)
+        return false;
+
+    // Keep to the frame timing unless a whole frame behind
+    if (gif->running && (int32_t)(now - gif->due) < delay)
+        gif->due += delay;
+    else
+        gif->due = now + delay;
+    gif->running = true;
+
+    return true;
+}
+
+#endif // LOAD_GIF
@@ -0,0 +1,75 @@
+#pragma once
+
+// Animated GIF player drawing straight to the TFT, see tft_gif.c
+
+#ifdef LOAD_GIF
+
+#ifndef GIF_INPUT_BUFFER
+#define GIF_INPUT_BUFFER 256 // Bytes fetched per imageReadCallback call
+#endif
+
+#ifndef GIF_MAX_WIDTH
+#define GIF_MAX_WIDTH 320 // Widest frame, sets the size of the line buffer
+#endif
+
+// Define GIF_RESTORE_PIXELS (e.g. 4096) to keep the area under frames with disposal method 3
+// (restore previous) when it fits, otherwise such frames are left in place as with method 1
+//#define GIF_RESTORE_PIXELS 4096
+
+typedef struct {
+    uint16_t width, height; // Logical screen size, valid after gifOpen()
+    uint16_t bg; // RGB565 colour for disposal method 2, from the GIF but may be changed
+    int32_t loops; // NETSCAPE2.0 loop count once read, 0 repeats forever, -1 (none) plays once
+
+    // Data source
+    const uint8_t *in;
+    uint32_t inLen, inPos;
+    imageReadCallback read;
+    void *ctx; // Passed to the read callback
+    bool eof;
+    uint32_t start; // Offset of the first frame in memory, to loop
+
+    // Graphic control extension for the next frame
+    uint8_t disposal;
+    int16_t transparent; // Palette index, -1 for none
+    uint32_t delay; // ms
+
+    // Previous frame, disposed of before the next is drawn
+    uint8_t prevDisposal;
+    uint16_t px, py, pw, ph;
+
+    uint16_t played; // Completed passes through the frames
+    bool frames; // A frame was drawn in this pass
+    bool running; // gifUpdate() has drawn a frame, due is valid
+    uint32_t due; // gifUpdate() time of the next frame
+
+    // LZW
+    uint8_t blockLeft; // Bytes left in the current data sub-block
+    uint8_t bitCnt;
+    uint32_t bitBuf;
+    uint16_t prefix[4096];
+    uint8_t suffix[4096];
+    uint8_t stack[4096];
+
+    uint16_t global[256], local[256]; // RGB565 colour tables
+    uint8_t line[GIF_MAX_WIDTH]; // Palette indices of the row being decoded
+#ifdef GIF_RESTORE_PIXELS
+    uint16_t restore[GIF_RESTORE_PIXELS];
+#endif
+    uint8_t buffer[GIF_INPUT_BUFFER];
+} gifDecoder;
+
+// Read the header of a GIF held in memory (data, size) or, if data is NULL, fetched through
+// read(ctx, ...). Only GIFs in memory can loop. The decoder is about 18kB, it is best made static
+bool gifOpen(gifDecoder *gif, const uint8_t *data, uint32_t size, imageReadCallback read, void *ctx);
+
+// Draw the next frame with the logical screen's top left at x,y. Only the frame's rectangle is
+// drawn, through pushImagePal8() with the palette. Returns the ms to show it for, or -1 once the
+// animation has ended or the data is bad
+int32_t gifStep(gifDecoder *gif, int32_t x, int32_t y);
+
+// Call from the main loop with a free running ms clock, draws the next frame once the
+// current one has been shown for its delay. Returns false once the animation has ended
+bool gifUpdate(gifDecoder *gif, int32_t x, int32_t y, uint32_t now);
+
+#endif // LOAD_GIF
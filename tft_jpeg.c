@@ -0,0 +1,547 @@
+/***************************************************
+  Baseline JPEG decoder for the TFT library.
+
+  Huffman coded sequential JPEG (SOF0/SOF1) with
+  8-bit samples is decoded an MCU at a time in a
+  fixed work area. MCUs are gathered into small
+  rectangles that are sent by DMA while the next
+  rectangle is decoded. An integer IDCT of size 8,
+  4, 2 or 1 gives 1/1, 1/2, 1/4 and 1/8 scaling,
+  the smaller sizes using fewer coefficients.
+ ****************************************************/
+
+#include "board.h"
+
+#ifdef LOAD_JPEG
+
+// Natural order position of each zigzag coefficient
+static const uint8_t jpegZigzag[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63
+};
+
+// IDCT basis, 4096 * C(u) * cos((2x + 1) * u * pi / 2n) for x (row) and u (column) < n.
+// The reduced sizes reconstruct the block from its n x n lowest frequencies
+static const int16_t jpegCos8[64] = {
+    2896,  4017,  3784,  3406,  2896,  2276,  1567,   799,
+    2896,  3406,  1567,  -799, -2896, -4017, -3784, -2276,
+    2896,  2276, -1567, -4017, -2896,   799,  3784,  3406,
+    2896,   799, -3784, -2276,  2896,  3406, -1567, -4017,
+    2896,  -799, -3784,  2276,  2896, -3406, -1567,  4017,
+    2896, -2276, -1567,  4017, -2896,  -799,  3784, -3406,
+    2896, -3406,  1567,   799, -2896,  4017, -3784,  2276,
+    2896, -4017,  3784, -3406,  2896, -2276,  1567,  -799
+};
+
+static const int16_t jpegCos4[16] = {
+    2896,  3784,  2896,  1567,
+    2896,  1567, -2896, -3784,
+    2896, -1567, -2896,  3784,
+    2896, -3784,  2896, -1567
+};
+
+static const int16_t jpegCos2[4] = {
+    2896,  2896,
+    2896, -2896
+};
+
+static uint8_t jpegClamp(int32_t v)
+{
+    return (v < 0) ? 0 : (v > 255) ? 255 : v;
+}
+
+// Dequantised coefficients are limited so corrupt data can't overflow the IDCT
+static int16_t jpegCoef(int32_t v)
+{
+    return (v < -2047) ? -2047 : (v > 2047) ? 2047 : v;
+}
+
+/***************************************************************************************
+** Function name:           jpegByte
+** Description:             Fetch the next byte of the compressed data, 0 past the end
+***************************************************************************************/
+static uint8_t jpegByte(jpegDecoder *j)
+{
+    if (j->inPos >= j->inLen) {
+        if (j->read)
+            j->inLen = j->read(j->ctx, j->buffer, JPEG_INPUT_BUFFER);
+        else
+            j->inLen = 0;
+        j->inPos = 0;
+        if (!j->inLen) {
+            j->eof = true;
+            return 0;
+        }
+    }
+
+    return j->in[j->inPos++];
+}
+
+static uint16_t jpegWord(jpegDecoder *j)
+{
+    uint16_t w = jpegByte(j) << 8;
+    return w | jpegByte(j);
+}
+
+static void jpegSkip(jpegDecoder *j, uint32_t len)
+{
+    while (len-- && !j->eof)
+        jpegByte(j);
+}
+
+/***************************************************************************************
+** Function name:           jpegFill
+** Description:             Top up the bit buffer to at least 25 bits
+***************************************************************************************/
+static void jpegFill(jpegDecoder *j)
+{
+    while (j->bitCnt <= 24) {
+        uint8_t b = 0;
+
+        // Once a marker is hit the scan is padded with zeros
+        if (!j->marker && !j->eof) {
+            b = jpegByte(j);
+            if (b == 0xFF) {
+                uint8_t m = jpegByte(j);
+                while (m == 0xFF && !j->eof)
+                    m = jpegByte(j); // Fill bytes
+                if (m) {
+                    j->marker = m;
+                    b = 0;
+                }
+            }
+        }
+
+        j->bitBuf |= (uint32_t)b << (24 - j->bitCnt);
+        j->bitCnt += 8;
+    }
+}
+
+static int32_t jpegBits(jpegDecoder *j, uint8_t n)
+{
+    if (!n)
+        return 0;
+
+    jpegFill(j);
+    int32_t v = j->bitBuf >> (32 - n);
+    j->bitBuf <<= n;
+    j->bitCnt -= n;
+
+    // Values with a leading 0 bit are negative
+    if (v < (1 << (n - 1)))
+        v += 1 - (1 << n);
+
+    return v;
+}
+
+static uint8_t jpegHuff(jpegDecoder *j, const jpegHuffman *h)
+{
+    jpegFill(j);
+
+    uint32_t code = j->bitBuf >> 16;
+    uint8_t len = 1;
+
+    while (len <= 16 && code >= h->limit[len])
+        len++;
+
+    if (len > 16) {
+        j->error = true;
+        return 0;
+    }
+
+    j->bitBuf <<= len;
+    j->bitCnt -= len;
+
+    return h->values[(h->offset[len] + (code >> (16 - len))) & 0xFF];
+}
+
+/***************************************************************************************
+** Function name:           jpegDQT, jpegDHT
+** Description:             Read quantisation and Huffman table segments
+***************************************************************************************/
+static bool jpegDQT(jpegDecoder *j, int32_t len)
+{
+    while (len > 0) {
+        uint8_t pq = jpegByte(j);
+        uint8_t tq = pq & 3;
+        for (uint8_t k = 0; k < 64; k++)
+            j->qt[tq][k] = (pq >> 4) ? jpegWord(j) : jpegByte(j);
+        len -= (pq >> 4) ? 129 : 65;
+    }
+
+    return len == 0 && !j->eof;
+}
+
+static bool jpegDHT(jpegDecoder *j, int32_t len)
+{
+    while (len > 17) {
+        uint8_t tc = jpegByte(j);
+        if ((tc & 0x0F) > 1 || (tc >> 4) > 1)
+            return false;
+
+        jpegHuffman *h = &j->huff[((tc >> 4) << 1) | (tc & 1)];
+        uint8_t counts[17];
+        uint16_t total = 0;
+
+        for (uint8_t i = 1; i <= 16; i++) {
+            counts[i] = jpegByte(j);
+            total += counts[i];
+        }
+        if (total > 256)
+            return false;
+
+        for (uint16_t i = 0; i < total; i++)
+            h->values[i] = jpegByte(j);
+
+        // Canonical codes, each length starts where the previous ended, doubled
+        uint32_t code = 0;
+        uint16_t index = 0;
+        for (uint8_t i = 1; i <= 16; i++) {
+            h->offset[i] = index - code;
+            code += counts[i];
+            index += counts[i];
+            h->limit[i] = counts[i] ? code << (16 - i) : 0;
+            code <<= 1;
+        }
+
+        len -= 17 + total;
+    }
+
+    return len == 0 && !j->eof;
+}
+
+/***************************************************************************************
+** Function name:           jpegOpen
+** Description:             Parse the headers up to the start of the scan
+***************************************************************************************/
+bool jpegOpen(jpegDecoder *j, const uint8_t *data, uint32_t size, imageReadCallback read, void *ctx)
+{
+    memset(j, 0, sizeof(jpegDecoder));
+
+    j->in = data ? data : j->buffer;
+    j->inLen = data ? size : 0;
+    j->read = data ? NULL : read;
+    j->ctx = ctx;
+
+    if (jpegByte(j) != 0xFF || jpegByte(j) != 0xD8)
+        return false;
+
+    bool frame = false;
+
+    while (!j->eof) {
+        uint8_t m = jpegByte(j);
+        if (m != 0xFF)
+            continue;
+        while (m == 0xFF && !j->eof)
+            m = jpegByte(j);
+
+        if (m == 0xD8 || (m >= 0xD0 && m <= 0xD7) || m == 0x01 || m == 0x00)
+            continue; // No length field
+        if (m == 0xD9)
+            return false; // End of image before any scan
+
+        int32_t len = jpegWord(j) - 2;
+        if (len < 0)
+            return false;
+
+        switch (m) {
+        case 0xC0: // Baseline
+        case 0xC1: // Extended sequential, Huffman
+            if (jpegByte(j) != 8)
+                return false;
+            j->height = jpegWord(j);
+            j->width = jpegWord(j);
+            j->components = jpegByte(j);
+            if ((j->components != 1 && j->components != 3) || !j->width || !j->height)
+                return false;
+            j->hMax = j->vMax = 1;
+            for (uint8_t c = 0; c < j->components; c++) {
+                jpegComponent *comp = &j->comp[c];
+                comp->id = jpegByte(j);
+                uint8_t hv = jpegByte(j);
+                comp->tq = jpegByte(j) & 3;
+                comp->h = (j->components == 1) ? 1 : hv >> 4;
+                comp->v = (j->components == 1) ? 1 : hv & 15;
+                if (comp->h < 1 || comp->h > 2 || comp->v < 1 || comp->v > 2)
+                    return false;
+                if (comp->h > j->hMax)
+                    j->hMax = comp->h;
+                if (comp->v > j->vMax)
+                    j->vMax = comp->v;
+            }
+            frame = true;
+            break;
+
+        case 0xC4:
+            if (!jpegDHT(j, len))
+                return false;
+            break;
+
+        case 0xDB:
+            if (!jpegDQT(j, len))
+                return false;
+            break;
+
+        case 0xDD:
+            j->restartInterval = jpegWord(j);
+            jpegSkip(j, len - 2);
+            break;
+
+        case 0xDA: { // Start of scan, the entropy coded data follows
+            uint8_t ns = jpegByte(j);
+            if (!frame || ns != j->components)
+                return false; // Progressive or non-interleaved scans are not handled
+            for (uint8_t i = 0; i < ns; i++) {
+                uint8_t id = jpegByte(j);
+                uint8_t t = jpegByte(j);
+                if (j->comp[i].id != id)
+                    return false; // MCUs are decoded in frame component order
+                j->comp[i].td = (t >> 4) & 1;
+                j->comp[i].ta = 2 | (t & 1);
+            }
+            jpegSkip(j, 3); // Spectral selection and approximation
+            return !j->eof;
+        }
+
+        default:
+            if ((m & 0xF0) == 0xC0 && m != 0xC8 && m != 0xCC)
+                return false; // Progressive, lossless or arithmetic coded
+            jpegSkip(j, len); // APPn, COM etc.
+            break;
+        }
+    }
+
+    return false;
+}
+
+/***************************************************************************************
+** Function name:           jpegBlock
+** Description:             Decode and dequantise one 8x8 block into coef[]
+***************************************************************************************/
+static void jpegBlock(jpegDecoder *j, jpegComponent *c)
+{
+    int16_t *coef = j->coef;
+    const uint16_t *q = j->qt[c->tq];
+
+    memset(coef, 0, sizeof(j->coef));
+
+    c->dc += jpegBits(j, jpegHuff(j, &j->huff[c->td]) & 15);
+    coef[0] = jpegCoef(c->dc * q[0]);
+
+    for (uint8_t k = 1; k < 64;) {
+        uint8_t rs = jpegHuff(j, &j->huff[c->ta]);
+        uint8_t s = rs & 15;
+
+        if (!s) {
+            if (rs != 0xF0)
+                break; // End of block
+            k += 16;
+            continue;
+        }
+
+        k += rs >> 4;
+        if (k > 63)
+            break;
+
+        int32_t v = jpegBits(j, s);
+        uint8_t z = jpegZigzag[k++];
+
+        // Coefficients beyond the scaled IDCT size are not needed
+        if ((z & 7) < c->nx && (z >> 3) < c->ny)
+            coef[z] = jpegCoef(v * q[k - 1]);
+    }
+}
+
+/***************************************************************************************
+** Function name:           jpegIDCT
+** Description:             Reconstruct nx x ny samples from the lowest frequencies in coef[]
+***************************************************************************************/
+static const int16_t *jpegBasis(uint8_t n)
+{
+    static const int16_t dc = 2896;
+
+    return (n == 8) ? jpegCos8 : (n == 4) ? jpegCos4 : (n == 2) ? jpegCos2 : &dc;
+}
+
+static void jpegIDCT(const int16_t *coef, uint8_t *out, uint8_t stride, uint8_t nx, uint8_t ny)
+{
+    if (nx == 1 && ny == 1) {
+        *out = jpegClamp(((coef[0] + 4) >> 3) + 128);
+        return;
+    }
+
+    const int16_t *kx = jpegBasis(nx);
+    const int16_t *ky = jpegBasis(ny);
+    int32_t t[64]; // Columns transformed, 2 fraction bits
+
+    for (uint8_t u = 0; u < nx; u++) {
+        bool ac = false;
+        for (uint8_t v = 1; v < ny; v++)
+            ac |= coef[v * 8 + u] != 0;
+
+        if (!ac) { // Flat column
+            int32_t dc = (coef[u] * 2896 + 512) >> 10;
+            for (uint8_t y = 0; y < ny; y++)
+                t[y * 8 + u] = dc;
+            continue;
+        }
+
+        for (uint8_t y = 0; y < ny; y++) {
+            int32_t s = 512;
+            for (uint8_t v = 0; v < ny; v++)
+                s += ky[y * ny + v] * coef[v * 8 + u];
+            t[y * 8 + u] = s >> 10;
+        }
+    }
+
+    for (uint8_t y = 0; y < ny; y++) {
+        for (uint8_t x = 0; x < nx; x++) {
+            int32_t s = 1 << 15;
+            for (uint8_t u = 0; u < nx; u++)
+                s += kx[x * nx + u] * t[y * 8 + u];
+            out[x] = jpegClamp((s >> 16) + 128);
+        }
+        out += stride;
+    }
+}
+
+/***************************************************************************************
+** Function name:           jpegRestart
+** Description:             Skip to the next RSTn marker and reset the predictors
+***************************************************************************************/
+static void jpegRestart(jpegDecoder *j)
+{
+    j->bitBuf = 0;
+    j->bitCnt = 0;
+
+    if (!j->marker) {
+        while (!j->eof) {
+            if (jpegByte(j) != 0xFF)
+                continue;
+            uint8_t m = jpegByte(j);
+            while (m == 0xFF && !j->eof)
+                m = jpegByte(j);
+            if (m >= 0xD0 && m <= 0xD7)
+                break;
+        }
+    }
+    j->marker = 0;
+
+    for (uint8_t c = 0; c < j->components; c++)
+        j->comp[c].dc = 0;
+}
+
+/***************************************************************************************
+** Function name:           jpegDecode
+** Description:             Decode the scan and draw it with the top left at x,y
+***************************************************************************************/
+bool jpegDecode(jpegDecoder *j, int32_t x, int32_t y, uint8_t scale, imageOutputCallback output)
+{
+    if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+        return false;
+
+    uint8_t n = 8 / scale; // Block size after scaling
+    int32_t mcuW = j->hMax * n;
+    int32_t mcuH = j->vMax * n;
+    int32_t mcusX = (j->width + 8 * j->hMax - 1) / (8 * j->hMax);
+    int32_t mcusY = (j->height + 8 * j->vMax - 1) / (8 * j->vMax);
+    int32_t outW = (j->width + scale - 1) / scale;
+    int32_t outH = (j->height + scale - 1) / scale;
+    int32_t group = JPEG_OUTPUT_PIXELS / (mcuW * mcuH); // MCUs per rectangle
+    uint16_t restarts = 0;
+    uint8_t cur = 0;
+
+    // Subsampled components are scaled less where possible so they need no upsampling
+    for (uint8_t c = 0; c < j->components; c++) {
+        jpegComponent *comp = &j->comp[c];
+        comp->nx = (n < 8 && comp->h < j->hMax) ? 2 * n : n;
+        comp->ny = (n < 8 && comp->v < j->vMax) ? 2 * n : n;
+        comp->sx = (comp->h * comp->nx < mcuW);
+        comp->sy = (comp->v * comp->ny < mcuH);
+    }
+
+    for (int32_t my = 0; my < mcusY; my++) {
+        int32_t ry = my * mcuH;
+        int32_t rh = (outH - ry < mcuH) ? outH - ry : mcuH;
+
+        for (int32_t mx = 0; mx < mcusX; mx += group) {
+            int32_t gn = (mcusX - mx < group) ? mcusX - mx : group;
+            int32_t rx = mx * mcuW;
+            int32_t rw = (outW - rx < gn * mcuW) ? outW - rx : gn * mcuW;
+            uint16_t *buf = j->out[cur];
+
+            for (int32_t g = 0; g < gn; g++) {
+                if (j->restartInterval) {
+                    if (restarts == j->restartInterval) {
+                        jpegRestart(j);
+                        restarts = 0;
+                    }
+                    restarts++;
+                }
+
+                for (uint8_t c = 0; c < j->components; c++) {
+                    jpegComponent *comp = &j->comp[c];
+                    uint8_t stride = comp->h * comp->nx;
+                    for (uint8_t by = 0; by < comp->v; by++) {
+                        for (uint8_t bx = 0; bx < comp->h; bx++) {
+                            jpegBlock(j, comp);
+                            jpegIDCT(j->coef, j->plane[c] + by * comp->ny * stride + bx * comp->nx, stride, comp->nx, comp->ny);
+                        }
+                    }
+                }
+
+                if (j->error)
+                    return false;
+
+                // Colour convert the visible part of the MCU into the rectangle
+                int32_t cols = rw - g * mcuW;
+                if (cols > mcuW)
+                    cols = mcuW;
+                for (int32_t py = 0; py < rh; py++) {
+                    uint16_t *ptr = buf + py * rw + g * mcuW;
+                    const uint8_t *yp = j->plane[0] + (py >> j->comp[0].sy) * j->comp[0].h * j->comp[0].nx;
+
+                    if (j->components == 1) {
+                        for (int32_t px = 0; px < cols; px++) {
+                            uint8_t l = yp[px];
+                            *ptr++ = color565(l, l, l);
+                        }
+                        continue;
+                    }
+
+                    const uint8_t *cbp = j->plane[1] + (py >> j->comp[1].sy) * j->comp[1].h * j->comp[1].nx;
+                    const uint8_t *crp = j->plane[2] + (py >> j->comp[2].sy) * j->comp[2].h * j->comp[2].nx;
+                    for (int32_t px = 0; px < cols; px++) {
+                        int32_t l = yp[px >> j->comp[0].sx];
+                        int32_t cb = cbp[px >> j->comp[1].sx] - 128;
+                        int32_t cr = crp[px >> j->comp[2].sx] - 128;
+                        // ITU-R BT.601 full range, 16 fraction bits
+                        *ptr++ = color565(jpegClamp(l + ((91881 * cr + 32768) >> 16)),
+                                          jpegClamp(l - ((22554 * cb + 46802 * cr - 32768) >> 16)),
+                                          jpegClamp(l + ((116130 * cb + 32768) >> 16)));
+                    }
+                }
+            }
+
+            if (output)
+                output(j->ctx, x + rx, y + ry, rw, rh, buf);
+            else
+                pushImageDMA(x + rx, y + ry, rw, rh, buf);
+
+            cur ^= 1; // Fill the other buffer while this one is sent
+        }
+    }
+
+    if (!output)
+        dmaWait();
+
+    return true;
+}
+
+#endif // LOAD_JPEG
@@ -0,0 +1,73 @@
+#pragma once
+
+// Baseline JPEG decoder drawing straight to the TFT, see tft_jpeg.c
+
+#ifdef LOAD_JPEG
+
+#ifndef JPEG_INPUT_BUFFER
+#define JPEG_INPUT_BUFFER 256 // Bytes fetched per imageReadCallback call
+#endif
+
+#ifndef JPEG_OUTPUT_PIXELS
+#define JPEG_OUTPUT_PIXELS 512 // Pixels in each of the two output buffers, at least 256 (one 16x16 MCU)
+#endif
+
+#if JPEG_OUTPUT_PIXELS < 256
+#error JPEG_OUTPUT_PIXELS must hold one 16x16 MCU, at least 256
+#endif
+
+typedef struct {
+    uint32_t limit[17]; // Codes of each length are below this, left aligned to 16 bits
+    int32_t offset[17]; // values[] index minus the first code of each length
+    uint8_t values[256]; // Symbols in code order
+} jpegHuffman;
+
+typedef struct {
+    uint8_t id; // Component identifier from the frame header
+    uint8_t h, v; // Sampling factors, 1 or 2
+    uint8_t tq; // Quantisation table
+    uint8_t td, ta; // DC and AC Huffman tables
+    uint8_t nx, ny; // Scaled block size
+    uint8_t sx, sy; // Shift from MCU pixel to component sample, 0 or 1
+    int16_t dc; // DC predictor
+} jpegComponent;
+
+typedef struct {
+    uint16_t width, height; // Image size, valid after jpegOpen()
+
+    // Compressed data source
+    const uint8_t *in;
+    uint32_t inLen, inPos;
+    imageReadCallback read;
+    void *ctx; // Passed to the read and output callbacks
+    bool eof;
+
+    // Entropy decoder
+    uint32_t bitBuf; // Next bits, left aligned
+    int8_t bitCnt;
+    uint8_t marker; // Marker found in the entropy coded data, 0 if none
+    bool error;
+
+    uint8_t components;
+    uint8_t hMax, vMax;
+    uint16_t restartInterval;
+    jpegComponent comp[3];
+    uint16_t qt[4][64]; // Quantisation tables in zigzag order
+    jpegHuffman huff[4]; // DC 0, DC 1, AC 0, AC 1
+
+    int16_t coef[64]; // Block being decoded
+    uint8_t plane[3][256]; // Samples of one MCU per component
+    uint16_t out[2][JPEG_OUTPUT_PIXELS]; // RGB565 rectangles, one is sent while the other is filled
+    uint8_t buffer[JPEG_INPUT_BUFFER];
+} jpegDecoder;
+
+// Read the headers of a JPEG held in memory (data, size) or, if data is NULL, fetched through
+// read(ctx, ...). Baseline and extended Huffman, 8-bit greyscale or YCbCr with sampling factors
+// 1 or 2. Returns false for anything else. The decoder is about 5kB, it can be static or on the stack
+bool jpegOpen(jpegDecoder *jpeg, const uint8_t *data, uint32_t size, imageReadCallback read, void *ctx);
+
+// Decode the image with its top left at x,y scaled by 1/scale (1, 2, 4 or 8). The rectangles are
+// pushed to the TFT by DMA while the next is decoded, or given to output(ctx, ...) if not NULL
+bool jpegDecode(jpegDecoder *jpeg, int32_t x, int32_t y, uint8_t scale, imageOutputCallback output);
+
+#endif // LOAD_JPEG
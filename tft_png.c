@@ -0,0 +1,647 @@
+/***************************************************
+  Streaming PNG decoder for the TFT library.
+
+  The IDAT chunks are inflated through a circular
+  window of 1 << PNG_WINDOW_BITS bytes into two row
+  buffers, the current row and the previous one the
+  filters refer to. Each row is converted to RGB565
+  as soon as it is complete, indexed and grey images
+  through a 565 palette, and drawn with pushImageDMA()
+  or, where pixels are transparent and no background
+  colour is given, pushMaskedImage().
+ ****************************************************/
+
+#include "board.h"
+
+#ifdef LOAD_PNG
+
+#define PNG_WINDOW_MASK ((1UL << PNG_WINDOW_BITS) - 1)
+
+#define PNG_CHUNK(a, b, c, d) ((uint32_t)(a) << 24 | (uint32_t)(b) << 16 | (c) << 8 | (d))
+
+// Length and distance codes, base value and extra bits
+static const uint16_t pngLengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t pngLengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t pngDistBase[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const uint8_t pngDistExtra[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+// Order of the code length code lengths in a dynamic block header
+static const uint8_t pngCodeOrder[19] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/***************************************************************************************
+** Function name:           pngByte
+** Description:             Fetch the next byte of the file, 0 past the end
+***************************************************************************************/
+static uint8_t pngByte(pngDecoder *p)
+{
+    if (p->inPos >= p->inLen) {
+        if (p->read)
+            p->inLen = p->read(p->ctx, p->buffer, PNG_INPUT_BUFFER);
+        else
+            p->inLen = 0;
+        p->inPos = 0;
+        if (!p->inLen) {
+            p->eof = true;
+            return 0;
+        }
+    }
+
+    return p->in[p->inPos++];
+}
+
+static uint16_t pngWord(pngDecoder *p)
+{
+    uint16_t w = pngByte(p) << 8;
+    return w | pngByte(p);
+}
+
+static uint32_t pngLong(pngDecoder *p)
+{
+    uint32_t v = (uint32_t)pngWord(p) << 16;
+    return v | pngWord(p);
+}
+
+static void pngSkip(pngDecoder *p, uint32_t len)
+{
+    while (len-- && !p->eof)
+        pngByte(p);
+}
+
+/***************************************************************************************
+** Function name:           pngData
+** Description:             Fetch the next byte of the zlib stream across IDAT chunks
+***************************************************************************************/
+static uint8_t pngData(pngDecoder *p)
+{
+    while (!p->idatLeft) {
+        if (p->idatEnd || p->eof) {
+            // A few bytes of padding let the bit reader look ahead, more means the data is cut short
+            if (++p->pad > 4)
+                p->error = true;
+            return 0;
+        }
+        pngSkip(p, 4); // CRC, not checked
+        p->idatLeft = pngLong(p);
+        if (pngLong(p) != PNG_CHUNK('I', 'D', 'A', 'T')) {
+            p->idatLeft = 0;
+            p->idatEnd = true;
+        }
+    }
+
+    p->idatLeft--;
+    return pngByte(p);
+}
+
+static void pngNeed(pngDecoder *p, uint8_t n)
+{
+    while (p->bitCnt < n) {
+        p->bitBuf |= (uint32_t)pngData(p) << p->bitCnt;
+        p->bitCnt += 8;
+    }
+}
+
+static uint32_t pngBits(pngDecoder *p, uint8_t n)
+{
+    pngNeed(p, n);
+    uint32_t v = p->bitBuf & ((1UL << n) - 1);
+    p->bitBuf >>= n;
+    p->bitCnt -= n;
+    return v;
+}
+
+/***************************************************************************************
+** Function name:           pngBuild
+** Description:             Make a canonical Huffman table from code lengths
+***************************************************************************************/
+static bool pngBuild(pngHuffman *h, const uint8_t *lengths, uint16_t n)
+{
+    uint16_t offset[16];
+
+    memset(h->count, 0, sizeof(h->count));
+    for (uint16_t i = 0; i < n; i++)
+        h->count[lengths[i]]++;
+    h->count[0] = 0;
+
+    // Over-subscribed sets are invalid, incomplete ones (e.g. a single distance code) are allowed
+    int32_t left = 1;
+    for (uint8_t len = 1; len < 16; len++) {
+        left = (left << 1) - h->count[len];
+        if (left < 0)
+            return false;
+    }
+
+    offset[1] = 0;
+    for (uint8_t len = 1; len < 15; len++)
+        offset[len + 1] = offset[len] + h->count[len];
+    for (uint16_t i = 0; i < n; i++)
+        if (lengths[i])
+            h->symbol[offset[lengths[i]]++] = i;
+
+    // The short codes fill every fast table slot that starts with their bits, which arrive reversed
+    memset(h->fast, 0, sizeof(h->fast));
+    uint16_t code = 0, index = 0;
+    for (uint8_t len = 1; len <= PNG_FAST_BITS; len++) {
+        for (uint16_t k = 0; k < h->count[len]; k++, code++) {
+            uint16_t rev = 0;
+            for (uint8_t b = 0; b < len; b++)
+                rev |= ((code >> b) & 1) << (len - 1 - b);
+            for (uint16_t r = rev; r < (1 << PNG_FAST_BITS); r += 1 << len)
+                h->fast[r] = h->symbol[index + k] << 4 | len;
+        }
+        index += h->count[len];
+        code <<= 1;
+    }
+
+    return true;
+}
+
+/***************************************************************************************
+** Function name:           pngSymbol
+** Description:             Decode one Huffman coded symbol, -1 if the code is invalid
+***************************************************************************************/
+static int32_t pngSymbol(pngDecoder *p, const pngHuffman *h)
+{
+    pngNeed(p, 15);
+
+    uint16_t e = h->fast[p->bitBuf & ((1 << PNG_FAST_BITS) - 1)];
+    if (e) {
+        p->bitBuf >>= e & 15;
+        p->bitCnt -= e & 15;
+        return e >> 4;
+    }
+
+    // Longer codes, a bit at a time from the most significant
+    int32_t code = 0, first = 0, index = 0;
+    for (uint8_t len = 1; len < 16; len++) {
+        code |= p->bitBuf & 1;
+        p->bitBuf >>= 1;
+        p->bitCnt--;
+        int32_t count = h->count[len];
+        if (code - first < count)
+            return h->symbol[index + code - first];
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+    }
+
+    p->error = true;
+    return -1;
+}
+
+static uint8_t pngPaeth(uint8_t a, uint8_t b, uint8_t c)
+{
+    int16_t pa = abs(b - c);
+    int16_t pb = abs(a - c);
+    int16_t pc = abs(a + b - 2 * c);
+
+    return (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+}
+
+/***************************************************************************************
+** Function name:           pngOutput
+** Description:             Send the converted row, or its visible runs, true if it may still be in use
+***************************************************************************************/
+static bool pngOutput(pngDecoder *p, const uint16_t *line, uint16_t visible)
+{
+    int32_t y = p->y + p->row;
+    uint16_t w = p->width;
+
+    if (!visible)
+        return false;
+
+    if (visible == w) {
+        if (p->output)
+            p->output(p->ctx, p->x, y, w, 1, line);
+        else
+            pushImageDMA(p->x, y, w, 1, line);
+        return true;
+    }
+
+    if (!p->output) {
+        pushMaskedImage(p->x, y, w, 1, line, p->mask);
+        return false;
+    }
+
+    for (uint16_t x = 0; x < w;) {
+        while (x < w && !(p->mask[x >> 3] & (0x80 >> (x & 7))))
+            x++;
+        uint16_t start = x;
+        while (x < w && (p->mask[x >> 3] & (0x80 >> (x & 7))))
+            x++;
+        if (x > start)
+            p->output(p->ctx, p->x + start, y, x - start, 1, line + start);
+    }
+
+    return true; // The sink may send it by DMA too
+}
+
+/***************************************************************************************
+** Function name:           pngRow
+** Description:             Unfilter a complete row, convert it to RGB565 and draw it
+***************************************************************************************/
+static void pngRow(pngDecoder *p)
+{
+    uint8_t *s = p->rows[p->cur] + 1;
+    const uint8_t *prev = p->rows[p->cur ^ 1] + 1;
+    uint16_t n = p->rowBytes - 1;
+    uint8_t bpp = p->bpp;
+
+    p->rowPos = 0;
+
+    switch (s[-1]) {
+    case 0:
+        break;
+    case 1: // Sub
+        for (uint16_t i = bpp; i < n; i++)
+            s[i] += s[i - bpp];
+        break;
+    case 2: // Up
+        for (uint16_t i = 0; i < n; i++)
+            s[i] += prev[i];
+        break;
+    case 3: // Average
+        for (uint16_t i = 0; i < bpp; i++)
+            s[i] += prev[i] >> 1;
+        for (uint16_t i = bpp; i < n; i++)
+            s[i] += (s[i - bpp] + prev[i]) >> 1;
+        break;
+    case 4: // Paeth
+        for (uint16_t i = 0; i < bpp; i++)
+            s[i] += prev[i];
+        for (uint16_t i = bpp; i < n; i++)
+            s[i] += pngPaeth(s[i - bpp], prev[i], prev[i - bpp]);
+        break;
+    default:
+        p->error = true;
+        return;
+    }
+
+    uint16_t *line = p->out[p->line];
+    uint16_t w = p->width;
+    bool blend = p->bg <= 0xFFFF;
+    uint16_t visible = w;
+
+    if (!blend && p->transparent) {
+        memset(p->mask, 0, (w + 7) >> 3);
+        visible = 0;
+    }
+
+    if (p->colorType == 3 || (p->colorType == 0 && p->depth <= 8)) {
+        // Palette lookup, already blended with bg by pngDecode()
+        uint8_t depth = p->depth;
+        uint8_t max = (1 << depth) - 1;
+        for (uint16_t x = 0; x < w; x++) {
+            uint8_t i = (depth == 8) ? s[x] : (s[(x * depth) >> 3] >> (8 - depth - ((x * depth) & 7))) & max;
+            line[x] = p->cmap[i];
+            if (!blend && p->transparent && p->alpha[i] >= 128) {
+                p->mask[x >> 3] |= 0x80 >> (x & 7);
+                visible++;
+            }
+        }
+    } else {
+        // 8 or 16-bit samples, only the most significant byte is used except to match the tRNS key
+        uint8_t step = p->depth >> 3;
+        const uint8_t *px = s;
+        for (uint16_t x = 0; x < w; x++, px += bpp) {
+            uint16_t c;
+            uint8_t a = 255;
+
+            if (p->colorType & 2) {
+                c = color565(px[0], px[step], px[2 * step]);
+                if (p->colorType & 4)
+                    a = px[3 * step];
+                else if (p->key && ((step == 2) ? (px[0] << 8 | px[1]) == p->trns[0] && (px[2] << 8 | px[3]) == p->trns[1]
+                                    && (px[4] << 8 | px[5]) == p->trns[2] : px[0] == p->trns[0] && px[1] == p->trns[1] && px[2] == p->trns[2]))
+                    a = 0;
+            } else {
+                c = color565(px[0], px[0], px[0]);
+                if (p->colorType & 4)
+                    a = px[step];
+                else if (p->key && (px[0] << 8 | px[1]) == p->trns[0])
+                    a = 0; // Grey below 16 bits uses the palette
+            }
+
+            if (blend) {
+                line[x] = (a == 255) ? c : alphaBlend(a, c, p->bg);
+            } else {
+                line[x] = c;
+                if (a >= 128 && p->transparent) {
+                    p->mask[x >> 3] |= 0x80 >> (x & 7);
+                    visible++;
+                }
+            }
+        }
+    }
+
+    if (pngOutput(p, line, visible))
+        p->line ^= 1; // The row just sent may still be in flight
+    p->cur ^= 1;
+    p->row++;
+}
+
+static void pngPut(pngDecoder *p, uint8_t b)
+{
+    p->window[p->total++ & PNG_WINDOW_MASK] = b;
+    p->rows[p->cur][p->rowPos++] = b;
+
+    if (p->rowPos == p->rowBytes)
+        pngRow(p);
+}
+
+/***************************************************************************************
+** Function name:           pngTables
+** Description:             Read the code lengths of a dynamic block and build its tables
+***************************************************************************************/
+static bool pngTables(pngDecoder *p)
+{
+    uint8_t lengths[288 + 32];
+    uint16_t nlit = pngBits(p, 5) + 257;
+    uint16_t ndist = pngBits(p, 5) + 1;
+    uint8_t ncode = pngBits(p, 4) + 4;
+
+    if (nlit > 286 || ndist > 30)
+        return false;
+
+    // The code length code is built in the distance table, which is free until the end
+    memset(lengths, 0, 19);
+    for (uint8_t i = 0; i < ncode; i++)
+        lengths[pngCodeOrder[i]] = pngBits(p, 3);
+    if (!pngBuild(&p->dist, lengths, 19))
+        return false;
+
+    for (uint16_t i = 0; i < nlit + ndist;) {
+        int32_t sym = pngSymbol(p, &p->dist);
+        uint8_t len = 0;
+        uint8_t repeat = 1;
+
+        if (sym < 0)
+            return false;
+        if (sym < 16) {
+            len = sym;
+        } else if (sym == 16) {
+            if (!i)
+                return false;
+            len = lengths[i - 1];
+            repeat = 3 + pngBits(p, 2);
+        } else if (sym == 17) {
+            repeat = 3 + pngBits(p, 3);
+        } else {
+            repeat = 11 + pngBits(p, 7);
+        }
+
+        if (i + repeat > nlit + ndist)
+            return false;
+        while (repeat--)
+            lengths[i++] = len;
+    }
+
+    if (!lengths[256])
+        return false; // No end of block code
+
+    return pngBuild(&p->lit, lengths, nlit) && pngBuild(&p->dist, lengths + nlit, ndist);
+}
+
+/***************************************************************************************
+** Function name:           pngInflate
+** Description:             Inflate the zlib stream, drawing rows as they complete
+***************************************************************************************/
+static bool pngInflate(pngDecoder *p)
+{
+    uint8_t cmf = pngBits(p, 8);
+    uint8_t flg = pngBits(p, 8);
+
+    if ((cmf & 0x0F) != 8 || (cmf << 8 | flg) % 31 || (flg & 0x20))
+        return false; // Not deflate, bad check bits or preset dictionary
+
+    bool last = false;
+    while (!last && p->row < p->height) {
+        last = pngBits(p, 1);
+        uint8_t type = pngBits(p, 2);
+
+        if (type == 0) { // Stored
+            pngBits(p, p->bitCnt & 7);
+            uint16_t len = pngBits(p, 16);
+            if ((uint16_t)~len != pngBits(p, 16))
+                return false;
+            while (len-- && p->row < p->height && !p->error)
+                pngPut(p, pngBits(p, 8));
+            continue;
+        }
+
+        if (type == 1) { // Fixed codes
+            uint8_t lengths[288];
+            memset(lengths, 8, 144);
+            memset(lengths + 144, 9, 112);
+            memset(lengths + 256, 7, 24);
+            memset(lengths + 280, 8, 8);
+            pngBuild(&p->lit, lengths, 288);
+            memset(lengths, 5, 30);
+            pngBuild(&p->dist, lengths, 30);
+        } else if (type != 2 || !pngTables(p)) {
+            return false;
+        }
+
+        while (p->row < p->height && !p->error) {
+            int32_t sym = pngSymbol(p, &p->lit);
+
+            if (sym < 256) {
+                if (sym < 0)
+                    return false;
+                pngPut(p, sym);
+                continue;
+            }
+            if (sym == 256)
+                break; // End of block
+
+            sym -= 257;
+            if (sym >= 29)
+                return false;
+            uint16_t len = pngLengthBase[sym] + pngBits(p, pngLengthExtra[sym]);
+
+            sym = pngSymbol(p, &p->dist);
+            if (sym < 0 || sym >= 30)
+                return false;
+            uint32_t dist = pngDistBase[sym] + pngBits(p, pngDistExtra[sym]);
+            if (dist > p->total || dist > PNG_WINDOW_MASK + 1)
+                return false; // Before the start, or written with a larger window than this one
+
+            while (len-- && p->row < p->height)
+                pngPut(p, p->window[(p->total - dist) & PNG_WINDOW_MASK]);
+        }
+
+        if (p->error)
+            return false;
+    }
+
+    return p->row == p->height && !p->error; // The Adler-32 checksum is not checked
+}
+
+/***************************************************************************************
+** Function name:           pngOpen
+** Description:             Parse the chunks up to the first IDAT
+***************************************************************************************/
+bool pngOpen(pngDecoder *p, const uint8_t *data, uint32_t size, imageReadCallback read, void *ctx)
+{
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A };
+
+    memset(p, 0, sizeof(pngDecoder));
+
+    p->in = data ? data : p->buffer;
+    p->inLen = data ? size : 0;
+    p->read = data ? NULL : read;
+    p->ctx = ctx;
+
+    for (uint8_t i = 0; i < 8; i++)
+        if (pngByte(p) != signature[i])
+            return false;
+
+    bool header = false;
+    uint16_t colors = 0;
+
+    while (!p->eof) {
+        uint32_t len = pngLong(p);
+        uint32_t type = pngLong(p);
+
+        switch (type) {
+        case PNG_CHUNK('I', 'H', 'D', 'R'): {
+            uint32_t w = pngLong(p);
+            uint32_t h = pngLong(p);
+            p->depth = pngByte(p);
+            p->colorType = pngByte(p);
+            uint8_t compression = pngByte(p);
+            uint8_t filter = pngByte(p);
+            uint8_t interlace = pngByte(p);
+
+            // Allowed bit depths are 1, 2, 4, 8 and 16 for grey, 8 and 16 with more than one sample
+            static const uint8_t depths[7] = { 0x1F, 0, 0x18, 0x0F, 0x18, 0, 0x18 };
+            if (p->colorType > 6 || p->depth & (p->depth - 1) || p->depth > 16
+                    || !(depths[p->colorType] & p->depth) || compression || filter)
+                return false;
+            if (interlace || !w || !h || w > PNG_MAX_WIDTH || h > 0xFFFF)
+                return false; // Adam7 would need the whole image
+
+            static const uint8_t channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+            p->width = w;
+            p->height = h;
+            p->channels = channels[p->colorType];
+            p->rowBytes = 1 + (w * p->channels * p->depth + 7) / 8;
+            p->bpp = (p->channels * p->depth + 7) / 8;
+            p->transparent = p->colorType & 4;
+            if (p->rowBytes > sizeof(p->rows[0]))
+                return false;
+            header = true;
+            pngSkip(p, 4);
+            continue;
+        }
+
+        case PNG_CHUNK('P', 'L', 'T', 'E'):
+            if (!header || len % 3 || len > 768)
+                return false;
+            colors = len / 3;
+            for (uint16_t i = 0; i < colors; i++) {
+                uint8_t r = pngByte(p);
+                uint8_t g = pngByte(p);
+                p->cmap[i] = color565(r, g, pngByte(p));
+            }
+            pngSkip(p, 4);
+            continue;
+
+        case PNG_CHUNK('t', 'R', 'N', 'S'):
+            if (!header)
+                return false;
+            if (p->colorType == 3) {
+                if (len > 256)
+                    return false;
+                memset(p->alpha, 255, sizeof(p->alpha));
+                for (uint16_t i = 0; i < len; i++)
+                    p->alpha[i] = pngByte(p);
+                p->transparent = true;
+                pngSkip(p, 4);
+                continue;
+            }
+            if ((p->colorType == 0 && len == 2) || (p->colorType == 2 && len == 6)) {
+                for (uint8_t i = 0; i < len / 2; i++)
+                    p->trns[i] = pngWord(p);
+                p->key = true;
+                p->transparent = true;
+                pngSkip(p, 4);
+                continue;
+            }
+            break; // Not valid for this colour type, ignored
+
+        case PNG_CHUNK('I', 'D', 'A', 'T'):
+            if (!header || (p->colorType == 3 && !colors))
+                return false;
+            p->idatLeft = len;
+            return !p->eof;
+
+        case PNG_CHUNK('I', 'E', 'N', 'D'):
+            return false;
+
+        default:
+            if (!(type & 0x20000000))
+                return false; // Unknown critical chunk
+            break;
+        }
+
+        pngSkip(p, len + 4); // Ancillary chunk and CRC
+    }
+
+    return false;
+}
+
+/***************************************************************************************
+** Function name:           pngDecode
+** Description:             Decode the image and draw it with the top left at x,y
+***************************************************************************************/
+bool pngDecode(pngDecoder *p, int32_t x, int32_t y, uint32_t bg, imageOutputCallback output)
+{
+    p->x = x;
+    p->y = y;
+    p->bg = bg;
+    p->output = output;
+
+    if (p->colorType == 0 && p->depth <= 8) {
+        // Grey levels go through the palette like indexed colours
+        uint8_t max = (1 << p->depth) - 1;
+        for (uint16_t i = 0; i <= max; i++) {
+            uint8_t l = i * 255 / max;
+            p->cmap[i] = color565(l, l, l);
+            p->alpha[i] = (p->key && i == p->trns[0]) ? 0 : 255;
+        }
+    } else if (p->colorType == 3 && !p->transparent) {
+        memset(p->alpha, 255, sizeof(p->alpha));
+    }
+
+    // The palette is blended once, rather than every pixel
+    if (bg <= 0xFFFF && (p->colorType == 3 || p->colorType == 0))
+        for (uint16_t i = 0; i < 256; i++)
+            if (p->alpha[i] < 255)
+                p->cmap[i] = alphaBlend(p->alpha[i], p->cmap[i], bg);
+
+    bool ok = pngInflate(p);
+
+    if (!output)
+        dmaWait();
+
+    return ok;
+}
+
+#endif // LOAD_PNG
@@ -0,0 +1,89 @@
+#pragma once
+
+// Streaming PNG decoder drawing straight to the TFT, see tft_png.c
+
+#ifdef LOAD_PNG
+
+#ifndef PNG_INPUT_BUFFER
+#define PNG_INPUT_BUFFER 256 // Bytes fetched per imageReadCallback call
+#endif
+
+#ifndef PNG_WINDOW_BITS
+#define PNG_WINDOW_BITS 15 // Inflate window of 1 << PNG_WINDOW_BITS bytes, 8 to 15
+#endif
+
+#ifndef PNG_MAX_WIDTH
+#define PNG_MAX_WIDTH 320 // Widest image, sets the size of the row and line buffers
+#endif
+
+#define PNG_FAST_BITS 9 // Huffman codes up to this length are decoded with one table lookup
+
+// pngDecode() bg value that leaves transparent pixels undrawn instead of blending them
+#define PNG_NO_BACKGROUND 0x10000
+
+typedef struct {
+    uint16_t fast[1 << PNG_FAST_BITS]; // symbol << 4 | code length indexed by the next bits, 0 if longer
+    uint16_t count[16]; // Codes of each length
+    uint16_t symbol[288]; // Symbols in code order
+} pngHuffman;
+
+typedef struct {
+    uint16_t width, height; // Image size, valid after pngOpen()
+    uint8_t depth; // Bits per sample
+    uint8_t colorType; // 0 grey, 2 RGB, 3 indexed, 4 grey and alpha, 6 RGBA
+    bool transparent; // Alpha channel or tRNS chunk present
+
+    // Compressed data source
+    const uint8_t *in;
+    uint32_t inLen, inPos;
+    imageReadCallback read;
+    void *ctx; // Passed to the read and output callbacks
+    bool eof;
+    uint32_t idatLeft; // Bytes left in the current IDAT chunk
+    bool idatEnd; // A chunk other than IDAT followed
+    uint8_t pad; // Zero bytes supplied past the end of the data
+
+    // Inflate
+    uint32_t bitBuf; // Next bits, least significant first
+    uint8_t bitCnt;
+    bool error;
+    uint32_t total; // Bytes inflated so far
+    pngHuffman lit, dist;
+    uint8_t window[1 << PNG_WINDOW_BITS];
+
+    // Rows
+    uint8_t channels;
+    uint8_t bpp; // Bytes per complete pixel for the filters, at least 1
+    uint16_t rowBytes; // Filtered row size including the filter type byte
+    uint16_t rowPos, row;
+    uint8_t cur; // rows[] index being filled, the other holds the previous row
+    uint8_t rows[2][PNG_MAX_WIDTH * 4 + 1];
+    bool key; // tRNS colour key of a grey or RGB image
+    uint16_t trns[3];
+    uint16_t cmap[256]; // RGB565 palette, also used for grey up to 8 bits
+    uint8_t alpha[256]; // Palette alpha from tRNS
+
+    // Output
+    int32_t x, y;
+    uint32_t bg;
+    imageOutputCallback output;
+    uint8_t line; // out[] index being filled, the other may still be sent by DMA
+    uint16_t out[2][PNG_MAX_WIDTH];
+    uint8_t mask[(PNG_MAX_WIDTH + 7) / 8]; // Visible pixels of the row when not blending
+    uint8_t buffer[PNG_INPUT_BUFFER];
+} pngDecoder;
+
+// Read the headers of a PNG held in memory (data, size) or, if data is NULL, fetched through
+// read(ctx, ...). Any colour type and bit depth up to PNG_MAX_WIDTH wide (16-bit RGB to two thirds
+// of that, 16-bit RGBA to half), not interlaced. Returns false for anything else. The decoder is about 41kB with the default
+// 32kB window (12kB with PNG_WINDOW_BITS 12), it is best made static
+bool pngOpen(pngDecoder *png, const uint8_t *data, uint32_t size, imageReadCallback read, void *ctx);
+
+// Decode the image row by row with its top left at x,y. Transparent pixels are blended with the
+// RGB565 colour bg, or with bg PNG_NO_BACKGROUND pixels under 50% alpha are left undrawn. Rows go
+// to the TFT, or to output(ctx, ...) if not NULL (only the drawn runs without a background).
+// Fails if the data refers back further than the window. Encoders like libpng shrink the window
+// to the image data, so anything with fewer filtered bytes than the window always decodes
+bool pngDecode(pngDecoder *png, int32_t x, int32_t y, uint32_t bg, imageOutputCallback output);
+
+#endif // LOAD_PNG
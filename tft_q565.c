@@ -0,0 +1,145 @@
+/***************************************************
+  Q565 lossless image decoder for the TFT library.
+
+  Q565 is a QOI style byte code for RGB565 pixels,
+  see Tools/q565_pack.py for the format. Every op
+  is decoded with a few shifts and adds straight
+  into a band of whole rows, so one pass produces
+  display ready pixels faster than SPI sends them.
+  Bands alternate between two buffers, one sent by
+  DMA while the other is filled.
+ ****************************************************/
+
+#include "board.h"
+
+#ifdef LOAD_Q565
+
+#define Q565_HASH(c) ((uint16_t)((c) * 0x9E37u) >> 10)
+
+/***************************************************************************************
+** Function name:           q565Byte
+** Description:             Fetch the next byte of the image, 0 past the end
+***************************************************************************************/
+static uint8_t q565Byte(q565Decoder *q)
+{
+    if (q->inPos >= q->inLen) {
+        if (q->read)
+            q->inLen = q->read(q->ctx, q->buffer, Q565_INPUT_BUFFER);
+        else
+            q->inLen = 0;
+        q->inPos = 0;
+        if (!q->inLen) {
+            q->eof = true;
+            return 0;
+        }
+    }
+
+    return q->in[q->inPos++];
+}
+
+static uint16_t q565Word(q565Decoder *q)
+{
+    uint16_t w = q565Byte(q);
+    return w | q565Byte(q) << 8;
+}
+
+/***************************************************************************************
+** Function name:           q565Open
+** Description:             Check the header and read the image size
+***************************************************************************************/
+bool q565Open(q565Decoder *q, const uint8_t *data, uint32_t size, imageReadCallback read, void *ctx)
+{
+    memset(q, 0, sizeof(q565Decoder));
+
+    q->in = data ? data : q->buffer;
+    q->inLen = data ? size : 0;
+    q->read = data ? NULL : read;
+    q->ctx = ctx;
+
+    if (q565Byte(q) != 'Q' || q565Byte(q) != '5' || q565Byte(q) != '6' || q565Byte(q) != '5')
+        return false;
+
+    q->width = q565Word(q);
+    q->height = q565Word(q);
+
+    return !q->eof && q->width && q->height && q->width <= Q565_OUTPUT_PIXELS;
+}
+
+/***************************************************************************************
+** Function name:           q565Decode
+** Description:             Decode the image and draw it with the top left at x,y
+***************************************************************************************/
+bool q565Decode(q565Decoder *q, int32_t x, int32_t y, imageOutputCallback output)
+{
+    uint16_t w = q->width;
+    uint16_t rows = Q565_OUTPUT_PIXELS / w; // Rows per band
+    uint16_t prev = 0;
+    uint32_t run = 0;
+    uint8_t cur = 0;
+
+    for (uint16_t row = 0; row < q->height; row += rows) {
+        uint16_t h = (q->height - row < rows) ? q->height - row : rows;
+        uint16_t *ptr = q->out[cur];
+        uint16_t *end = ptr + w * h;
+
+        while (ptr < end) {
+            if (run) { // Runs may continue into the next band
+                uint32_t n = (run < (uint32_t)(end - ptr)) ? run : (uint32_t)(end - ptr);
+                run -= n;
+                while (n--)
+                    *ptr++ = prev;
+                continue;
+            }
+
+            uint8_t op = q565Byte(q);
+
+            if (op < 0x40) { // Table entry
+                prev = q->table[op];
+                *ptr++ = prev;
+                continue;
+            }
+
+            if (op < 0x80) { // Small difference
+                uint16_t r = ((prev >> 11) + ((op >> 4) & 3) - 2) & 0x1F;
+                uint16_t g = ((prev >> 5) + ((op >> 2) & 3) - 2) & 0x3F;
+                uint16_t b = (prev + (op & 3) - 2) & 0x1F;
+                prev = r << 11 | g << 5 | b;
+            } else if (op < 0xC0) { // Green difference, red and blue relative to half of it
+                uint8_t rb = q565Byte(q);
+                int16_t dg = (op & 0x3F) - 32;
+                uint16_t r = ((prev >> 11) + (dg >> 1) + (rb >> 4) - 8) & 0x1F;
+                uint16_t g = ((prev >> 5) + dg) & 0x3F;
+                uint16_t b = (prev + (dg >> 1) + (rb & 15) - 8) & 0x1F;
+                prev = r << 11 | g << 5 | b;
+            } else if (op < 0xFE) { // Short run
+                run = op - 0xBF;
+                continue;
+            } else if (op == 0xFE) { // Raw pixel
+                prev = q565Word(q);
+            } else { // Long run
+                run = q565Word(q);
+                continue;
+            }
+
+            q->table[Q565_HASH(prev)] = prev;
+            *ptr++ = prev;
+        }
+
+        if (q->eof)
+            break;
+
+        if (output)
+            output(q->ctx, x, y + row, w, h, q->out[cur]);
+        else
+            pushImageDMA(x, y + row, w, h, q->out[cur]);
+
+        cur ^= 1; // Fill the other buffer while this one is sent
+    }
+
+    if (!output)
+        dmaWait();
+
+    return !q->eof;
+}
+
+#endif // LOAD_Q565
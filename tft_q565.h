@@ -0,0 +1,39 @@
+#pragma once
+
+// Lossless RGB565 image decoder drawing straight to the TFT, see tft_q565.c
+
+#ifdef LOAD_Q565
+
+#ifndef Q565_INPUT_BUFFER
+#define Q565_INPUT_BUFFER 256 // Bytes fetched per imageReadCallback call
+#endif
+
+#ifndef Q565_OUTPUT_PIXELS
+#define Q565_OUTPUT_PIXELS 640 // Pixels in each of the two output buffers, at least the image width
+#endif
+
+typedef struct {
+    uint16_t width, height; // Image size, valid after q565Open()
+
+    // Compressed data source
+    const uint8_t *in;
+    uint32_t inLen, inPos;
+    imageReadCallback read;
+    void *ctx; // Passed to the read and output callbacks
+    bool eof;
+
+    uint16_t table[64]; // Recently seen colours, indexed by hash
+    uint16_t out[2][Q565_OUTPUT_PIXELS]; // Bands of whole rows, one is sent while the other is filled
+    uint8_t buffer[Q565_INPUT_BUFFER];
+} q565Decoder;
+
+// Read the header of a Q565 image (made by Tools/q565_pack.py) held in memory (data, size) or,
+// if data is NULL, fetched through read(ctx, ...). Fails if the image is wider than
+// Q565_OUTPUT_PIXELS. The decoder is under 3kB, it can be static or on the stack
+bool q565Open(q565Decoder *q, const uint8_t *data, uint32_t size, imageReadCallback read, void *ctx);
+
+// Decode the image with its top left at x,y. Bands of rows are pushed to the TFT by DMA while the
+// next is decoded, or given to output(ctx, ...) if not NULL
+bool q565Decode(q565Decoder *q, int32_t x, int32_t y, imageOutputCallback output);
+
+#endif // LOAD_Q565
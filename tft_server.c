@@ -0,0 +1,298 @@
+/***************************************************
+  Render server for the TFT library.
+
+  The drawing API keeps its state in file statics
+  and is not thread safe, so with an RTOS one display
+  task makes every call. Other tasks queue commands
+  into their own single producer ring (parameters and
+  strings copied, images referenced) and go on, the
+  server runs them in order per queue. An image is
+  sent by DMA while the next commands are taken, the
+  following draw waits for it.
+ ****************************************************/
+
+#include "board.h"
+
+#ifdef LOAD_RENDER_SERVER
+
+#ifdef RENDER_PTHREAD
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#if (RENDER_QUEUE_LEN & (RENDER_QUEUE_LEN - 1)) != 0
+#error RENDER_QUEUE_LEN must be a power of 2
+#endif
+
+static struct {
+    renderPort port;
+    renderQueue *queue[RENDER_QUEUES];
+    uint8_t queues;
+    bool stop; // Set by another task, read with __atomic
+} server;
+
+/***************************************************************************************
+** Function name:           renderBegin
+** Description:             Set the RTOS hooks, before any task uses the server
+***************************************************************************************/
+void renderBegin(const renderPort *port)
+{
+    server.port = *port;
+    server.queues = 0;
+    server.stop = false;
+}
+
+/***************************************************************************************
+** Function name:           renderAttach
+** Description:             Add a producer queue, each task pushing commands has its own
+***************************************************************************************/
+bool renderAttach(renderQueue *q)
+{
+    if (server.queues >= RENDER_QUEUES)
+        return false;
+
+    q->head = 0;
+    q->tail = 0;
+    server.queue[server.queues++] = q;
+    return true;
+}
+
+/***************************************************************************************
+** Function name:           renderPush
+** Description:             Copy a command into the ring and wake the server
+***************************************************************************************/
+bool renderPush(renderQueue *q, const renderCmd *cmd)
+{
+    uint32_t head = q->head;
+
+    if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE) >= RENDER_QUEUE_LEN)
+        return false;
+
+    q->cmd[head & (RENDER_QUEUE_LEN - 1)] = *cmd;
+    // The command is complete before the server can see the new head
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+
+    server.port.wake(server.port.ctx);
+    return true;
+}
+
+static void renderPut(renderQueue *q, const renderCmd *cmd)
+{
+    while (!renderPush(q, cmd))
+        server.port.yield(server.port.ctx);
+}
+
+/***************************************************************************************
+** Function name:           renderExec
+** Description:             Make the drawing call for one command, in the display task
+***************************************************************************************/
+static void renderExec(const renderCmd *c)
+{
+    switch (c->op) {
+    case RENDER_FILL_SCREEN:
+        fillScreen(c->color);
+        break;
+    case RENDER_FILL_RECT:
+        fillRect(c->x, c->y, c->w, c->h, c->color);
+        break;
+    case RENDER_DRAW_RECT:
+        drawRect(c->x, c->y, c->w, c->h, c->color);
+        break;
+    case RENDER_LINE:
+        drawLine(c->x, c->y, c->w, c->h, c->color);
+        break;
+    case RENDER_PIXEL:
+        drawPixel(c->x, c->y, c->color);
+        break;
+    case RENDER_CIRCLE:
+        drawCircle(c->x, c->y, c->w, c->color);
+        break;
+    case RENDER_FILL_CIRCLE:
+        fillCircle(c->x, c->y, c->w, c->color);
+        break;
+    case RENDER_IMAGE:
+        pushImageDMA(c->x, c->y, c->w, c->h, c->image);
+        break;
+    case RENDER_TEXT:
+        // The text state belongs to the display task, each command brings its own
+        setTextColorAll(c->color, c->text.bg, c->text.fill);
+        setTextDatum(c->text.datum);
+        setTextSize(c->text.size);
+        drawString(c->text.str, c->x, c->y, c->text.font);
+        break;
+    case RENDER_CALL:
+        dmaWait();
+        c->call.fn(c->call.ctx);
+        break;
+    }
+}
+
+/***************************************************************************************
+** Function name:           renderRun
+** Description:             Run the queued commands, up to RENDER_BURST from each queue
+***************************************************************************************/
+uint32_t renderRun(void)
+{
+    renderQueue *q;
+    uint32_t head, tail, run, n = 0;
+    uint8_t i;
+
+    for (i = 0; i < server.queues; i++) {
+        q = server.queue[i];
+        head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+        tail = q->tail;
+
+        for (run = 0; tail != head && run < RENDER_BURST; run++) {
+            renderExec(&q->cmd[tail & (RENDER_QUEUE_LEN - 1)]);
+            // Only now can the producer reuse the slot
+            __atomic_store_n(&q->tail, ++tail, __ATOMIC_RELEASE);
+        }
+        n += run;
+    }
+
+    return n;
+}
+
+/***************************************************************************************
+** Function name:           renderServe
+** Description:             Body of the display task, waits for work when the queues are empty
+***************************************************************************************/
+void renderServe(void)
+{
+    while (!__atomic_load_n(&server.stop, __ATOMIC_ACQUIRE)) {
+        if (renderRun())
+            continue;
+        dmaWait(); // Let the bus go while idle
+        server.port.wait(server.port.ctx);
+    }
+    dmaWait();
+}
+
+void renderStop(void)
+{
+    __atomic_store_n(&server.stop, true, __ATOMIC_RELEASE);
+    server.port.wake(server.port.ctx);
+}
+
+/***************************************************************************************
+** Function name:           renderFillScreen etc.
+** Description:             Producer side, copy the parameters into a command and queue it
+***************************************************************************************/
+void renderFillScreen(renderQueue *q, uint32_t color)
+{
+    renderCmd c = { .op = RENDER_FILL_SCREEN, .color = color };
+
+    renderPut(q, &c);
+}
+
+void renderFillRect(renderQueue *q, int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
+{
+    renderCmd c = { .op = RENDER_FILL_RECT, .x = x, .y = y, .w = w, .h = h, .color = color };
+
+    renderPut(q, &c);
+}
+
+void renderDrawRect(renderQueue *q, int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color)
+{
+    renderCmd c = { .op = RENDER_DRAW_RECT, .x = x, .y = y, .w = w, .h = h, .color = color };
+
+    renderPut(q, &c);
+}
+
+void renderLine(renderQueue *q, int32_t xs, int32_t ys, int32_t xe, int32_t ye, uint32_t color)
+{
+    renderCmd c = { .op = RENDER_LINE, .x = xs, .y = ys, .w = xe, .h = ye, .color = color };
+
+    renderPut(q, &c);
+}
+
+void renderPixel(renderQueue *q, int32_t x, int32_t y, uint32_t color)
+{
+    renderCmd c = { .op = RENDER_PIXEL, .x = x, .y = y, .color = color };
+
+    renderPut(q, &c);
+}
+
+void renderCircle(renderQueue *q, int32_t x, int32_t y, int32_t r, uint32_t color, bool fill)
+{
+    renderCmd c = { .op = fill ? RENDER_FILL_CIRCLE : RENDER_CIRCLE, .x = x, .y = y, .w = r, .color = color };
+
+    renderPut(q, &c);
+}
+
+void renderImage(renderQueue *q, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data)
+{
+    renderCmd c = { .op = RENDER_IMAGE, .x = x, .y = y, .w = w, .h = h, .image = data };
+
+    renderPut(q, &c);
+}
+
+void renderText(renderQueue *q, const char *string, int32_t x, int32_t y, uint8_t font, uint8_t datum,
+                uint8_t size, uint32_t color, uint32_t bg, bool fill)
+{
+    renderCmd c = { .op = RENDER_TEXT, .x = x, .y = y, .color = color };
+    uint8_t i;
+
+    c.text.bg = bg;
+    c.text.font = font;
+    c.text.datum = datum;
+    c.text.size = size;
+    c.text.fill = fill;
+    for (i = 0; i < RENDER_TEXT_MAX - 1 && string[i]; i++)
+        c.text.str[i] = string[i];
+    c.text.str[i] = 0;
+
+    renderPut(q, &c);
+}
+
+void renderCall(renderQueue *q, void (*fn)(void *ctx), void *ctx)
+{
+    renderCmd c = { .op = RENDER_CALL, .call = { fn, ctx } };
+
+    renderPut(q, &c);
+}
+
+#ifdef RENDER_PTHREAD
+/***************************************************************************************
+** Function name:           renderPthreadPort
+** Description:             RTOS hooks for a host build, the server runs in a pthread
+***************************************************************************************/
+static pthread_mutex_t renderMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t renderCond = PTHREAD_COND_INITIALIZER;
+static bool renderWoken;
+
+static void pthreadWait(void *ctx)
+{
+    (void)ctx;
+    pthread_mutex_lock(&renderMutex);
+    while (!renderWoken)
+        pthread_cond_wait(&renderCond, &renderMutex);
+    renderWoken = false;
+    pthread_mutex_unlock(&renderMutex);
+}
+
+static void pthreadWake(void *ctx)
+{
+    (void)ctx;
+    pthread_mutex_lock(&renderMutex);
+    renderWoken = true;
+    pthread_cond_signal(&renderCond);
+    pthread_mutex_unlock(&renderMutex);
+}
+
+static void pthreadYield(void *ctx)
+{
+    (void)ctx;
+    sched_yield();
+}
+
+void renderPthreadPort(renderPort *port)
+{
+    port->wait = pthreadWait;
+    port->wake = pthreadWake;
+    port->yield = pthreadYield;
+    port->ctx = NULL;
+}
+#endif
+
+#endif // LOAD_RENDER_SERVER
@@ -0,0 +1,93 @@
+#pragma once
+
+// Render server, one display task draws for all the others, see tft_server.c
+
+#ifdef LOAD_RENDER_SERVER
+
+#ifndef RENDER_QUEUE_LEN
+#define RENDER_QUEUE_LEN 32 // Commands per producer queue, a power of 2
+#endif
+
+#ifndef RENDER_QUEUES
+#define RENDER_QUEUES 4 // Producer queues the server takes commands from
+#endif
+
+#ifndef RENDER_BURST
+#define RENDER_BURST 16 // Commands run from one queue before moving to the next
+#endif
+
+#ifndef RENDER_TEXT_MAX
+#define RENDER_TEXT_MAX 32 // Longest string copied into a command, with its terminator
+#endif
+
+#define RENDER_FILL_SCREEN 0
+#define RENDER_FILL_RECT   1
+#define RENDER_DRAW_RECT   2
+#define RENDER_LINE        3 // x, y to w, h
+#define RENDER_PIXEL       4
+#define RENDER_CIRCLE      5 // Radius in w
+#define RENDER_FILL_CIRCLE 6
+#define RENDER_IMAGE       7 // Sent by DMA while the next commands are taken
+#define RENDER_TEXT        8
+#define RENDER_CALL        9 // Runs once everything before it is on the display
+
+typedef struct {
+    uint8_t op; // RENDER_ value
+    int32_t x, y, w, h;
+    uint32_t color;
+    union {
+        const uint16_t *image; // Not copied, must stay unchanged until a later RENDER_CALL runs
+        struct {
+            void (*fn)(void *ctx);
+            void *ctx;
+        } call;
+        struct {
+            uint32_t bg;
+            uint8_t font, datum, size;
+            bool fill; // Draw the background too
+            char str[RENDER_TEXT_MAX];
+        } text;
+    };
+} renderCmd;
+
+// Lock-free ring with one producer task and the server as its consumer
+typedef struct {
+    renderCmd cmd[RENDER_QUEUE_LEN];
+    uint32_t head; // Written by the producer only
+    uint32_t tail; // Written by the server only
+} renderQueue;
+
+// What the server needs from the RTOS. wake() must be remembered if the server is not waiting
+// yet (binary semaphore, task notification), yield() lets a producer wait for room
+typedef struct {
+    void (*wait)(void *ctx);
+    void (*wake)(void *ctx);
+    void (*yield)(void *ctx);
+    void *ctx;
+} renderPort;
+
+void renderBegin(const renderPort *port);
+bool renderAttach(renderQueue *q); // Add a producer queue, before the server starts, false when full
+bool renderPush(renderQueue *q, const renderCmd *cmd); // Queue a copy of cmd, false when full
+uint32_t renderRun(void); // Run what is queued now, returns the commands run
+void renderServe(void); // The display task, returns after renderStop()
+void renderStop(void);
+
+// Producer side, these wait for room in the queue
+void renderFillScreen(renderQueue *q, uint32_t color);
+void renderFillRect(renderQueue *q, int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+void renderDrawRect(renderQueue *q, int32_t x, int32_t y, int32_t w, int32_t h, uint32_t color);
+void renderLine(renderQueue *q, int32_t xs, int32_t ys, int32_t xe, int32_t ye, uint32_t color);
+void renderPixel(renderQueue *q, int32_t x, int32_t y, uint32_t color);
+void renderCircle(renderQueue *q, int32_t x, int32_t y, int32_t r, uint32_t color, bool fill);
+void renderImage(renderQueue *q, int32_t x, int32_t y, int32_t w, int32_t h, const uint16_t *data);
+// Copies up to RENDER_TEXT_MAX - 1 characters of string, drawn with drawString()
+void renderText(renderQueue *q, const char *string, int32_t x, int32_t y, uint8_t font, uint8_t datum,
+                uint8_t size, uint32_t color, uint32_t bg, bool fill);
+void renderCall(renderQueue *q, void (*fn)(void *ctx), void *ctx);
+
+#ifdef RENDER_PTHREAD
+void renderPthreadPort(renderPort *port); // Host stand-in for the RTOS, a mutex and condition
+#endif
+
+#endif // LOAD_RENDER_SERVER
@@ -0,0 +1,265 @@
+/***************************************************
+  Screen capture for the TFT library.
+
+  An area of the TFT (or of an RGB565 buffer) is
+  read a strip of rows at a time and encoded row by
+  row into a BMP or PNG file handed to a byte sink,
+  e.g. a UART or USB CDC port, so only one strip and
+  one encoded row are held in RAM. PNG rows are sent
+  as stored deflate blocks, one IDAT chunk each, so
+  no compressor state is needed.
+ ****************************************************/
+
+#include "board.h"
+
+#ifdef LOAD_SCREENSHOT
+
+// CRC-32 (poly 0xEDB88320) a nibble at a time
+static const uint32_t crcNibble[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+static uint32_t shotCrc(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    while (len--) {
+        crc ^= *buf++;
+        crc = (crc >> 4) ^ crcNibble[crc & 15];
+        crc = (crc >> 4) ^ crcNibble[crc & 15];
+    }
+    return crc;
+}
+
+static uint8_t *put16(uint8_t *p, uint16_t v) // Little endian
+{
+    *p++ = v;
+    *p++ = v >> 8;
+    return p;
+}
+
+static uint8_t *put32(uint8_t *p, uint32_t v) // Little endian
+{
+    return put16(put16(p, v), v >> 16);
+}
+
+static uint8_t *put32BE(uint8_t *p, uint32_t v)
+{
+    *p++ = v >> 24;
+    *p++ = v >> 16;
+    *p++ = v >> 8;
+    *p++ = v;
+    return p;
+}
+
+/***************************************************************************************
+** Function name:           shotWrite
+** Description:             Hand bytes to the sink, nothing once it has failed
+***************************************************************************************/
+static void shotWrite(screenShot *s, const uint8_t *buf, uint32_t len)
+{
+    if (s->error)
+        return;
+    if (s->write(s->ctx, buf, len))
+        s->bytes += len;
+    else
+        s->error = true;
+}
+
+/***************************************************************************************
+** Function name:           shotChunk
+** Description:             Send the PNG chunk of len bytes whose data is at out + 8
+***************************************************************************************/
+static void shotChunk(screenShot *s, const char *type, uint32_t len)
+{
+    uint8_t *p = s->out;
+    put32BE(p, len);
+    memcpy(p + 4, type, 4);
+    put32BE(p + 8 + len, shotCrc(0xFFFFFFFF, p + 4, len + 4) ^ 0xFFFFFFFF);
+    shotWrite(s, p, len + 12);
+}
+
+/***************************************************************************************
+** Function name:           shotRow
+** Description:             Encode one row of RGB565 pixels and send it
+***************************************************************************************/
+static void shotRow(screenShot *s, const uint16_t *line)
+{
+    int32_t w = s->w;
+
+    if (s->format == SHOT_BMP) {
+        uint8_t *p = s->out;
+        for (int32_t i = 0; i < w; i++)
+            p = put16(p, line[i]);
+        while ((p - s->out) & 3) // Rows are padded to 4 bytes
+            *p++ = 0;
+        shotWrite(s, s->out, p - s->out);
+        return;
+    }
+
+    // IDAT holding the zlib header before the first row, a stored block and the Adler-32 after the last
+    uint8_t *p = s->out + 8;
+    if (!s->row) {
+        *p++ = 0x78; // Deflate, 32k window
+        *p++ = 0x01;
+    }
+    uint16_t len = 1 + 3 * w;
+    *p++ = (s->row == s->h - 1); // Final block flag, stored type
+    p = put16(p, len);
+    p = put16(p, ~len);
+
+    uint8_t *raw = p;
+    *p++ = 0; // Filter type none
+    for (int32_t i = 0; i < w; i++) {
+        uint16_t c = line[i];
+        *p++ = (c >> 8 & 0xF8) | c >> 13;
+        *p++ = (c >> 3 & 0xFC) | (c >> 9 & 0x03);
+        *p++ = (c << 3 & 0xF8) | (c >> 2 & 0x07);
+    }
+
+    // Adler-32, reduced often enough that the sums cannot overflow
+    uint32_t a = s->adler & 0xFFFF, b = s->adler >> 16;
+    while (raw < p) {
+        uint32_t n = (p - raw < 4096) ? p - raw : 4096;
+        while (n--) {
+            a += *raw++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    s->adler = b << 16 | a;
+
+    if (s->row == s->h - 1)
+        p = put32BE(p, s->adler);
+
+    shotChunk(s, "IDAT", p - (s->out + 8));
+}
+
+/***************************************************************************************
+** Function name:           shotOpen
+** Description:             Start a capture and send the file header
+***************************************************************************************/
+bool shotOpen(screenShot *shot, int32_t x, int32_t y, int32_t w, int32_t h, uint8_t format,
+              const uint16_t *source, int32_t stride, imageWriteCallback write, void *ctx)
+{
+    memset(shot, 0, sizeof(screenShot));
+
+    shot->x = x;
+    shot->y = y;
+    shot->w = w;
+    shot->h = h;
+    shot->format = format;
+    shot->source = source;
+    shot->stride = stride;
+    shot->write = write;
+    shot->ctx = ctx;
+    shot->adler = 1;
+
+    if (w < 1 || h < 1 || w > SHOT_MAX_WIDTH || w > SHOT_STRIP_PIXELS || format > SHOT_PNG || !write) {
+        shot->error = true;
+        return false;
+    }
+
+    uint8_t *p = shot->out;
+
+    if (format == SHOT_BMP) {
+        uint32_t rowBytes = (2 * w + 3) & ~3;
+        *p++ = 'B';
+        *p++ = 'M';
+        p = put32(p, 66 + rowBytes * h); // File size
+        p = put32(p, 0);
+        p = put32(p, 66); // Offset of the pixels
+        p = put32(p, 40); // BITMAPINFOHEADER
+        p = put32(p, w);
+        p = put32(p, -h); // Negative height, rows top down
+        p = put16(p, 1); // Planes
+        p = put16(p, 16); // Bits per pixel
+        p = put32(p, 3); // BI_BITFIELDS
+        p = put32(p, rowBytes * h);
+        p = put32(p, 2835); // 72 dpi
+        p = put32(p, 2835);
+        p = put32(p, 0);
+        p = put32(p, 0);
+        p = put32(p, 0xF800); // Red, green and blue masks
+        p = put32(p, 0x07E0);
+        p = put32(p, 0x001F);
+        shotWrite(shot, shot->out, p - shot->out);
+    } else {
+        static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+        shotWrite(shot, signature, 8);
+
+        p += 8;
+        p = put32BE(p, w);
+        p = put32BE(p, h);
+        *p++ = 8; // Bit depth
+        *p++ = 2; // RGB
+        *p++ = 0; // Deflate
+        *p++ = 0; // Adaptive filtering
+        *p++ = 0; // Not interlaced
+        shotChunk(shot, "IHDR", 13);
+    }
+
+    return !shot->error;
+}
+
+/***************************************************************************************
+** Function name:           shotStep
+** Description:             Read and send the next strip, false once done or failed
+***************************************************************************************/
+bool shotStep(screenShot *shot)
+{
+    if (shot->error || shot->row >= shot->h)
+        return false;
+
+    int32_t rows = SHOT_STRIP_PIXELS / shot->w;
+    if (rows > shot->h - shot->row)
+        rows = shot->h - shot->row;
+
+    const uint16_t *line;
+    int32_t step;
+
+    if (shot->source) {
+        line = shot->source + (shot->y + shot->row) * shot->stride + shot->x;
+        step = shot->stride;
+    } else {
+        // Any part off the screen is left black
+        memset(shot->strip, 0, shot->w * rows * sizeof(uint16_t));
+        readRect(shot->x, shot->y + shot->row, shot->w, rows, shot->strip);
+        for (int32_t i = 0; i < shot->w * rows; i++) // readRect() gives the bytes swapped
+            shot->strip[i] = shot->strip[i] << 8 | shot->strip[i] >> 8;
+        line = shot->strip;
+        step = shot->w;
+    }
+
+    while (rows-- && !shot->error) {
+        shotRow(shot, line);
+        line += step;
+        shot->row++;
+    }
+
+    if (shot->row < shot->h)
+        return !shot->error;
+
+    if (shot->format == SHOT_PNG)
+        shotChunk(shot, "IEND", 0);
+
+    return false;
+}
+
+/***************************************************************************************
+** Function name:           shotCapture
+** Description:             Capture an area in one call
+***************************************************************************************/
+bool shotCapture(screenShot *shot, int32_t x, int32_t y, int32_t w, int32_t h, uint8_t format,
+                 const uint16_t *source, int32_t stride, imageWriteCallback write, void *ctx)
+{
+    if (!shotOpen(shot, x, y, w, h, format, source, stride, write, ctx))
+        return false;
+
+    while (shotStep(shot))
+        ;
+
+    return !shot->error;
+}
+
+#endif // LOAD_SCREENSHOT
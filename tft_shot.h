@@ -0,0 +1,54 @@
+#pragma once
+
+// Screen capture streamed as BMP or PNG to a byte sink, see tft_shot.c
+
+#ifdef LOAD_SCREENSHOT
+
+#ifndef SHOT_MAX_WIDTH
+#define SHOT_MAX_WIDTH 480 // Widest capture, sets the size of the output row buffer
+#endif
+
+#ifndef SHOT_STRIP_PIXELS
+#define SHOT_STRIP_PIXELS 1920 // Pixels read from the TFT per shotStep(), at least the capture width
+#endif
+
+#define SHOT_BMP 0 // 16-bit RGB565 bitmap, rows top down
+#define SHOT_PNG 1 // 24-bit RGB PNG with stored (uncompressed) deflate blocks
+
+typedef struct {
+    int32_t x, y, w, h; // Area captured
+    uint8_t format; // SHOT_BMP or SHOT_PNG
+
+    // Pixel source, the TFT when NULL
+    const uint16_t *source;
+    int32_t stride;
+
+    imageWriteCallback write;
+    void *ctx; // Passed to the write callback
+    bool error; // The sink refused data or the area is bad
+    uint32_t bytes; // Written so far
+
+    int32_t row; // Next row to encode
+    uint32_t crc; // PNG chunk CRC-32
+    uint32_t adler; // PNG image data Adler-32
+
+    uint16_t strip[SHOT_STRIP_PIXELS];
+    uint8_t out[SHOT_MAX_WIDTH * 3 + 32]; // One encoded row with its chunk framing
+} screenShot;
+
+// Start a capture of the w x h area at x,y in format, sending the file header to write(ctx, ...).
+// source NULL reads the TFT with readRect(), else the area is taken from an RGB565 buffer with rows
+// stride pixels long, e.g. an off-screen frame. Fails if w is over SHOT_MAX_WIDTH or the sink fails
+bool shotOpen(screenShot *shot, int32_t x, int32_t y, int32_t w, int32_t h, uint8_t format,
+              const uint16_t *source, int32_t stride, imageWriteCallback write, void *ctx);
+
+// Encode and send the next strip of rows, call again from the main loop until it returns false.
+// Each call holds the TFT only for one readRect(), so the UI keeps running between strips.
+// The capture is complete when it returns false with shot->error clear
+bool shotStep(screenShot *shot);
+
+// Capture the whole area at once, returns true if it all went to the sink
+bool shotCapture(screenShot *shot, int32_t x, int32_t y, int32_t w, int32_t h, uint8_t format,
+                 const uint16_t *source, int32_t stride, imageWriteCallback write, void *ctx);
+
+#endif // LOAD_SCREENSHOT
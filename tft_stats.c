@@ -0,0 +1,80 @@
+/***************************************************
+  Instrumentation for the TFT library.
+
+  With TFT_STATS defined for the whole build the
+  drawing functions count their calls and time
+  themselves, and the SPI layer counts the bytes it
+  sends, DMA and CPU fed transfers and the time it
+  spends waiting for the bus.
+ ****************************************************/
+
+#include "board.h"
+
+#ifdef TFT_STATS
+
+tftStats tftStat;
+
+static const char *const statNames[STAT_FUNCS] = {
+    "fillScreen", "fillRect", "drawRect", "drawFastHLine", "drawFastVLine", "drawLine",
+    "drawPixel", "drawCircle", "fillCircle", "drawChar", "drawString", "pushImage",
+    "pushImageDMA", "pushRect", "readRect", "readPixel", "setWindow"
+};
+
+/***************************************************************************************
+** Function name:           statsReset
+** Description:             Clear the counters and make sure the cycle counter runs
+***************************************************************************************/
+void statsReset(void)
+{
+#ifdef __arm__
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    memset(&tftStat, 0, sizeof(tftStat));
+}
+
+void statsSnapshot(tftStats *stats)
+{
+    *stats = tftStat;
+}
+
+// Decimal text of v at the end of buf[21], newlib-nano's printf has no %llu
+static const char *statU64(char *buf, uint64_t v)
+{
+    char *p = buf + 20;
+
+    *p = 0;
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+
+    return p;
+}
+
+/***************************************************************************************
+** Function name:           statsDump
+** Description:             Write the counters as text, one line per function used
+***************************************************************************************/
+void statsDump(bool (*write)(void *ctx, const uint8_t *buf, uint32_t len), void *ctx)
+{
+    tftStats s = tftStat; // Counts keep going while the lines are sent
+    char line[100], a[21], b[21];
+    int i, n;
+
+    for (i = 0; i < STAT_FUNCS; i++) {
+        if (!s.calls[i])
+            continue;
+        n = snprintf(line, sizeof(line), "%-13s %8lu calls %11s cyc %8s avg\r\n", statNames[i],
+                     (unsigned long)s.calls[i], statU64(a, s.cycles[i]),
+                     statU64(b, s.cycles[i] / s.calls[i]));
+        if (!write(ctx, (const uint8_t *)line, n))
+            return;
+    }
+
+    n = snprintf(line, sizeof(line), "bytes %s dma %lu slow %lu wait %s cyc\r\n", statU64(a, s.bytes),
+                 (unsigned long)s.dma, (unsigned long)s.slow, statU64(b, s.waitCycles));
+    write(ctx, (const uint8_t *)line, n);
+}
+
+#endif // TFT_STATS
@@ -0,0 +1,83 @@
+#pragma once
+
+// Call counts and timings of the drawing functions and the SPI transfers, see tft_stats.c.
+// TFT_STATS has to reach display_hal_f4.c too, so define it for the whole build (-DTFT_STATS)
+
+#ifdef TFT_STATS
+
+#ifndef __arm__
+#include <time.h>
+#endif
+
+#define STAT_FILL_SCREEN    0
+#define STAT_FILL_RECT      1
+#define STAT_DRAW_RECT      2
+#define STAT_FAST_HLINE     3
+#define STAT_FAST_VLINE     4
+#define STAT_DRAW_LINE      5
+#define STAT_DRAW_PIXEL     6
+#define STAT_DRAW_CIRCLE    7
+#define STAT_FILL_CIRCLE    8
+#define STAT_DRAW_CHAR      9
+#define STAT_DRAW_STRING    10
+#define STAT_PUSH_IMAGE     11
+#define STAT_PUSH_IMAGE_DMA 12
+#define STAT_PUSH_RECT      13
+#define STAT_READ_RECT      14
+#define STAT_READ_PIXEL     15
+#define STAT_SET_WINDOW     16 // Also the windows drawPixel() and setSpanWindow() set themselves
+#define STAT_FUNCS          17
+
+typedef struct {
+    uint32_t calls[STAT_FUNCS];
+    uint64_t cycles[STAT_FUNCS]; // Including the functions they call
+    uint64_t bytes; // Sent to the display
+    uint32_t dma; // displayTransfer16() and displayTransfer8Buf() calls
+    uint32_t slow; // displayTransfer16Slow() calls, the CPU feeds the SPI
+    uint64_t waitCycles; // Busy waiting in displayTransfer16(), displayTransfer16End() and dff()
+} tftStats;
+
+extern tftStats tftStat;
+
+// CPU cycles from the DWT on the target, nanoseconds on a host
+static inline uint32_t statClock(void)
+{
+#ifdef __arm__
+    return DWT->CYCCNT;
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+typedef struct {
+    uint8_t id;
+    uint32_t start;
+} statScope;
+
+static inline void statEnd(statScope *s)
+{
+    tftStat.calls[s->id]++;
+    tftStat.cycles[s->id] += statClock() - s->start;
+}
+
+// First line of an instrumented function, counted and timed on every return
+#define STAT_CALL(id) statScope statScope_ __attribute__((cleanup(statEnd))) = { id, statClock() }
+#define STAT_ADD(field, n) (tftStat.field += (n))
+#define STAT_WAIT(wait) do { uint32_t statWait_ = statClock(); wait; tftStat.waitCycles += statClock() - statWait_; } while (0)
+
+void statsReset(void); // Clear the counters, on the target it also starts the DWT cycle counter
+void statsSnapshot(tftStats *stats); // Copy of the counters
+// One line per function called since the reset, then the transfer totals, to a byte sink
+// such as an imageWriteCallback for the serial console
+void statsDump(bool (*write)(void *ctx, const uint8_t *buf, uint32_t len), void *ctx);
+
+#else
+
+#define STAT_CALL(id)
+#define STAT_ADD(field, n)
+#define STAT_WAIT(wait) wait
+
+#endif // TFT_STATS